@@ -0,0 +1,747 @@
+#include "Benchmarks.h"
+#include "RenderQueue.h"
+#include "SimpleShader.h"
+#include "OcclusionCuller.h"
+#include "LightClusters.h"
+#include "StateCache.h"
+#include "NullRenderBackend.h"
+#include "MaterialAtlas.h"
+#include "Texels.h"
+#include "Material.h"
+#include "Mesh.h"
+#include "PipelineState.h"
+#include "Camera.h"
+#include "Transform.h"
+#include "GeometryArena.h"
+#include "FrameGovernorTraces.h"
+#include "SoftwareRasterScene.h"
+#include <algorithm>
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+using namespace DirectX;
+
+// --------------------------------------------------------
+// Runs every benchmark with its default size
+// --------------------------------------------------------
+void Benchmarks::RunAll(RenderBackend* backend, ISimpleShader* shader, const wchar_t* shaderFile)
+{
+	printf("---- Benchmarks ----\n");
+	RenderQueueSort(100000);
+	OcclusionCulling(64, 2000);
+	LightBinning(1000);
+	MaterialBinds(600, 6);
+	ColorOutput(10);
+	PipelineStateBinds(600, 6, 3);
+	VertexTransforms(600);
+	GeometryArenaBinds(600, 6, 100000);
+	FrameGovernorTraces();
+	SoftwareRaster(400, 1280, 720);
+	if (shader)
+		ShaderSetData(shader, 1000000);
+	if (backend)
+		DrawBindings(backend, 2000);
+	if (backend && shaderFile)
+		ShaderLoad(backend, shaderFile, 50);
+	printf("--------------------\n");
+}
+
+// --------------------------------------------------------
+// Times the render queue's radix sort on random keys
+// --------------------------------------------------------
+void Benchmarks::RenderQueueSort(unsigned int packetCount)
+{
+	double ms = RenderQueue::BenchmarkSort(packetCount, 20);
+	printf("RenderQueue sort: %u packets in %.3f ms (%.1f ns/packet)\n",
+		packetCount, ms, ms * 1000000.0 / packetCount);
+}
+
+// --------------------------------------------------------
+// Times setting a matrix by name (string build + hash per
+// call) against setting it through a pre-resolved handle
+// --------------------------------------------------------
+void Benchmarks::ShaderSetData(ISimpleShader* shader, unsigned int calls)
+{
+	int handle = shader->GetVariableHandle("world");
+	if (handle < 0)
+	{
+		printf("SetData: shader has no \"world\" variable, skipped\n");
+		return;
+	}
+
+	// Alternate two values so every call really writes
+	DirectX::XMFLOAT4X4 values[2];
+	DirectX::XMStoreFloat4x4(&values[0], DirectX::XMMatrixIdentity());
+	DirectX::XMStoreFloat4x4(&values[1], DirectX::XMMatrixScaling(2.0f, 2.0f, 2.0f));
+
+	auto start = std::chrono::high_resolution_clock::now();
+	for (unsigned int i = 0; i < calls; i++)
+		shader->SetMatrix4x4("world", values[i & 1]);
+	auto mid = std::chrono::high_resolution_clock::now();
+	for (unsigned int i = 0; i < calls; i++)
+		shader->SetMatrix4x4(handle, values[i & 1]);
+	auto end = std::chrono::high_resolution_clock::now();
+
+	double byName = std::chrono::duration<double, std::milli>(mid - start).count();
+	double byHandle = std::chrono::duration<double, std::milli>(end - mid).count();
+	printf("SetData: %u calls by name %.3f ms (%.1f ns/call), by handle %.3f ms (%.1f ns/call)\n",
+		calls, byName, byName * 1000000.0 / calls, byHandle, byHandle * 1000000.0 / calls);
+}
+
+// --------------------------------------------------------
+// Times creating the same shader over and over, first with
+// the reflection cache off and then on.  The first cached
+// load writes the sidecar if it doesn't exist yet.
+// --------------------------------------------------------
+void Benchmarks::ShaderLoad(RenderBackend* backend, const wchar_t* shaderFile, unsigned int loads)
+{
+	bool wasEnabled = ShaderReflectionCache::IsEnabled();
+	double ms[2] = {};
+
+	for (int cached = 0; cached < 2; cached++)
+	{
+		ShaderReflectionCache::SetEnabled(cached == 1);
+		delete new SimpleVertexShader(backend, shaderFile); // Warm up, and write the sidecar
+
+		auto start = std::chrono::high_resolution_clock::now();
+		for (unsigned int i = 0; i < loads; i++)
+			delete new SimpleVertexShader(backend, shaderFile);
+		auto end = std::chrono::high_resolution_clock::now();
+
+		ms[cached] = std::chrono::duration<double, std::milli>(end - start).count() / loads;
+	}
+
+	ShaderReflectionCache::SetEnabled(wasEnabled);
+	printf("Shader load: %.3f ms reflecting, %.3f ms from the reflection cache\n", ms[0], ms[1]);
+}
+
+// --------------------------------------------------------
+// Times the occlusion culler on a synthetic track: two long
+// walls plus random boxes as occluders, then random boxes
+// to test, looking down the corridor
+// --------------------------------------------------------
+void Benchmarks::OcclusionCulling(unsigned int occluders, unsigned int tests)
+{
+	const int frames = 20;
+	XMFLOAT3 unitMin(-0.5f, -0.5f, -0.5f);
+	XMFLOAT3 unitMax(0.5f, 0.5f, 0.5f);
+
+	XMFLOAT4X4 view, proj;
+	XMStoreFloat4x4(&view, XMMatrixLookAtLH(XMVectorSet(0, 1, -5, 0), XMVectorSet(0, 1, 0, 0), XMVectorSet(0, 1, 0, 0)));
+	XMStoreFloat4x4(&proj, XMMatrixPerspectiveFovLH(0.25f * 3.1415926535f, 16.0f / 9.0f, 0.1f, 100.0f));
+
+	// Walls on either side, then boxes in the lanes
+	srand(1);
+	std::vector<XMFLOAT4X4> occluderWorlds(occluders);
+	for (unsigned int i = 0; i < occluders; i++)
+	{
+		XMMATRIX world;
+		if (i < 2)
+			world = XMMatrixScaling(1, 2, 100) * XMMatrixTranslation(i == 0 ? -3.0f : 3.0f, 1, 50);
+		else
+			world = XMMatrixScaling(1, 2, 1) * XMMatrixTranslation((float)(rand() % 5 - 2), 1, (float)(rand() % 60 + 2));
+		XMStoreFloat4x4(&occluderWorlds[i], world);
+	}
+
+	std::vector<XMFLOAT4X4> testWorlds(tests);
+	for (unsigned int i = 0; i < tests; i++)
+	{
+		XMMATRIX world = XMMatrixTranslation((float)(rand() % 9 - 4), 0.5f, (float)(rand() % 90 + 2));
+		XMStoreFloat4x4(&testWorlds[i], world);
+	}
+
+	OcclusionCuller culler;
+	double rasterMs = 0;
+	double testMs = 0;
+	unsigned int occluded = 0;
+	for (int f = 0; f < frames; f++)
+	{
+		culler.BeginFrame(view, proj);
+		for (unsigned int i = 0; i < occluders; i++)
+			culler.RenderOccluder(occluderWorlds[i], unitMin, unitMax);
+		for (unsigned int i = 0; i < tests; i++)
+			culler.IsVisible(testWorlds[i], unitMin, unitMax);
+
+		rasterMs += culler.GetStats().rasterMilliseconds;
+		testMs += culler.GetStats().testMilliseconds;
+		occluded = culler.GetStats().occluded;
+	}
+
+	printf("Occlusion: %u occluders rasterized in %.3f ms, %u boxes tested in %.3f ms (%u occluded)\n",
+		occluders, rasterMs / frames, tests, testMs / frames, occluded);
+}
+
+// --------------------------------------------------------
+// Times binning lights scattered down a track-like corridor,
+// single threaded and then with the worker pool
+// --------------------------------------------------------
+void Benchmarks::LightBinning(unsigned int lightCount)
+{
+	const int builds = 50;
+
+	XMFLOAT4X4 view, proj;
+	XMStoreFloat4x4(&view, XMMatrixLookAtLH(XMVectorSet(1, 2.5f, -1, 0), XMVectorSet(1, 1, 10, 0), XMVectorSet(0, 1, 0, 0)));
+	XMStoreFloat4x4(&proj, XMMatrixPerspectiveFovLH(1.7f, 16.0f / 9.0f, 0.1f, 500.0f));
+
+	srand(1);
+	std::vector<ClusterLight> lights(lightCount);
+	for (auto& l : lights)
+	{
+		l.position = XMFLOAT3((float)(rand() % 90) / 10.0f - 3.5f, (float)(rand() % 40) / 10.0f, (float)(rand() % 1000) / 10.0f);
+		l.range = 1.0f + (float)(rand() % 30) / 10.0f;
+		l.color = XMFLOAT3(1, 1, 1);
+		l.intensity = 1.0f;
+	}
+
+	LightClusters clusters(0, 1);
+	double ms[2] = {};
+	unsigned int threads[2] = { 1, 0 };
+	for (int pass = 0; pass < 2; pass++)
+	{
+		clusters.SetThreadCount(threads[pass]);
+		threads[pass] = clusters.GetThreadCount();
+
+		for (int b = 0; b < builds; b++)
+		{
+			clusters.Build(view, proj, 0.1f, 500.0f, 1280, 720, lights.data(), lightCount);
+			ms[pass] += clusters.GetStats().binMilliseconds;
+		}
+	}
+
+	const LightClusterStats& stats = clusters.GetStats();
+	printf("Light binning: %u lights (%u visible, %u refs, %u dropped) in %.3f ms on 1 thread, %.3f ms on %u\n",
+		lightCount, stats.visibleLights, stats.indices, stats.dropped, ms[0] / builds, ms[1] / builds, threads[1]);
+}
+
+// --------------------------------------------------------
+// Binds each draw's maps through a state cache, in
+// submission (random) order and in material order, and counts
+// the binds forwarded and the runs of draws that share all
+// of them - the most draws a single instanced call could cover.
+// Views are stand-in addresses; only their identity matters.
+// --------------------------------------------------------
+void Benchmarks::MaterialBinds(unsigned int draws, unsigned int materials)
+{
+	NullRenderBackend backend;
+	StateCache cache(&backend);
+
+	// A texture per map is four views a material, the atlas packs them into three
+	const unsigned int separateMaps = 4;
+	std::vector<char> views(materials * separateMaps);
+	std::vector<unsigned int> order(draws);
+	srand(1);
+	for (auto& m : order)
+		m = rand() % materials;
+
+	std::vector<unsigned int> sorted = order;
+	std::sort(sorted.begin(), sorted.end());
+
+	const char* layouts[2] = { "separate maps", "atlas" };
+	for (int atlas = 0; atlas < 2; atlas++)
+	{
+		unsigned int binds[2], batches[2];
+		for (int pass = 0; pass < 2; pass++)
+		{
+			const std::vector<unsigned int>& draw = pass ? sorted : order;
+			batches[pass] = 0;
+
+			cache.BeginFrame();
+			RenderResource* last = 0;
+			for (unsigned int d = 0; d < draws; d++)
+			{
+				// With the atlas every material binds material 0's arrays
+				unsigned int m = atlas ? 0 : draw[d];
+				unsigned int maps = atlas ? MATERIAL_ATLAS_MAP_COUNT : separateMaps;
+				for (unsigned int map = 0; map < maps; map++)
+					cache.PSSetShaderResource(map, (RenderResource*)&views[m * separateMaps + map]);
+
+				RenderResource* first = (RenderResource*)&views[m * separateMaps];
+				if (first != last) batches[pass]++;
+				last = first;
+			}
+			cache.BeginFrame();
+			binds[pass] = cache.GetStats().forwarded[STATE_CALL_SHADER_RESOURCE];
+		}
+
+		printf("Material binds (%s): %u draws of %u materials, %u binds / %u batches unsorted, %u binds / %u batches sorted\n",
+			layouts[atlas], draws, materials, binds[0], batches[0], binds[1], batches[1]);
+	}
+}
+
+// --------------------------------------------------------
+// Runs every albedo byte through both pipelines at a range of
+// lighting scales (what the shader's lighting multiplies the
+// linear albedo by), mimicking the hardware on each side:
+//  - old: UNORM read, pow(2.2), light, pow(1 / 2.2), UNORM write
+//  - new: sRGB read, light, sRGB write
+// The two gamma curves differ most in the darks, where sRGB
+// has its linear toe.
+// --------------------------------------------------------
+bool Benchmarks::ColorOutput(unsigned int toleranceLevels)
+{
+	const float scales[] = { 0.05f, 0.1f, 0.25f, 0.5f, 0.75f, 1.0f, 1.5f, 2.0f };
+	const unsigned int scaleCount = sizeof(scales) / sizeof(scales[0]);
+
+	unsigned int maxDiff = 0;
+	unsigned int worstByte = 0;
+	float worstScale = 0;
+	unsigned int roundTripErrors = 0;
+	double totalDiff = 0;
+	for (unsigned int s = 0; s < scaleCount; s++)
+	{
+		for (unsigned int b = 0; b < 256; b++)
+		{
+			float lit = powf(b / 255.0f, 2.2f) * scales[s];
+			float gamma = powf(lit < 1.0f ? lit : 1.0f, 1.0f / 2.2f);
+			int oldLevel = (int)(gamma * 255.0f + 0.5f);
+			int newLevel = LinearToSRGB(SRGBToLinear((unsigned char)b) * scales[s]);
+
+			unsigned int diff = (unsigned int)abs(newLevel - oldLevel);
+			totalDiff += diff;
+			if (diff > maxDiff)
+			{
+				maxDiff = diff;
+				worstByte = b;
+				worstScale = scales[s];
+			}
+		}
+	}
+
+	// Unlit, a texel must come back out as itself
+	for (unsigned int b = 0; b < 256; b++)
+		if (LinearToSRGB(SRGBToLinear((unsigned char)b)) != b)
+			roundTripErrors++;
+
+	bool pass = maxDiff <= toleranceLevels && roundTripErrors == 0;
+	printf("Color output (sRGB vs pow 2.2): max %u levels (byte %u at x%.2f), mean %.2f levels, %u round trip errors - %s\n",
+		maxDiff, worstByte, worstScale, totalDiff / (256.0 * scaleCount), roundTripErrors, pass ? "PASS" : "FAIL");
+	return pass;
+}
+
+// --------------------------------------------------------
+// Binds a mesh, four maps and a sampler per draw through a
+// state cache on a null backend, first copying each out as a
+// RenderRef (the old by-value getters, an atomic AddRef and
+// Release apiece) and then borrowing them from baked tables.
+// The objects come from the backend so their refcounting is
+// the real thing; only the fetching differs between the two.
+// --------------------------------------------------------
+void Benchmarks::DrawBindings(RenderBackend* backend, unsigned int draws)
+{
+	const int frames = 50;
+	const unsigned int maps = 4;
+
+	Vertex verts[3] = {};
+	unsigned int inds[3] = { 0, 1, 2 };
+	Mesh mesh(verts, 3, inds, 3, backend);
+
+	unsigned int texel = 0xFFFFFFFF;
+	TextureDesc texDesc = {};
+	texDesc.Type = RENDER_TEXTURE_2D;
+	texDesc.Width = 1;
+	texDesc.Height = 1;
+	texDesc.MipLevels = 1;
+	texDesc.ArraySize = 1;
+	texDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+	texDesc.Usage = RENDER_USAGE_IMMUTABLE;
+	texDesc.BindFlags = RENDER_BIND_SHADER_RESOURCE;
+	SubresourceData texData = { &texel, 4, 0 };
+
+	RenderRef<RenderTexture> views[maps];
+	for (unsigned int m = 0; m < maps; m++)
+		backend->CreateTexture(texDesc, &texData, views[m].GetAddressOf());
+
+	SamplerDesc samplerDesc = {};
+	samplerDesc.Filter = RENDER_FILTER_LINEAR;
+	samplerDesc.AddressMode = RENDER_ADDRESS_WRAP;
+	RenderRef<RenderSamplerState> sampler;
+	backend->CreateSamplerState(samplerDesc, sampler.GetAddressOf());
+
+	// What Material::BakeBindings() would make of these
+	MaterialBindings matBindings = {};
+	for (unsigned int m = 0; m < maps; m++)
+	{
+		matBindings.textures[m].handle = m;
+		matBindings.textures[m].srv = views[m].Get();
+	}
+	matBindings.textureCount = maps;
+	matBindings.samplerHandle = 0;
+	matBindings.sampler = sampler.Get();
+
+	// The binds go nowhere, whichever backend made the objects
+	NullRenderBackend nullBackend;
+	StateCache cache(&nullBackend);
+
+	double ms[2] = {};
+	for (int pass = 0; pass < 2; pass++)
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+		for (int f = 0; f < frames; f++)
+		{
+			cache.BeginFrame();
+			for (unsigned int d = 0; d < draws; d++)
+			{
+				if (pass == 0)
+				{
+					for (unsigned int m = 0; m < maps; m++)
+					{
+						RenderRef<RenderTexture> view = views[m];
+						cache.PSSetShaderResource(m, view.Get());
+					}
+					RenderRef<RenderSamplerState> samplerCopy = sampler;
+					cache.PSSetSampler(0, samplerCopy.Get());
+
+					RenderRef<RenderBuffer> vertexBuffer = mesh.vertexBuffer;
+					RenderRef<RenderBuffer> indexBuffer = mesh.indexBuffer;
+					unsigned int stride = sizeof(Vertex);
+					unsigned int offset = 0;
+					cache.IASetVertexBuffers(0, 1, vertexBuffer.GetAddressOf(), &stride, &offset);
+					cache.IASetIndexBuffer(indexBuffer.Get(), DXGI_FORMAT_R32_UINT, 0);
+					cache.DrawIndexed(mesh.GetIndexCount(), 0, 0);
+				}
+				else
+				{
+					for (unsigned int t = 0; t < matBindings.textureCount; t++)
+						cache.PSSetShaderResource(matBindings.textures[t].handle, matBindings.textures[t].srv);
+					cache.PSSetSampler(matBindings.samplerHandle, matBindings.sampler);
+
+					const MeshBindings& meshBindings = mesh.GetBindings();
+					cache.IASetVertexBuffers(0, 1, &meshBindings.vertexBuffer, &meshBindings.stride, &meshBindings.offset);
+					cache.IASetIndexBuffer(meshBindings.indexBuffer, meshBindings.indexFormat, 0);
+					cache.DrawIndexed(meshBindings.indexCount, meshBindings.startIndex, meshBindings.baseVertex);
+				}
+			}
+		}
+		auto end = std::chrono::high_resolution_clock::now();
+		ms[pass] = std::chrono::duration<double, std::milli>(end - start).count() / frames;
+	}
+
+	printf("Draw bindings: %u draws, %.3f ms with RenderRef copies (%u AddRef/Release pairs), %.3f ms from baked tables (%.1f ns/draw saved)\n",
+		draws, ms[0], draws * (maps + 3), ms[1], (ms[0] - ms[1]) * 1000000.0 / draws);
+}
+
+// --------------------------------------------------------
+// Binds a PSO per draw, as FramePipeline does, in random and
+// in sorted order.  Materials are spread over the variants,
+// and every variant shares one input layout and fixed function
+// setup, as the material shaders do.  PSOs are built by hand
+// from stand-in addresses; only their identity matters.
+// --------------------------------------------------------
+void Benchmarks::PipelineStateBinds(unsigned int draws, unsigned int materials, unsigned int variants)
+{
+	NullRenderBackend backend;
+	StateCache cache(&backend);
+
+	// Shaders per variant, then the layout, rasterizer, depth and blend states
+	std::vector<char> objects(variants * 2 + 4);
+	std::vector<PipelineState> psos(materials);
+	for (unsigned int m = 0; m < materials; m++)
+	{
+		unsigned int v = m % variants;
+		PipelineState& pso = psos[m];
+		pso.vertexShader = (RenderVertexShader*)&objects[v * 2];
+		pso.pixelShader = (RenderPixelShader*)&objects[v * 2 + 1];
+		pso.inputLayout = (RenderInputLayout*)&objects[variants * 2];
+		pso.topology = RENDER_TOPOLOGY_TRIANGLE_LIST;
+		pso.rasterizerState = (RenderRasterizerState*)&objects[variants * 2 + 1];
+		pso.depthStencilState = (RenderDepthStencilState*)&objects[variants * 2 + 2];
+		pso.blendState = (RenderBlendState*)&objects[variants * 2 + 3];
+		pso.hash = 0;
+		pso.id = m;
+	}
+
+	std::vector<unsigned int> order(draws);
+	srand(1);
+	for (auto& m : order)
+		m = rand() % materials;
+
+	// The render queue sorts by shader first, then material
+	std::vector<unsigned int> sorted = order;
+	std::sort(sorted.begin(), sorted.end(), [variants](unsigned int a, unsigned int b)
+	{
+		return a % variants != b % variants ? a % variants < b % variants : a < b;
+	});
+
+	const unsigned int callsPerPso = 7;
+	unsigned int psoBinds[2], calls[2];
+	for (int pass = 0; pass < 2; pass++)
+	{
+		const std::vector<unsigned int>& draw = pass ? sorted : order;
+
+		cache.BeginFrame();
+		for (unsigned int d = 0; d < draws; d++)
+			cache.SetPipelineState(&psos[draw[d]]);
+		cache.BeginFrame();
+
+		const StateCacheStats& stats = cache.GetStats();
+		psoBinds[pass] = stats.forwarded[STATE_CALL_PIPELINE_STATE];
+		calls[pass] = stats.TotalForwarded() - psoBinds[pass];
+	}
+
+	printf("Pipeline state binds: %u draws of %u materials (%u variants), %u calls unbatched, %u PSO changes / %u calls unsorted, %u / %u sorted\n",
+		draws, materials, variants, draws * callsPerPso, psoBinds[0], calls[0], psoBinds[1], calls[1]);
+}
+
+// --------------------------------------------------------
+// Records a frame of draws through the null backend, then
+// replays it doing each draw's vertices the old way and the
+// new way.  Every index is one vertex shader invocation (no
+// post-transform cache), and draws are stretched boxes like
+// the walls and ground, so normals see non-uniform scales.
+// --------------------------------------------------------
+void Benchmarks::VertexTransforms(unsigned int draws)
+{
+	const unsigned int meshIndices[4] = { 36, 36, 240, 6 };	// Cube, cube, cylinder, quad
+	const unsigned int vertexCount = 1024;
+
+	NullRenderBackend backend;
+	backend.SetRecording(true);
+	StateCache cache(&backend);
+	cache.BeginFrame();
+	for (unsigned int d = 0; d < draws; d++)
+		cache.DrawIndexed(meshIndices[d % 4], 0, 0);
+	backend.Present();
+
+	srand(1);
+	std::vector<Transform> transforms(draws);
+	for (auto& t : transforms)
+	{
+		t.SetPosition((float)(rand() % 9) - 4.0f, (float)(rand() % 3), (float)(rand() % 200));
+		t.SetRotation(0, (float)(rand() % 628) / 100.0f, 0);
+		t.SetScale(0.5f + (float)(rand() % 8), 0.5f + (float)(rand() % 4), 0.5f + (float)(rand() % 40));
+	}
+
+	std::vector<XMFLOAT3> positions(vertexCount), normals(vertexCount);
+	for (unsigned int v = 0; v < vertexCount; v++)
+	{
+		positions[v] = XMFLOAT3((float)rand() / RAND_MAX - 0.5f, (float)rand() / RAND_MAX - 0.5f, (float)rand() / RAND_MAX - 0.5f);
+		XMStoreFloat3(&normals[v], XMVector3Normalize(XMVectorSet((float)rand() / RAND_MAX - 0.5f, (float)rand() / RAND_MAX - 0.5f, (float)rand() / RAND_MAX - 0.5f, 0)));
+	}
+
+	Camera cam(XMFLOAT3(0, 2, -5), XMFLOAT3(0, 0, 0), 16.0f / 9.0f);
+	XMFLOAT4X4 view = cam.getView();
+	XMFLOAT4X4 proj = cam.getProj();
+
+	const std::vector<RecordedCommand>& commands = backend.GetCommands();
+	unsigned int vertices = 0;
+	for (const RecordedCommand& c : commands)
+	{
+		if (c.Type == RENDER_COMMAND_DRAW_INDEXED)
+			vertices += c.Args[0];
+	}
+
+	// Clip positions and world normals, old then new
+	std::vector<XMFLOAT4> clip[2];
+	std::vector<XMFLOAT3> normal[2];
+	double ms[2];
+	for (int pass = 0; pass < 2; pass++)
+	{
+		clip[pass].reserve(vertices);
+		normal[pass].reserve(vertices);
+		auto start = std::chrono::high_resolution_clock::now();
+
+		unsigned int d = 0, v = 0;
+		for (const RecordedCommand& c : commands)
+		{
+			if (c.Type != RENDER_COMMAND_DRAW_INDEXED)
+				continue;
+			Transform& t = transforms[d++];
+			XMFLOAT4X4 world = t.GetWorldMatrix();
+			XMMATRIX w = XMLoadFloat4x4(&world);
+
+			if (pass == 0)
+			{
+				XMMATRIX vw = XMLoadFloat4x4(&view);
+				XMMATRIX pr = XMLoadFloat4x4(&proj);
+				for (unsigned int i = 0; i < c.Args[0]; i++, v++)
+				{
+					XMVECTOR p = XMLoadFloat3(&positions[v % vertexCount]);
+					XMVECTOR n = XMLoadFloat3(&normals[v % vertexCount]);
+					XMMATRIX wvp = XMMatrixMultiply(XMMatrixMultiply(w, vw), pr);
+					XMFLOAT4 out;
+					XMStoreFloat4(&out, XMVector3Transform(p, wvp));
+					clip[0].push_back(out);
+					XMFLOAT3 outNormal;
+					XMStoreFloat3(&outNormal, XMVector3Normalize(XMVector3TransformNormal(n, w)));
+					normal[0].push_back(outNormal);
+				}
+			}
+			else
+			{
+				XMMATRIX viewProj = XMLoadFloat4x4(&cam.getViewProj());
+				XMFLOAT4X4 worldInverseTranspose = t.GetWorldInverseTransposeMatrix();
+				XMMATRIX wit = XMLoadFloat4x4(&worldInverseTranspose);
+				for (unsigned int i = 0; i < c.Args[0]; i++, v++)
+				{
+					XMVECTOR p = XMLoadFloat3(&positions[v % vertexCount]);
+					XMVECTOR n = XMLoadFloat3(&normals[v % vertexCount]);
+					XMFLOAT4 out;
+					XMStoreFloat4(&out, XMVector4Transform(XMVector3Transform(p, w), viewProj));
+					clip[1].push_back(out);
+					XMFLOAT3 outNormal;
+					XMStoreFloat3(&outNormal, XMVector3Normalize(XMVector3TransformNormal(n, wit)));
+					normal[1].push_back(outNormal);
+				}
+			}
+		}
+
+		ms[pass] = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	}
+
+	// The positions should agree to rounding; the normals are
+	// where the old (float3x3)world went wrong
+	float maxClipError = 0, maxNormalDegrees = 0;
+	for (unsigned int v = 0; v < vertices; v++)
+	{
+		float scale = fmaxf(fabsf(clip[1][v].w), 1.0f);
+		maxClipError = fmaxf(maxClipError, fabsf(clip[0][v].x - clip[1][v].x) / scale);
+		maxClipError = fmaxf(maxClipError, fabsf(clip[0][v].y - clip[1][v].y) / scale);
+		float cosine = normal[0][v].x * normal[1][v].x + normal[0][v].y * normal[1][v].y + normal[0][v].z * normal[1][v].z;
+		maxNormalDegrees = fmaxf(maxNormalDegrees, acosf(fminf(fmaxf(cosine, -1.0f), 1.0f)) * 57.2957795f);
+	}
+
+	// Multiply-adds per vertex in MaterialVS: two 4x4 matrix
+	// products, position to clip and to world, normal and tangent
+	const unsigned int madsBefore = 64 + 64 + 16 + 16 + 9 + 9;
+	const unsigned int madsAfter = 16 + 16 + 9 + 9;
+	printf("Vertex transforms: %u draws, %u vertices, %.3f ms per-vertex wvp, %.3f ms cached view-proj (%u -> %u MADs/vertex), clip error %g, old normals off by up to %.1f degrees\n",
+		draws, vertices, ms[0], ms[1], madsBefore, madsAfter, maxClipError, maxNormalDegrees);
+}
+
+// --------------------------------------------------------
+// Draws meshes in sorted order through a state cache, each
+// with its own stand-in buffers and then all sharing one
+// pair, counting the IA binds forwarded.  Then churns a
+// vertex free list the size of the game's arena with random
+// mesh loads and unloads, keeping it around three quarters
+// full.
+// --------------------------------------------------------
+void Benchmarks::GeometryArenaBinds(unsigned int draws, unsigned int meshes, unsigned int operations)
+{
+	NullRenderBackend backend;
+	StateCache cache(&backend);
+
+	srand(1);
+	std::vector<unsigned int> order(draws);
+	for (auto& m : order)
+		m = rand() % meshes;
+	std::sort(order.begin(), order.end());
+
+	std::vector<char> buffers(meshes * 2 + 2);
+	unsigned int stride = sizeof(CompactVertex);
+	unsigned int offset = 0;
+	unsigned int binds[2];
+	for (int arena = 0; arena < 2; arena++)
+	{
+		cache.BeginFrame();
+		for (unsigned int d = 0; d < draws; d++)
+		{
+			// The arena's buffers sit past the meshes' own
+			unsigned int m = arena ? meshes : order[d];
+			RenderBuffer* vertexBuffer = (RenderBuffer*)&buffers[m * 2];
+			cache.IASetVertexBuffers(0, 1, &vertexBuffer, &stride, &offset);
+			cache.IASetIndexBuffer((RenderBuffer*)&buffers[m * 2 + 1], DXGI_FORMAT_R16_UINT, 0);
+			cache.DrawIndexed(36, arena ? order[d] * 36 : 0, arena ? order[d] * 24 : 0);
+		}
+		cache.BeginFrame();
+		binds[arena] = cache.GetStats().forwarded[STATE_CALL_VERTEX_BUFFER] + cache.GetStats().forwarded[STATE_CALL_INDEX_BUFFER];
+	}
+
+	printf("Geometry arena: %u draws of %u meshes, %u IA binds with a buffer pair each, %u sharing the arena's\n",
+		draws, meshes, binds[0], binds[1]);
+
+	const unsigned int capacity = 32768;
+	GeometryFreeList freeList(capacity);
+	struct Loaded { unsigned int offset, count; };
+	std::vector<Loaded> loaded;
+	unsigned int failed = 0;
+
+	auto start = std::chrono::high_resolution_clock::now();
+	for (unsigned int op = 0; op < operations; op++)
+	{
+		bool unload = !loaded.empty() && (freeList.GetUsed() > capacity * 3 / 4 || rand() % 2 == 0);
+		if (unload)
+		{
+			size_t i = rand() % loaded.size();
+			freeList.Free(loaded[i].offset, loaded[i].count);
+			loaded[i] = loaded.back();
+			loaded.pop_back();
+		}
+		else
+		{
+			Loaded mesh;
+			mesh.count = 24 + rand() % 2000;
+			if (freeList.Allocate(mesh.count, &mesh.offset))
+				loaded.push_back(mesh);
+			else
+				failed++;
+		}
+	}
+	double ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+	printf("  %u loads and unloads in %.3f ms (%.1f ns each): %u meshes, %.1f%% used, %u free ranges, %.0f%% fragmented, %u loads didn't fit\n",
+		operations, ms, ms * 1000000.0 / operations, (unsigned int)loaded.size(),
+		100.0 * freeList.GetUsed() / capacity, freeList.GetRangeCount(), 100.0 * freeList.GetFragmentation(), failed);
+}
+
+// --------------------------------------------------------
+// The traces live with the standalone test, which runs them
+// without the app; here they're part of the benchmark run
+// --------------------------------------------------------
+bool Benchmarks::FrameGovernorTraces()
+{
+	return RunFrameGovernorTraces();
+}
+
+// --------------------------------------------------------
+// A few frames of the same scene per thread count
+// --------------------------------------------------------
+bool Benchmarks::SoftwareRaster(unsigned int cubes, unsigned int width, unsigned int height)
+{
+	const int frames = 10;
+	SoftwareRasterScene scene(cubes, width, height);
+
+	SoftwareRasterizer rasterizer(width, height, 1);
+	std::vector<unsigned char> images[2];
+	SoftwareRasterizerStats sums[2];
+	unsigned int threads[2] = { 1, 0 };
+	for (int pass = 0; pass < 2; pass++)
+	{
+		rasterizer.SetThreadCount(threads[pass]);
+		threads[pass] = rasterizer.GetThreadCount();
+
+		memset(&sums[pass], 0, sizeof(SoftwareRasterizerStats));
+		for (int f = 0; f < frames; f++)
+		{
+			scene.Draw(rasterizer);
+
+			const SoftwareRasterizerStats& stats = rasterizer.GetStats();
+			sums[pass].vertexMilliseconds += stats.vertexMilliseconds / frames;
+			sums[pass].binMilliseconds += stats.binMilliseconds / frames;
+			sums[pass].rasterMilliseconds += stats.rasterMilliseconds / frames;
+			sums[pass].resolveMilliseconds += stats.resolveMilliseconds / frames;
+			sums[pass].totalMilliseconds += stats.totalMilliseconds / frames;
+		}
+		images[pass].assign(rasterizer.GetPixels(), rasterizer.GetPixels() + width * height * 4);
+	}
+
+	const SoftwareRasterizerStats& stats = rasterizer.GetStats();
+	printf("Software raster: %u draws, %u triangles (%u clipped, %u culled), %u bin entries, %u light entries at %ux%u\n",
+		stats.draws, stats.triangles, stats.trianglesClipped, stats.trianglesCulled, stats.binEntries, stats.lightEntries, width, height);
+	printf("  %llu pixels covered, %llu shaded (%.2f depth pass writes per shaded pixel)\n",
+		(unsigned long long)stats.pixelsCovered, (unsigned long long)stats.pixelsShaded,
+		stats.pixelsShaded ? (double)stats.pixelsCovered / stats.pixelsShaded : 0.0);
+	for (int pass = 0; pass < 2; pass++)
+	{
+		printf("  %2u thread%s: vertex %.3f ms, bin %.3f ms, raster %.3f ms, resolve %.3f ms, total %.3f ms\n",
+			threads[pass], threads[pass] == 1 ? " " : "s", sums[pass].vertexMilliseconds, sums[pass].binMilliseconds,
+			sums[pass].rasterMilliseconds, sums[pass].resolveMilliseconds, sums[pass].totalMilliseconds);
+	}
+
+	bool pass = stats.pixelsShaded > 0 && images[0] == images[1];
+	printf("Software raster images %s - %s\n", images[0] == images[1] ? "match" : "differ", pass ? "PASS" : "FAIL");
+	return pass;
+}
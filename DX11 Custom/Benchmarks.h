@@ -0,0 +1,79 @@
+#pragma once
+
+// --------------------------------------------------------
+// CPU-side micro-benchmarks for the renderer.
+//
+// Define RUN_BENCHMARKS in the project's preprocessor
+// settings to run these once from Game::Init().  Results
+// are printed to the debug console.
+// --------------------------------------------------------
+class ISimpleShader;
+class RenderBackend;
+
+namespace Benchmarks
+{
+	// Benchmarks that need a backend or a shader are skipped if those are null.
+	// shader is a loaded shader; shaderFile is a vertex shader .cso to reload.
+	void RunAll(RenderBackend* backend = 0, ISimpleShader* shader = 0, const wchar_t* shaderFile = 0);
+
+	// Radix sort of the render queue's draw packets
+	void RenderQueueSort(unsigned int packetCount);
+
+	// SetData throughput by name versus by handle, on a shader
+	// that has a float4x4 named "world"
+	void ShaderSetData(ISimpleShader* shader, unsigned int calls);
+
+	// Loading a shader with the reflection cache off versus on
+	void ShaderLoad(RenderBackend* backend, const wchar_t* shaderFile, unsigned int loads);
+
+	// Software occlusion: rasterizing a corridor of walls and
+	// boxes, then testing boxes scattered down it
+	void OcclusionCulling(unsigned int occluders, unsigned int tests);
+
+	// Binning point lights into the light clusters, on one
+	// thread and then on one per core
+	void LightBinning(unsigned int lightCount);
+
+	// Texture binds that reach the backend for draws spread over
+	// several PBR materials, with a texture per map versus the
+	// material atlas's shared arrays
+	void MaterialBinds(unsigned int draws, unsigned int materials);
+
+	// Final colors from sRGB textures and an sRGB back buffer
+	// versus the old manual pow(2.2) gamma, failing if any is
+	// more than toleranceLevels (of 255) apart
+	bool ColorOutput(unsigned int toleranceLevels);
+
+	// Per-draw CPU cost of fetching bindings through by-value
+	// RenderRef getters versus the baked mesh and material tables
+	void DrawBindings(RenderBackend* backend, unsigned int draws);
+
+	// State calls reaching the backend when every draw binds a
+	// pipeline state object, over materials sharing a few variants
+	void PipelineStateBinds(unsigned int draws, unsigned int materials, unsigned int variants);
+
+	// The material vertex shader's math, run on the CPU over a
+	// recorded draw stream: world, view and proj multiplied per
+	// vertex versus the cached view-projection and inverse
+	// transpose.  Also reports how far the old normals were off
+	// under the scene's non-uniform scales.
+	void VertexTransforms(unsigned int draws);
+
+	// Input assembler binds reaching the backend for draws over
+	// several meshes, with their own buffers versus suballocated
+	// from one geometry arena; then meshes loaded and unloaded at
+	// random through the arena's free lists, reporting how full
+	// and how fragmented they end up
+	void GeometryArenaBinds(unsigned int draws, unsigned int meshes, unsigned int operations);
+
+	// The frame governor's synthetic traces (FrameGovernorTraces.h),
+	// also built on their own as the FrameGovernorTests target.
+	// Fails if any trace ends up somewhere it shouldn't.
+	bool FrameGovernorTraces();
+
+	// The software rasterizer drawing a field of textured cubes
+	// over a floor, with the scene's kinds of lights, on one
+	// thread and then on one per core.  Prints each stage's time.
+	// Fails unless both images come out the same.
+	bool SoftwareRaster(unsigned int cubes, unsigned int width, unsigned int height);
+}
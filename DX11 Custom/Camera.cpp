@@ -1,7 +1,11 @@
 #include "Camera.h"
+#include <stdio.h>
+
 Camera::Camera(DirectX::XMFLOAT3 initialPos, DirectX::XMFLOAT3 orientation, float aspectRatio)
 {
 	trans = Transform();
+	nearClip = 0.1f;
+	farClip = 500.0f;
 	trans.SetPosition(initialPos.x, initialPos.y, initialPos.z);
 	trans.SetRotation(orientation.x, orientation.y, orientation.z);
 	UpdateViewMatrix();
@@ -9,6 +13,8 @@ Camera::Camera(DirectX::XMFLOAT3 initialPos, DirectX::XMFLOAT3 orientation, floa
 	moveSpeed = 0.2f;
 	mouseLookSpeed = 2;
 	inputDoing = false;
+	prevMouseX = 0;
+	prevMouseY = 0;
 }
 
 DirectX::XMFLOAT4X4 Camera::getView()
@@ -21,6 +27,21 @@ DirectX::XMFLOAT4X4 Camera::getProj()
 	return proj;
 }
 
+const DirectX::XMFLOAT4X4& Camera::getViewProj()
+{
+	return viewProj;
+}
+
+float Camera::GetNearClip()
+{
+	return nearClip;
+}
+
+float Camera::GetFarClip()
+{
+	return farClip;
+}
+
 Transform* Camera::GetTransform()
 {
 	return &trans;
@@ -37,29 +58,38 @@ void Camera::UpdateViewMatrix()
 
 	//getting new rotation and direction vectors for view matrix
 	DirectX::XMFLOAT3 rot = trans.GetPitchYawRoll();
+	DirectX::XMFLOAT3 pos = trans.GetPosition();
 	DirectX::XMVECTOR dir = DirectX::XMVector3Rotate(DirectX::XMVectorSet(0, 0, 1, 0), DirectX::XMQuaternionRotationRollPitchYawFromVector(XMLoadFloat3(&rot)));
 
-	DirectX::XMMATRIX viewM = DirectX::XMMatrixLookToLH(XMLoadFloat3(&trans.GetPosition()), dir, DirectX::XMVectorSet(0, 1, 0, 0));
+	DirectX::XMMATRIX viewM = DirectX::XMMatrixLookToLH(XMLoadFloat3(&pos), dir, DirectX::XMVectorSet(0, 1, 0, 0));
 
 	//setting updated view matrix
 	DirectX::XMStoreFloat4x4(&view, viewM);
+	UpdateViewProjMatrix();
 }
 
 void Camera::UpdateProjectionMatrix(float aspectRatio)
 {
-	DirectX::XMStoreFloat4x4(&proj, DirectX::XMMatrixPerspectiveFovLH(1.7f, aspectRatio, 0.1f, 500));
+	DirectX::XMStoreFloat4x4(&proj, DirectX::XMMatrixPerspectiveFovLH(1.7f, aspectRatio, nearClip, farClip));
+	UpdateViewProjMatrix();
+}
+
+//combined here so the vertex shader doesn't multiply them for every vertex
+void Camera::UpdateViewProjMatrix()
+{
+	DirectX::XMStoreFloat4x4(&viewProj, DirectX::XMMatrixMultiply(DirectX::XMLoadFloat4x4(&view), DirectX::XMLoadFloat4x4(&proj)));
 }
 
 
 
-void Camera::Update(float dt, HWND windowHandle, Transform* t)
+void Camera::Update(float dt, Transform* t)
 {
 	int key = 0;
 
 
 	
 	//input buffer and getting key input
-	if (GetKeyState('A') >= 0 && GetKeyState('D') >= 0) {
+	if (!DXCore::IsKeyDown('A') && !DXCore::IsKeyDown('D')) {
 		inputDoing = false;
 		key = 0;
 	}
@@ -69,12 +99,12 @@ void Camera::Update(float dt, HWND windowHandle, Transform* t)
 		return; 
 	}
 
-	if (GetKeyState('D') < 0) {
+	if (DXCore::IsKeyDown('D')) {
 		key = 1;
 		inputDoing = true;
 	}
 
-	if (GetKeyState('A') < 0) {
+	if (DXCore::IsKeyDown('A')) {
 		key = 2;
 		inputDoing = true;
 	}
@@ -119,27 +149,27 @@ void Camera::Update(float dt, HWND windowHandle, Transform* t)
 	//key event functions
 	//if(GetAsyncKeyState('D') & 0x8000){ trans.MoveRelative(speed, 0, 0); }
 	//if (GetAsyncKeyState('A') & 0x8000) { trans.MoveRelative(-speed, 0, 0); }
-	if(GetAsyncKeyState('W') & 0x8000) { trans.MoveRelative(0, 0, speed); }
-	if(GetAsyncKeyState('S') & 0x8000) { trans.MoveRelative(0, 0, -speed); }
+	if(DXCore::IsKeyDown('W')) { trans.MoveRelative(0, 0, speed); }
+	if(DXCore::IsKeyDown('S')) { trans.MoveRelative(0, 0, -speed); }
 	
-	if(GetAsyncKeyState(VK_SPACE) & 0x8000) { trans.MoveAbsolute(0, speed, 0); }
-	if(GetAsyncKeyState('X') & 0x8000) { trans.MoveAbsolute(0, -speed, 0); }
+	if(DXCore::IsKeyDown(KEY_SPACE)) { trans.MoveAbsolute(0, speed, 0); }
+	if(DXCore::IsKeyDown('X')) { trans.MoveAbsolute(0, -speed, 0); }
 
 
 
 	//getting the mouse position and moving view matrix if necessary
-	POINT mousePos = {};
-	GetCursorPos(&mousePos);
-	ScreenToClient(windowHandle, &mousePos);
+	int mouseX, mouseY;
+	DXCore::GetMousePosition(&mouseX, &mouseY);
 
 
-	if(GetAsyncKeyState(VK_LBUTTON) & 0x8000)
+	if(DXCore::IsKeyDown(KEY_LBUTTON))
 	{
-		trans.Rotate((mousePos.y - prevMousePos.y) * mouseLookSpeed * dt, (mousePos.x - prevMousePos.x) * mouseLookSpeed * dt, 0);
+		trans.Rotate((mouseY - prevMouseY) * mouseLookSpeed * dt, (mouseX - prevMouseX) * mouseLookSpeed * dt, 0);
 		
 	}
 
-	prevMousePos = mousePos;
+	prevMouseX = mouseX;
+	prevMouseY = mouseY;
 
 	UpdateViewMatrix();
 
@@ -1,7 +1,4 @@
 #pragma once
-#include <Windows.h>
-#include <d3d11.h>
-#include <wrl/event.h>
 #include "DXCore.h"
 #include <DirectXMath.h>
 #include "Transform.h"
@@ -12,11 +9,15 @@ class Camera
 {
 	public:
 		Camera(DirectX::XMFLOAT3 intialPos, DirectX::XMFLOAT3 orientation, float aspectRatio);
-		void Update(float dt, HWND windowHandle, Transform* t);
+		void Update(float dt, Transform* t);
 		void UpdateProjectionMatrix(float aspectRatio);
 		void UpdateViewMatrix();
 		DirectX::XMFLOAT4X4 getView();
 		DirectX::XMFLOAT4X4 getProj();
+		//view * proj, redone only when either changes, so once a frame at most
+		const DirectX::XMFLOAT4X4& getViewProj();
+		float GetNearClip();
+		float GetFarClip();
 		Transform* GetTransform();
 		void moveSideways();
 		bool inputDoing;
@@ -24,11 +25,16 @@ class Camera
 	private:
 		DirectX::XMFLOAT4X4 view;
 		DirectX::XMFLOAT4X4 proj;
+		DirectX::XMFLOAT4X4 viewProj;
 		Transform trans;
 		float moveSpeed;
 		float mouseLookSpeed;
-		POINT prevMousePos;
+		int prevMouseX;
+		int prevMouseY;
 		float fov;
+		float nearClip;
+		float farClip;
+		void UpdateViewProjMatrix();
 		
 		
 
@@ -0,0 +1,17 @@
+#pragma once
+#include <DirectXMath.h>
+
+// --------------------------------------------------------
+// A point light with a finite range.  Matches ClusterLight
+// in MaterialPS.hlsl.
+//
+// On its own so the CPU-only code (the software rasterizer)
+// can take these without LightClusters' D3D buffers.
+// --------------------------------------------------------
+struct ClusterLight
+{
+	DirectX::XMFLOAT3 position;
+	float range;
+	DirectX::XMFLOAT3 color;
+	float intensity;
+};
@@ -0,0 +1,78 @@
+#include "ConstantBufferRing.h"
+#include <string.h>
+
+// Offsets must be a multiple of 16 constants of 16 bytes each
+static const unsigned int RING_ALIGNMENT = 256;
+
+ConstantBufferRing::ConstantBufferRing(RenderBackend* backend, unsigned int sizeInBytes)
+{
+	this->backend = backend;
+	this->buffer = 0;
+	this->size = (sizeInBytes + RING_ALIGNMENT - 1) & ~(RING_ALIGNMENT - 1);
+	this->offset = 0;
+	this->generation = 0;
+	this->discards = 0;
+	this->discardPending = true; // The first map of a dynamic buffer must be a discard
+
+	if (!backend->SupportsConstantBufferOffsets())
+		return;
+
+	BufferDesc desc = {};
+	desc.ByteWidth = this->size;
+	desc.Usage = RENDER_USAGE_DYNAMIC;
+	desc.BindFlags = RENDER_BIND_CONSTANT_BUFFER;
+	backend->CreateBuffer(desc, 0, &buffer);
+}
+
+ConstantBufferRing::~ConstantBufferRing()
+{
+	if (buffer) { buffer->Release(); buffer = 0; }
+}
+
+void ConstantBufferRing::BeginFrame()
+{
+	if (offset > size / 2)
+		discardPending = true;
+}
+
+// --------------------------------------------------------
+// Appends data to the ring.  When the data doesn't fit (or a
+// frame boundary asked for it) the ring is discarded and the
+// generation bumped.
+//
+// Returns false if the ring is unsupported or the data is
+// larger than the whole ring
+// --------------------------------------------------------
+bool ConstantBufferRing::Upload(const void* data, unsigned int dataSize, ConstantBufferRange* range)
+{
+	if (!buffer)
+		return false;
+
+	unsigned int alignedSize = (dataSize + RING_ALIGNMENT - 1) & ~(RING_ALIGNMENT - 1);
+	if (alignedSize > size)
+		return false;
+
+	RenderMap mapType = RENDER_MAP_WRITE_NO_OVERWRITE;
+	if (discardPending || offset + alignedSize > size)
+	{
+		mapType = RENDER_MAP_WRITE_DISCARD;
+		offset = 0;
+		generation++;
+		discards++;
+		discardPending = false;
+	}
+
+	void* mapped = backend->Map(buffer, mapType);
+	if (!mapped)
+		return false;
+
+	memcpy((unsigned char*)mapped + offset, data, dataSize);
+	backend->Unmap(buffer);
+
+	range->Buffer = buffer;
+	range->FirstConstant = offset / 16;
+	range->NumConstants = alignedSize / 16;
+
+	offset += alignedSize;
+	return true;
+}
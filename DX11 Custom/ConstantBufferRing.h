@@ -0,0 +1,56 @@
+#pragma once
+#include "RenderBackend.h"
+
+// --------------------------------------------------------
+// Where a constant buffer upload landed in the ring, in the
+// units VSSetConstantBuffers1/PSSetConstantBuffers1 expect
+// --------------------------------------------------------
+struct ConstantBufferRange
+{
+	RenderBuffer* Buffer;
+	unsigned int FirstConstant;	// In 16-byte constants, multiple of 16
+	unsigned int NumConstants;	// In 16-byte constants, multiple of 16
+};
+
+// --------------------------------------------------------
+// A single large dynamic constant buffer that per-draw
+// constants are suballocated from.  Uploads append with
+// Map(NO_OVERWRITE) and the ring only restarts with
+// Map(DISCARD) once it is full, so the driver never stalls
+// on data the GPU is still reading.
+//
+// Requires D3D 11.1 constant buffer offsetting - check
+// IsSupported() and fall back to per-buffer uploads if not.
+// --------------------------------------------------------
+class ConstantBufferRing
+{
+public:
+	ConstantBufferRing(RenderBackend* backend, unsigned int sizeInBytes);
+	~ConstantBufferRing();
+
+	bool IsSupported() { return buffer != 0; }
+
+	// Restarts the ring at a frame boundary if it is more than half
+	// used, so mid-frame wraps only happen for very large frames
+	void BeginFrame();
+
+	// Copies size bytes into the ring, returning where they landed
+	bool Upload(const void* data, unsigned int size, ConstantBufferRange* range);
+
+	// Bumped every time the ring is discarded - allocations from an
+	// older generation no longer hold their data and must be re-uploaded
+	unsigned int GetGeneration() { return generation; }
+
+	unsigned int GetSize() { return size; }
+	unsigned int GetDiscardCount() { return discards; }
+
+private:
+	RenderBackend* backend;
+	RenderBuffer* buffer;
+
+	unsigned int size;
+	unsigned int offset;
+	unsigned int generation;
+	unsigned int discards;
+	bool discardPending;
+};
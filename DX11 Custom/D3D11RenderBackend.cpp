@@ -0,0 +1,682 @@
+#include "D3D11RenderBackend.h"
+#include "WICTextureLoader.h"
+#include "DDSTextureLoader.h"
+#include "SpriteBatch.h"
+#include "SpriteFont.h"
+#include <vector>
+#include <wchar.h>
+
+using Microsoft::WRL::ComPtr;
+
+// --------------------------------------------------------
+// The handles this backend makes.  Shaders, layouts and
+// states hold just their D3D11 object; buffers and textures
+// keep the views they're bound through as well.
+// --------------------------------------------------------
+template<typename Handle, typename Object>
+class D3D11Object : public Handle
+{
+public:
+	ComPtr<Object> object;
+
+	static Object* Get(Handle* handle) { return handle ? static_cast<D3D11Object*>(handle)->object.Get() : 0; }
+};
+
+typedef D3D11Object<RenderVertexShader, ID3D11VertexShader> D3D11VertexShader;
+typedef D3D11Object<RenderPixelShader, ID3D11PixelShader> D3D11PixelShader;
+typedef D3D11Object<RenderInputLayout, ID3D11InputLayout> D3D11InputLayout;
+typedef D3D11Object<RenderSamplerState, ID3D11SamplerState> D3D11SamplerState;
+typedef D3D11Object<RenderRasterizerState, ID3D11RasterizerState> D3D11RasterizerState;
+typedef D3D11Object<RenderDepthStencilState, ID3D11DepthStencilState> D3D11DepthStencilState;
+typedef D3D11Object<RenderBlendState, ID3D11BlendState> D3D11BlendState;
+
+class D3D11Buffer : public RenderBuffer
+{
+public:
+	ComPtr<ID3D11Buffer> buffer;
+	ComPtr<ID3D11ShaderResourceView> srv;
+
+	static D3D11Buffer* Get(RenderBuffer* buffer) { return static_cast<D3D11Buffer*>(buffer); }
+};
+
+class D3D11Texture : public RenderTexture
+{
+public:
+	ComPtr<ID3D11ShaderResourceView> srv;
+	ComPtr<ID3D11RenderTargetView> rtv;
+	ComPtr<ID3D11DepthStencilView> dsv;
+
+	static D3D11Texture* Get(RenderTexture* texture) { return static_cast<D3D11Texture*>(texture); }
+};
+
+static ID3D11Buffer* GetBuffer(RenderBuffer* buffer)
+{
+	return buffer ? D3D11Buffer::Get(buffer)->buffer.Get() : 0;
+}
+
+static ID3D11ShaderResourceView* GetSRV(RenderResource* resource)
+{
+	if (!resource)
+		return 0;
+	if (resource->IsBuffer())
+		return D3D11Buffer::Get(static_cast<RenderBuffer*>(resource))->srv.Get();
+	return D3D11Texture::Get(static_cast<RenderTexture*>(resource))->srv.Get();
+}
+
+// --------------------------------------------------------
+// Engine descs to D3D11's
+// --------------------------------------------------------
+static D3D11_USAGE GetUsage(RenderUsage usage)
+{
+	switch (usage)
+	{
+	case RENDER_USAGE_IMMUTABLE: return D3D11_USAGE_IMMUTABLE;
+	case RENDER_USAGE_DYNAMIC: return D3D11_USAGE_DYNAMIC;
+	default: return D3D11_USAGE_DEFAULT;
+	}
+}
+
+static UINT GetBindFlags(unsigned int flags)
+{
+	UINT bind = 0;
+	if (flags & RENDER_BIND_VERTEX_BUFFER) bind |= D3D11_BIND_VERTEX_BUFFER;
+	if (flags & RENDER_BIND_INDEX_BUFFER) bind |= D3D11_BIND_INDEX_BUFFER;
+	if (flags & RENDER_BIND_CONSTANT_BUFFER) bind |= D3D11_BIND_CONSTANT_BUFFER;
+	if (flags & RENDER_BIND_SHADER_RESOURCE) bind |= D3D11_BIND_SHADER_RESOURCE;
+	if (flags & RENDER_BIND_RENDER_TARGET) bind |= D3D11_BIND_RENDER_TARGET;
+	if (flags & RENDER_BIND_DEPTH_STENCIL) bind |= D3D11_BIND_DEPTH_STENCIL;
+	return bind;
+}
+
+static D3D11_COMPARISON_FUNC GetComparison(RenderComparison comparison)
+{
+	switch (comparison)
+	{
+	case RENDER_COMPARISON_NEVER: return D3D11_COMPARISON_NEVER;
+	case RENDER_COMPARISON_EQUAL: return D3D11_COMPARISON_EQUAL;
+	case RENDER_COMPARISON_LESS_EQUAL: return D3D11_COMPARISON_LESS_EQUAL;
+	case RENDER_COMPARISON_GREATER: return D3D11_COMPARISON_GREATER;
+	case RENDER_COMPARISON_GREATER_EQUAL: return D3D11_COMPARISON_GREATER_EQUAL;
+	case RENDER_COMPARISON_ALWAYS: return D3D11_COMPARISON_ALWAYS;
+	default: return D3D11_COMPARISON_LESS;
+	}
+}
+
+static D3D11_BLEND GetBlend(RenderBlend blend)
+{
+	switch (blend)
+	{
+	case RENDER_BLEND_ZERO: return D3D11_BLEND_ZERO;
+	case RENDER_BLEND_SRC_ALPHA: return D3D11_BLEND_SRC_ALPHA;
+	case RENDER_BLEND_INV_SRC_ALPHA: return D3D11_BLEND_INV_SRC_ALPHA;
+	default: return D3D11_BLEND_ONE;
+	}
+}
+
+D3D11RenderBackend::D3D11RenderBackend(ID3D11Device* device, ID3D11DeviceContext* context, IDXGISwapChain* swapChain, unsigned int width, unsigned int height)
+{
+	this->device = device;
+	this->context = context;
+	this->swapChain = swapChain;
+	this->rtv = 0;
+	this->dsv = 0;
+	context->QueryInterface(__uuidof(ID3D11DeviceContext1), (void**)context1.GetAddressOf());
+
+	CreateTargets(width, height);
+}
+
+D3D11RenderBackend::~D3D11RenderBackend()
+{
+}
+
+// --------------------------------------------------------
+// The back buffer's view is sRGB, so the hardware gamma
+// encodes linear shader output on write (flip model swap
+// chains can't be sRGB themselves, but their views can)
+// --------------------------------------------------------
+bool D3D11RenderBackend::CreateTargets(unsigned int width, unsigned int height)
+{
+	D3D11Texture* back = new D3D11Texture();
+	*backBuffer.ReleaseAndGetAddressOf() = back;
+
+	ComPtr<ID3D11Texture2D> backBufferTexture;
+	swapChain->GetBuffer(0, __uuidof(ID3D11Texture2D), (void**)backBufferTexture.GetAddressOf());
+	if (backBufferTexture)
+	{
+		D3D11_RENDER_TARGET_VIEW_DESC rtvDesc = {};
+		rtvDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM_SRGB;
+		rtvDesc.ViewDimension = D3D11_RTV_DIMENSION_TEXTURE2D;
+		device->CreateRenderTargetView(backBufferTexture.Get(), &rtvDesc, back->rtv.GetAddressOf());
+	}
+
+	TextureDesc depthDesc = {};
+	depthDesc.Type = RENDER_TEXTURE_2D;
+	depthDesc.Width = width;
+	depthDesc.Height = height;
+	depthDesc.MipLevels = 1;
+	depthDesc.ArraySize = 1;
+	depthDesc.Format = DXGI_FORMAT_D24_UNORM_S8_UINT;
+	depthDesc.Usage = RENDER_USAGE_DEFAULT;
+	depthDesc.BindFlags = RENDER_BIND_DEPTH_STENCIL;
+	CreateTexture(depthDesc, 0, depthBuffer.ReleaseAndGetAddressOf());
+
+	SetRenderTargets(backBuffer.Get(), depthBuffer.Get());
+	SetViewport((float)width, (float)height);
+	return back->rtv && depthBuffer;
+}
+
+// --------------------------------------------------------
+// The buffers have to be released before the swap chain
+// can resize them
+// --------------------------------------------------------
+bool D3D11RenderBackend::Resize(unsigned int width, unsigned int height)
+{
+	context->OMSetRenderTargets(0, 0, 0);
+	rtv = 0;
+	dsv = 0;
+	backBuffer.Reset();
+	depthBuffer.Reset();
+
+	swapChain->ResizeBuffers(2, width, height, DXGI_FORMAT_R8G8B8A8_UNORM, 0);
+	return CreateTargets(width, height);
+}
+
+// --------------------------------------------------------
+// Buffers - a structured buffer bound as a shader resource
+// gets a view of all of its elements
+// --------------------------------------------------------
+bool D3D11RenderBackend::CreateBuffer(const BufferDesc& desc, const void* initialData, RenderBuffer** buffer)
+{
+	*buffer = 0;
+
+	D3D11_BUFFER_DESC d3dDesc = {};
+	d3dDesc.ByteWidth = desc.ByteWidth;
+	d3dDesc.Usage = GetUsage(desc.Usage);
+	d3dDesc.BindFlags = GetBindFlags(desc.BindFlags);
+	d3dDesc.CPUAccessFlags = desc.Usage == RENDER_USAGE_DYNAMIC ? D3D11_CPU_ACCESS_WRITE : 0;
+	if (desc.StructureByteStride > 0)
+	{
+		d3dDesc.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
+		d3dDesc.StructureByteStride = desc.StructureByteStride;
+	}
+
+	D3D11_SUBRESOURCE_DATA data = {};
+	data.pSysMem = initialData;
+
+	D3D11Buffer* created = new D3D11Buffer();
+	HRESULT hr = device->CreateBuffer(&d3dDesc, initialData ? &data : 0, created->buffer.GetAddressOf());
+	if (SUCCEEDED(hr) && (desc.BindFlags & RENDER_BIND_SHADER_RESOURCE) && desc.StructureByteStride > 0)
+	{
+		D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+		srvDesc.Format = DXGI_FORMAT_UNKNOWN;
+		srvDesc.ViewDimension = D3D11_SRV_DIMENSION_BUFFER;
+		srvDesc.Buffer.FirstElement = 0;
+		srvDesc.Buffer.NumElements = desc.ByteWidth / desc.StructureByteStride;
+		hr = device->CreateShaderResourceView(created->buffer.Get(), &srvDesc, created->srv.GetAddressOf());
+	}
+
+	if (FAILED(hr))
+	{
+		created->Release();
+		return false;
+	}
+	*buffer = created;
+	return true;
+}
+
+void* D3D11RenderBackend::Map(RenderBuffer* buffer, RenderMap mapType)
+{
+	D3D11_MAPPED_SUBRESOURCE mapped;
+	D3D11_MAP d3dMap = mapType == RENDER_MAP_WRITE_NO_OVERWRITE ? D3D11_MAP_WRITE_NO_OVERWRITE : D3D11_MAP_WRITE_DISCARD;
+	if (FAILED(context->Map(GetBuffer(buffer), 0, d3dMap, 0, &mapped)))
+		return 0;
+	return mapped.pData;
+}
+
+void D3D11RenderBackend::Unmap(RenderBuffer* buffer)
+{
+	context->Unmap(GetBuffer(buffer), 0);
+}
+
+void D3D11RenderBackend::UpdateBuffer(RenderBuffer* buffer, unsigned int offset, const void* data, unsigned int size)
+{
+	D3D11_BOX box = { offset, 0, 0, offset + size, 1, 1 };
+	context->UpdateSubresource(GetBuffer(buffer), 0, &box, data, 0, 0);
+}
+
+bool D3D11RenderBackend::SupportsConstantBufferOffsets()
+{
+	// Binding with offsets and mapping constant buffers with
+	// NO_OVERWRITE are both D3D 11.1 features
+	D3D11_FEATURE_DATA_D3D11_OPTIONS options = {};
+	HRESULT hr = device->CheckFeatureSupport(D3D11_FEATURE_D3D11_OPTIONS, &options, sizeof(options));
+	return SUCCEEDED(hr) &&
+		context1 &&
+		options.ConstantBufferOffsetting &&
+		options.MapNoOverwriteOnDynamicConstantBuffer;
+}
+
+// --------------------------------------------------------
+// Textures - WIC textures get mips generated on the context
+// --------------------------------------------------------
+bool D3D11RenderBackend::LoadTexture(const wchar_t* file, RenderTexture** texture, bool srgb)
+{
+	*texture = 0;
+	D3D11Texture* loaded = new D3D11Texture();
+
+	HRESULT hr;
+	const wchar_t* ext = wcsrchr(file, L'.');
+	if (ext && _wcsicmp(ext, L".dds") == 0)
+		hr = DirectX::CreateDDSTextureFromFileEx(device.Get(), file, 0, D3D11_USAGE_DEFAULT, D3D11_BIND_SHADER_RESOURCE, 0, 0, srgb, 0, loaded->srv.GetAddressOf());
+	else
+		hr = DirectX::CreateWICTextureFromFileEx(device.Get(), context.Get(), file, 0, D3D11_USAGE_DEFAULT, D3D11_BIND_SHADER_RESOURCE, 0, 0,
+			srgb ? DirectX::WIC_LOADER_FORCE_SRGB : DirectX::WIC_LOADER_IGNORE_SRGB, 0, loaded->srv.GetAddressOf());
+
+	if (FAILED(hr))
+	{
+		loaded->Release();
+		return false;
+	}
+	*texture = loaded;
+	return true;
+}
+
+// --------------------------------------------------------
+// Makes a view for each way the texture can be bound
+// --------------------------------------------------------
+bool D3D11RenderBackend::CreateTexture(const TextureDesc& desc, const SubresourceData* initialData, RenderTexture** texture)
+{
+	*texture = 0;
+
+	D3D11_TEXTURE2D_DESC d3dDesc = {};
+	d3dDesc.Width = desc.Width;
+	d3dDesc.Height = desc.Height;
+	d3dDesc.MipLevels = desc.MipLevels;
+	d3dDesc.ArraySize = desc.ArraySize;
+	d3dDesc.Format = desc.Format;
+	d3dDesc.SampleDesc.Count = 1;
+	d3dDesc.Usage = GetUsage(desc.Usage);
+	d3dDesc.BindFlags = GetBindFlags(desc.BindFlags);
+	d3dDesc.CPUAccessFlags = desc.Usage == RENDER_USAGE_DYNAMIC ? D3D11_CPU_ACCESS_WRITE : 0;
+	d3dDesc.MiscFlags = desc.Type == RENDER_TEXTURE_CUBE ? D3D11_RESOURCE_MISC_TEXTURECUBE : 0;
+
+	std::vector<D3D11_SUBRESOURCE_DATA> data;
+	if (initialData)
+	{
+		data.resize(desc.MipLevels * desc.ArraySize);
+		for (size_t i = 0; i < data.size(); i++)
+		{
+			data[i].pSysMem = initialData[i].Data;
+			data[i].SysMemPitch = initialData[i].RowPitch;
+			data[i].SysMemSlicePitch = initialData[i].SlicePitch;
+		}
+	}
+
+	ComPtr<ID3D11Texture2D> d3dTexture;
+	if (FAILED(device->CreateTexture2D(&d3dDesc, initialData ? data.data() : 0, d3dTexture.GetAddressOf())))
+		return false;
+
+	D3D11Texture* created = new D3D11Texture();
+	HRESULT hr = S_OK;
+	if (desc.BindFlags & RENDER_BIND_SHADER_RESOURCE)
+	{
+		D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+		srvDesc.Format = desc.Format;
+		switch (desc.Type)
+		{
+		case RENDER_TEXTURE_2D_ARRAY:
+			srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2DARRAY;
+			srvDesc.Texture2DArray.MipLevels = desc.MipLevels;
+			srvDesc.Texture2DArray.ArraySize = desc.ArraySize;
+			break;
+		case RENDER_TEXTURE_CUBE:
+			srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURECUBE;
+			srvDesc.TextureCube.MipLevels = desc.MipLevels;
+			break;
+		default:
+			srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
+			srvDesc.Texture2D.MipLevels = desc.MipLevels;
+			break;
+		}
+		hr = device->CreateShaderResourceView(d3dTexture.Get(), &srvDesc, created->srv.GetAddressOf());
+	}
+	if (SUCCEEDED(hr) && (desc.BindFlags & RENDER_BIND_RENDER_TARGET))
+		hr = device->CreateRenderTargetView(d3dTexture.Get(), 0, created->rtv.GetAddressOf());
+	if (SUCCEEDED(hr) && (desc.BindFlags & RENDER_BIND_DEPTH_STENCIL))
+		hr = device->CreateDepthStencilView(d3dTexture.Get(), 0, created->dsv.GetAddressOf());
+
+	if (FAILED(hr))
+	{
+		created->Release();
+		return false;
+	}
+	*texture = created;
+	return true;
+}
+
+// --------------------------------------------------------
+// Shaders and state objects
+// --------------------------------------------------------
+bool D3D11RenderBackend::CreateVertexShader(const void* byteCode, size_t byteCodeSize, RenderVertexShader** shader)
+{
+	*shader = 0;
+	D3D11VertexShader* created = new D3D11VertexShader();
+	if (FAILED(device->CreateVertexShader(byteCode, byteCodeSize, 0, created->object.GetAddressOf())))
+	{
+		created->Release();
+		return false;
+	}
+	*shader = created;
+	return true;
+}
+
+bool D3D11RenderBackend::CreatePixelShader(const void* byteCode, size_t byteCodeSize, RenderPixelShader** shader)
+{
+	*shader = 0;
+	D3D11PixelShader* created = new D3D11PixelShader();
+	if (FAILED(device->CreatePixelShader(byteCode, byteCodeSize, 0, created->object.GetAddressOf())))
+	{
+		created->Release();
+		return false;
+	}
+	*shader = created;
+	return true;
+}
+
+bool D3D11RenderBackend::CreateInputLayout(const InputElementDesc* elements, unsigned int elementCount, const void* byteCode, size_t byteCodeSize, RenderInputLayout** layout)
+{
+	*layout = 0;
+
+	std::vector<D3D11_INPUT_ELEMENT_DESC> d3dElements(elementCount);
+	for (unsigned int i = 0; i < elementCount; i++)
+	{
+		d3dElements[i].SemanticName = elements[i].SemanticName;
+		d3dElements[i].SemanticIndex = elements[i].SemanticIndex;
+		d3dElements[i].Format = elements[i].Format;
+		d3dElements[i].InputSlot = elements[i].InputSlot;
+		d3dElements[i].AlignedByteOffset = elements[i].AlignedByteOffset;
+		d3dElements[i].InputSlotClass = elements[i].PerInstance ? D3D11_INPUT_PER_INSTANCE_DATA : D3D11_INPUT_PER_VERTEX_DATA;
+		d3dElements[i].InstanceDataStepRate = elements[i].InstanceDataStepRate;
+	}
+
+	D3D11InputLayout* created = new D3D11InputLayout();
+	if (FAILED(device->CreateInputLayout(d3dElements.data(), elementCount, byteCode, byteCodeSize, created->object.GetAddressOf())))
+	{
+		created->Release();
+		return false;
+	}
+	*layout = created;
+	return true;
+}
+
+bool D3D11RenderBackend::CreateSamplerState(const SamplerDesc& desc, RenderSamplerState** state)
+{
+	*state = 0;
+
+	D3D11_SAMPLER_DESC d3dDesc = {};
+	switch (desc.Filter)
+	{
+	case RENDER_FILTER_LINEAR_MIP_POINT: d3dDesc.Filter = D3D11_FILTER_MIN_MAG_LINEAR_MIP_POINT; break;
+	case RENDER_FILTER_POINT: d3dDesc.Filter = D3D11_FILTER_MIN_MAG_MIP_POINT; break;
+	default: d3dDesc.Filter = D3D11_FILTER_MIN_MAG_MIP_LINEAR; break;
+	}
+	D3D11_TEXTURE_ADDRESS_MODE address = desc.AddressMode == RENDER_ADDRESS_CLAMP ? D3D11_TEXTURE_ADDRESS_CLAMP : D3D11_TEXTURE_ADDRESS_WRAP;
+	d3dDesc.AddressU = address;
+	d3dDesc.AddressV = address;
+	d3dDesc.AddressW = address;
+	d3dDesc.MaxLOD = D3D11_FLOAT32_MAX;
+
+	D3D11SamplerState* created = new D3D11SamplerState();
+	if (FAILED(device->CreateSamplerState(&d3dDesc, created->object.GetAddressOf())))
+	{
+		created->Release();
+		return false;
+	}
+	*state = created;
+	return true;
+}
+
+bool D3D11RenderBackend::CreateRasterizerState(const RasterizerDesc& desc, RenderRasterizerState** state)
+{
+	*state = 0;
+
+	D3D11_RASTERIZER_DESC d3dDesc = {};
+	d3dDesc.FillMode = D3D11_FILL_SOLID;
+	d3dDesc.CullMode = desc.CullMode == RENDER_CULL_NONE ? D3D11_CULL_NONE :
+		desc.CullMode == RENDER_CULL_FRONT ? D3D11_CULL_FRONT : D3D11_CULL_BACK;
+	d3dDesc.DepthClipEnable = desc.DepthClipEnable;
+
+	D3D11RasterizerState* created = new D3D11RasterizerState();
+	if (FAILED(device->CreateRasterizerState(&d3dDesc, created->object.GetAddressOf())))
+	{
+		created->Release();
+		return false;
+	}
+	*state = created;
+	return true;
+}
+
+bool D3D11RenderBackend::CreateDepthStencilState(const DepthStencilDesc& desc, RenderDepthStencilState** state)
+{
+	*state = 0;
+
+	// Stencil is off, but its ops still have to be valid
+	D3D11_DEPTH_STENCIL_DESC d3dDesc = {};
+	d3dDesc.DepthEnable = desc.DepthEnable;
+	d3dDesc.DepthWriteMask = desc.DepthWrite ? D3D11_DEPTH_WRITE_MASK_ALL : D3D11_DEPTH_WRITE_MASK_ZERO;
+	d3dDesc.DepthFunc = GetComparison(desc.DepthFunc);
+	d3dDesc.StencilReadMask = D3D11_DEFAULT_STENCIL_READ_MASK;
+	d3dDesc.StencilWriteMask = D3D11_DEFAULT_STENCIL_WRITE_MASK;
+	D3D11_DEPTH_STENCILOP_DESC keep = { D3D11_STENCIL_OP_KEEP, D3D11_STENCIL_OP_KEEP, D3D11_STENCIL_OP_KEEP, D3D11_COMPARISON_ALWAYS };
+	d3dDesc.FrontFace = keep;
+	d3dDesc.BackFace = keep;
+
+	D3D11DepthStencilState* created = new D3D11DepthStencilState();
+	if (FAILED(device->CreateDepthStencilState(&d3dDesc, created->object.GetAddressOf())))
+	{
+		created->Release();
+		return false;
+	}
+	*state = created;
+	return true;
+}
+
+bool D3D11RenderBackend::CreateBlendState(const BlendDesc& desc, RenderBlendState** state)
+{
+	*state = 0;
+
+	D3D11_BLEND_DESC d3dDesc = {};
+	for (unsigned int i = 0; i < 8; i++)
+	{
+		D3D11_RENDER_TARGET_BLEND_DESC& target = d3dDesc.RenderTarget[i];
+		target.BlendEnable = desc.BlendEnable;
+		target.SrcBlend = GetBlend(desc.SrcBlend);
+		target.DestBlend = GetBlend(desc.DestBlend);
+		target.BlendOp = D3D11_BLEND_OP_ADD;
+		target.SrcBlendAlpha = target.SrcBlend;
+		target.DestBlendAlpha = target.DestBlend;
+		target.BlendOpAlpha = D3D11_BLEND_OP_ADD;
+		target.RenderTargetWriteMask = D3D11_COLOR_WRITE_ENABLE_ALL;
+	}
+
+	D3D11BlendState* created = new D3D11BlendState();
+	if (FAILED(device->CreateBlendState(&d3dDesc, created->object.GetAddressOf())))
+	{
+		created->Release();
+		return false;
+	}
+	*state = created;
+	return true;
+}
+
+// --------------------------------------------------------
+// Binding
+// --------------------------------------------------------
+void D3D11RenderBackend::SetInputLayout(RenderInputLayout* layout)
+{
+	context->IASetInputLayout(D3D11InputLayout::Get(layout));
+}
+
+void D3D11RenderBackend::SetVertexShader(RenderVertexShader* shader)
+{
+	context->VSSetShader(D3D11VertexShader::Get(shader), 0, 0);
+}
+
+void D3D11RenderBackend::SetPixelShader(RenderPixelShader* shader)
+{
+	context->PSSetShader(D3D11PixelShader::Get(shader), 0, 0);
+}
+
+void D3D11RenderBackend::SetConstantBuffer(ShaderStage stage, unsigned int slot, RenderBuffer* buffer, unsigned int firstConstant, unsigned int numConstants)
+{
+	ID3D11Buffer* d3dBuffer = GetBuffer(buffer);
+	if (numConstants > 0 && context1)
+	{
+		if (stage == SHADER_STAGE_VERTEX)
+			context1->VSSetConstantBuffers1(slot, 1, &d3dBuffer, &firstConstant, &numConstants);
+		else
+			context1->PSSetConstantBuffers1(slot, 1, &d3dBuffer, &firstConstant, &numConstants);
+		return;
+	}
+
+	if (stage == SHADER_STAGE_VERTEX)
+		context->VSSetConstantBuffers(slot, 1, &d3dBuffer);
+	else
+		context->PSSetConstantBuffers(slot, 1, &d3dBuffer);
+}
+
+void D3D11RenderBackend::SetShaderResources(ShaderStage stage, unsigned int startSlot, unsigned int count, RenderResource* const* resources)
+{
+	ID3D11ShaderResourceView* srvs[D3D11_COMMONSHADER_INPUT_RESOURCE_SLOT_COUNT];
+	for (unsigned int i = 0; i < count; i++)
+		srvs[i] = GetSRV(resources[i]);
+
+	if (stage == SHADER_STAGE_VERTEX)
+		context->VSSetShaderResources(startSlot, count, srvs);
+	else
+		context->PSSetShaderResources(startSlot, count, srvs);
+}
+
+void D3D11RenderBackend::SetSamplers(ShaderStage stage, unsigned int startSlot, unsigned int count, RenderSamplerState* const* samplers)
+{
+	ID3D11SamplerState* states[D3D11_COMMONSHADER_SAMPLER_SLOT_COUNT];
+	for (unsigned int i = 0; i < count; i++)
+		states[i] = D3D11SamplerState::Get(samplers[i]);
+
+	if (stage == SHADER_STAGE_VERTEX)
+		context->VSSetSamplers(startSlot, count, states);
+	else
+		context->PSSetSamplers(startSlot, count, states);
+}
+
+void D3D11RenderBackend::SetVertexBuffers(unsigned int startSlot, unsigned int numBuffers, RenderBuffer* const* buffers, const unsigned int* strides, const unsigned int* offsets)
+{
+	ID3D11Buffer* d3dBuffers[D3D11_IA_VERTEX_INPUT_RESOURCE_SLOT_COUNT];
+	for (unsigned int i = 0; i < numBuffers; i++)
+		d3dBuffers[i] = GetBuffer(buffers[i]);
+
+	context->IASetVertexBuffers(startSlot, numBuffers, d3dBuffers, strides, offsets);
+}
+
+void D3D11RenderBackend::SetIndexBuffer(RenderBuffer* buffer, DXGI_FORMAT format, unsigned int offset)
+{
+	context->IASetIndexBuffer(GetBuffer(buffer), format, offset);
+}
+
+void D3D11RenderBackend::SetPrimitiveTopology(RenderTopology topology)
+{
+	context->IASetPrimitiveTopology((D3D11_PRIMITIVE_TOPOLOGY)topology);
+}
+
+void D3D11RenderBackend::SetRasterizerState(RenderRasterizerState* state)
+{
+	context->RSSetState(D3D11RasterizerState::Get(state));
+}
+
+void D3D11RenderBackend::SetDepthStencilState(RenderDepthStencilState* state, unsigned int stencilRef)
+{
+	context->OMSetDepthStencilState(D3D11DepthStencilState::Get(state), stencilRef);
+}
+
+void D3D11RenderBackend::SetBlendState(RenderBlendState* state)
+{
+	context->OMSetBlendState(D3D11BlendState::Get(state), 0, 0xFFFFFFFF);
+}
+
+void D3D11RenderBackend::SetRenderTargets(RenderTexture* renderTarget, RenderTexture* depthTarget)
+{
+	rtv = renderTarget ? D3D11Texture::Get(renderTarget)->rtv.Get() : 0;
+	dsv = depthTarget ? D3D11Texture::Get(depthTarget)->dsv.Get() : 0;
+	context->OMSetRenderTargets(1, &rtv, dsv);
+}
+
+void D3D11RenderBackend::SetViewport(float width, float height)
+{
+	D3D11_VIEWPORT viewport = {};
+	viewport.Width = width;
+	viewport.Height = height;
+	viewport.MaxDepth = 1.0f;
+	context->RSSetViewports(1, &viewport);
+}
+
+// --------------------------------------------------------
+// Text, through DirectXTK's sprite font
+// --------------------------------------------------------
+bool D3D11RenderBackend::LoadFont(const wchar_t* file)
+{
+	font = std::make_unique<DirectX::SpriteFont>(device.Get(), file);
+	spriteBatch = std::make_unique<DirectX::SpriteBatch>(context.Get());
+	return true;
+}
+
+void D3D11RenderBackend::MeasureString(const wchar_t* text, float* width, float* height)
+{
+	DirectX::XMFLOAT2 size;
+	DirectX::XMStoreFloat2(&size, font->MeasureString(text));
+	*width = size.x;
+	*height = size.y;
+}
+
+void D3D11RenderBackend::BeginText()
+{
+	spriteBatch->Begin();
+}
+
+void D3D11RenderBackend::DrawString(const wchar_t* text, float x, float y, const float color[4], float originX, float originY)
+{
+	font->DrawString(spriteBatch.get(), text, DirectX::XMFLOAT2(x, y), DirectX::XMVectorSet(color[0], color[1], color[2], color[3]),
+		0.0f, DirectX::XMFLOAT2(originX, originY));
+}
+
+void D3D11RenderBackend::EndText()
+{
+	spriteBatch->End();
+}
+
+// --------------------------------------------------------
+// Frame
+// --------------------------------------------------------
+void D3D11RenderBackend::Clear(const float color[4], float depth)
+{
+	context->ClearRenderTargetView(rtv, color);
+	context->ClearDepthStencilView(dsv, D3D11_CLEAR_DEPTH | D3D11_CLEAR_STENCIL, depth, 0);
+}
+
+void D3D11RenderBackend::DrawIndexed(unsigned int indexCount, unsigned int startIndex, int baseVertex)
+{
+	context->DrawIndexed(indexCount, startIndex, baseVertex);
+}
+
+void D3D11RenderBackend::Draw(unsigned int vertexCount, unsigned int startVertex)
+{
+	context->Draw(vertexCount, startVertex);
+}
+
+void D3D11RenderBackend::Present()
+{
+	swapChain->Present(0, 0);
+
+	// Due to the usage of a more sophisticated swap chain,
+	// the render target must be re-bound after every call to Present()
+	context->OMSetRenderTargets(1, &rtv, dsv);
+}
@@ -0,0 +1,95 @@
+#pragma once
+#include <d3d11.h>
+#include <d3d11_1.h>
+#include <wrl/client.h>
+#include <memory>
+#include "RenderBackend.h"
+
+namespace DirectX
+{
+	class SpriteBatch;
+	class SpriteFont;
+}
+
+// --------------------------------------------------------
+// Forwards everything to a D3D11 device and immediate
+// context, presenting through the swap chain.  The handles
+// it hands out wrap the D3D11 objects (and their views),
+// and are unwrapped again when bound.
+// --------------------------------------------------------
+class D3D11RenderBackend : public RenderBackend
+{
+public:
+	// Makes the back and depth buffers for the swap chain at
+	// width x height, and binds them
+	D3D11RenderBackend(ID3D11Device* device, ID3D11DeviceContext* context, IDXGISwapChain* swapChain, unsigned int width, unsigned int height);
+	~D3D11RenderBackend();
+
+	RenderTexture* GetBackBuffer() { return backBuffer.Get(); }
+	RenderTexture* GetDepthBuffer() { return depthBuffer.Get(); }
+	bool Resize(unsigned int width, unsigned int height);
+
+	bool CreateBuffer(const BufferDesc& desc, const void* initialData, RenderBuffer** buffer);
+	void* Map(RenderBuffer* buffer, RenderMap mapType);
+	void Unmap(RenderBuffer* buffer);
+	void UpdateBuffer(RenderBuffer* buffer, unsigned int offset, const void* data, unsigned int size);
+	bool SupportsConstantBufferOffsets();
+
+	bool LoadTexture(const wchar_t* file, RenderTexture** texture, bool srgb = false);
+	bool CreateTexture(const TextureDesc& desc, const SubresourceData* initialData, RenderTexture** texture);
+
+	bool CreateVertexShader(const void* byteCode, size_t byteCodeSize, RenderVertexShader** shader);
+	bool CreatePixelShader(const void* byteCode, size_t byteCodeSize, RenderPixelShader** shader);
+	bool CreateInputLayout(const InputElementDesc* elements, unsigned int elementCount, const void* byteCode, size_t byteCodeSize, RenderInputLayout** layout);
+
+	bool CreateSamplerState(const SamplerDesc& desc, RenderSamplerState** state);
+	bool CreateRasterizerState(const RasterizerDesc& desc, RenderRasterizerState** state);
+	bool CreateDepthStencilState(const DepthStencilDesc& desc, RenderDepthStencilState** state);
+	bool CreateBlendState(const BlendDesc& desc, RenderBlendState** state);
+
+	void SetInputLayout(RenderInputLayout* layout);
+	void SetVertexShader(RenderVertexShader* shader);
+	void SetPixelShader(RenderPixelShader* shader);
+	void SetConstantBuffer(ShaderStage stage, unsigned int slot, RenderBuffer* buffer, unsigned int firstConstant, unsigned int numConstants);
+	void SetShaderResources(ShaderStage stage, unsigned int startSlot, unsigned int count, RenderResource* const* resources);
+	void SetSamplers(ShaderStage stage, unsigned int startSlot, unsigned int count, RenderSamplerState* const* samplers);
+	void SetVertexBuffers(unsigned int startSlot, unsigned int numBuffers, RenderBuffer* const* buffers, const unsigned int* strides, const unsigned int* offsets);
+	void SetIndexBuffer(RenderBuffer* buffer, DXGI_FORMAT format, unsigned int offset);
+	void SetPrimitiveTopology(RenderTopology topology);
+	void SetRasterizerState(RenderRasterizerState* state);
+	void SetDepthStencilState(RenderDepthStencilState* state, unsigned int stencilRef);
+	void SetBlendState(RenderBlendState* state);
+
+	void SetRenderTargets(RenderTexture* renderTarget, RenderTexture* depthTarget);
+	void SetViewport(float width, float height);
+
+	bool LoadFont(const wchar_t* file);
+	void MeasureString(const wchar_t* text, float* width, float* height);
+	void BeginText();
+	void DrawString(const wchar_t* text, float x, float y, const float color[4], float originX, float originY);
+	void EndText();
+
+	void Clear(const float color[4], float depth);
+	void DrawIndexed(unsigned int indexCount, unsigned int startIndex, int baseVertex);
+	void Draw(unsigned int vertexCount, unsigned int startVertex);
+	void Present();
+
+private:
+	Microsoft::WRL::ComPtr<ID3D11Device> device;
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> context;
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext1> context1; // Null before D3D 11.1
+	Microsoft::WRL::ComPtr<IDXGISwapChain> swapChain;
+
+	RenderRef<RenderTexture> backBuffer;
+	RenderRef<RenderTexture> depthBuffer;
+
+	// The views of the bound targets
+	ID3D11RenderTargetView* rtv;
+	ID3D11DepthStencilView* dsv;
+
+	std::unique_ptr<DirectX::SpriteFont> font;
+	std::unique_ptr<DirectX::SpriteBatch> spriteBatch;
+
+	// Back buffer views of the swap chain, and a depth buffer to match
+	bool CreateTargets(unsigned int width, unsigned int height);
+};
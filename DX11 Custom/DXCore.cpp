@@ -1,12 +1,29 @@
 #include "DXCore.h"
 
-#include <WindowsX.h>
+#include <algorithm>
 #include <sstream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "NullRenderBackend.h"
+
+#ifdef _WIN32
+#include <WindowsX.h>
+#include "D3D11RenderBackend.h"
+
+// Between the folders of a path
+static const char PATH_SEPARATOR = '\\';
+#else
+#include <unistd.h>
+
+static const char PATH_SEPARATOR = '/';
+#endif
 
 // Define the static instance variable so our OS-level 
 // message handling function below can talk to our object
 DXCore* DXCore::DXCoreInstance = 0;
 
+#ifdef _WIN32
 // --------------------------------------------------------
 // The global callback function for handling windows OS-level messages.
 //
@@ -17,6 +34,7 @@ LRESULT DXCore::WindowProc(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
 {
 	return DXCoreInstance->ProcessMessage(hWnd, uMsg, wParam, lParam);
 }
+#endif
 
 // --------------------------------------------------------
 // Constructor - Set up fields and timer
@@ -42,6 +60,7 @@ DXCore::DXCore(
 
 	// Save params
 	this->hInstance = hInstance;
+	this->hWnd = 0;
 	this->titleBarText = titleBarText;
 	this->width = windowWidth;
 	this->height = windowHeight;
@@ -52,15 +71,15 @@ DXCore::DXCore(
 	
 	this->fpsFrameCount = 0;
 	this->fpsTimeElapsed = 0.0f;
-	this->currentTime = 0;
 	this->deltaTime = 0;
-	this->startTime = 0;
 	this->totalTime = 0;
 
-	// Query performance counter for accurate timing information
-	__int64 perfFreq;
-	QueryPerformanceFrequency((LARGE_INTEGER*)&perfFreq);
-	perfCounterSeconds = 1.0 / (double)perfFreq;
+	this->backend = 0;
+	this->headless = false;
+	this->headlessFrames = 0;
+	this->headlessTime = std::chrono::high_resolution_clock::duration::zero();
+	this->headlessFramesRun = 0;
+	this->quitting = false;
 }
 
 // --------------------------------------------------------
@@ -72,6 +91,23 @@ DXCore::~DXCore()
 	// we don't need to explicitly clean up those DirectX objects
 	// - If we weren't using smart pointers, we'd need
 	//   to call Release() on each DirectX object created in DXCore
+	delete backend;
+}
+
+// --------------------------------------------------------
+// Switches to a headless run of frameCount frames.  There's
+// no window to show anything, so make sure there is a
+// console for the results.
+// --------------------------------------------------------
+void DXCore::SetHeadless(unsigned int frameCount)
+{
+	headless = true;
+	headlessFrames = frameCount;
+
+#ifdef _WIN32
+	if (!GetConsoleWindow())
+		CreateConsoleWindow(500, 120, 32, 120);
+#endif
 }
 
 // --------------------------------------------------------
@@ -79,6 +115,10 @@ DXCore::~DXCore()
 // --------------------------------------------------------
 HRESULT DXCore::InitWindow()
 {
+#ifndef _WIN32
+	// Nothing to make a window with, headless runs don't need one
+	return S_OK;
+#else
 	// Start window creation by filling out the
 	// appropriate window class struct
 	WNDCLASS wndClass		= {}; // Zero out the memory
@@ -145,10 +185,13 @@ HRESULT DXCore::InitWindow()
 
 	// The window exists but is not visible yet
 	// We need to tell Windows to show it, and how to show it
-	ShowWindow(hWnd, SW_SHOW);
+	// (headless runs keep it hidden, it's only there for messages)
+	if (!headless)
+		ShowWindow(hWnd, SW_SHOW);
 
 	// Return an "everything is ok" HRESULT value
 	return S_OK;
+#endif
 }
 
 
@@ -159,6 +202,19 @@ HRESULT DXCore::InitWindow()
 // --------------------------------------------------------
 HRESULT DXCore::InitDirectX()
 {
+	// Headless runs render nothing, so the null backend stands
+	// in for the device and there's no swap chain to make
+	if (headless)
+	{
+		backend = new NullRenderBackend();
+		return S_OK;
+	}
+
+#ifndef _WIN32
+	// Only headless runs work without Windows
+	printf("There's no window or device to render with here - run with -headless\n");
+	return E_FAIL;
+#else
 	// This will hold options for DirectX initialization
 	unsigned int deviceFlags = 0;
 
@@ -189,11 +245,8 @@ HRESULT DXCore::InitDirectX()
 	swapDesc.SwapEffect = DXGI_SWAP_EFFECT_FLIP_DISCARD;
 	swapDesc.Windowed = true;
 
-	// Result variable for below function calls
-	HRESULT hr = S_OK;
-
 	// Attempt to initialize DirectX
-	hr = D3D11CreateDeviceAndSwapChain(
+	HRESULT hr = D3D11CreateDeviceAndSwapChain(
 		0,							// Video adapter (physical GPU) to use, or null for default
 		D3D_DRIVER_TYPE_HARDWARE,	// We want to use the hardware (GPU)
 		0,							// Used when doing software rendering
@@ -208,73 +261,14 @@ HRESULT DXCore::InitDirectX()
 		context.GetAddressOf());	// Pointer to our Device Context pointer
 	if (FAILED(hr)) return hr;
 
-	// The above function created the back buffer render target
-	// for us, but we need a reference to it
-	ID3D11Texture2D* backBufferTexture = 0;
-	swapChain->GetBuffer(
-		0,
-		__uuidof(ID3D11Texture2D),
-		(void**)&backBufferTexture);
-
-	// Now that we have the texture, create a render target view
-	// for the back buffer so we can render into it.  Then release
-	// our local reference to the texture, since we have the view.
-	if (backBufferTexture != 0)
-	{
-		device->CreateRenderTargetView(
-			backBufferTexture,
-			0,
-			backBufferRTV.GetAddressOf());
-		backBufferTexture->Release();
-	}
-
-	// Set up the description of the texture to use for the depth buffer
-	D3D11_TEXTURE2D_DESC depthStencilDesc = {};
-	depthStencilDesc.Width				= width;
-	depthStencilDesc.Height				= height;
-	depthStencilDesc.MipLevels			= 1;
-	depthStencilDesc.ArraySize			= 1;
-	depthStencilDesc.Format				= DXGI_FORMAT_D24_UNORM_S8_UINT;
-	depthStencilDesc.Usage				= D3D11_USAGE_DEFAULT;
-	depthStencilDesc.BindFlags			= D3D11_BIND_DEPTH_STENCIL;
-	depthStencilDesc.CPUAccessFlags		= 0;
-	depthStencilDesc.MiscFlags			= 0;
-	depthStencilDesc.SampleDesc.Count	= 1;
-	depthStencilDesc.SampleDesc.Quality = 0;
-
-	// Create the depth buffer and its view, then 
-	// release our reference to the texture
-	ID3D11Texture2D* depthBufferTexture = 0;
-	device->CreateTexture2D(&depthStencilDesc, 0, &depthBufferTexture);
-	if (depthBufferTexture != 0)
-	{
-		device->CreateDepthStencilView(
-			depthBufferTexture, 
-			0, 
-			depthStencilView.GetAddressOf());
-		depthBufferTexture->Release();
-	}
-
-	// Bind the views to the pipeline, so rendering properly 
-	// uses their underlying textures
-	context->OMSetRenderTargets(
-		1, 
-		backBufferRTV.GetAddressOf(), 
-		depthStencilView.Get());
-
-	// Lastly, set up a viewport so we render into
-	// to correct portion of the window
-	D3D11_VIEWPORT viewport = {};
-	viewport.TopLeftX	= 0;
-	viewport.TopLeftY	= 0;
-	viewport.Width		= (float)width;
-	viewport.Height		= (float)height;
-	viewport.MinDepth	= 0.0f;
-	viewport.MaxDepth	= 1.0f;
-	context->RSSetViewports(1, &viewport);
+	// Everything the game draws goes through the backend.  It
+	// makes the back buffer's sRGB view and a depth buffer to
+	// match, and binds them with a viewport over the window.
+	backend = new D3D11RenderBackend(device.Get(), context.Get(), swapChain.Get(), width, height);
 
 	// Return the "everything is ok" HRESULT value
 	return S_OK;
+#endif
 }
 
 // --------------------------------------------------------
@@ -287,75 +281,12 @@ HRESULT DXCore::InitDirectX()
 // --------------------------------------------------------
 void DXCore::OnResize()
 {
-	// Release the buffers before resizing the swap chain
-	backBufferRTV.Reset();
-	depthStencilView.Reset();
-
-	// Resize the underlying swap chain buffers
-	swapChain->ResizeBuffers(
-		2,
-		width,
-		height,
-		DXGI_FORMAT_R8G8B8A8_UNORM,
-		0);
-
-	// Recreate the render target view for the back buffer
-	// texture, then release our local texture reference
-	ID3D11Texture2D* backBufferTexture = 0;
-	swapChain->GetBuffer(0, __uuidof(ID3D11Texture2D), reinterpret_cast<void**>(&backBufferTexture));
-	if (backBufferTexture != 0)
-	{
-		device->CreateRenderTargetView(
-			backBufferTexture, 
-			0, 
-			backBufferRTV.ReleaseAndGetAddressOf()); // ReleaseAndGetAddressOf() cleans up the old object before giving us the pointer
-		backBufferTexture->Release();
-	}
-
-	// Set up the description of the texture to use for the depth buffer
-	D3D11_TEXTURE2D_DESC depthStencilDesc;
-	depthStencilDesc.Width				= width;
-	depthStencilDesc.Height				= height;
-	depthStencilDesc.MipLevels			= 1;
-	depthStencilDesc.ArraySize			= 1;
-	depthStencilDesc.Format				= DXGI_FORMAT_D24_UNORM_S8_UINT;
-	depthStencilDesc.Usage				= D3D11_USAGE_DEFAULT;
-	depthStencilDesc.BindFlags			= D3D11_BIND_DEPTH_STENCIL;
-	depthStencilDesc.CPUAccessFlags		= 0;
-	depthStencilDesc.MiscFlags			= 0;
-	depthStencilDesc.SampleDesc.Count	= 1;
-	depthStencilDesc.SampleDesc.Quality = 0;
-
-	// Create the depth buffer and its view, then 
-	// release our reference to the texture
-	ID3D11Texture2D* depthBufferTexture = 0;
-	device->CreateTexture2D(&depthStencilDesc, 0, &depthBufferTexture);
-	if (depthBufferTexture != 0)
-	{
-		device->CreateDepthStencilView(
-			depthBufferTexture, 
-			0, 
-			depthStencilView.ReleaseAndGetAddressOf()); // ReleaseAndGetAddressOf() cleans up the old object before giving us the pointer
-		depthBufferTexture->Release();
-	}
+	// Headless runs have a fixed size offscreen target
+	if (headless)
+		return;
 
-	// Bind the views to the pipeline, so rendering properly 
-	// uses their underlying textures
-	context->OMSetRenderTargets(
-		1, 
-		backBufferRTV.GetAddressOf(), // This requires a pointer to a pointer (an array of pointers), so we get the address of the pointer
-		depthStencilView.Get());
-
-	// Lastly, set up a viewport so we render into
-	// to correct portion of the window
-	D3D11_VIEWPORT viewport = {};
-	viewport.TopLeftX = 0;
-	viewport.TopLeftY = 0;
-	viewport.Width = (float)width;
-	viewport.Height = (float)height;
-	viewport.MinDepth = 0.0f;
-	viewport.MaxDepth = 1.0f;
-	context->RSSetViewports(1, &viewport);
+	// Remakes the buffers and views, and rebinds them
+	backend->Resize(width, height);
 }
 
 
@@ -368,18 +299,21 @@ HRESULT DXCore::Run()
 {
 	// Grab the start time now that
 	// the game loop is running
-	__int64 now;
-	QueryPerformanceCounter((LARGE_INTEGER*)&now);
-	startTime = now;
-	currentTime = now;
-	previousTime = now;
+	startTime = std::chrono::high_resolution_clock::now();
+	currentTime = startTime;
+	previousTime = startTime;
 
 	// Give subclass a chance to initialize
 	Init();
 
-	// Our overall game and message loop
+	headlessTime = std::chrono::high_resolution_clock::duration::zero();
+	headlessFramesRun = 0;
+
+#ifdef _WIN32
+	// Our overall game and message loop.  Headless runs end
+	// once they've run their frames.
 	MSG msg = {};
-	while (msg.message != WM_QUIT)
+	while (msg.message != WM_QUIT && !(headless && headlessFramesRun >= headlessFrames))
 	{
 		// Determine if there is a message waiting
 		if (PeekMessage(&msg, NULL, 0, 0, PM_REMOVE))
@@ -391,20 +325,56 @@ HRESULT DXCore::Run()
 		}
 		else
 		{
-			// Update timer and title bar (if necessary)
-			UpdateTimer();
-			if(titleBarStats)
-				UpdateTitleBarStats();
-
-			// The game loop
-			Update(deltaTime, totalTime);
-			Draw(deltaTime, totalTime);
+			RunFrame();
 		}
 	}
 
+	// A headless run that finished its frames never saw a quit
+	if (msg.message != WM_QUIT)
+		return S_OK;
+
 	// We'll end up here once we get a WM_QUIT message,
 	// which usually comes from the user closing the window
 	return (HRESULT)msg.wParam;
+#else
+	// No window, so no messages - just frames until the run
+	// is over or the game quits
+	while (!quitting && !(headless && headlessFramesRun >= headlessFrames))
+		RunFrame();
+
+	return S_OK;
+#endif
+}
+
+// --------------------------------------------------------
+// One pass of the game loop, timed for headless runs
+// --------------------------------------------------------
+void DXCore::RunFrame()
+{
+	// Update timer and title bar (if necessary) - headless
+	// runs have no window to show it
+	UpdateTimer();
+#ifdef _WIN32
+	if(titleBarStats && !headless)
+		UpdateTitleBarStats();
+#endif
+
+	auto frameStart = std::chrono::high_resolution_clock::now();
+
+	// The game loop
+	Update(deltaTime, totalTime);
+	Draw(deltaTime, totalTime);
+
+	if (headless)
+	{
+		headlessTime += std::chrono::high_resolution_clock::now() - frameStart;
+		headlessFramesRun++;
+	}
+}
+
+double DXCore::GetHeadlessFrameMilliseconds()
+{
+	return headlessFramesRun ? std::chrono::duration<double, std::milli>(headlessTime).count() / headlessFramesRun : 0.0;
 }
 
 
@@ -414,7 +384,42 @@ HRESULT DXCore::Run()
 // --------------------------------------------------------
 void DXCore::Quit()
 {
+	quitting = true;
+#ifdef _WIN32
 	PostMessage(this->hWnd, WM_CLOSE, NULL, NULL);
+#endif
+}
+
+
+// --------------------------------------------------------
+// Polled keyboard and mouse state.  Keys are virtual key
+// codes.
+// --------------------------------------------------------
+bool DXCore::IsKeyDown(int key)
+{
+#ifdef _WIN32
+	if (!DXCoreInstance || DXCoreInstance->headless)
+		return false;
+	return (GetAsyncKeyState(key) & 0x8000) != 0;
+#else
+	return false;
+#endif
+}
+
+void DXCore::GetMousePosition(int* x, int* y)
+{
+	*x = 0;
+	*y = 0;
+#ifdef _WIN32
+	if (!DXCoreInstance || DXCoreInstance->headless)
+		return;
+
+	POINT mousePos = {};
+	GetCursorPos(&mousePos);
+	ScreenToClient(DXCoreInstance->hWnd, &mousePos);
+	*x = mousePos.x;
+	*y = mousePos.y;
+#endif
 }
 
 
@@ -425,23 +430,22 @@ void DXCore::Quit()
 void DXCore::UpdateTimer()
 {
 	// Grab the current time
-	__int64 now;
-	QueryPerformanceCounter((LARGE_INTEGER*)&now);
-	currentTime = now;
+	currentTime = std::chrono::high_resolution_clock::now();
 
 	// Calculate delta time and clamp to zero
 	//  - Could go negative if CPU goes into power save mode 
 	//    or the process itself gets moved to another core
-	deltaTime = max((float)((currentTime - previousTime) * perfCounterSeconds), 0.0f);
+	deltaTime = std::max(std::chrono::duration<float>(currentTime - previousTime).count(), 0.0f);
 
 	// Calculate the total time from start to now
-	totalTime = (float)((currentTime - startTime) * perfCounterSeconds);
+	totalTime = std::chrono::duration<float>(currentTime - startTime).count();
 
 	// Save current time for next frame
 	previousTime = currentTime;
 }
 
 
+#ifdef _WIN32
 // --------------------------------------------------------
 // Updates the window's title bar with several stats once
 // per second, including:
@@ -483,6 +487,8 @@ void DXCore::UpdateTitleBarStats()
 	default:                     output << "    DX ???";  break;
 	}
 
+	output << GetTitleBarStats();
+
 	// Actually update the title bar and reset fps data
 	SetWindowText(hWnd, output.str().c_str());
 	fpsFrameCount = 0;
@@ -526,6 +532,7 @@ void DXCore::CreateConsoleWindow(int bufferLines, int bufferColumns, int windowL
 	HMENU hmenu = GetSystemMenu(consoleHandle, FALSE);
 	EnableMenuItem(hmenu, SC_CLOSE, MF_GRAYED);
 }
+#endif
 
 // --------------------------------------------------------------------------
 // Gets the actual path to this executable
@@ -545,14 +552,19 @@ void DXCore::CreateConsoleWindow(int bufferLines, int bufferColumns, int windowL
 std::string DXCore::GetExePath()
 {
 	// Assume the path is just the "current directory" for now
-	std::string path = ".\\";
+	std::string path = ".";
 
 	// Get the real, full path to this executable
 	char currentDir[1024] = {};
+#ifdef _WIN32
 	GetModuleFileName(0, currentDir, 1024);
+#else
+	if (readlink("/proc/self/exe", currentDir, 1023) < 0)
+		currentDir[0] = 0;
+#endif
 
 	// Find the location of the last slash charaacter
-	char* lastSlash = strrchr(currentDir, '\\');
+	char* lastSlash = strrchr(currentDir, PATH_SEPARATOR);
 	if (lastSlash)
 	{
 		// End the string at the last slash character, essentially
@@ -581,7 +593,11 @@ std::wstring DXCore::GetExePath_Wide()
 
 	// Convert to a wide string
 	wchar_t widePath[1024] = {};
+#ifdef _WIN32
 	mbstowcs_s(0, widePath, path.c_str(), 1024);
+#else
+	mbstowcs(widePath, path.c_str(), 1023);
+#endif
 
 	// Create a wstring for it and return
 	return std::wstring(widePath);
@@ -595,7 +611,7 @@ std::wstring DXCore::GetExePath_Wide()
 // ----------------------------------------------------
 std::string DXCore::GetFullPathTo(std::string relativeFilePath)
 {
-	return GetExePath() + "\\" + relativeFilePath;
+	return GetExePath() + PATH_SEPARATOR + relativeFilePath;
 }
 
 
@@ -609,13 +625,14 @@ std::string DXCore::GetFullPathTo(std::string relativeFilePath)
 // ----------------------------------------------------
 std::wstring DXCore::GetFullPathTo_Wide(std::wstring relativeFilePath)
 {
-	return GetExePath_Wide() + L"\\" + relativeFilePath;
+	return GetExePath_Wide() + (wchar_t)PATH_SEPARATOR + relativeFilePath;
 }
 
 
 
 
 
+#ifdef _WIN32
 // --------------------------------------------------------
 // Handles messages that are sent to our window by the
 // operating system.  Ignoring these messages would cause
@@ -656,7 +673,7 @@ LRESULT DXCore::ProcessMessage(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lPara
 
 		// If DX is initialized, resize 
 		// our required buffers
-		if (device) 
+		if (backend) 
 			OnResize();
 
 		return 0;
@@ -670,4 +687,4 @@ LRESULT DXCore::ProcessMessage(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lPara
 	// Let Windows handle any messages we're not touching
 	return DefWindowProc(hWnd, uMsg, wParam, lParam);
 }
-
+#endif
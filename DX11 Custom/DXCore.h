@@ -1,13 +1,33 @@
 #pragma once
 
+#include <chrono>
+#include <string>
+#include "RenderBackend.h"
+
+#ifdef _WIN32
 #include <Windows.h>
 #include <d3d11.h>
-#include <string>
 #include <wrl/client.h> // Used for ComPtr - a smart pointer for COM objects
 
 // We can include the correct library files here
 // instead of in Visual Studio settings if we want
 #pragma comment(lib, "d3d11.lib")
+#else
+// Stand-ins for the Windows types in the interface.  Without
+// Windows there's no window, so only headless runs work.
+typedef void* HINSTANCE;
+typedef void* HWND;
+typedef int HRESULT;
+#define S_OK ((HRESULT)0)
+#define E_FAIL ((HRESULT)0x80004005)
+#define FAILED(hr) (((HRESULT)(hr)) < 0)
+#endif
+
+// Keys for DXCore::IsKeyDown() that aren't characters.  Letters
+// and digits are their uppercase character, as in 'W'.
+#define KEY_LBUTTON	0x01
+#define KEY_ESCAPE	0x1B
+#define KEY_SPACE	0x20
 
 class DXCore
 {
@@ -22,6 +42,7 @@ public:
 
 	// Static requirements for OS-level message processing
 	static DXCore* DXCoreInstance;
+#ifdef _WIN32
 	static LRESULT CALLBACK WindowProc(
 		HWND hWnd,		// Window handle
 		UINT uMsg,		// Message
@@ -31,6 +52,13 @@ public:
 
 	// Internal method for message handling
 	LRESULT ProcessMessage(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam);
+#endif
+
+	// Polled input: whether a key (or mouse button) is held,
+	// and the cursor in client coordinates.  Headless runs see
+	// nothing pressed and the cursor at 0, 0.
+	static bool IsKeyDown(int key);
+	static void GetMousePosition(int* x, int* y);
 
 	// Initialization and game-loop related methods
 	HRESULT InitWindow();
@@ -39,11 +67,26 @@ public:
 	void Quit();
 	virtual void OnResize();
 
+	// Runs without showing a window or touching the GPU: the
+	// NullRenderBackend stands in for the device and drops all
+	// rendering, and Run() returns after the given frame count.
+	// The only way to run without Windows.  Call before
+	// InitWindow().
+	void SetHeadless(unsigned int frameCount);
+
+	// After a headless Run(), the frames it ran and their average
+	// CPU time in Update() and Draw()
+	unsigned int GetHeadlessFramesRun() { return headlessFramesRun; }
+	double GetHeadlessFrameMilliseconds();
+
 	// Pure virtual methods for setup and game functionality
 	virtual void Init() = 0;
 	virtual void Update(float deltaTime, float totalTime) = 0;
 	virtual void Draw(float deltaTime, float totalTime) = 0;
 
+	// Extra text for the end of the title bar, asked for once a second
+	virtual std::string GetTitleBarStats() { return std::string(); }
+
 protected:
 	HINSTANCE	hInstance;		// The handle to the application
 	HWND		hWnd;			// The handle to the window itself
@@ -58,17 +101,27 @@ protected:
 	// Helpful if we want to pause while not the active window
 	bool hasFocus;
 
-	// DirectX related objects and variables
+#ifdef _WIN32
+	// DirectX related objects and variables, only made for
+	// runs with a window
 	D3D_FEATURE_LEVEL		dxFeatureLevel;
 	Microsoft::WRL::ComPtr<IDXGISwapChain>		swapChain;
 	Microsoft::WRL::ComPtr<ID3D11Device>		device;
 	Microsoft::WRL::ComPtr<ID3D11DeviceContext>	context;
 
-	Microsoft::WRL::ComPtr<ID3D11RenderTargetView> backBufferRTV;
-	Microsoft::WRL::ComPtr<ID3D11DepthStencilView> depthStencilView;
-
 	// Helper function for allocating a console window
 	void CreateConsoleWindow(int bufferLines, int bufferColumns, int windowLines, int windowColumns);
+#endif
+
+	// Everything the frame loop draws goes through this
+	RenderBackend* backend;
+
+	// Headless runs - see SetHeadless()
+	bool headless;
+	unsigned int headlessFrames;
+
+	// Set by Quit() - without Windows there's no message to post
+	bool quitting;
 
 	// Helpers for determining the actual path to the executable
 	std::string GetExePath();
@@ -80,18 +133,24 @@ protected:
 
 private:
 	// Timing related data
-	double perfCounterSeconds;
 	float totalTime;
 	float deltaTime;
-	__int64 startTime;
-	__int64 currentTime;
-	__int64 previousTime;
+	std::chrono::high_resolution_clock::time_point startTime;
+	std::chrono::high_resolution_clock::time_point currentTime;
+	std::chrono::high_resolution_clock::time_point previousTime;
 
 	// FPS calculation
 	int fpsFrameCount;
 	float fpsTimeElapsed;
 
+	// CPU time spent in Update() and Draw(), for headless runs
+	std::chrono::high_resolution_clock::duration headlessTime;
+	unsigned int headlessFramesRun;
+
+	void RunFrame();			// Update() and Draw() once, timed
 	void UpdateTimer();			// Updates the timer for this frame
+#ifdef _WIN32
 	void UpdateTitleBarStats();	// Puts debug info in the title bar
+#endif
 };
 
@@ -0,0 +1,130 @@
+#include "DynamicResolution.h"
+#include "ShaderConstants.h"
+
+DynamicResolution::DynamicResolution(RenderBackend* backend, PipelineStateCache* pipelineStates, SimpleVertexShader* upscaleVS, SimplePixelShader* upscalePS)
+{
+	this->backend = backend;
+	this->pipelineStates = pipelineStates;
+	this->upscaleVS = upscaleVS;
+	this->upscalePS = upscalePS;
+	pipelineState = 0;
+
+	width = 0;
+	height = 0;
+	renderWidth = 0;
+	renderHeight = 0;
+	scale = 1.0f;
+	scaled = false;
+
+	// Bilinear, and clamped so the edges don't wrap
+	SamplerDesc samplerDesc = {};
+	samplerDesc.Filter = RENDER_FILTER_LINEAR_MIP_POINT;
+	samplerDesc.AddressMode = RENDER_ADDRESS_CLAMP;
+	backend->CreateSamplerState(samplerDesc, sampler.GetAddressOf());
+}
+
+DynamicResolution::~DynamicResolution()
+{
+	delete upscaleVS;
+	delete upscalePS;
+}
+
+// --------------------------------------------------------
+// The scene target is srgb like the back buffer's view, so
+// the upscale filters linear values
+// --------------------------------------------------------
+void DynamicResolution::Resize(unsigned int width, unsigned int height)
+{
+	this->width = width;
+	this->height = height;
+
+	TextureDesc desc = {};
+	desc.Type = RENDER_TEXTURE_2D;
+	desc.Width = width;
+	desc.Height = height;
+	desc.MipLevels = 1;
+	desc.ArraySize = 1;
+	desc.Format = DXGI_FORMAT_R8G8B8A8_UNORM_SRGB;
+	desc.Usage = RENDER_USAGE_DEFAULT;
+	desc.BindFlags = RENDER_BIND_RENDER_TARGET | RENDER_BIND_SHADER_RESOURCE;
+	backend->CreateTexture(desc, 0, sceneTexture.ReleaseAndGetAddressOf());
+}
+
+void DynamicResolution::SetScale(float scale)
+{
+	if (scale > 1.0f)
+		scale = 1.0f;
+	if (scale < 0.01f)
+		scale = 0.01f;
+	this->scale = scale;
+}
+
+void DynamicResolution::Begin(RenderTexture* backBuffer, RenderTexture* depthBuffer)
+{
+	renderWidth = (unsigned int)(width * scale + 0.5f);
+	renderHeight = (unsigned int)(height * scale + 0.5f);
+	if (renderWidth < 1) renderWidth = 1;
+	if (renderHeight < 1) renderHeight = 1;
+
+	// Without a scene target everything draws at full size
+	scaled = sceneTexture && (renderWidth < width || renderHeight < height);
+	if (!scaled)
+	{
+		renderWidth = width;
+		renderHeight = height;
+	}
+
+	backend->SetRenderTargets(scaled ? sceneTexture.Get() : backBuffer, depthBuffer);
+	backend->SetViewport((float)renderWidth, (float)renderHeight);
+}
+
+void DynamicResolution::End(StateCache* state, RenderTexture* backBuffer, RenderTexture* depthBuffer)
+{
+	if (!scaled)
+		return;
+
+	backend->SetRenderTargets(backBuffer, depthBuffer);
+	backend->SetViewport((float)width, (float)height);
+
+	//the shaders are set after construction, so the pso is made on first draw
+	if (!pipelineState)
+	{
+		//a single triangle over the whole screen, with no vertex input
+		//and no depth, covering everything drawn before it
+		PipelineStateDesc desc;
+		desc.vertexShader = upscaleVS->GetDirectXShader();
+		desc.pixelShader = upscalePS->GetDirectXShader();
+		desc.inputLayout = upscaleVS->GetInputLayout();
+		desc.rasterizer.CullMode = RENDER_CULL_NONE;
+		desc.depthStencil.DepthEnable = false;
+		desc.depthStencil.DepthWrite = false;
+		pipelineState = pipelineStates->GetPipelineState(desc);
+	}
+	state->SetPipelineState(pipelineState);
+
+	upscaleVS->SetShader();
+	upscalePS->SetShader();
+
+	// Only the top left of the scene texture was drawn into.  The
+	// uvs stop half a texel in from its edge, so the filter never
+	// blends in what's left from larger frames.
+	UpscalePSExternalData data;
+	data.uvScale.x = (float)renderWidth / width;
+	data.uvScale.y = (float)renderHeight / height;
+	data.uvMax.x = (renderWidth - 0.5f) / width;
+	data.uvMax.y = (renderHeight - 0.5f) / height;
+	upscalePS->SetBufferData("ExternalData", data);
+
+	upscalePS->SetSamplerState("sampleState", sampler.Get());
+	upscalePS->SetShaderResourceView("sceneTexture", sceneTexture.Get());
+	upscalePS->FlushBindings();
+
+	upscalePS->CopyAllBufferData();
+	upscaleVS->CopyAllBufferData();
+
+	state->Draw(3, 0);
+
+	// Unbound again, as next frame draws into it
+	upscalePS->SetShaderResourceView("sceneTexture", 0);
+	upscalePS->FlushBindings();
+}
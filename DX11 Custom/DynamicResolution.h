@@ -0,0 +1,65 @@
+#pragma once
+#include "RenderBackend.h"
+#include "StateCache.h"
+#include "PipelineState.h"
+#include "SimpleShader.h"
+
+// --------------------------------------------------------
+// Draws the scene at a fraction of the window's size and
+// stretches it over the back buffer.
+//
+// The scene target is made at the full window size once, and
+// only its top left part is drawn into, so changing the scale
+// never reallocates anything - it only moves the viewport and
+// the upscale's uv range.  The depth buffer is shared with the
+// back buffer the same way.
+//
+// At a scale of 1 the scene goes straight to the back buffer
+// and End() does nothing.
+// --------------------------------------------------------
+class DynamicResolution
+{
+public:
+	// Takes ownership of the upscale shaders
+	DynamicResolution(RenderBackend* backend, PipelineStateCache* pipelineStates, SimpleVertexShader* upscaleVS, SimplePixelShader* upscalePS);
+	~DynamicResolution();
+
+	// Remakes the scene target for a new window size
+	void Resize(unsigned int width, unsigned int height);
+
+	// Per axis, clamped to (0, 1].  Takes effect at the next Begin().
+	void SetScale(float scale);
+	float GetScale() { return scale; }
+
+	// The size the scene is drawn at this frame
+	unsigned int GetRenderWidth() { return renderWidth; }
+	unsigned int GetRenderHeight() { return renderHeight; }
+
+	// Binds where the scene draws (for the backend's Clear() as
+	// well), with the viewport at the render size
+	void Begin(RenderTexture* backBuffer, RenderTexture* depthBuffer);
+
+	// Upscales into the back buffer, leaving it bound with the
+	// full viewport for anything drawn over the top
+	void End(StateCache* state, RenderTexture* backBuffer, RenderTexture* depthBuffer);
+
+private:
+	RenderBackend* backend;
+	PipelineStateCache* pipelineStates;
+	const PipelineState* pipelineState;
+
+	SimpleVertexShader* upscaleVS;
+	SimplePixelShader* upscalePS;
+
+	RenderRef<RenderTexture> sceneTexture;
+	RenderRef<RenderSamplerState> sampler;
+
+	unsigned int width;
+	unsigned int height;
+	unsigned int renderWidth;
+	unsigned int renderHeight;
+	float scale;
+
+	// Whether this frame went to the scene target
+	bool scaled;
+};
@@ -0,0 +1,1042 @@
+#include "EnvironmentLighting.h"
+#include "Texels.h"
+#include "ShaderReflectionCache.h"
+#include "FilePath.h"
+#include <DirectXPackedVector.h>
+#include <emmintrin.h>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iterator>
+#include <string.h>
+
+using namespace DirectX;
+using namespace DirectX::PackedVector;
+
+// Bump whenever the cooked layout or the filtering changes
+static const uint32_t ENVIRONMENT_MAGIC = 0x4C564E45; // "ENVL"
+static const uint32_t ENVIRONMENT_VERSION = 1;
+
+// Larger cubemaps are box filtered down to this before cooking
+static const unsigned int MAX_SOURCE_SIZE = 512;
+
+// The specular chain stops at 4x4, where it's a blur anyway
+static const unsigned int MIN_SPECULAR_SIZE = 4;
+
+static const unsigned int SPECULAR_SAMPLES = 256;
+static const unsigned int BRDF_SAMPLES = 512;
+
+// SH are projected from the level at most this big
+static const unsigned int SH_SOURCE_SIZE = 64;
+
+static const float PI = 3.14159265359f;
+
+// --------------------------------------------------------
+// Cooked file header, followed by the irradiance, specular
+// and BRDF pixels in order, then the SH coefficients
+// --------------------------------------------------------
+struct EnvironmentFileHeader
+{
+	uint32_t Magic;
+	uint32_t Version;
+	uint64_t Hash;
+	uint32_t SourceSize;
+	uint32_t SpecularSize;
+	uint32_t SpecularMips;
+	uint32_t IrradianceSize;
+	uint32_t LutSize;
+	uint32_t Pad;
+};
+
+// --------------------------------------------------------
+// The parts of the DDS header we read
+// --------------------------------------------------------
+struct DdsPixelFormat
+{
+	uint32_t size;
+	uint32_t flags;
+	uint32_t fourCC;
+	uint32_t rgbBitCount;
+	uint32_t rMask;
+	uint32_t gMask;
+	uint32_t bMask;
+	uint32_t aMask;
+};
+
+struct DdsHeader
+{
+	uint32_t size;
+	uint32_t flags;
+	uint32_t height;
+	uint32_t width;
+	uint32_t pitchOrLinearSize;
+	uint32_t depth;
+	uint32_t mipMapCount;
+	uint32_t reserved1[11];
+	DdsPixelFormat ddspf;
+	uint32_t caps;
+	uint32_t caps2;
+	uint32_t caps3;
+	uint32_t caps4;
+	uint32_t reserved2;
+};
+
+struct DdsHeaderDX10
+{
+	uint32_t dxgiFormat;
+	uint32_t resourceDimension;
+	uint32_t miscFlag;
+	uint32_t arraySize;
+	uint32_t miscFlags2;
+};
+
+static const uint32_t DDS_MAGIC = 0x20534444; // "DDS "
+static const uint32_t DDS_FOURCC = 0x4;
+static const uint32_t DDS_RGB = 0x40;
+static const uint32_t DDS_CUBEMAP_ALLFACES = 0xFE00;
+static const uint32_t DDS_DX10_TEXTURECUBE = 0x4;
+
+static uint32_t MakeFourCC(char a, char b, char c, char d)
+{
+	return (uint32_t)(unsigned char)a | ((uint32_t)(unsigned char)b << 8) | ((uint32_t)(unsigned char)c << 16) | ((uint32_t)(unsigned char)d << 24);
+}
+
+// The formats DecodeCubemap understands
+enum CubemapFormat
+{
+	CUBEMAP_UNKNOWN,
+	CUBEMAP_RGBA8,
+	CUBEMAP_BGRA8,
+	CUBEMAP_BC1,
+	CUBEMAP_BC2,
+	CUBEMAP_BC3,
+	CUBEMAP_RGBA16F,
+	CUBEMAP_RGBA32F,
+};
+
+static CubemapFormat GetDX10Format(uint32_t format)
+{
+	switch ((DXGI_FORMAT)format)
+	{
+	case DXGI_FORMAT_R8G8B8A8_UNORM:
+	case DXGI_FORMAT_R8G8B8A8_UNORM_SRGB:
+		return CUBEMAP_RGBA8;
+	case DXGI_FORMAT_B8G8R8A8_UNORM:
+	case DXGI_FORMAT_B8G8R8A8_UNORM_SRGB:
+	case DXGI_FORMAT_B8G8R8X8_UNORM:
+	case DXGI_FORMAT_B8G8R8X8_UNORM_SRGB:
+		return CUBEMAP_BGRA8;
+	case DXGI_FORMAT_BC1_UNORM:
+	case DXGI_FORMAT_BC1_UNORM_SRGB:
+		return CUBEMAP_BC1;
+	case DXGI_FORMAT_BC2_UNORM:
+	case DXGI_FORMAT_BC2_UNORM_SRGB:
+		return CUBEMAP_BC2;
+	case DXGI_FORMAT_BC3_UNORM:
+	case DXGI_FORMAT_BC3_UNORM_SRGB:
+		return CUBEMAP_BC3;
+	case DXGI_FORMAT_R16G16B16A16_FLOAT:
+		return CUBEMAP_RGBA16F;
+	case DXGI_FORMAT_R32G32B32A32_FLOAT:
+		return CUBEMAP_RGBA32F;
+	default:
+		return CUBEMAP_UNKNOWN;
+	}
+}
+
+static CubemapFormat GetLegacyFormat(const DdsPixelFormat& pf)
+{
+	if (pf.flags & DDS_FOURCC)
+	{
+		if (pf.fourCC == MakeFourCC('D', 'X', 'T', '1')) return CUBEMAP_BC1;
+		if (pf.fourCC == MakeFourCC('D', 'X', 'T', '2') || pf.fourCC == MakeFourCC('D', 'X', 'T', '3')) return CUBEMAP_BC2;
+		if (pf.fourCC == MakeFourCC('D', 'X', 'T', '4') || pf.fourCC == MakeFourCC('D', 'X', 'T', '5')) return CUBEMAP_BC3;
+		if (pf.fourCC == 113) return CUBEMAP_RGBA16F;	// D3DFMT_A16B16G16R16F
+		if (pf.fourCC == 116) return CUBEMAP_RGBA32F;	// D3DFMT_A32B32G32R32F
+		return CUBEMAP_UNKNOWN;
+	}
+	if ((pf.flags & DDS_RGB) && pf.rgbBitCount == 32)
+	{
+		if (pf.rMask == 0x000000FF && pf.gMask == 0x0000FF00 && pf.bMask == 0x00FF0000) return CUBEMAP_RGBA8;
+		if (pf.rMask == 0x00FF0000 && pf.gMask == 0x0000FF00 && pf.bMask == 0x000000FF) return CUBEMAP_BGRA8;
+	}
+	return CUBEMAP_UNKNOWN;
+}
+
+// --------------------------------------------------------
+// Bytes of one mip of one face
+// --------------------------------------------------------
+static size_t GetMipBytes(CubemapFormat format, unsigned int size)
+{
+	unsigned int blocks = (size + 3) / 4;
+	switch (format)
+	{
+	case CUBEMAP_BC1: return (size_t)blocks * blocks * 8;
+	case CUBEMAP_BC2:
+	case CUBEMAP_BC3: return (size_t)blocks * blocks * 16;
+	case CUBEMAP_RGBA16F: return (size_t)size * size * 8;
+	case CUBEMAP_RGBA32F: return (size_t)size * size * 16;
+	default: return (size_t)size * size * 4;
+	}
+}
+
+// --------------------------------------------------------
+// One BC1 color block (BC2 and BC3 carry one too, always in
+// four color mode) into 16 linear RGBA texels.  Alpha is
+// left at 1, since nothing here reads it.
+// --------------------------------------------------------
+static void DecodeColorBlock(const unsigned char* block, bool fourColor, float* texels, unsigned int pitch)
+{
+	uint16_t c0 = (uint16_t)(block[0] | (block[1] << 8));
+	uint16_t c1 = (uint16_t)(block[2] | (block[3] << 8));
+	uint32_t bits = (uint32_t)block[4] | ((uint32_t)block[5] << 8) | ((uint32_t)block[6] << 16) | ((uint32_t)block[7] << 24);
+
+	unsigned char palette[4][3];
+	uint16_t ends[2] = { c0, c1 };
+	for (unsigned int e = 0; e < 2; e++)
+	{
+		unsigned int r = (ends[e] >> 11) & 31, g = (ends[e] >> 5) & 63, b = ends[e] & 31;
+		palette[e][0] = (unsigned char)((r << 3) | (r >> 2));
+		palette[e][1] = (unsigned char)((g << 2) | (g >> 4));
+		palette[e][2] = (unsigned char)((b << 3) | (b >> 2));
+	}
+	for (unsigned int c = 0; c < 3; c++)
+	{
+		if (fourColor || c0 > c1)
+		{
+			palette[2][c] = (unsigned char)((2 * palette[0][c] + palette[1][c] + 1) / 3);
+			palette[3][c] = (unsigned char)((palette[0][c] + 2 * palette[1][c] + 1) / 3);
+		}
+		else
+		{
+			palette[2][c] = (unsigned char)((palette[0][c] + palette[1][c] + 1) / 2);
+			palette[3][c] = 0;
+		}
+	}
+
+	for (unsigned int t = 0; t < 16; t++)
+	{
+		const unsigned char* color = palette[(bits >> (t * 2)) & 3];
+		float* texel = texels + (t / 4) * pitch + (t % 4) * 4;
+		texel[0] = SRGBToLinear(color[0]);
+		texel[1] = SRGBToLinear(color[1]);
+		texel[2] = SRGBToLinear(color[2]);
+		texel[3] = 1.0f;
+	}
+}
+
+// --------------------------------------------------------
+// The top mip of each face of a DDS cubemap, as linear RGBA
+// floats.  8 bit and BC formats are taken as sRGB, the way
+// the sky loads them.
+// --------------------------------------------------------
+static bool DecodeCubemap(const std::vector<unsigned char>& file, unsigned int* faceSize, std::vector<float>& faces)
+{
+	if (file.size() < 4 + sizeof(DdsHeader))
+		return false;
+
+	uint32_t magic;
+	DdsHeader header;
+	memcpy(&magic, file.data(), sizeof(magic));
+	memcpy(&header, file.data() + 4, sizeof(header));
+	if (magic != DDS_MAGIC || header.width != header.height || header.width == 0)
+		return false;
+
+	size_t offset = 4 + sizeof(DdsHeader);
+	CubemapFormat format;
+	if ((header.ddspf.flags & DDS_FOURCC) && header.ddspf.fourCC == MakeFourCC('D', 'X', '1', '0'))
+	{
+		DdsHeaderDX10 dx10;
+		if (file.size() < offset + sizeof(dx10))
+			return false;
+		memcpy(&dx10, file.data() + offset, sizeof(dx10));
+		offset += sizeof(dx10);
+
+		if (!(dx10.miscFlag & DDS_DX10_TEXTURECUBE))
+			return false;
+		format = GetDX10Format(dx10.dxgiFormat);
+	}
+	else
+	{
+		if ((header.caps2 & DDS_CUBEMAP_ALLFACES) != DDS_CUBEMAP_ALLFACES)
+			return false;
+		format = GetLegacyFormat(header.ddspf);
+	}
+	if (format == CUBEMAP_UNKNOWN)
+		return false;
+
+	// Faces are stored one after another, each with its mips
+	unsigned int size = header.width;
+	unsigned int mips = header.mipMapCount > 0 ? header.mipMapCount : 1;
+	size_t faceBytes = 0;
+	for (unsigned int m = 0; m < mips; m++)
+		faceBytes += GetMipBytes(format, (size >> m) > 0 ? (size >> m) : 1);
+	if (file.size() < offset + faceBytes * 6)
+		return false;
+
+	*faceSize = size;
+	size_t faceTexels = (size_t)size * size;
+	faces.resize(faceTexels * 6 * 4);
+	for (unsigned int face = 0; face < 6; face++)
+	{
+		const unsigned char* src = file.data() + offset + faceBytes * face;
+		float* dst = faces.data() + faceTexels * 4 * face;
+
+		switch (format)
+		{
+		case CUBEMAP_RGBA8:
+		case CUBEMAP_BGRA8:
+		{
+			unsigned int r = format == CUBEMAP_RGBA8 ? 0 : 2;
+			for (size_t t = 0; t < faceTexels; t++)
+			{
+				dst[t * 4 + 0] = SRGBToLinear(src[t * 4 + r]);
+				dst[t * 4 + 1] = SRGBToLinear(src[t * 4 + 1]);
+				dst[t * 4 + 2] = SRGBToLinear(src[t * 4 + 2 - r]);
+				dst[t * 4 + 3] = 1.0f;
+			}
+			break;
+		}
+		case CUBEMAP_BC1:
+		case CUBEMAP_BC2:
+		case CUBEMAP_BC3:
+		{
+			if (size % 4 != 0)
+				return false;
+			unsigned int blockBytes = format == CUBEMAP_BC1 ? 8 : 16;
+			unsigned int colorOffset = format == CUBEMAP_BC1 ? 0 : 8;
+			for (unsigned int by = 0; by < size / 4; by++)
+			{
+				for (unsigned int bx = 0; bx < size / 4; bx++)
+				{
+					const unsigned char* block = src + ((size_t)by * (size / 4) + bx) * blockBytes;
+					DecodeColorBlock(block + colorOffset, format != CUBEMAP_BC1, dst + ((size_t)by * 4 * size + bx * 4) * 4, size * 4);
+				}
+			}
+			break;
+		}
+		case CUBEMAP_RGBA16F:
+		{
+			const HALF* halves = (const HALF*)src;
+			for (size_t t = 0; t < faceTexels * 4; t++)
+				dst[t] = XMConvertHalfToFloat(halves[t]);
+			break;
+		}
+		case CUBEMAP_RGBA32F:
+			memcpy(dst, src, faceTexels * 16);
+			break;
+		default:
+			return false;
+		}
+	}
+	return true;
+}
+
+// --------------------------------------------------------
+// Halves each face of a level, averaging 2x2 texels
+// --------------------------------------------------------
+static void DownsampleLevel(const std::vector<float>& src, unsigned int srcSize, std::vector<float>& dst)
+{
+	unsigned int dstSize = srcSize / 2;
+	dst.resize((size_t)dstSize * dstSize * 6 * 4);
+	__m128 quarter = _mm_set1_ps(0.25f);
+	for (unsigned int face = 0; face < 6; face++)
+	{
+		const float* s = src.data() + (size_t)srcSize * srcSize * 4 * face;
+		float* d = dst.data() + (size_t)dstSize * dstSize * 4 * face;
+		for (unsigned int y = 0; y < dstSize; y++)
+		{
+			const float* row0 = s + (size_t)(y * 2) * srcSize * 4;
+			const float* row1 = row0 + srcSize * 4;
+			for (unsigned int x = 0; x < dstSize; x++)
+			{
+				__m128 sum = _mm_add_ps(
+					_mm_add_ps(_mm_loadu_ps(row0 + x * 8), _mm_loadu_ps(row0 + x * 8 + 4)),
+					_mm_add_ps(_mm_loadu_ps(row1 + x * 8), _mm_loadu_ps(row1 + x * 8 + 4)));
+				_mm_storeu_ps(d + ((size_t)y * dstSize + x) * 4, _mm_mul_ps(sum, quarter));
+			}
+		}
+	}
+}
+
+static __m128 Lerp(__m128 a, __m128 b, float t)
+{
+	return _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), _mm_set1_ps(t)));
+}
+
+// --------------------------------------------------------
+// Bilinear fetch from one face of a level, clamped to the
+// face's edges rather than wrapping to the next face
+// --------------------------------------------------------
+static __m128 SampleFace(const float* level, unsigned int size, unsigned int face, float u, float v)
+{
+	float x = (u * 0.5f + 0.5f) * size - 0.5f;
+	float y = (v * 0.5f + 0.5f) * size - 0.5f;
+	float maxCoord = (float)(size - 1);
+	x = x < 0.0f ? 0.0f : (x > maxCoord ? maxCoord : x);
+	y = y < 0.0f ? 0.0f : (y > maxCoord ? maxCoord : y);
+
+	unsigned int x0 = (unsigned int)x, y0 = (unsigned int)y;
+	unsigned int x1 = x0 + 1 < size ? x0 + 1 : x0;
+	unsigned int y1 = y0 + 1 < size ? y0 + 1 : y0;
+	float fx = x - x0, fy = y - y0;
+
+	const float* texels = level + (size_t)size * size * 4 * face;
+	__m128 top = Lerp(_mm_loadu_ps(texels + ((size_t)y0 * size + x0) * 4), _mm_loadu_ps(texels + ((size_t)y0 * size + x1) * 4), fx);
+	__m128 bottom = Lerp(_mm_loadu_ps(texels + ((size_t)y1 * size + x0) * 4), _mm_loadu_ps(texels + ((size_t)y1 * size + x1) * 4), fx);
+	return Lerp(top, bottom, fy);
+}
+
+// --------------------------------------------------------
+// Trilinear fetch from the source levels; lod 0 is the top
+// --------------------------------------------------------
+static __m128 SampleCube(const std::vector<std::vector<float>>& levels, unsigned int topSize, const XMFLOAT3& dir, float lod)
+{
+	float u, v;
+	unsigned int face = EnvironmentLighting::DirectionToFace(dir, &u, &v);
+
+	float maxLod = (float)(levels.size() - 1);
+	lod = lod < 0.0f ? 0.0f : (lod > maxLod ? maxLod : lod);
+	unsigned int l0 = (unsigned int)lod;
+	unsigned int l1 = l0 + 1 < levels.size() ? l0 + 1 : l0;
+
+	__m128 a = SampleFace(levels[l0].data(), topSize >> l0, face, u, v);
+	if (l1 == l0)
+		return a;
+	__m128 b = SampleFace(levels[l1].data(), topSize >> l1, face, u, v);
+	return Lerp(a, b, lod - l0);
+}
+
+static XMFLOAT2 Hammersley(unsigned int i, unsigned int count)
+{
+	unsigned int bits = i;
+	bits = (bits << 16) | (bits >> 16);
+	bits = ((bits & 0x55555555u) << 1) | ((bits & 0xAAAAAAAAu) >> 1);
+	bits = ((bits & 0x33333333u) << 2) | ((bits & 0xCCCCCCCCu) >> 2);
+	bits = ((bits & 0x0F0F0F0Fu) << 4) | ((bits & 0xF0F0F0F0u) >> 4);
+	bits = ((bits & 0x00FF00FFu) << 8) | ((bits & 0xFF00FF00u) >> 8);
+	return XMFLOAT2((float)i / count, bits * 2.3283064365386963e-10f);
+}
+
+// --------------------------------------------------------
+// A GGX distributed half vector around +z
+// --------------------------------------------------------
+static XMFLOAT3 ImportanceSampleGGX(XMFLOAT2 xi, float alpha)
+{
+	float a2 = alpha * alpha;
+	float phi = 2.0f * PI * xi.x;
+	float cosTheta = sqrtf((1.0f - xi.y) / (1.0f + (a2 - 1.0f) * xi.y));
+	float sinTheta = sqrtf(1.0f - cosTheta * cosTheta);
+	return XMFLOAT3(sinTheta * cosf(phi), sinTheta * sinf(phi), cosTheta);
+}
+
+// --------------------------------------------------------
+// Solid angle of the part of a face from (0, 0) to (x, y),
+// for weighting texels in the SH projection
+// --------------------------------------------------------
+static float AreaElement(float x, float y)
+{
+	return atan2f(x * y, sqrtf(x * x + y * y + 1.0f));
+}
+
+// --------------------------------------------------------
+// The 9 SH basis functions for a unit direction
+// --------------------------------------------------------
+static void EvaluateSH(const XMFLOAT3& n, float* basis)
+{
+	basis[0] = 0.282095f;
+	basis[1] = 0.488603f * n.y;
+	basis[2] = 0.488603f * n.z;
+	basis[3] = 0.488603f * n.x;
+	basis[4] = 1.092548f * n.x * n.y;
+	basis[5] = 1.092548f * n.y * n.z;
+	basis[6] = 0.315392f * (3.0f * n.z * n.z - 1.0f);
+	basis[7] = 1.092548f * n.x * n.z;
+	basis[8] = 0.546274f * (n.x * n.x - n.y * n.y);
+}
+
+EnvironmentLighting::EnvironmentLighting(unsigned int specularSize, unsigned int irradianceSize, unsigned int lutSize, unsigned int threadCount)
+	: pool(threadCount)
+{
+	this->specularSize = specularSize;
+	this->irradianceSize = irradianceSize;
+	this->lutSize = lutSize;
+
+	specularMips = 1;
+	while ((specularSize >> specularMips) >= MIN_SPECULAR_SIZE)
+		specularMips++;
+
+	sourceSize = 0;
+	memset(sh, 0, sizeof(sh));
+	memset(&stats, 0, sizeof(stats));
+}
+
+XMFLOAT3 EnvironmentLighting::FaceToDirection(unsigned int face, float u, float v)
+{
+	XMFLOAT3 dir;
+	switch (face)
+	{
+	case 0: dir = XMFLOAT3(1, -v, -u); break;
+	case 1: dir = XMFLOAT3(-1, -v, u); break;
+	case 2: dir = XMFLOAT3(u, 1, v); break;
+	case 3: dir = XMFLOAT3(u, -1, -v); break;
+	case 4: dir = XMFLOAT3(u, -v, 1); break;
+	default: dir = XMFLOAT3(-u, -v, -1); break;
+	}
+	XMStoreFloat3(&dir, XMVector3Normalize(XMLoadFloat3(&dir)));
+	return dir;
+}
+
+unsigned int EnvironmentLighting::DirectionToFace(const XMFLOAT3& dir, float* u, float* v)
+{
+	float ax = fabsf(dir.x), ay = fabsf(dir.y), az = fabsf(dir.z);
+	if (ax >= ay && ax >= az)
+	{
+		*u = (dir.x > 0 ? -dir.z : dir.z) / ax;
+		*v = -dir.y / ax;
+		return dir.x > 0 ? 0 : 1;
+	}
+	if (ay >= az)
+	{
+		*u = dir.x / ay;
+		*v = (dir.y > 0 ? dir.z : -dir.z) / ay;
+		return dir.y > 0 ? 2 : 3;
+	}
+	*u = (dir.z > 0 ? dir.x : -dir.x) / az;
+	*v = -dir.y / az;
+	return dir.z > 0 ? 4 : 5;
+}
+
+// --------------------------------------------------------
+// The split sum's second half: how much of F0 (scale) and
+// of 1 (bias) reaches the eye, integrated over GGX with
+// Smith-Schlick visibility (k = alpha / 2 for IBL)
+// --------------------------------------------------------
+XMFLOAT2 EnvironmentLighting::IntegrateBRDF(float NdotV, float roughness, unsigned int samples)
+{
+	float alpha = roughness * roughness;
+	float k = alpha / 2.0f;
+	XMFLOAT3 v(sqrtf(1.0f - NdotV * NdotV), 0.0f, NdotV);
+
+	float scale = 0.0f, bias = 0.0f;
+	for (unsigned int i = 0; i < samples; i++)
+	{
+		XMFLOAT3 h = ImportanceSampleGGX(Hammersley(i, samples), alpha);
+		float VdotH = v.x * h.x + v.y * h.y + v.z * h.z;
+		float NdotL = 2.0f * VdotH * h.z - v.z;
+		float NdotH = h.z;
+		if (NdotL <= 0.0f)
+			continue;
+
+		VdotH = VdotH > 0.0f ? VdotH : 0.0f;
+		float g = (NdotV / (NdotV * (1.0f - k) + k)) * (NdotL / (NdotL * (1.0f - k) + k));
+		float visibility = g * VdotH / (NdotH * NdotV);
+		float fresnel = powf(1.0f - VdotH, 5.0f);
+		scale += (1.0f - fresnel) * visibility;
+		bias += fresnel * visibility;
+	}
+	return XMFLOAT2(scale / samples, bias / samples);
+}
+
+// --------------------------------------------------------
+// Hashes the cubemap's bytes along with everything that
+// changes the cooked output
+// --------------------------------------------------------
+uint64_t EnvironmentLighting::Hash(const std::vector<unsigned char>& cubemap)
+{
+	uint64_t key[] =
+	{
+		ShaderReflectionCache::Hash(cubemap.data(), cubemap.size()),
+		specularSize,
+		irradianceSize,
+		lutSize,
+		SPECULAR_SAMPLES,
+		BRDF_SAMPLES,
+		MAX_SOURCE_SIZE,
+	};
+	return ShaderReflectionCache::Hash(key, sizeof(key));
+}
+
+bool EnvironmentLighting::Build(RenderBackend* backend, const std::wstring& cubemapFile, const std::wstring& cookedFile)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	// The whole file is hashed, so it's read either way
+	std::ifstream file(ToNativePath(cubemapFile).c_str(), std::ios::binary);
+	if (!file)
+		return false;
+	std::vector<unsigned char> cubemap((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	file.close();
+
+	uint64_t hash = Hash(cubemap);
+	stats.cooked = false;
+	if (!Load(cookedFile, hash))
+	{
+		if (!Cook(cubemap))
+			return false;
+
+		stats.cooked = true;
+		Save(cookedFile, hash);
+	}
+
+	stats.sourceSize = sourceSize;
+	stats.specularMips = specularMips;
+	stats.bytes = (irradiance.size() + specular.size() + brdf.size()) * sizeof(uint16_t);
+
+	bool ok = CreateTextures(backend);
+
+	auto end = std::chrono::high_resolution_clock::now();
+	stats.buildMilliseconds = std::chrono::duration<double, std::milli>(end - start).count();
+	return ok;
+}
+
+// --------------------------------------------------------
+// Decodes the cubemap into its box filtered levels, then
+// runs the three precomputations
+// --------------------------------------------------------
+bool EnvironmentLighting::Cook(const std::vector<unsigned char>& cubemap)
+{
+	std::vector<float> faces;
+	unsigned int size = 0;
+	if (!DecodeCubemap(cubemap, &size, faces))
+		return false;
+
+	// Down to a power of 2 no bigger than MAX_SOURCE_SIZE
+	unsigned int topSize = 1;
+	while (topSize * 2 <= size && topSize * 2 <= MAX_SOURCE_SIZE)
+		topSize *= 2;
+
+	std::vector<float> top;
+	if (size == topSize)
+	{
+		top.swap(faces);
+	}
+	else
+	{
+		// Halve while that lands on a power of 2, then resample the rest
+		while (size / 2 >= topSize && size % 2 == 0)
+		{
+			std::vector<float> half;
+			DownsampleLevel(faces, size, half);
+			faces.swap(half);
+			size /= 2;
+		}
+		top.resize((size_t)topSize * topSize * 6 * 4);
+		for (unsigned int face = 0; face < 6; face++)
+		{
+			for (unsigned int y = 0; y < topSize; y++)
+			{
+				for (unsigned int x = 0; x < topSize; x++)
+				{
+					float u = (x + 0.5f) / topSize * 2.0f - 1.0f;
+					float v = (y + 0.5f) / topSize * 2.0f - 1.0f;
+					_mm_storeu_ps(&top[(((size_t)face * topSize + y) * topSize + x) * 4], SampleFace(faces.data(), size, face, u, v));
+				}
+			}
+		}
+	}
+	faces.clear();
+	faces.shrink_to_fit();
+
+	sourceSize = topSize;
+	sourceLevels.clear();
+	sourceLevels.push_back(std::move(top));
+	for (unsigned int s = topSize; s > 1; s /= 2)
+	{
+		std::vector<float> next;
+		DownsampleLevel(sourceLevels.back(), s, next);
+		sourceLevels.push_back(std::move(next));
+	}
+
+	auto t0 = std::chrono::high_resolution_clock::now();
+	CookIrradiance();
+	auto t1 = std::chrono::high_resolution_clock::now();
+	CookSpecular();
+	auto t2 = std::chrono::high_resolution_clock::now();
+	CookBRDF();
+	auto t3 = std::chrono::high_resolution_clock::now();
+
+	stats.irradianceMilliseconds = std::chrono::duration<double, std::milli>(t1 - t0).count();
+	stats.specularMilliseconds = std::chrono::duration<double, std::milli>(t2 - t1).count();
+	stats.brdfMilliseconds = std::chrono::duration<double, std::milli>(t3 - t2).count();
+
+	sourceLevels.clear();
+	sourceLevels.shrink_to_fit();
+	return true;
+}
+
+// --------------------------------------------------------
+// Projects the radiance onto SH (one face per job), then
+// convolves with the clamped cosine and bakes E / pi out to
+// the irradiance cube, so the shader multiplies by albedo
+// --------------------------------------------------------
+void EnvironmentLighting::CookIrradiance()
+{
+	unsigned int level = 0;
+	while ((sourceSize >> level) > SH_SOURCE_SIZE)
+		level++;
+	unsigned int size = sourceSize >> level;
+	const float* texels = sourceLevels[level].data();
+
+	__m128 faceSums[6][ENVIRONMENT_SH_COEFFICIENTS];
+	pool.ParallelFor(6, [&](unsigned int face, unsigned int)
+	{
+		__m128* sums = faceSums[face];
+		for (unsigned int c = 0; c < ENVIRONMENT_SH_COEFFICIENTS; c++)
+			sums[c] = _mm_setzero_ps();
+
+		float texelSize = 2.0f / size;
+		for (unsigned int y = 0; y < size; y++)
+		{
+			for (unsigned int x = 0; x < size; x++)
+			{
+				float u = (x + 0.5f) * texelSize - 1.0f;
+				float v = (y + 0.5f) * texelSize - 1.0f;
+				float h = texelSize * 0.5f;
+				float solidAngle =
+					AreaElement(u - h, v - h) - AreaElement(u - h, v + h) -
+					AreaElement(u + h, v - h) + AreaElement(u + h, v + h);
+
+				float basis[ENVIRONMENT_SH_COEFFICIENTS];
+				EvaluateSH(FaceToDirection(face, u, v), basis);
+
+				__m128 color = _mm_loadu_ps(texels + (((size_t)face * size + y) * size + x) * 4);
+				for (unsigned int c = 0; c < ENVIRONMENT_SH_COEFFICIENTS; c++)
+					sums[c] = _mm_add_ps(sums[c], _mm_mul_ps(color, _mm_set1_ps(basis[c] * solidAngle)));
+			}
+		}
+	});
+
+	// Cosine lobe per band (pi, 2pi/3, pi/4), already over pi
+	static const float BAND_SCALE[ENVIRONMENT_SH_COEFFICIENTS] = { 1.0f, 2.0f / 3.0f, 2.0f / 3.0f, 2.0f / 3.0f, 0.25f, 0.25f, 0.25f, 0.25f, 0.25f };
+	__m128 convolved[ENVIRONMENT_SH_COEFFICIENTS];
+	for (unsigned int c = 0; c < ENVIRONMENT_SH_COEFFICIENTS; c++)
+	{
+		__m128 sum = _mm_setzero_ps();
+		for (unsigned int face = 0; face < 6; face++)
+			sum = _mm_add_ps(sum, faceSums[face][c]);
+
+		float rgba[4];
+		_mm_storeu_ps(rgba, sum);
+		sh[c] = XMFLOAT3(rgba[0], rgba[1], rgba[2]);
+		convolved[c] = _mm_mul_ps(sum, _mm_set1_ps(BAND_SCALE[c]));
+	}
+
+	irradiance.resize((size_t)irradianceSize * irradianceSize * 6 * 4);
+	pool.ParallelFor(6 * irradianceSize, [&](unsigned int row, unsigned int)
+	{
+		unsigned int face = row / irradianceSize;
+		unsigned int y = row % irradianceSize;
+		std::vector<float> out(irradianceSize * 4);
+		for (unsigned int x = 0; x < irradianceSize; x++)
+		{
+			float u = (x + 0.5f) / irradianceSize * 2.0f - 1.0f;
+			float v = (y + 0.5f) / irradianceSize * 2.0f - 1.0f;
+			float basis[ENVIRONMENT_SH_COEFFICIENTS];
+			EvaluateSH(FaceToDirection(face, u, v), basis);
+
+			__m128 color = _mm_setzero_ps();
+			for (unsigned int c = 0; c < ENVIRONMENT_SH_COEFFICIENTS; c++)
+				color = _mm_add_ps(color, _mm_mul_ps(convolved[c], _mm_set1_ps(basis[c])));
+
+			// Ringing can dip below zero opposite a bright sun
+			color = _mm_max_ps(color, _mm_setzero_ps());
+			_mm_storeu_ps(&out[x * 4], color);
+			out[x * 4 + 3] = 1.0f;
+		}
+		XMConvertFloatToHalfStream(&irradiance[(size_t)row * irradianceSize * 4], sizeof(HALF), out.data(), sizeof(float), irradianceSize * 4);
+	});
+}
+
+// --------------------------------------------------------
+// The top mip is the cubemap itself at that size.  Every
+// mip below prefilters for a rougher surface, assuming the
+// view is along the normal.  Sample directions only depend
+// on the roughness, so they're found once per mip, along
+// with the source level each should read from (the level
+// whose texels cover the sample's share of the lobe).
+// --------------------------------------------------------
+void EnvironmentLighting::CookSpecular()
+{
+	size_t faceHalves = 0;
+	for (unsigned int m = 0; m < specularMips; m++)
+		faceHalves += (size_t)(specularSize >> m) * (specularSize >> m) * 4;
+	specular.resize(faceHalves * 6);
+
+	struct SpecularSample
+	{
+		XMFLOAT3 direction;		// Around +z
+		float weight;			// NdotL
+		float lod;
+	};
+
+	size_t mipOffset = 0;
+	float texelSolidAngle = 4.0f * PI / (6.0f * sourceSize * sourceSize);
+	for (unsigned int m = 0; m < specularMips; m++)
+	{
+		unsigned int size = specularSize >> m;
+		float roughness = specularMips > 1 ? (float)m / (specularMips - 1) : 0.0f;
+		float alpha = roughness * roughness;
+
+		// Roughness 0 reads the level matching this mip's texels
+		float topLod = log2f((float)sourceSize / size);
+		topLod = topLod > 0.0f ? topLod : 0.0f;
+
+		std::vector<SpecularSample> samples;
+		float totalWeight = 0.0f;
+		if (m > 0)
+		{
+			for (unsigned int i = 0; i < SPECULAR_SAMPLES; i++)
+			{
+				XMFLOAT3 h = ImportanceSampleGGX(Hammersley(i, SPECULAR_SAMPLES), alpha);
+
+				// With V = N = +z, L reflects it about H
+				SpecularSample s;
+				s.direction = XMFLOAT3(2.0f * h.z * h.x, 2.0f * h.z * h.y, 2.0f * h.z * h.z - 1.0f);
+				s.weight = s.direction.z;
+				if (s.weight <= 0.0f)
+					continue;
+
+				// pdf = D * NdotH / (4 * VdotH), and NdotH = VdotH here
+				float a2 = alpha * alpha;
+				float denom = h.z * h.z * (a2 - 1.0f) + 1.0f;
+				float pdf = a2 / (PI * denom * denom) / 4.0f;
+				float sampleSolidAngle = 1.0f / (SPECULAR_SAMPLES * pdf + 0.0001f);
+				s.lod = 0.5f * log2f(sampleSolidAngle / texelSolidAngle) + 1.0f;
+				s.lod = s.lod > topLod ? s.lod : topLod;
+
+				samples.push_back(s);
+				totalWeight += s.weight;
+			}
+		}
+
+		pool.ParallelFor(6 * size, [&](unsigned int row, unsigned int)
+		{
+			unsigned int face = row / size;
+			unsigned int y = row % size;
+			std::vector<float> out(size * 4);
+			for (unsigned int x = 0; x < size; x++)
+			{
+				float u = (x + 0.5f) / size * 2.0f - 1.0f;
+				float v = (y + 0.5f) / size * 2.0f - 1.0f;
+				XMFLOAT3 n = FaceToDirection(face, u, v);
+
+				__m128 color;
+				if (samples.empty())
+				{
+					color = SampleCube(sourceLevels, sourceSize, n, topLod);
+				}
+				else
+				{
+					// Tangent frame around the normal
+					XMVECTOR normal = XMLoadFloat3(&n);
+					XMVECTOR up = fabsf(n.z) < 0.999f ? XMVectorSet(0, 0, 1, 0) : XMVectorSet(1, 0, 0, 0);
+					XMVECTOR tangent = XMVector3Normalize(XMVector3Cross(up, normal));
+					XMVECTOR bitangent = XMVector3Cross(normal, tangent);
+
+					color = _mm_setzero_ps();
+					for (const SpecularSample& s : samples)
+					{
+						XMVECTOR l = XMVectorAdd(XMVectorAdd(
+							XMVectorScale(tangent, s.direction.x),
+							XMVectorScale(bitangent, s.direction.y)),
+							XMVectorScale(normal, s.direction.z));
+						XMFLOAT3 dir;
+						XMStoreFloat3(&dir, l);
+						color = _mm_add_ps(color, _mm_mul_ps(SampleCube(sourceLevels, sourceSize, dir, s.lod), _mm_set1_ps(s.weight)));
+					}
+					color = _mm_mul_ps(color, _mm_set1_ps(1.0f / totalWeight));
+				}
+
+				_mm_storeu_ps(&out[x * 4], color);
+				out[x * 4 + 3] = 1.0f;
+			}
+
+			// Subresources go mip by mip within each face
+			HALF* dst = &specular[faceHalves * face + mipOffset + (size_t)y * size * 4];
+			XMConvertFloatToHalfStream(dst, sizeof(HALF), out.data(), sizeof(float), size * 4);
+		});
+
+		mipOffset += (size_t)size * size * 4;
+	}
+}
+
+// --------------------------------------------------------
+// NdotV across, roughness down, texel centers at both
+// ends so the shader can sample it with a clamp
+// --------------------------------------------------------
+void EnvironmentLighting::CookBRDF()
+{
+	brdf.resize((size_t)lutSize * lutSize * 2);
+	pool.ParallelFor(lutSize, [&](unsigned int y, unsigned int)
+	{
+		std::vector<float> out(lutSize * 2);
+		float roughness = (y + 0.5f) / lutSize;
+		for (unsigned int x = 0; x < lutSize; x++)
+		{
+			XMFLOAT2 terms = IntegrateBRDF((x + 0.5f) / lutSize, roughness, BRDF_SAMPLES);
+			out[x * 2 + 0] = terms.x;
+			out[x * 2 + 1] = terms.y;
+		}
+		XMConvertFloatToHalfStream(&brdf[(size_t)y * lutSize * 2], sizeof(HALF), out.data(), sizeof(float), lutSize * 2);
+	});
+}
+
+void EnvironmentLighting::ClearPixels()
+{
+	irradiance.clear();
+	irradiance.shrink_to_fit();
+	specular.clear();
+	specular.shrink_to_fit();
+	brdf.clear();
+	brdf.shrink_to_fit();
+}
+
+// --------------------------------------------------------
+// Reads a cooked file, failing if it is missing, from another
+// version or was cooked from a different cubemap
+// --------------------------------------------------------
+bool EnvironmentLighting::Load(const std::wstring& cookedFile, uint64_t hash)
+{
+	std::ifstream file(ToNativePath(cookedFile).c_str(), std::ios::binary);
+	if (!file)
+		return false;
+
+	EnvironmentFileHeader header;
+	file.read((char*)&header, sizeof(header));
+	if (!file.good() ||
+		header.Magic != ENVIRONMENT_MAGIC ||
+		header.Version != ENVIRONMENT_VERSION ||
+		header.Hash != hash ||
+		header.SpecularSize != specularSize ||
+		header.SpecularMips != specularMips ||
+		header.IrradianceSize != irradianceSize ||
+		header.LutSize != lutSize)
+		return false;
+
+	size_t specularHalves = 0;
+	for (unsigned int m = 0; m < specularMips; m++)
+		specularHalves += (size_t)(specularSize >> m) * (specularSize >> m) * 4 * 6;
+
+	irradiance.resize((size_t)irradianceSize * irradianceSize * 6 * 4);
+	specular.resize(specularHalves);
+	brdf.resize((size_t)lutSize * lutSize * 2);
+	file.read((char*)irradiance.data(), irradiance.size() * sizeof(uint16_t));
+	file.read((char*)specular.data(), specular.size() * sizeof(uint16_t));
+	file.read((char*)brdf.data(), brdf.size() * sizeof(uint16_t));
+	file.read((char*)sh, sizeof(sh));
+
+	// A truncated file is as good as no file
+	if (!file.good())
+	{
+		ClearPixels();
+		return false;
+	}
+
+	sourceSize = header.SourceSize;
+	stats.irradianceMilliseconds = 0;
+	stats.specularMilliseconds = 0;
+	stats.brdfMilliseconds = 0;
+	return true;
+}
+
+bool EnvironmentLighting::Save(const std::wstring& cookedFile, uint64_t hash)
+{
+	std::ofstream file(ToNativePath(cookedFile).c_str(), std::ios::binary | std::ios::trunc);
+	if (!file)
+		return false;
+
+	EnvironmentFileHeader header = {};
+	header.Magic = ENVIRONMENT_MAGIC;
+	header.Version = ENVIRONMENT_VERSION;
+	header.Hash = hash;
+	header.SourceSize = sourceSize;
+	header.SpecularSize = specularSize;
+	header.SpecularMips = specularMips;
+	header.IrradianceSize = irradianceSize;
+	header.LutSize = lutSize;
+	file.write((const char*)&header, sizeof(header));
+
+	file.write((const char*)irradiance.data(), irradiance.size() * sizeof(uint16_t));
+	file.write((const char*)specular.data(), specular.size() * sizeof(uint16_t));
+	file.write((const char*)brdf.data(), brdf.size() * sizeof(uint16_t));
+	file.write((const char*)sh, sizeof(sh));
+	return file.good();
+}
+
+// --------------------------------------------------------
+// Two immutable half float cubes and the LUT, plus the
+// clamped sampler they're read with.  The CPU copies are
+// dropped once the GPU has them.
+// --------------------------------------------------------
+bool EnvironmentLighting::CreateTextures(RenderBackend* backend)
+{
+	bool ok = true;
+
+	TextureDesc desc = {};
+	desc.Type = RENDER_TEXTURE_CUBE;
+	desc.ArraySize = 6;
+	desc.Format = DXGI_FORMAT_R16G16B16A16_FLOAT;
+	desc.Usage = RENDER_USAGE_IMMUTABLE;
+	desc.BindFlags = RENDER_BIND_SHADER_RESOURCE;
+
+	// Irradiance, one mip per face
+	std::vector<SubresourceData> data(6 * specularMips);
+	for (unsigned int face = 0; face < 6; face++)
+	{
+		data[face].Data = &irradiance[(size_t)irradianceSize * irradianceSize * 4 * face];
+		data[face].RowPitch = irradianceSize * 4 * sizeof(uint16_t);
+		data[face].SlicePitch = 0;
+	}
+	desc.Width = desc.Height = irradianceSize;
+	desc.MipLevels = 1;
+
+	if (!backend->CreateTexture(desc, data.data(), irradianceSRV.ReleaseAndGetAddressOf()))
+		ok = false;
+
+	// Specular, mip by mip within each face
+	const uint16_t* mip = specular.data();
+	for (unsigned int face = 0; face < 6; face++)
+	{
+		for (unsigned int m = 0; m < specularMips; m++)
+		{
+			unsigned int size = specularSize >> m;
+			SubresourceData& sub = data[face * specularMips + m];
+			sub.Data = mip;
+			sub.RowPitch = size * 4 * sizeof(uint16_t);
+			sub.SlicePitch = 0;
+			mip += (size_t)size * size * 4;
+		}
+	}
+	desc.Width = desc.Height = specularSize;
+	desc.MipLevels = specularMips;
+
+	if (!backend->CreateTexture(desc, data.data(), specularSRV.ReleaseAndGetAddressOf()))
+		ok = false;
+
+	// BRDF LUT, a plain 2D texture
+	TextureDesc lutDesc = {};
+	lutDesc.Type = RENDER_TEXTURE_2D;
+	lutDesc.Width = lutDesc.Height = lutSize;
+	lutDesc.MipLevels = 1;
+	lutDesc.ArraySize = 1;
+	lutDesc.Format = DXGI_FORMAT_R16G16_FLOAT;
+	lutDesc.Usage = RENDER_USAGE_IMMUTABLE;
+	lutDesc.BindFlags = RENDER_BIND_SHADER_RESOURCE;
+
+	SubresourceData lutData = {};
+	lutData.Data = brdf.data();
+	lutData.RowPitch = lutSize * 2 * sizeof(uint16_t);
+
+	if (!backend->CreateTexture(lutDesc, &lutData, brdfSRV.ReleaseAndGetAddressOf()))
+		ok = false;
+
+	SamplerDesc samplerDesc = {};
+	samplerDesc.Filter = RENDER_FILTER_LINEAR;
+	samplerDesc.AddressMode = RENDER_ADDRESS_CLAMP;
+	if (!backend->CreateSamplerState(samplerDesc, sampler.ReleaseAndGetAddressOf()))
+		ok = false;
+
+	ClearPixels();
+	return ok;
+}
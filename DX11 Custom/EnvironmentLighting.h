@@ -0,0 +1,120 @@
+#pragma once
+#include <DirectXMath.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "RenderBackend.h"
+#include "WorkerPool.h"
+
+// Spherical harmonics bands 0 - 2, enough for diffuse irradiance
+#define ENVIRONMENT_SH_COEFFICIENTS	9
+
+// --------------------------------------------------------
+// Numbers from the last Build()
+// --------------------------------------------------------
+struct EnvironmentLightingStats
+{
+	bool cooked;				// False if the cooked file was reused
+	unsigned int sourceSize;	// Face size of the cubemap
+	unsigned int specularMips;
+	size_t bytes;				// Across all three textures
+
+	// Zero when the cooked file was reused
+	double irradianceMilliseconds;
+	double specularMilliseconds;
+	double brdfMilliseconds;
+
+	double buildMilliseconds;
+};
+
+// --------------------------------------------------------
+// Image based lighting, precomputed on the CPU from a sky
+// cubemap (.dds) and split into three textures:
+//  - diffuse irradiance: the cubemap projected onto 9
+//    spherical harmonics, then baked out to a small cube
+//  - specular: the cubemap GGX prefiltered into a mip chain,
+//    roughness 0 at the top mip and 1 at the last
+//  - the split sum BRDF LUT: scale and bias on F0, indexed by
+//    NdotV and roughness
+// so a pixel shader gets its ambient light from three lookups.
+//
+// Roughness is remapped to GGX alpha = roughness^2, as in
+// MaterialPS.hlsl.  The prefilter uses importance sampling
+// from a box filtered copy of the cubemap, picking each
+// sample's mip from its PDF, so a few hundred samples give a
+// clean result.  Texels are filtered 4 channels at a time with
+// SSE, and faces, mips and LUT rows are split between threads.
+//
+// Results are cooked to a file keyed by a hash of the
+// cubemap's bytes and the settings, and reloaded until the
+// cubemap changes.
+// --------------------------------------------------------
+class EnvironmentLighting
+{
+public:
+	// specularSize - Face size of the specular cube's top mip, a power of 2
+	// irradianceSize - Face size of the irradiance cube
+	// lutSize - Width and height of the BRDF LUT
+	// threadCount - 0 is one per core
+	EnvironmentLighting(unsigned int specularSize = 128, unsigned int irradianceSize = 32, unsigned int lutSize = 64, unsigned int threadCount = 0);
+
+	// Cooks (or loads) the maps and creates the textures.  False
+	// if the cubemap couldn't be read or isn't a format we decode.
+	bool Build(RenderBackend* backend, const std::wstring& cubemapFile, const std::wstring& cookedFile);
+
+	RenderRef<RenderTexture> GetIrradianceSRV() { return irradianceSRV; }
+	RenderRef<RenderTexture> GetSpecularSRV() { return specularSRV; }
+	RenderRef<RenderTexture> GetBrdfSRV() { return brdfSRV; }
+
+	// Linear and clamped, for the LUT's edges
+	RenderRef<RenderSamplerState> GetSampler() { return sampler; }
+
+	// Radiance as SH coefficients, before the cosine convolution
+	const DirectX::XMFLOAT3* GetSH() { return sh; }
+
+	const EnvironmentLightingStats& GetStats() { return stats; }
+
+	// D3D cube face conventions.  u and v run -1 to 1 across the
+	// face, left to right and top to bottom.
+	static DirectX::XMFLOAT3 FaceToDirection(unsigned int face, float u, float v);
+	static unsigned int DirectionToFace(const DirectX::XMFLOAT3& dir, float* u, float* v);
+
+	// The split sum terms for one NdotV and roughness
+	static DirectX::XMFLOAT2 IntegrateBRDF(float NdotV, float roughness, unsigned int samples);
+
+private:
+	unsigned int specularSize;
+	unsigned int specularMips;
+	unsigned int irradianceSize;
+	unsigned int lutSize;
+	WorkerPool pool;
+
+	// The decoded cubemap as linear RGBA floats, box filtered down
+	// to 1x1.  Each level is its 6 faces back to back.
+	std::vector<std::vector<float>> sourceLevels;
+	unsigned int sourceSize;
+
+	// Cooked results, as half floats in subresource order
+	std::vector<uint16_t> irradiance;
+	std::vector<uint16_t> specular;
+	std::vector<uint16_t> brdf;
+	DirectX::XMFLOAT3 sh[ENVIRONMENT_SH_COEFFICIENTS];
+
+	RenderRef<RenderTexture> irradianceSRV;
+	RenderRef<RenderTexture> specularSRV;
+	RenderRef<RenderTexture> brdfSRV;
+	RenderRef<RenderSamplerState> sampler;
+
+	EnvironmentLightingStats stats;
+
+	uint64_t Hash(const std::vector<unsigned char>& cubemap);
+	bool Cook(const std::vector<unsigned char>& cubemap);
+	void CookIrradiance();
+	void CookSpecular();
+	void CookBRDF();
+
+	bool Load(const std::wstring& cookedFile, uint64_t hash);
+	bool Save(const std::wstring& cookedFile, uint64_t hash);
+	bool CreateTextures(RenderBackend* backend);
+	void ClearPixels();
+};
@@ -0,0 +1,71 @@
+#include "FilePath.h"
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <sys/stat.h>
+#endif
+
+#ifdef _WIN32
+
+NativePath ToNativePath(const std::wstring& path)
+{
+	return path;
+}
+
+unsigned long long GetFileWriteTime(const std::wstring& path)
+{
+	WIN32_FILE_ATTRIBUTE_DATA info;
+	if (!GetFileAttributesExW(path.c_str(), GetFileExInfoStandard, &info))
+		return 0;
+	return ((unsigned long long)info.ftLastWriteTime.dwHighDateTime << 32) | info.ftLastWriteTime.dwLowDateTime;
+}
+
+#else
+
+// --------------------------------------------------------
+// UTF-8 encodes the path (wchar_t is UTF-32 here), turning
+// backslashes into forward slashes on the way
+// --------------------------------------------------------
+NativePath ToNativePath(const std::wstring& path)
+{
+	std::string native;
+	native.reserve(path.size());
+	for (wchar_t wc : path)
+	{
+		unsigned int c = (unsigned int)wc;
+		if (c == '\\')
+			native += '/';
+		else if (c < 0x80)
+			native += (char)c;
+		else if (c < 0x800)
+		{
+			native += (char)(0xC0 | (c >> 6));
+			native += (char)(0x80 | (c & 0x3F));
+		}
+		else if (c < 0x10000)
+		{
+			native += (char)(0xE0 | (c >> 12));
+			native += (char)(0x80 | ((c >> 6) & 0x3F));
+			native += (char)(0x80 | (c & 0x3F));
+		}
+		else
+		{
+			native += (char)(0xF0 | (c >> 18));
+			native += (char)(0x80 | ((c >> 12) & 0x3F));
+			native += (char)(0x80 | ((c >> 6) & 0x3F));
+			native += (char)(0x80 | (c & 0x3F));
+		}
+	}
+	return native;
+}
+
+unsigned long long GetFileWriteTime(const std::wstring& path)
+{
+	struct stat info;
+	if (stat(ToNativePath(path).c_str(), &info) != 0)
+		return 0;
+	return (unsigned long long)info.st_mtime;
+}
+
+#endif
@@ -0,0 +1,21 @@
+#pragma once
+#include <string>
+
+// --------------------------------------------------------
+// Paths are passed around as wide strings, with either
+// slash, as the Windows APIs take them.  Off Windows they
+// go to the C runtime as UTF-8 with forward slashes, which
+// is what these convert to.
+// --------------------------------------------------------
+#ifdef _WIN32
+typedef std::wstring NativePath;
+#else
+typedef std::string NativePath;
+#endif
+
+// The path as file streams (and fopen) take it on this platform
+NativePath ToNativePath(const std::wstring& path);
+
+// Last write time of a file, or 0 if it doesn't exist.  Only
+// meaningful compared with other write times.
+unsigned long long GetFileWriteTime(const std::wstring& path);
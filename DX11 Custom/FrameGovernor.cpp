@@ -0,0 +1,141 @@
+#include "FrameGovernor.h"
+#include <math.h>
+#include <string.h>
+
+FrameGovernorSettings::FrameGovernorSettings()
+{
+	targetMilliseconds = 1000.0f / 60.0f;
+	windowFrames = 30;
+	overBudget = 1.0f;
+	underBudget = 0.8f;
+	hitchClamp = 4.0f;
+	minResolutionScale = 0.5f;
+	resolutionStep = 0.05f;
+	minLodScale = 0.5f;
+	lodStep = 0.1f;
+}
+
+FrameGovernor::FrameGovernor(const FrameGovernorSettings& settings)
+{
+	this->settings = settings;
+	Reset();
+}
+
+void FrameGovernor::Reset()
+{
+	memset(&stats, 0, sizeof(stats));
+	resolutionScale = 1.0f;
+	lodScale = 1.0f;
+	window.clear();
+	windowNext = 0;
+	windowSum = 0;
+}
+
+bool FrameGovernor::AddFrame(float milliseconds)
+{
+	stats.frames++;
+	if (milliseconds > settings.targetMilliseconds)
+		stats.framesOverBudget++;
+	if (milliseconds > settings.targetMilliseconds * settings.hitchClamp)
+		milliseconds = settings.targetMilliseconds * settings.hitchClamp;
+
+	// A ring of the last window's frames, with a running sum
+	if (window.size() < settings.windowFrames)
+	{
+		window.push_back(milliseconds);
+	}
+	else
+	{
+		windowSum -= window[windowNext];
+		window[windowNext] = milliseconds;
+		windowNext = (windowNext + 1) % settings.windowFrames;
+	}
+	windowSum += milliseconds;
+
+	if (window.size() < settings.windowFrames)
+		return false;
+
+	float average = windowSum / settings.windowFrames;
+	stats.averageMilliseconds = average;
+
+	bool changed = false;
+	if (average > settings.targetMilliseconds * settings.overBudget)
+		changed = ScaleDown(average);
+	else if (average < settings.targetMilliseconds * settings.underBudget)
+		changed = ScaleUp(average);
+
+	// Only frames drawn at the new scales count towards the next decision
+	if (changed)
+	{
+		window.clear();
+		windowNext = 0;
+		windowSum = 0;
+	}
+	return changed;
+}
+
+// --------------------------------------------------------
+// Resolution first, down to its minimum, then LOD
+// --------------------------------------------------------
+bool FrameGovernor::ScaleDown(float average)
+{
+	if (resolutionScale > settings.minResolutionScale)
+	{
+		float aim = settings.targetMilliseconds * 0.5f * (settings.overBudget + settings.underBudget);
+		float scale = Quantize(resolutionScale * sqrtf(aim / average));
+		if (scale > resolutionScale - settings.resolutionStep)
+			scale = resolutionScale - settings.resolutionStep;
+		if (scale < settings.minResolutionScale)
+			scale = settings.minResolutionScale;
+
+		resolutionScale = scale;
+		stats.resolutionChanges++;
+		return true;
+	}
+
+	if (lodScale > settings.minLodScale)
+	{
+		lodScale = fmaxf(settings.minLodScale, lodScale - settings.lodStep);
+		stats.lodChanges++;
+		return true;
+	}
+
+	return false;
+}
+
+// --------------------------------------------------------
+// LOD first, back to 1, then resolution, as far as the
+// frame time predicted from the area stays under budget
+// --------------------------------------------------------
+bool FrameGovernor::ScaleUp(float average)
+{
+	if (lodScale < 1.0f)
+	{
+		lodScale = fminf(1.0f, lodScale + settings.lodStep);
+		stats.lodChanges++;
+		return true;
+	}
+
+	if (resolutionScale < 1.0f)
+	{
+		float aim = settings.targetMilliseconds * 0.5f * (settings.overBudget + settings.underBudget);
+		float scale = Quantize(resolutionScale * sqrtf(aim / average));
+		if (scale < resolutionScale + settings.resolutionStep)
+			scale = resolutionScale + settings.resolutionStep;
+		if (scale > 1.0f)
+			scale = 1.0f;
+
+		resolutionScale = scale;
+		stats.resolutionChanges++;
+		return true;
+	}
+
+	return false;
+}
+
+// Down to a whole number of steps, so the scale only ever
+// takes a handful of values
+float FrameGovernor::Quantize(float scale)
+{
+	return floorf(scale / settings.resolutionStep + 0.001f) * settings.resolutionStep;
+}
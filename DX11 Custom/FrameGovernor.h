@@ -0,0 +1,98 @@
+#pragma once
+#include <vector>
+
+// --------------------------------------------------------
+// How the governor reacts.  The defaults aim at 60 fps.
+// --------------------------------------------------------
+struct FrameGovernorSettings
+{
+	float targetMilliseconds;	// The frame budget
+	unsigned int windowFrames;	// Frames averaged per decision, and waited after a change
+
+	// The average has to pass overBudget (or drop below
+	// underBudget) times the target to change anything, so
+	// frame times between the two leave the scales alone
+	float overBudget;
+	float underBudget;
+
+	// Frames are counted as at most this many times the target,
+	// so one hitch (a load, dragging the window) can't push a
+	// whole window's average over on its own
+	float hitchClamp;
+
+	// Resolution scale per axis.  Changes are rounded to
+	// resolutionStep, and never smaller than one step.
+	float minResolutionScale;
+	float resolutionStep;
+
+	// Scale on draw distances, tightened only once the
+	// resolution is at its minimum, and relaxed first
+	float minLodScale;
+	float lodStep;
+
+	FrameGovernorSettings();
+};
+
+// --------------------------------------------------------
+// What the governor has done since it was made or Reset()
+// --------------------------------------------------------
+struct FrameGovernorStats
+{
+	unsigned int frames;
+	unsigned int framesOverBudget;
+	unsigned int resolutionChanges;
+	unsigned int lodChanges;
+	float averageMilliseconds;		// Of the last full window
+};
+
+// --------------------------------------------------------
+// Keeps frame times inside a budget by trading resolution
+// and then draw distance.  Pure CPU: fed one frame time at a
+// time, it only hands out the scales, and the renderer
+// applies them.
+//
+// Each decision looks at the average of a full window of
+// frames.  Over budget, the resolution drops by the square
+// root of how far over it is (pixel cost goes with the
+// area), aiming for the middle of the dead band; once it's
+// at the minimum the LOD scale tightens a step at a time.
+// Under budget, LOD relaxes first, then the resolution rises
+// as far as the prediction stays under budget.
+//
+// Two things keep it from oscillating: the dead band between
+// underBudget and overBudget, and the window being emptied
+// after each change, so the next decision only sees frames
+// drawn at the new scales.
+// --------------------------------------------------------
+class FrameGovernor
+{
+public:
+	FrameGovernor(const FrameGovernorSettings& settings = FrameGovernorSettings());
+
+	// Adds a frame's time.  True if either scale changed.
+	bool AddFrame(float milliseconds);
+
+	// Back to full resolution and LOD, with the stats cleared
+	void Reset();
+
+	float GetResolutionScale() { return resolutionScale; }
+	float GetLodScale() { return lodScale; }
+	const FrameGovernorSettings& GetSettings() { return settings; }
+	const FrameGovernorStats& GetStats() { return stats; }
+
+private:
+	FrameGovernorSettings settings;
+	FrameGovernorStats stats;
+
+	float resolutionScale;
+	float lodScale;
+
+	// Frame times since the last change, up to a window's worth
+	std::vector<float> window;
+	unsigned int windowNext;
+	float windowSum;
+
+	bool ScaleDown(float average);
+	bool ScaleUp(float average);
+	float Quantize(float scale);
+};
@@ -0,0 +1,84 @@
+#include "FrameGovernorTraces.h"
+#include "FrameGovernor.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+// --------------------------------------------------------
+// A frame's cost at full scale (its load) is split into a
+// part that doesn't change with resolution, a per pixel part
+// that goes with the area, and a part of that the lod scale
+// draws less of:
+//   load * (0.25 + 0.75 * resolution^2) * (0.7 + 0.3 * lod)
+// Noise is added per frame, evenly spread +-noise.
+// --------------------------------------------------------
+bool RunFrameGovernorTraces()
+{
+	srand(1);
+	FrameGovernor governor;
+	float target = governor.GetSettings().targetMilliseconds;
+	float lastAverage = 0;
+
+	auto run = [&](float load, float noise, unsigned int frames)
+	{
+		double sum = 0;
+		unsigned int counted = 0;
+		for (unsigned int f = 0; f < frames; f++)
+		{
+			float res = governor.GetResolutionScale();
+			float ms = load * (0.25f + 0.75f * res * res) * (0.7f + 0.3f * governor.GetLodScale());
+			ms += noise * ((float)rand() / RAND_MAX * 2.0f - 1.0f);
+			governor.AddFrame(ms);
+
+			// The average over the last 60 frames of the trace
+			if (f + 60 >= frames)
+			{
+				sum += ms;
+				counted++;
+			}
+		}
+		lastAverage = (float)(sum / counted);
+	};
+
+	bool allPass = true;
+	auto report = [&](const char* name, bool pass)
+	{
+		const FrameGovernorStats& stats = governor.GetStats();
+		printf("  %-22s resolution %3.0f%%, lod %3.0f%%, %2u resolution and %u lod changes, ending at %5.2f ms - %s\n",
+			name, governor.GetResolutionScale() * 100, governor.GetLodScale() * 100,
+			stats.resolutionChanges, stats.lodChanges, lastAverage, pass ? "PASS" : "FAIL");
+		allPass &= pass;
+	};
+
+	printf("Frame governor (%.2f ms budget):\n", target);
+
+	// Under budget, with a single long frame in the middle
+	governor.Reset();
+	run(12.0f, 1.0f, 300);
+	run(500.0f, 0, 1);
+	run(12.0f, 1.0f, 300);
+	report("steady, one hitch", governor.GetStats().resolutionChanges == 0 && governor.GetStats().lodChanges == 0);
+
+	// Over budget: resolution alone gets it back under
+	governor.Reset();
+	run(30.0f, 1.0f, 600);
+	report("overload", governor.GetResolutionScale() < 1.0f && governor.GetLodScale() == 1.0f && lastAverage <= target);
+
+	// ...and once the load goes, back to full
+	run(12.0f, 1.0f, 900);
+	report("recovery", governor.GetResolutionScale() == 1.0f && governor.GetLodScale() == 1.0f);
+
+	// Just over budget with heavy noise: one drop into the dead band, then it stays put
+	governor.Reset();
+	run(19.0f, 4.0f, 1800);
+	report("noisy, near budget", governor.GetStats().resolutionChanges <= 2 && lastAverage <= target);
+
+	// Too heavy for any scale: both end at their minimums
+	governor.Reset();
+	run(80.0f, 1.0f, 900);
+	report("beyond the minimums",
+		governor.GetResolutionScale() == governor.GetSettings().minResolutionScale &&
+		governor.GetLodScale() == governor.GetSettings().minLodScale);
+
+	printf("Frame governor traces - %s\n", allPass ? "PASS" : "FAIL");
+	return allPass;
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+// --------------------------------------------------------
+// The frame governor fed synthetic frame time traces, with
+// frame cost modelled from the scales it picks: a steady
+// load (and one hitch) it must leave alone, an overload and
+// the recovery after it, a noisy load that must settle
+// rather than oscillate, and one too heavy for any scale.
+// Prints a line per trace; false if any ends up somewhere
+// it shouldn't.
+//
+// Pure CPU code, so it runs both from the benchmarks and
+// from the FrameGovernorTests target on any platform.
+// --------------------------------------------------------
+bool RunFrameGovernorTraces();
@@ -0,0 +1,136 @@
+#include "FramePipeline.h"
+#include <chrono>
+
+FramePipeline::FramePipeline(PipelineStateCache* pipelineStates)
+{
+	this->pipelineStates = pipelineStates;
+
+	passes.push_back(FRAME_PASS_DEPTH_PREPASS);
+	passes.push_back(FRAME_PASS_OPAQUE);
+	passes.push_back(FRAME_PASS_SKY);
+	passes.push_back(FRAME_PASS_TRANSPARENT);
+}
+
+void FramePipeline::SetPasses(const std::vector<FramePass>& passes)
+{
+	this->passes = passes;
+}
+
+void FramePipeline::SetDepthPrepass(bool enabled)
+{
+	if (enabled == GetDepthPrepass())
+		return;
+
+	if (enabled)
+	{
+		passes.insert(passes.begin(), FRAME_PASS_DEPTH_PREPASS);
+		return;
+	}
+
+	std::vector<FramePass> kept;
+	for (FramePass p : passes)
+		if (p != FRAME_PASS_DEPTH_PREPASS) kept.push_back(p);
+	passes = kept;
+}
+
+bool FramePipeline::GetDepthPrepass()
+{
+	for (FramePass p : passes)
+		if (p == FRAME_PASS_DEPTH_PREPASS) return true;
+	return false;
+}
+
+const char* FramePipeline::GetPassName(FramePass pass)
+{
+	switch (pass)
+	{
+	case FRAME_PASS_DEPTH_PREPASS: return "depth prepass";
+	case FRAME_PASS_OPAQUE: return "opaque";
+	case FRAME_PASS_SKY: return "sky";
+	case FRAME_PASS_TRANSPARENT: return "transparent";
+	default: return "unknown";
+	}
+}
+
+// --------------------------------------------------------
+// Draws every queued packet of one queue pass under its
+// material's PSO for the pipeline.  Depth only draws keep the
+// material's vertex shader, so positions come out
+// bit-identical to the shading pass and EQUAL holds.
+// --------------------------------------------------------
+unsigned int FramePipeline::DrawPackets(StateCache* state, RenderQueue& queue, Camera* cam, RenderPass pass, MaterialPipeline pipeline)
+{
+	bool depthOnly = pipeline == MATERIAL_PIPELINE_DEPTH_ONLY;
+	unsigned int draws = 0;
+
+	for (auto& p : queue.GetPackets())
+	{
+		if (RenderQueue::GetKeyPass(p.key) != pass)
+			continue;
+
+		gameEntity* m = p.entity;
+		state->SetPipelineState(m->mat->GetPipelineState(pipelineStates, pipeline));
+		if (depthOnly)
+		{
+			m->drawDepth(state, cam);
+		}
+		else
+		{
+			SimplePixelShader* ps = m->mat->getPixel();
+			ps->SetFloat(m->mat->specHandle, m->mat->specExponent);
+			ps->CopyAllBufferData();
+			m->draw(state, cam);
+		}
+		draws++;
+	}
+
+	return draws;
+}
+
+void FramePipeline::Execute(StateCache* state, RenderQueue& queue, Camera* cam, Sky* sky)
+{
+	stats.clear();
+	bool depthLaidDown = false;
+
+	for (FramePass pass : passes)
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+
+		FramePassStats passStats = {};
+		passStats.pass = pass;
+
+		switch (pass)
+		{
+		case FRAME_PASS_DEPTH_PREPASS:
+			passStats.draws = DrawPackets(state, queue, cam, RENDER_PASS_OPAQUE, MATERIAL_PIPELINE_DEPTH_ONLY);
+			depthLaidDown = true;
+			break;
+
+		case FRAME_PASS_OPAQUE:
+			//LESS with writes unless the prepass already has the depth
+			passStats.draws = DrawPackets(state, queue, cam, RENDER_PASS_OPAQUE, depthLaidDown ? MATERIAL_PIPELINE_OPAQUE_EQUAL : MATERIAL_PIPELINE_OPAQUE);
+			break;
+
+		case FRAME_PASS_SKY:
+			sky->Draw(state, cam);
+			passStats.draws = 1;
+			break;
+
+		case FRAME_PASS_TRANSPARENT:
+			passStats.draws = DrawPackets(state, queue, cam, RENDER_PASS_TRANSPARENT, MATERIAL_PIPELINE_TRANSPARENT);
+			break;
+
+		default:
+			break;
+		}
+
+		auto end = std::chrono::high_resolution_clock::now();
+		passStats.cpuMilliseconds = std::chrono::duration<double, std::milli>(end - start).count();
+		stats.push_back(passStats);
+	}
+
+	//back to the defaults for anything drawn after the frame
+	state->RSSetState(0);
+	state->OMSetDepthStencilState(0, 0);
+	state->OMSetBlendState(0);
+}
@@ -0,0 +1,75 @@
+#pragma once
+#include <vector>
+#include "RenderBackend.h"
+#include "RenderQueue.h"
+#include "StateCache.h"
+#include "Camera.h"
+#include "Sky.h"
+#include "Material.h"
+
+// --------------------------------------------------------
+// The passes a frame can be made of.  Each draws a subset of
+// the render queue (or the sky) under its own depth state.
+// --------------------------------------------------------
+enum FramePass
+{
+	FRAME_PASS_DEPTH_PREPASS,	// Opaque packets, depth only
+	FRAME_PASS_OPAQUE,			// Opaque packets, fully shaded
+	FRAME_PASS_SKY,				// Only where depth is still at the far plane
+	FRAME_PASS_TRANSPARENT,		// Transparent packets, back to front
+	FRAME_PASS_COUNT
+};
+
+// --------------------------------------------------------
+// Per-pass numbers from the last Execute()
+// --------------------------------------------------------
+struct FramePassStats
+{
+	FramePass pass;
+	unsigned int draws;
+	double cpuMilliseconds;
+};
+
+// --------------------------------------------------------
+// Runs a frame's passes in a configurable order.  The default
+// list is depth prepass, opaque, sky, transparent:
+//  - the prepass lays down opaque depth with no pixel shader
+//  - opaque then shades with an EQUAL test and no depth writes,
+//    so the material shader runs once per visible pixel
+//  - the sky goes after, filling only what's left at the far
+//    plane instead of being overdrawn by everything else
+// Without a prepass in the list, opaque tests LESS and writes
+// depth as usual.
+//
+// Every draw binds a pipeline state object for its material
+// and pass, so nothing depends on state left over from the
+// previous draw.
+// --------------------------------------------------------
+class FramePipeline
+{
+public:
+	FramePipeline(PipelineStateCache* pipelineStates);
+
+	void SetPasses(const std::vector<FramePass>& passes);
+	const std::vector<FramePass>& GetPasses() { return passes; }
+
+	// Adds or removes the prepass from the front of the list
+	void SetDepthPrepass(bool enabled);
+	bool GetDepthPrepass();
+
+	// Draws the sorted queue and the sky
+	void Execute(StateCache* state, RenderQueue& queue, Camera* cam, Sky* sky);
+
+	// One entry per pass in the list, in order
+	const std::vector<FramePassStats>& GetStats() { return stats; }
+
+	static const char* GetPassName(FramePass pass);
+
+private:
+	std::vector<FramePass> passes;
+	std::vector<FramePassStats> stats;
+
+	PipelineStateCache* pipelineStates;
+
+	unsigned int DrawPackets(StateCache* state, RenderQueue& queue, Camera* cam, RenderPass pass, MaterialPipeline pipeline);
+};
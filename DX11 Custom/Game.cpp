@@ -1,18 +1,47 @@
 #include "Game.h"
 #include "Vertex.h"
 
-// Needed for a helper function to read compiled shader files from the hard drive
-#pragma comment(lib, "d3dcompiler.lib")
-#include <d3dcompiler.h>
-#include "bufferStructs.h"
+#include "ShaderConstants.h"
 #include <cmath>
 #include "Camera.h"
-#include <SpriteBatch.h>
-#include <SpriteFont.h>
-#include <d3d11.h>
+#include "Benchmarks.h"
+#include <cassert>
+#include <chrono>
+#include <string.h>
+#include <wchar.h>
 // For the DirectX Math library
 using namespace DirectX;
 
+//each terrain segment is 8 parts (ground, platform, 4 walls and 2 unused), the first
+//6 drawn, followed by its batched entities
+static const size_t terrainParts = 8;
+static const unsigned int terrainDrawnParts = 6;
+
+//obstacles and terrain further than this (times the governor's lod scale) from the
+//camera aren't drawn - at full lod it covers everything that's active
+static const float maxDrawDistance = 90.0f;
+
+//true if any part of the entity's bounds is within distance of the eye
+static bool WithinDrawDistance(gameEntity* e, const XMFLOAT3& eye, float distance)
+{
+	Mesh* mesh = e->GetMesh();
+	XMFLOAT4X4 world = e->GetTransform()->GetWorldMatrix();
+	XMMATRIX m = XMLoadFloat4x4(&world);
+
+	//world space box around the transformed bounds
+	XMVECTOR center = XMVectorScale(XMVectorAdd(XMLoadFloat3(&mesh->boundsMin), XMLoadFloat3(&mesh->boundsMax)), 0.5f);
+	XMVECTOR extent = XMVectorScale(XMVectorSubtract(XMLoadFloat3(&mesh->boundsMax), XMLoadFloat3(&mesh->boundsMin)), 0.5f);
+	center = XMVector3Transform(center, m);
+	extent = XMVectorAdd(XMVectorAdd(
+		XMVectorScale(XMVectorAbs(m.r[0]), XMVectorGetX(extent)),
+		XMVectorScale(XMVectorAbs(m.r[1]), XMVectorGetY(extent))),
+		XMVectorScale(XMVectorAbs(m.r[2]), XMVectorGetZ(extent)));
+
+	//distance from the eye to the nearest point of the box
+	XMVECTOR outside = XMVectorMax(XMVectorSubtract(XMVectorAbs(XMVectorSubtract(XMLoadFloat3(&eye), center)), extent), XMVectorZero());
+	return XMVectorGetX(XMVector3LengthSq(outside)) <= distance * distance;
+}
+
 // --------------------------------------------------------
 // Constructor
 //
@@ -38,6 +67,28 @@ Game::Game(HINSTANCE hInstance)
 
 	ready = false;
 	highScore = 0;
+	benchmarksDone = false;
+	softwareRendering = false;
+	softwareRenderer = 0;
+
+	//made in Init(), which doesn't run if the window or the backend can't be
+	//created - the destructor deletes whatever was made
+	obj1 = obj2 = obj3 = obj4 = obj5 = obj6 = 0;
+	terrainBatch = 0;
+	geometryArena = 0;
+	g1 = g2 = g3 = player = g5 = g6 = ground = 0;
+	mat1 = mat2 = mat3 = mat4 = mat5 = mat6 = mat7 = 0;
+	cam = 0;
+	shaderVariants = 0;
+	skyObj = 0;
+	dynamicResolution = 0;
+	lightClusters = 0;
+	framePipeline = 0;
+	materialAtlas = 0;
+	environment = 0;
+	stateCache = 0;
+	pipelineStates = 0;
+	cbRing = 0;
 }
 
 // --------------------------------------------------------
@@ -47,16 +98,18 @@ Game::Game(HINSTANCE hInstance)
 // --------------------------------------------------------
 Game::~Game()
 {
-	// Note: Since we're using smart pointers (ComPtr),
-	// we don't need to explicitly clean up those DirectX objects
+	// Note: Since we're using smart pointers (RenderRef),
+	// we don't need to explicitly clean up those render objects
 	// - If we weren't using smart pointers, we'd need
-	//   to call Release() on each DirectX object created in Game
+	//   to call Release() on each render object created in Game
 	delete obj1;
 	delete obj2;
 	delete obj3;
 	delete obj4; 
 	delete obj5;
 	delete obj6;
+	delete terrainBatch;
+	delete geometryArena;
 
 	delete g1;
 	delete g2;
@@ -76,16 +129,25 @@ Game::~Game()
 
 	delete cam;
 
-	delete vertexShader;
-	delete pixelShader;
-
-	delete vertexShaderNormal;
-	delete pixelShaderNormal;
+	delete shaderVariants;
 
 	delete skyObj;
+	delete dynamicResolution;
+
+	//what the cpu renderer took per frame, and its last frame
+	if (softwareRenderer) {
+		softwareRenderer->PrintStats();
+		softwareRenderer->SaveFrame(GetFullPathTo("software.ppm").c_str());
+		delete softwareRenderer;
+	}
 
-	m_font.reset();
-	m_spriteBatch.reset();
+	delete lightClusters;
+	delete framePipeline;
+	delete materialAtlas;
+	delete environment;
+	delete stateCache;
+	delete pipelineStates;
+	delete cbRing;
 
 
 	entities.clear();
@@ -106,66 +168,100 @@ Game::~Game()
 // --------------------------------------------------------
 void Game::Init()
 {
+	//all binds in the draw path go through the state cache, including the shaders'
+	stateCache = new StateCache(backend);
+	ISimpleShader::SetStateCache(stateCache);
+
+	//psos for every draw, and input layouts shared between vertex shaders - before any shader loads
+	pipelineStates = new PipelineStateCache(backend);
+	ISimpleShader::SetPipelineStateCache(pipelineStates);
+
+	//per-draw constants are suballocated from one ring buffer - must exist before any shader loads
+	cbRing = new ConstantBufferRing(backend, 1024 * 1024);
+	ISimpleShader::SetConstantBufferRing(cbRing);
+
+	//structured buffers for the clustered lights
+	lightClusters = new LightClusters(backend);
+
+	//the frame's passes, each drawing under its materials' psos
+	framePipeline = new FramePipeline(pipelineStates);
+
+	//creating the three directional lights and one point light
+	//before the shaders, since their counts pick the material variants
+	lightList.Clear();
+	lightList.AddDirectional(XMFLOAT3(1.01f, 0.5f, 1.1f), XMFLOAT3(1.0f, 1.1f, 1.1f), XMFLOAT3(1, -1, 0));
+	lightList.AddDirectional(XMFLOAT3(0.01f, 0.01f, 0.1f), XMFLOAT3(1.0f, 0.1f, 0.1f), XMFLOAT3(-1, 1, 0));
+	lightList.AddDirectional(XMFLOAT3(0.01f, 0.01f, 0.01f), XMFLOAT3(1.0f, 1.0f, 0.1f), XMFLOAT3(0, 1, -1));
+	lightList.AddPoint(XMFLOAT3(0.01f, 0.01f, 0.01f), XMFLOAT3(1.0f, 1.0f, 1.0f), XMFLOAT3(0, 5, 0));
+
+	//ambient light from the sky, also before the shaders since it adds a material feature
+	environment = new EnvironmentLighting();
+	if (environment->Build(backend, GetFullPathTo_Wide(L"../../models/textures/SunnyCubeMap.dds"), GetFullPathTo_Wide(L"environment.ibl"))) {
+		const EnvironmentLightingStats& envStats = environment->GetStats();
+		printf("Environment lighting %s in %.3f ms: %ux%u source, %u specular mips, %.1f MB\n",
+			envStats.cooked ? "cooked" : "loaded", envStats.buildMilliseconds,
+			envStats.sourceSize, envStats.sourceSize, envStats.specularMips,
+			envStats.bytes / (1024.0 * 1024.0));
+		if (envStats.cooked) {
+			printf("  irradiance %.3f ms, specular %.3f ms, brdf lut %.3f ms\n",
+				envStats.irradianceMilliseconds, envStats.specularMilliseconds, envStats.brdfMilliseconds);
+		}
+	}
+	else {
+		printf("Environment lighting failed to build, the materials get no ambient light\n");
+		delete environment;
+		environment = 0;
+	}
+
 	// Helper methods for loading shaders, creating some basic
 	// geometry to draw and some simple camera matrices.
 	//  - You'll be expanding and/or replacing these later
+#if defined(RUN_BENCHMARKS)
+	//shader loads are timed to show what the reflection cache saves
+	ShaderReflectionCache::ResetCounts();
+	auto shaderStart = std::chrono::high_resolution_clock::now();
 	LoadShaders();
+	auto shaderEnd = std::chrono::high_resolution_clock::now();
+	printf("Shaders loaded in %.3f ms (reflection cache %s: %u hits, %u misses)\n",
+		std::chrono::duration<double, std::milli>(shaderEnd - shaderStart).count(),
+		ShaderReflectionCache::IsEnabled() ? "on" : "off",
+		ShaderReflectionCache::GetHitCount(),
+		ShaderReflectionCache::GetMissCount());
+#else
+	LoadShaders();
+#endif
+
+	//made once, and kept over restarts - it needs to exist before the atlas is built
+	if (softwareRendering && !softwareRenderer)
+		softwareRenderer = new SoftwareRenderer(width, height);
+
 	CreateBasicGeometry();
+
+	//vertex shaders with the same input signature share a layout
+	printf("Input layouts: %u for %u vertex shaders\n",
+		pipelineStates->GetStats().inputLayouts,
+		pipelineStates->GetStats().layoutRequests);
 	
 	// Tell the input assembler stage of the pipeline what kind of
 	// geometric primitives (points, lines or triangles) we want to draw.  
 	// Essentially: "What kind of shape should the GPU draw with our data?"
-	context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-
-	//buffer size initialization
-	unsigned int size = sizeof(VertexShaderExternalData);
-	size = (size + 15) / 16 * 16;
-
-	//buffer description
-	D3D11_BUFFER_DESC cbDesc = {}; 
-	cbDesc.BindFlags= D3D11_BIND_CONSTANT_BUFFER;
-	cbDesc.ByteWidth= size;
-	cbDesc.CPUAccessFlags= D3D11_CPU_ACCESS_WRITE;
-	cbDesc.Usage= D3D11_USAGE_DYNAMIC;
-
+	stateCache->IASetPrimitiveTopology(RENDER_TOPOLOGY_TRIANGLE_LIST);
 
 	angle = 0.0f;
 	scaleSize = 1;
 
+	//a restart starts back at full resolution and lod
+	governor.Reset();
+
 	//creating initial position and orientation of camera
 	XMFLOAT3 pos = { 0,2.5f,-1 };
 	XMFLOAT3 orient{ 0.5f,0,0 };
 
 	cam = new Camera(pos, orient, (float)this->width/this->height);
 
-	//creating the three directional lights and one point light
-	light = DirectionalLight();
-	light.ambientColor = XMFLOAT3(1.01f, 0.5f, 1.1f);
-	light.diffuseColor = XMFLOAT3(1.0f, 1.1f, 1.1f);
-	light.direction = XMFLOAT3(1, -1, 0);
-
-	light2 = DirectionalLight();
-	light2.ambientColor = XMFLOAT3(0.01f, 0.01f, 0.1f);
-	light2.diffuseColor = XMFLOAT3(1.0f, 0.1f, 0.1f);
-	light2.direction = XMFLOAT3(-1, 1, 0);
-
-	light3 = DirectionalLight();
-	light3.ambientColor = XMFLOAT3(0.01f, 0.01f, 0.01f);
-	light3.diffuseColor = XMFLOAT3(1.0f, 1.0f, 0.1f);
-	light3.direction = XMFLOAT3(0, 1, -1);
-
-	point1 = PointLight();
-	point1.ambientColor = XMFLOAT3(0.01f, 0.01f, 0.01f);
-	point1.diffuseColor = XMFLOAT3(1.0f, 1.0f, 1.0f);
-	point1.position = XMFLOAT3(0, 5, 0);
-
 	doneInput = false;
 
-	m_font = std::make_unique<SpriteFont>(device.Get(), L"myfile.spritefont");
-	m_spriteBatch = std::make_unique<SpriteBatch>(context.Get());
-
-	m_fontPos.x =  -0.0f;
-	m_fontPos.y =  -0.0f;
+	backend->LoadFont(L"myfile.spritefont");
 
 	playerDead = false;
 
@@ -173,6 +269,14 @@ void Game::Init()
 
 	speedMult = 1.0f;
 	benchMark = 0;
+
+#if defined(RUN_BENCHMARKS)
+	//only once, not on every restart
+	if (!benchmarksDone) {
+		Benchmarks::RunAll(backend, mat1->getVertex(), GetFullPathTo_Wide(L"MaterialVS.cso").c_str());
+		benchmarksDone = true;
+	}
+#endif
 	
 }
 
@@ -186,10 +290,16 @@ void Game::Init()
 // --------------------------------------------------------
 void Game::LoadShaders()
 {
-	vertexShader = new SimpleVertexShader(device.Get(), context.Get(), GetFullPathTo_Wide(L"VertexShader.cso").c_str());
-	pixelShader = new SimplePixelShader(device.Get(), context.Get(), GetFullPathTo_Wide(L"PixelShader.cso").c_str());
-	pixelShaderNormal = new SimplePixelShader(device.Get(), context.Get(), GetFullPathTo_Wide(L"pixelShaderNormal.cso").c_str());
-	vertexShaderNormal = new SimpleVertexShader(device.Get(), context.Get(), GetFullPathTo_Wide(L"vertexShaderNormal.cso").c_str());
+	//the build copies the material sources next to the exe, where the .cso files go
+	shaderVariants = new ShaderVariantCache(backend, GetExePath_Wide(), GetExePath_Wide());
+
+	//compile the variants the materials use up front, so the first frame doesn't hitch
+	unsigned int lights = lightList.GetFeatures() | MATERIAL_FEATURE_CLUSTERED_LIGHTS | MATERIAL_FEATURE_COMPACT_VERTICES;
+	if (environment) lights |= MATERIAL_FEATURE_IMAGE_LIGHTING;
+	shaderVariants->GetVertexShader(lights);
+	shaderVariants->GetPixelShader(lights);
+	shaderVariants->GetVertexShader(lights | MATERIAL_FEATURE_NORMAL_MAP);
+	shaderVariants->GetPixelShader(lights | MATERIAL_FEATURE_NORMAL_MAP | MATERIAL_FEATURE_PBR_MAPS);
 
 }
 
@@ -259,88 +369,163 @@ void Game::CreateBasicGeometry()
 	unsigned int indices3[] = { 0, 1, 2, 1, 2, 3, 0, 4, 2 };
 
 	//get textures from files
-	CreateWICTextureFromFile(device.Get(), context.Get(), GetFullPathTo_Wide(L"../../models/grass.jpg").c_str(), 0, texture2SRV.GetAddressOf());
-	CreateWICTextureFromFile(device.Get(), context.Get(), GetFullPathTo_Wide(L"../../models/textures/rock.PNG").c_str(), 0, textureSRV.GetAddressOf());
-	CreateWICTextureFromFile(device.Get(), context.Get(), GetFullPathTo_Wide(L"../../models/textures/rock_normals.png").c_str(), 0, normalSRV.GetAddressOf());
-	
-	//pbr textures
-	CreateWICTextureFromFile(device.Get(), context.Get(), GetFullPathTo_Wide(L"../../models/textures/pbr/cobblestone_albedo.png").c_str(), 0, cobbleA.GetAddressOf());
-	CreateWICTextureFromFile(device.Get(), context.Get(), GetFullPathTo_Wide(L"../../models/textures/pbr/cobblestone_normals.png").c_str(), 0, cobbleN.GetAddressOf());
-	CreateWICTextureFromFile(device.Get(), context.Get(), GetFullPathTo_Wide(L"../../models/textures/pbr/cobblestone_roughness.png").c_str(), 0, cobbleR.GetAddressOf());
-	CreateWICTextureFromFile(device.Get(), context.Get(), GetFullPathTo_Wide(L"../../models/textures/pbr/cobblestone_metal.png").c_str(), 0, cobbleM.GetAddressOf());
-
-	CreateWICTextureFromFile(device.Get(), context.Get(), GetFullPathTo_Wide(L"../../models/textures/pbr/floor_albedo.png").c_str(), 0, floorA.GetAddressOf());
-	CreateWICTextureFromFile(device.Get(), context.Get(), GetFullPathTo_Wide(L"../../models/textures/pbr/floor_normals.png").c_str(), 0, floorN.GetAddressOf());
-	CreateWICTextureFromFile(device.Get(), context.Get(), GetFullPathTo_Wide(L"../../models/textures/pbr/floor_roughness.png").c_str(), 0, floorR.GetAddressOf());
-	CreateWICTextureFromFile(device.Get(), context.Get(), GetFullPathTo_Wide(L"../../models/textures/pbr/floor_metal.png").c_str(), 0, floorM.GetAddressOf());
-
-	CreateWICTextureFromFile(device.Get(), context.Get(), GetFullPathTo_Wide(L"../../models/textures/pbr/paint_albedo.png").c_str(), 0, paintA.GetAddressOf());
-	CreateWICTextureFromFile(device.Get(), context.Get(), GetFullPathTo_Wide(L"../../models/textures/pbr/paint_normals.png").c_str(), 0, paintN.GetAddressOf());
-	CreateWICTextureFromFile(device.Get(), context.Get(), GetFullPathTo_Wide(L"../../models/textures/pbr/paint_roughness.png").c_str(), 0, paintR.GetAddressOf());
-	CreateWICTextureFromFile(device.Get(), context.Get(), GetFullPathTo_Wide(L"../../models/textures/pbr/paint_metal.png").c_str(), 0, paintM.GetAddressOf());
-
-	CreateWICTextureFromFile(device.Get(), context.Get(), GetFullPathTo_Wide(L"../../models/textures/pbr/scratched_albedo.png").c_str(), 0, scratchedA.GetAddressOf());
-	CreateWICTextureFromFile(device.Get(), context.Get(), GetFullPathTo_Wide(L"../../models/textures/pbr/scratched_normals.png").c_str(), 0, scratchedN.GetAddressOf());
-	CreateWICTextureFromFile(device.Get(), context.Get(), GetFullPathTo_Wide(L"../../models/textures/pbr/scratched_roughness.png").c_str(), 0, scratchedR.GetAddressOf());
-	CreateWICTextureFromFile(device.Get(), context.Get(), GetFullPathTo_Wide(L"../../models/textures/pbr/scratched_metal.png").c_str(), 0, scratchedM.GetAddressOf());
-
-	CreateWICTextureFromFile(device.Get(), context.Get(), GetFullPathTo_Wide(L"../../models/textures/pbr/bronze_albedo.png").c_str(), 0, bronzeA.GetAddressOf());
-	CreateWICTextureFromFile(device.Get(), context.Get(), GetFullPathTo_Wide(L"../../models/textures/pbr/bronze_normals.png").c_str(), 0, bronzeN.GetAddressOf());
-	CreateWICTextureFromFile(device.Get(), context.Get(), GetFullPathTo_Wide(L"../../models/textures/pbr/bronze_roughness.png").c_str(), 0, bronzeR.GetAddressOf());
-	CreateWICTextureFromFile(device.Get(), context.Get(), GetFullPathTo_Wide(L"../../models/textures/pbr/bronze_metal.png").c_str(), 0, bronzeM.GetAddressOf());
-
-	CreateWICTextureFromFile(device.Get(), context.Get(), GetFullPathTo_Wide(L"../../models/textures/pbr/rough_albedo.png").c_str(), 0, roughA.GetAddressOf());
-	CreateWICTextureFromFile(device.Get(), context.Get(), GetFullPathTo_Wide(L"../../models/textures/pbr/rough_normals.png").c_str(), 0, roughN.GetAddressOf());
-	CreateWICTextureFromFile(device.Get(), context.Get(), GetFullPathTo_Wide(L"../../models/textures/pbr/rough_roughness.png").c_str(), 0, roughR.GetAddressOf());
-	CreateWICTextureFromFile(device.Get(), context.Get(), GetFullPathTo_Wide(L"../../models/textures/pbr/rough_metal.png").c_str(), 0, roughM.GetAddressOf());
-
-	CreateWICTextureFromFile(device.Get(), context.Get(), GetFullPathTo_Wide(L"../../models/textures/pbr/wood_albedo.png").c_str(), 0, woodA.GetAddressOf());
-	CreateWICTextureFromFile(device.Get(), context.Get(), GetFullPathTo_Wide(L"../../models/textures/pbr/wood_normals.png").c_str(), 0, woodN.GetAddressOf());
-	CreateWICTextureFromFile(device.Get(), context.Get(), GetFullPathTo_Wide(L"../../models/textures/pbr/wood_roughness.png").c_str(), 0, woodR.GetAddressOf());
-	CreateWICTextureFromFile(device.Get(), context.Get(), GetFullPathTo_Wide(L"../../models/textures/pbr/wood_metal.png").c_str(), 0, woodM.GetAddressOf());
+	//color maps are srgb, so the hardware linearizes them when sampled
+	backend->LoadTexture(GetFullPathTo_Wide(L"../../models/grass.jpg").c_str(), texture2SRV.GetAddressOf(), true);
+	backend->LoadTexture(GetFullPathTo_Wide(L"../../models/textures/rock.PNG").c_str(), textureSRV.GetAddressOf(), true);
+	backend->LoadTexture(GetFullPathTo_Wide(L"../../models/textures/rock_normals.png").c_str(), normalSRV.GetAddressOf());
 	
+	//pbr textures, channel packed into texture arrays so the materials using them share their binds
+	materialAtlas = new MaterialAtlas(512);
+	//the cpu renderer samples the maps from memory
+	materialAtlas->SetKeepPixels(softwareRenderer != 0);
+	std::wstring pbrDir = GetFullPathTo_Wide(L"../../models/textures/pbr/");
+	const wchar_t* atlasNames[] = { L"wood", L"bronze", L"paint", L"rough", L"floor", L"cobblestone" };
+	for (const wchar_t* name : atlasNames) {
+		std::wstring base = pbrDir + name;
+		materialAtlas->AddMaterial(base + L"_albedo.png", base + L"_normals.png", base + L"_roughness.png", base + L"_metal.png");
+	}
+
+	bool atlasBuilt = materialAtlas->Build(backend, GetFullPathTo_Wide(L"materials.atlas"));
+	if (atlasBuilt) {
+		const MaterialAtlasStats& atlasStats = materialAtlas->GetStats();
+		printf("Material atlas %s in %.3f ms: %u slices of %ux%u, %u mips, %.1f MB\n",
+			atlasStats.cooked ? "cooked" : "loaded", atlasStats.buildMilliseconds,
+			atlasStats.slices, atlasStats.size, atlasStats.size, atlasStats.mipLevels,
+			atlasStats.bytes / (1024.0 * 1024.0));
+
+		//what channel packing saved on each material over a texture per map
+		for (unsigned int i = 0; i < materialAtlas->GetSliceCount(); i++) {
+			const MaterialAtlasSliceStats& slice = materialAtlas->GetSliceStats(i);
+			printf("  %ls: %.1f MB as separate maps, %.1f MB packed (%.0f%% saved)\n",
+				atlasNames[i], slice.sourceBytes / (1024.0 * 1024.0), slice.cookedBytes / (1024.0 * 1024.0),
+				100.0 - 100.0 * slice.cookedBytes / (double)slice.sourceBytes);
+		}
+	}
+	else {
+		//fall back to a texture per map
+		printf("Material atlas failed to build, loading the maps separately\n");
+		delete materialAtlas;
+		materialAtlas = 0;
+
+		//pbr textures
+		backend->LoadTexture(GetFullPathTo_Wide(L"../../models/textures/pbr/cobblestone_albedo.png").c_str(), cobbleA.GetAddressOf(), true);
+		backend->LoadTexture(GetFullPathTo_Wide(L"../../models/textures/pbr/cobblestone_normals.png").c_str(), cobbleN.GetAddressOf());
+		backend->LoadTexture(GetFullPathTo_Wide(L"../../models/textures/pbr/cobblestone_roughness.png").c_str(), cobbleR.GetAddressOf());
+		backend->LoadTexture(GetFullPathTo_Wide(L"../../models/textures/pbr/cobblestone_metal.png").c_str(), cobbleM.GetAddressOf());
+
+		backend->LoadTexture(GetFullPathTo_Wide(L"../../models/textures/pbr/floor_albedo.png").c_str(), floorA.GetAddressOf(), true);
+		backend->LoadTexture(GetFullPathTo_Wide(L"../../models/textures/pbr/floor_normals.png").c_str(), floorN.GetAddressOf());
+		backend->LoadTexture(GetFullPathTo_Wide(L"../../models/textures/pbr/floor_roughness.png").c_str(), floorR.GetAddressOf());
+		backend->LoadTexture(GetFullPathTo_Wide(L"../../models/textures/pbr/floor_metal.png").c_str(), floorM.GetAddressOf());
+
+		backend->LoadTexture(GetFullPathTo_Wide(L"../../models/textures/pbr/paint_albedo.png").c_str(), paintA.GetAddressOf(), true);
+		backend->LoadTexture(GetFullPathTo_Wide(L"../../models/textures/pbr/paint_normals.png").c_str(), paintN.GetAddressOf());
+		backend->LoadTexture(GetFullPathTo_Wide(L"../../models/textures/pbr/paint_roughness.png").c_str(), paintR.GetAddressOf());
+		backend->LoadTexture(GetFullPathTo_Wide(L"../../models/textures/pbr/paint_metal.png").c_str(), paintM.GetAddressOf());
+
+		backend->LoadTexture(GetFullPathTo_Wide(L"../../models/textures/pbr/scratched_albedo.png").c_str(), scratchedA.GetAddressOf(), true);
+		backend->LoadTexture(GetFullPathTo_Wide(L"../../models/textures/pbr/scratched_normals.png").c_str(), scratchedN.GetAddressOf());
+		backend->LoadTexture(GetFullPathTo_Wide(L"../../models/textures/pbr/scratched_roughness.png").c_str(), scratchedR.GetAddressOf());
+		backend->LoadTexture(GetFullPathTo_Wide(L"../../models/textures/pbr/scratched_metal.png").c_str(), scratchedM.GetAddressOf());
+
+		backend->LoadTexture(GetFullPathTo_Wide(L"../../models/textures/pbr/bronze_albedo.png").c_str(), bronzeA.GetAddressOf(), true);
+		backend->LoadTexture(GetFullPathTo_Wide(L"../../models/textures/pbr/bronze_normals.png").c_str(), bronzeN.GetAddressOf());
+		backend->LoadTexture(GetFullPathTo_Wide(L"../../models/textures/pbr/bronze_roughness.png").c_str(), bronzeR.GetAddressOf());
+		backend->LoadTexture(GetFullPathTo_Wide(L"../../models/textures/pbr/bronze_metal.png").c_str(), bronzeM.GetAddressOf());
+
+		backend->LoadTexture(GetFullPathTo_Wide(L"../../models/textures/pbr/rough_albedo.png").c_str(), roughA.GetAddressOf(), true);
+		backend->LoadTexture(GetFullPathTo_Wide(L"../../models/textures/pbr/rough_normals.png").c_str(), roughN.GetAddressOf());
+		backend->LoadTexture(GetFullPathTo_Wide(L"../../models/textures/pbr/rough_roughness.png").c_str(), roughR.GetAddressOf());
+		backend->LoadTexture(GetFullPathTo_Wide(L"../../models/textures/pbr/rough_metal.png").c_str(), roughM.GetAddressOf());
+
+		backend->LoadTexture(GetFullPathTo_Wide(L"../../models/textures/pbr/wood_albedo.png").c_str(), woodA.GetAddressOf(), true);
+		backend->LoadTexture(GetFullPathTo_Wide(L"../../models/textures/pbr/wood_normals.png").c_str(), woodN.GetAddressOf());
+		backend->LoadTexture(GetFullPathTo_Wide(L"../../models/textures/pbr/wood_roughness.png").c_str(), woodR.GetAddressOf());
+		backend->LoadTexture(GetFullPathTo_Wide(L"../../models/textures/pbr/wood_metal.png").c_str(), woodM.GetAddressOf());
+	}
+
 	//set sampler description
-	D3D11_SAMPLER_DESC samplerDesc = {};
-	samplerDesc.AddressU = D3D11_TEXTURE_ADDRESS_WRAP;
-	samplerDesc.AddressV = D3D11_TEXTURE_ADDRESS_WRAP;
-	samplerDesc.AddressW = D3D11_TEXTURE_ADDRESS_WRAP;
-	samplerDesc.Filter = D3D11_FILTER_MIN_MAG_MIP_LINEAR;
-	samplerDesc.MaxLOD = D3D11_FLOAT32_MAX;
+	SamplerDesc samplerDesc = {};
+	samplerDesc.Filter = RENDER_FILTER_LINEAR;
+	samplerDesc.AddressMode = RENDER_ADDRESS_WRAP;
 
 	//create sampler state
-	device->CreateSamplerState(&samplerDesc, &sampler);
+	backend->CreateSamplerState(samplerDesc, sampler.ReleaseAndGetAddressOf());
 	
 	
 
 	//intializing materials, each with a different color tint
-	mat2 = new Material(XMFLOAT4(1, 0, 0, 1), pixelShaderNormal, vertexShaderNormal, 100, woodA, sampler, true, woodN, woodM, woodR);
-	mat4 = new Material(XMFLOAT4(1, 1, 0, 1), pixelShaderNormal, vertexShaderNormal, 20, bronzeA, sampler, true, bronzeN, bronzeM, bronzeR);
-	mat3 = new Material(XMFLOAT4(1, 1, 1, 1), pixelShaderNormal, vertexShaderNormal, 512, paintA, sampler, true, paintN, paintM, paintR);
-	mat1 = new Material(XMFLOAT4(0, 1, 1, 1), pixelShaderNormal, vertexShaderNormal, 30, roughA, sampler, true, roughN, roughM, roughR);
-	mat5 = new Material(XMFLOAT4(1, 0, 1, 1), pixelShaderNormal, vertexShaderNormal, 400, floorA, sampler, true, floorN, floorM, floorR);
-	mat6 = new Material(XMFLOAT4(1, 0, 1, 1), pixelShaderNormal, vertexShaderNormal, 400, cobbleA, sampler, true, cobbleN, cobbleM, cobbleR);
-	mat7 = new Material(XMFLOAT4(1, 0, 1, 1), pixelShader, vertexShader, 100, texture2SRV, sampler, false, nullptr, nullptr, nullptr);
+	//every material is lit by the light list's lights and the clustered lights,
+	//the rest of its shader variant depends on which maps it has.
+	//every entity mesh is compact, so every material reads compact vertices
+	unsigned int lights = lightList.GetFeatures() | MATERIAL_FEATURE_CLUSTERED_LIGHTS | MATERIAL_FEATURE_COMPACT_VERTICES;
+	if (environment) lights |= MATERIAL_FEATURE_IMAGE_LIGHTING;
+	if (materialAtlas) {
+		//slices in the order they were added to the atlas
+		mat2 = new Material(XMFLOAT4(1, 0, 0, 1), shaderVariants, lights, 100, materialAtlas, 0, sampler);
+		mat4 = new Material(XMFLOAT4(1, 1, 0, 1), shaderVariants, lights, 20, materialAtlas, 1, sampler);
+		mat3 = new Material(XMFLOAT4(1, 1, 1, 1), shaderVariants, lights, 512, materialAtlas, 2, sampler);
+		mat1 = new Material(XMFLOAT4(0, 1, 1, 1), shaderVariants, lights, 30, materialAtlas, 3, sampler);
+		mat5 = new Material(XMFLOAT4(1, 0, 1, 1), shaderVariants, lights, 400, materialAtlas, 4, sampler);
+		mat6 = new Material(XMFLOAT4(1, 0, 1, 1), shaderVariants, lights, 400, materialAtlas, 5, sampler);
+	}
+	else {
+		mat2 = new Material(XMFLOAT4(1, 0, 0, 1), shaderVariants, lights, 100, woodA, sampler, true, woodN, woodM, woodR);
+		mat4 = new Material(XMFLOAT4(1, 1, 0, 1), shaderVariants, lights, 20, bronzeA, sampler, true, bronzeN, bronzeM, bronzeR);
+		mat3 = new Material(XMFLOAT4(1, 1, 1, 1), shaderVariants, lights, 512, paintA, sampler, true, paintN, paintM, paintR);
+		mat1 = new Material(XMFLOAT4(0, 1, 1, 1), shaderVariants, lights, 30, roughA, sampler, true, roughN, roughM, roughR);
+		mat5 = new Material(XMFLOAT4(1, 0, 1, 1), shaderVariants, lights, 400, floorA, sampler, true, floorN, floorM, floorR);
+		mat6 = new Material(XMFLOAT4(1, 0, 1, 1), shaderVariants, lights, 400, cobbleA, sampler, true, cobbleN, cobbleM, cobbleR);
+	}
+	mat7 = new Material(XMFLOAT4(1, 0, 1, 1), shaderVariants, lights, 100, texture2SRV, sampler, false, nullptr, nullptr, nullptr);
 
 	//create mesh for sky
-	Mesh* skyMesh = new Mesh(GetFullPathTo("../../models/cube.obj").c_str(), device);
+	Mesh* skyMesh = new Mesh(GetFullPathTo("../../models/cube.obj").c_str(), backend);
 
 	//initialize sky object, vertex, and pixel shaders
-	skyObj = new Sky(skyMesh, sampler.Get(), device.Get());
-	skyObj->simpleVertex = new SimpleVertexShader(device.Get(), context.Get(), GetFullPathTo_Wide(L"vertexShaderSky.cso").c_str());
-	skyObj->simplePixel = new SimplePixelShader(device.Get(), context.Get(), GetFullPathTo_Wide(L"pixelShaderSky.cso").c_str());
+	skyObj = new Sky(skyMesh, sampler.Get(), pipelineStates);
+	skyObj->simpleVertex = new SimpleVertexShader(backend, GetFullPathTo_Wide(L"vertexShaderSky.cso").c_str());
+	skyObj->simplePixel = new SimplePixelShader(backend, GetFullPathTo_Wide(L"pixelShaderSky.cso").c_str());
+
+	//offscreen scene target and the fullscreen triangle that upscales it
+	dynamicResolution = new DynamicResolution(backend, pipelineStates,
+		new SimpleVertexShader(backend, GetFullPathTo_Wide(L"vertexShaderUpscale.cso").c_str()),
+		new SimplePixelShader(backend, GetFullPathTo_Wide(L"pixelShaderUpscale.cso").c_str()));
+	dynamicResolution->Resize(width, height);
 	
 	//import texture for skybox
-	CreateDDSTextureFromFile(device.Get(), GetFullPathTo_Wide(L"../../models/textures/SunnyCubeMap.dds").c_str(), nullptr, skyObj->shaderView.GetAddressOf());
-
-
-	//initialize objects with models
-	obj2 = new Mesh(GetFullPathTo("../../models/cube.obj").c_str(), device);
-	obj3 = new Mesh(GetFullPathTo("../../models/cube.obj").c_str(), device);
-
-	obj1 = new Mesh(GetFullPathTo("../../models/cube.obj").c_str(), device);
-	obj4 = new Mesh(GetFullPathTo("../../models/cylinder.obj").c_str(), device);
-	obj5 = new Mesh(GetFullPathTo("../../models/cube.obj").c_str(), device);
-	obj6 = new Mesh(GetFullPathTo("../../models/cube.obj").c_str(), device);
+	backend->LoadTexture(GetFullPathTo_Wide(L"../../models/textures/SunnyCubeMap.dds").c_str(), skyObj->shaderView.GetAddressOf(), true);
+
+
+	//every compact mesh shares one vertex and index buffer, so draws of different
+	//meshes keep the same input assembler bindings
+	geometryArena = new GeometryArena(backend, sizeof(CompactVertex), DXGI_FORMAT_R16_UINT, 32768, 98304);
+
+	//initialize objects with models, in the compact vertex format.  the software
+	//renderer draws from the meshes' source data, and the terrain batch is built
+	//from obj1's, so only those keep it after upload
+	obj2 = new Mesh(GetFullPathTo("../../models/cube.obj").c_str(), backend, MESH_VERTEX_COMPACT, geometryArena, softwareRendering);
+	obj3 = new Mesh(GetFullPathTo("../../models/cube.obj").c_str(), backend, MESH_VERTEX_COMPACT, geometryArena, softwareRendering);
+
+	obj1 = new Mesh(GetFullPathTo("../../models/cube.obj").c_str(), backend, MESH_VERTEX_COMPACT, geometryArena, true);
+	obj4 = new Mesh(GetFullPathTo("../../models/cylinder.obj").c_str(), backend, MESH_VERTEX_COMPACT, geometryArena, softwareRendering);
+	obj5 = new Mesh(GetFullPathTo("../../models/cube.obj").c_str(), backend, MESH_VERTEX_COMPACT, geometryArena, softwareRendering);
+	obj6 = new Mesh(GetFullPathTo("../../models/cube.obj").c_str(), backend, MESH_VERTEX_COMPACT, geometryArena, softwareRendering);
+
+	//what the compact vertices and 16 bit indices saved, and what they cost in precision
+	const char* meshNames[] = { "cube", "cylinder" };
+	Mesh* reportMeshes[] = { obj1, obj4 };
+	for (int i = 0; i < 2; i++) {
+		const MeshVertexStats& meshStats = reportMeshes[i]->GetVertexStats();
+		if (meshStats.vertexCount == 0)
+			continue;
+		printf("Mesh %s: %u verts, %u indices, %u bytes (%u as full floats, %.0f%% saved)\n",
+			meshNames[i], meshStats.vertexCount, meshStats.indexCount,
+			meshStats.vertexBytes + meshStats.indexBytes, meshStats.fullBytes,
+			100.0 - 100.0 * (meshStats.vertexBytes + meshStats.indexBytes) / (double)meshStats.fullBytes);
+		printf("  max error: position %g, normal %.3f deg, tangent %.3f deg, uv %g\n",
+			meshStats.maxPositionError, meshStats.maxNormalDegrees, meshStats.maxTangentDegrees, meshStats.maxUVError);
+	}
 
 
 	
@@ -377,6 +562,8 @@ void Game::CreateBasicGeometry()
 				m[i]->isActive = true;
 			}
 			m[i]->GetTransform()->SetScale(1, 1 * rand() % 2 + 1, 1);
+			//the tall ones hide the track behind them
+			m[i]->isOccluder = m[i]->GetTransform()->GetScale().y >= 2;
 			entityPos.push_back(m[i]);
 		}
 		count++;
@@ -409,9 +596,58 @@ void Game::CreateBasicGeometry()
 		grounds[i][4]->GetTransform()->SetScale(4, 1.75f, 15);
 		grounds[i][5]->GetTransform()->SetScale(4, 1.75f, 15);
 
+		//the walls block the view down the track
+		for (int w = 2; w <= 5; w++) {
+			grounds[i][w]->isOccluder = true;
+		}
+
 		
 		
 	}
+
+	//merge the first segment's drawn parts by material, in the space of its ground piece.
+	//every segment has the same layout, so they all share the batch's meshes, each with
+	//one entity per material (after its parts) that follows its ground piece around
+	terrainBatch = new StaticBatch();
+	XMFLOAT3 segmentOrigin = grounds[0][0]->GetTransform()->GetPosition();
+	XMFLOAT4X4 segmentWorld;
+	XMStoreFloat4x4(&segmentWorld, XMMatrixTranslation(segmentOrigin.x, segmentOrigin.y, segmentOrigin.z));
+	terrainPartOffsets.clear();
+	for (unsigned int p = 0; p < terrainDrawnParts; p++) {
+		terrainBatch->Add(grounds[0][p], segmentWorld);
+
+		XMFLOAT3 partPos = grounds[0][p]->GetTransform()->GetPosition();
+		terrainPartOffsets.push_back(XMFLOAT3(partPos.x - segmentOrigin.x, partPos.y - segmentOrigin.y, partPos.z - segmentOrigin.z));
+	}
+	terrainBatch->Build(backend, MESH_VERTEX_COMPACT, geometryArena, softwareRendering);
+	if (!softwareRendering)
+		obj1->ReleaseSource();
+
+	for (auto& g : grounds) {
+		for (const StaticBatchGroup& group : terrainBatch->GetGroups()) {
+			gameEntity* batched = new gameEntity(group.mesh, group.material, true);
+			batched->isActive = false;
+			g.push_back(batched);
+		}
+	}
+
+	//what batching saves in draws, and what its buffers cost
+	const StaticBatchStats& batchStats = terrainBatch->GetStats();
+	printf("Terrain batch: %u draws per segment down to %u, %u verts, %u indices in %.3f ms\n",
+		batchStats.parts, batchStats.groups, batchStats.vertexCount, batchStats.indexCount, batchStats.buildMilliseconds);
+	printf("  %u bytes shared by %u segments (%u for the parts' mesh), max position error %g\n",
+		batchStats.batchBytes, (unsigned int)grounds.size(), batchStats.sourceBytes, batchStats.maxPositionError);
+
+	//how full the geometry arena is, and how broken up its free space
+	GeometryArenaStats arenaStats = geometryArena->GetStats();
+	printf("Geometry arena: %u meshes (%u didn't fit), %.1f KB\n",
+		arenaStats.allocations, arenaStats.failedAllocations, arenaStats.bytes / 1024.0);
+	printf("  vertices %u of %u (%.1f%%), %u free ranges, %.0f%% fragmented\n",
+		arenaStats.verticesUsed, arenaStats.vertexCapacity, 100.0 * arenaStats.verticesUsed / arenaStats.vertexCapacity,
+		arenaStats.vertexFreeRanges, 100.0 * arenaStats.vertexFragmentation);
+	printf("  indices %u of %u (%.1f%%), %u free ranges, %.0f%% fragmented\n",
+		arenaStats.indicesUsed, arenaStats.indexCapacity, 100.0 * arenaStats.indicesUsed / arenaStats.indexCapacity,
+		arenaStats.indexFreeRanges, 100.0 * arenaStats.indexFragmentation);
 	
 
 	//g1->GetTransform()->SetScale(5, 0.1f, 50);
@@ -441,6 +677,9 @@ void Game::OnResize()
 	// Handle base-level DX resize stuff
 	DXCore::OnResize();
 	cam->UpdateProjectionMatrix((float)this->width/this->height);
+	dynamicResolution->Resize(width, height);
+	if (softwareRenderer)
+		softwareRenderer->Resize(width, height);
 }
 
 // --------------------------------------------------------
@@ -449,7 +688,7 @@ void Game::OnResize()
 void Game::Update(float deltaTime, float totalTime)
 {
 	// Quit if the escape key is pressed
-	if (GetAsyncKeyState(VK_ESCAPE))
+	if (IsKeyDown(KEY_ESCAPE))
 		Quit();
 
 
@@ -458,7 +697,7 @@ void Game::Update(float deltaTime, float totalTime)
 	scaleSize += deltaTime;
 	
 	if (ready) {
-		cam->Update(deltaTime, hWnd, player->GetTransform());
+		cam->Update(deltaTime, player->GetTransform());
 
 	}
 
@@ -471,28 +710,9 @@ void Game::Update(float deltaTime, float totalTime)
 		int tempCount = 0;
 		for (int i = 0; i < grounds.size(); i++) {
 			grounds[i][0]->GetTransform()->MoveAbsolute(0, 0, -2.5 * deltaTime * speedMult);
-			grounds[i][1]->GetTransform()->MoveAbsolute(0, 0, -2.5 * deltaTime * speedMult);
-			grounds[i][2]->GetTransform()->MoveAbsolute(0, 0, -2.5 * deltaTime * speedMult);
-			grounds[i][3]->GetTransform()->MoveAbsolute(0, 0, -2.5 * deltaTime * speedMult);
-			grounds[i][4]->GetTransform()->MoveAbsolute(0, 0, -2.5 * deltaTime * speedMult);
-			grounds[i][5]->GetTransform()->MoveAbsolute(0, 0, -2.5 * deltaTime * speedMult);
 			if (grounds[i][0]->GetTransform()->GetPosition().z < -30) {
 				XMFLOAT3 p = grounds[i][0]->GetTransform()->GetPosition();
 				grounds[i][0]->GetTransform()->SetPosition(p.x, p.y, grounds.back()[0]->GetTransform()->GetPosition().z + 30);
-				p = grounds[i][1]->GetTransform()->GetPosition();
-				grounds[i][1]->GetTransform()->SetPosition(p.x, p.y, grounds.back()[1]->GetTransform()->GetPosition().z + 30);
-				p = grounds[i][2]->GetTransform()->GetPosition();
-				grounds[i][2]->GetTransform()->SetPosition(p.x, p.y, grounds.back()[2]->GetTransform()->GetPosition().z + 30);
-				p = grounds[i][3]->GetTransform()->GetPosition();
-				
-
-				grounds[i][3]->GetTransform()->SetPosition(p.x, p.y, grounds.back()[3]->GetTransform()->GetPosition().z + 30+15);
-				
-				p = grounds[i][4]->GetTransform()->GetPosition();
-				
-				grounds[i][4]->GetTransform()->SetPosition(p.x, p.y, grounds.back()[4]->GetTransform()->GetPosition().z + 30);
-				p = grounds[i][5]->GetTransform()->GetPosition();
-				grounds[i][5]->GetTransform()->SetPosition(p.x, p.y, grounds.back()[5]->GetTransform()->GetPosition().z + 30+15);
 
 				grounds.push_back(grounds[i]);
 				grounds[i][0]->isActive = false;
@@ -515,6 +735,20 @@ void Game::Update(float deltaTime, float totalTime)
 			}
 		}
 
+		//the parts (the terrain's occluders) keep the layout the batch was built from,
+		//around their segment's ground piece, and so do the batched entities
+		for (auto& g : grounds) {
+			XMFLOAT3 origin = g[0]->GetTransform()->GetPosition();
+			for (size_t p = 1; p < terrainPartOffsets.size(); p++) {
+				const XMFLOAT3& offset = terrainPartOffsets[p];
+				g[p]->GetTransform()->SetPosition(origin.x + offset.x, origin.y + offset.y, origin.z + offset.z);
+			}
+			for (size_t b = terrainParts; b < g.size(); b++) {
+				g[b]->GetTransform()->SetPosition(origin.x, origin.y, origin.z);
+				g[b]->isActive = g[0]->isActive;
+			}
+		}
+
 		//obstancle movment code for all columns
 		for (auto& c : allCols) {
 			for (int j = 0; j < c.size(); j++) {
@@ -559,12 +793,12 @@ void Game::Update(float deltaTime, float totalTime)
 		//score code
 		score += 100 * deltaTime;
 		benchMark += deltaTime;
-		light.ambientColor.y -= 0.001f*deltaTime;
+		lightList.GetDirectional(0).ambientColor.y -= 0.001f*deltaTime;
 		
 		if (benchMark > 5.0f) { speedMult *= 1.15f; benchMark = 0.0f; }
 	}
 	else {
-		if (GetAsyncKeyState('R') & 0x8000) {
+		if (IsKeyDown('R')) {
 			//restarts the game
 			entities.clear();
 			col3.clear();
@@ -574,6 +808,8 @@ void Game::Update(float deltaTime, float totalTime)
 			delete obj4;
 			delete obj5;
 			delete obj6;
+			delete terrainBatch;
+			delete geometryArena;
 
 			delete g1;
 			delete g2;
@@ -593,16 +829,23 @@ void Game::Update(float deltaTime, float totalTime)
 
 			delete cam;
 
-			delete vertexShader;
-			delete pixelShader;
-
-			delete vertexShaderNormal;
-			delete pixelShaderNormal;
+			delete shaderVariants;
 
 			delete skyObj;
+			delete dynamicResolution;
+
+			delete lightClusters;
+			delete framePipeline;
+			delete materialAtlas;
+			if (softwareRenderer)
+				softwareRenderer->ClearMaterials();
+			delete environment;
+			delete stateCache;
+			delete pipelineStates;
+			delete cbRing;
 
-			m_font.reset();
-			m_spriteBatch.reset();
+			//the queue's ids point at what was just deleted
+			renderQueue.Reset();
 
 
 			entities.clear();
@@ -623,6 +866,52 @@ void Game::Update(float deltaTime, float totalTime)
 
 
 	
+}
+
+// --------------------------------------------------------
+// Fills clusterLights for this frame: rows of lane lights
+// along the inside of each wall segment, and a glow above
+// every active obstacle
+// --------------------------------------------------------
+void Game::GatherClusterLights()
+{
+	clusterLights.clear();
+
+	//lane lights move with their ground segment, 12 rows of 2 per 30 unit segment
+	for (auto& g : grounds) {
+		if (!g[0]->isActive) {
+			continue;
+		}
+
+		float segmentZ = g[0]->GetTransform()->GetPosition().z;
+		for (int row = 0; row < 12; row++) {
+			ClusterLight l;
+			l.position = XMFLOAT3(-1.3f, 1.5f, segmentZ - 13.75f + row * 2.5f);
+			l.range = 3.0f;
+			l.color = XMFLOAT3(0.2f, 0.6f, 1.0f);
+			l.intensity = 1.5f;
+			clusterLights.push_back(l);
+
+			l.position.x = 3.3f;
+			l.color = XMFLOAT3(1.0f, 0.3f, 0.8f);
+			clusterLights.push_back(l);
+		}
+	}
+
+	//obstacle glows sit just above the obstacle
+	for (auto& c : allCols) {
+		for (auto& m : c) {
+			if (m->isActive) {
+				XMFLOAT3 p = m->GetTransform()->GetPosition();
+				ClusterLight l;
+				l.position = XMFLOAT3(p.x, p.y + m->GetTransform()->GetScale().y * 0.5f + 0.5f, p.z);
+				l.range = 2.5f;
+				l.color = XMFLOAT3(1.0f, 0.5f, 0.1f);
+				l.intensity = 2.0f;
+				clusterLights.push_back(l);
+			}
+		}
+	}
 }
 
 // --------------------------------------------------------
@@ -631,19 +920,21 @@ void Game::Update(float deltaTime, float totalTime)
 void Game::Draw(float deltaTime, float totalTime)
 {
 	// Background color (Cornflower Blue in this case) for clearing
-	const float color[4] = { 0.4f, 0.6f, 0.75f, 0.0f };
+	//linear, since the back buffer view is srgb (the old 0.4, 0.6, 0.75)
+	const float color[4] = { 0.133f, 0.325f, 0.531f, 0.0f };
 
 
 
+	//last frame's time picks this frame's scale, and the scene is drawn into
+	//that much of the offscreen target
+	governor.AddFrame(deltaTime * 1000.0f);
+	dynamicResolution->SetScale(governor.GetResolutionScale());
+	dynamicResolution->Begin(backend->GetBackBuffer(), backend->GetDepthBuffer());
+
 	// Clear the render target and depth buffer (erases what's on the screen)
 	//  - Do this ONCE PER FRAME
 	//  - At the beginning of Draw (before drawing *anything*)
-	context->ClearRenderTargetView(backBufferRTV.Get(), color);
-	context->ClearDepthStencilView(
-		depthStencilView.Get(),
-		D3D11_CLEAR_DEPTH | D3D11_CLEAR_STENCIL,
-		1.0f,
-		0);
+	backend->Clear(color, 1.0f);
 
 
 	// Set the vertex and pixel shaders to use for the next Draw() command
@@ -661,104 +952,121 @@ void Game::Draw(float deltaTime, float totalTime)
 	// - However, this isn't always the case (but might be for this course)
 	//context->IASetInputLayout(inputLayout.Get());
 
-	//initialize stride and offset
-	UINT stride = sizeof(Vertex);
-	UINT offset = 0;
-
-	//draw sky
-	skyObj->Draw(context, cam);
-	//loop through entities and call draw functions after mapping constant buffer and setting struct values
-	for (auto& m : entities)
+	//start a new frame of state cache stats and constant uploads
+	stateCache->BeginFrame();
+	cbRing->BeginFrame();
+	stateCache->IASetPrimitiveTopology(RENDER_TOPOLOGY_TRIANGLE_LIST);
+
+	//the lights and camera position are the same for every entity, so set them once per frame
+	//the spec exponent is still set per draw, over the top of this
+	MaterialPSExternalData frameData;
+	memset(&frameData, 0, sizeof(frameData));
+	lightList.Apply(&frameData);
+	frameData.cameraPos = cam->GetTransform()->GetPosition();
+
+	for (auto& ps : shaderVariants->GetPixelShaders())
+		ps->SetBufferData("ExternalData", frameData);
+
+	//bin this frame's lane lights and obstacle glows into the camera's clusters
+	GatherClusterLights();
+	//the clusters tile the pixels actually drawn, at the scaled size
+	lightClusters->Build(cam->getView(), cam->getProj(), cam->GetNearClip(), cam->GetFarClip(),
+		dynamicResolution->GetRenderWidth(), dynamicResolution->GetRenderHeight(), clusterLights.data(), (unsigned int)clusterLights.size());
+	lightClusters->Upload();
+
+	MaterialPSClusterData clusterData;
+	memset(&clusterData, 0, sizeof(clusterData));
+	clusterData.clusterParams = lightClusters->GetParams();
+
+	//the views and samplers are only staged here, each variant binds its
+	//whole table when an entity using it flushes before drawing
+	for (auto& ps : shaderVariants->GetPixelShaders())
 	{
-		//setting the pixel shader lights
-		pixelShader->SetData("light", &light, sizeof(DirectionalLight));
-		pixelShader->SetData("light2", &light2, sizeof(DirectionalLight));
-		pixelShader->SetData("light3", &light3, sizeof(DirectionalLight));
-		pixelShader->SetData("point1", &point1, sizeof(PointLight));
-		pixelShader->SetData("cameraPos", &cam->GetTransform()->GetPosition(), sizeof(XMFLOAT3));
-		pixelShader->SetData("specExponent", &m->mat->specExponent, sizeof(float));
-
-		pixelShaderNormal->SetData("light", &light, sizeof(DirectionalLight));
-		pixelShaderNormal->SetData("light2", &light2, sizeof(DirectionalLight));
-		pixelShaderNormal->SetData("light3", &light3, sizeof(DirectionalLight));
-		pixelShaderNormal->SetData("point1", &point1, sizeof(PointLight));
-		pixelShaderNormal->SetData("cameraPos", &cam->GetTransform()->GetPosition(), sizeof(XMFLOAT3));
-		pixelShaderNormal->SetData("specExponent", &m->mat->specExponent, sizeof(float));
-
-		pixelShaderNormal->CopyAllBufferData();
-
-		pixelShader->CopyAllBufferData();
-		m->draw(context, stride, offset, cam);
+		//only the clustered variants have ClusterData, and each of those must take all three buffers
+		if (ps->GetBufferHandle("ClusterData") >= 0)
+		{
+			bool bound = ps->SetBufferData("ClusterData", clusterData);
+			bound &= ps->SetShaderResourceView("ClusterLights", lightClusters->GetLightBuffer());
+			bound &= ps->SetShaderResourceView("ClusterLightIndices", lightClusters->GetIndexBuffer());
+			bound &= ps->SetShaderResourceView("ClusterGrid", lightClusters->GetGridBuffer());
+			assert(bound && "a clustered MaterialPS variant is missing its cluster data or buffers");
+		}
 
+		if (environment) {
+			ps->SetShaderResourceView("IrradianceMap", environment->GetIrradianceSRV().Get());
+			ps->SetShaderResourceView("SpecularMap", environment->GetSpecularSRV().Get());
+			ps->SetShaderResourceView("BrdfLut", environment->GetBrdfSRV().Get());
+			ps->SetSamplerState("EnvironmentSampler", environment->GetSampler().Get());
+		}
 	}
 
-	//rendering for the obstacles
+	//rasterize the occluders into the cpu depth buffer
+	occlusion.BeginFrame(cam->getView(), cam->getProj());
 	for (auto& c : allCols) {
 		for (auto& m : c) {
-			if (m->isActive) {
-				pixelShader->SetData("light", &light, sizeof(DirectionalLight));
-				pixelShader->SetData("light2", &light2, sizeof(DirectionalLight));
-				pixelShader->SetData("light3", &light3, sizeof(DirectionalLight));
-				pixelShader->SetData("point1", &point1, sizeof(PointLight));
-				pixelShader->SetData("cameraPos", &cam->GetTransform()->GetPosition(), sizeof(XMFLOAT3));
-				pixelShader->SetData("specExponent", &m->mat->specExponent, sizeof(float));
-
-				pixelShaderNormal->SetData("light", &light, sizeof(DirectionalLight));
-				pixelShaderNormal->SetData("light2", &light2, sizeof(DirectionalLight));
-				pixelShaderNormal->SetData("light3", &light3, sizeof(DirectionalLight));
-				pixelShaderNormal->SetData("point1", &point1, sizeof(PointLight));
-				pixelShaderNormal->SetData("cameraPos", &cam->GetTransform()->GetPosition(), sizeof(XMFLOAT3));
-				pixelShaderNormal->SetData("specExponent", &m->mat->specExponent, sizeof(float));
-
-				pixelShaderNormal->CopyAllBufferData();
-
-				pixelShader->CopyAllBufferData();
-				m->draw(context, stride, offset, cam);
+			if (m->isActive && m->isOccluder) {
+				occlusion.RenderOccluder(m);
 			}
-			
 		}
 	}
 
-	//rendering for the terrain
 	for (auto& g : grounds) {
 		for (auto& s : g) {
-			if (s->isActive) {
-				pixelShader->SetData("light", &light, sizeof(DirectionalLight));
-				pixelShader->SetData("light2", &light2, sizeof(DirectionalLight));
-				pixelShader->SetData("light3", &light3, sizeof(DirectionalLight));
-				pixelShader->SetData("point1", &point1, sizeof(PointLight));
-				pixelShader->SetData("cameraPos", &cam->GetTransform()->GetPosition(), sizeof(XMFLOAT3));
-				pixelShader->SetData("specExponent", &s->mat->specExponent, sizeof(float));
-
-				pixelShaderNormal->SetData("light", &light, sizeof(DirectionalLight));
-				pixelShaderNormal->SetData("light2", &light2, sizeof(DirectionalLight));
-				pixelShaderNormal->SetData("light3", &light3, sizeof(DirectionalLight));
-				pixelShaderNormal->SetData("point1", &point1, sizeof(PointLight));
-				pixelShaderNormal->SetData("cameraPos", &cam->GetTransform()->GetPosition(), sizeof(XMFLOAT3));
-				pixelShaderNormal->SetData("specExponent", &s->mat->specExponent, sizeof(float));
-
-				pixelShaderNormal->CopyAllBufferData();
-
-				pixelShader->CopyAllBufferData();
-				s->draw(context, stride, offset, cam);
+			if (s->isActive && s->isOccluder) {
+				occlusion.RenderOccluder(s);
 			}
 		}
-		
 	}
-	
+
+	//queue the entities, the active obstacles and the active terrain, skipping anything hidden behind the occluders
+	//or past the draw distance, which the governor pulls in when it's out of resolution to drop
+	XMFLOAT3 eye = cam->GetTransform()->GetPosition();
+	float drawDistance = maxDrawDistance * governor.GetLodScale();
+	renderQueue.Clear();
+	for (auto& m : entities)
+	{
+		if (occlusion.IsVisible(m)) {
+			renderQueue.Submit(m, cam);
+		}
+	}
+
+	for (auto& c : allCols) {
+		for (auto& m : c) {
+			if (m->isActive && WithinDrawDistance(m, eye, drawDistance) && occlusion.IsVisible(m)) {
+				renderQueue.Submit(m, cam);
+			}
+		}
+	}
+
+	//the terrain draws through each segment's batched entities, the parts are only occluders
+	for (auto& g : grounds) {
+		for (size_t b = terrainParts; b < g.size(); b++) {
+			if (g[b]->isActive && WithinDrawDistance(g[b], eye, drawDistance) && occlusion.IsVisible(g[b])) {
+				renderQueue.Submit(g[b], cam);
+			}
+		}
+	}
+
+	//sort by shader, material and mesh, front to back, then draw in that order,
+	//depth first, then shading only the visible pixels, then the sky behind it all
+	renderQueue.Sort();
+	framePipeline->Execute(stateCache, renderQueue, cam, skyObj);
+
+	//the cpu renderer draws the same queue and lights, with the clear color for the sky
+	if (softwareRenderer)
+		softwareRenderer->Render(renderQueue, cam, frameData, lightList.GetDirectionalCount(), lightList.GetPointCount(), clusterLights, color);
+
+	//stretch the scene over the back buffer, the text is drawn at full resolution over it
+	dynamicResolution->End(stateCache, backend->GetBackBuffer(), backend->GetDepthBuffer());
+
 	//creating and rendering the on screen text
-	m_spriteBatch->Begin();
-	std::string str = std::to_string(score);
-	char vOut[17];
-	_gcvt_s(vOut, sizeof(vOut), score, 8);
+	backend->BeginText();
 	wchar_t v[17];
-	mbstowcs_s(NULL, v, sizeof(v) / 2, vOut, sizeof(vOut));
+	swprintf(v, 17, L"%.8g", score);
 	const wchar_t* output = v;
 
-	char vOut2[17];
-	_gcvt_s(vOut2, sizeof(vOut2), highScore, 8);
 	wchar_t v2[17];
-	mbstowcs_s(NULL, v2, sizeof(v2) / 2, vOut2, sizeof(vOut2));
+	swprintf(v2, 17, L"%.8g", highScore);
 	const wchar_t* highScoreOutput = v2;
 	
 	const wchar_t* gameOver = L"You Died\nPress R to retry";
@@ -766,26 +1074,31 @@ void Game::Draw(float deltaTime, float totalTime)
 	const wchar_t* highScoreText = L"HighScore: ";
 	
 
-	DirectX::SimpleMath::Vector2 origin = m_font->MeasureString(output) / 2.f;
+	const float white[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+	const float lightYellow[4] = { 1.0f, 1.0f, 0.878f, 1.0f };
+	const float red[4] = { 1.0f, 0.0f, 0.0f, 1.0f };
+
+	float originX, originY;
+	backend->MeasureString(output, &originX, &originY);
+	originX /= 2.0f;
+	originY /= 2.0f;
 
-	m_font->DrawString(m_spriteBatch.get(), output,
-		DirectX::SimpleMath::Vector2::Vector2(320,50), Colors::White, 0.f, origin);
+	backend->DrawString(output, 320, 50, white, originX, originY);
 
-	m_font->DrawString(m_spriteBatch.get(), scoreText,
-		DirectX::SimpleMath::Vector2::Vector2(150, 50), Colors::White, 0.f, origin);
+	backend->DrawString(scoreText, 150, 50, white, originX, originY);
 	
-	m_font->DrawString(m_spriteBatch.get(), highScoreText,
-		DirectX::SimpleMath::Vector2::Vector2(900, 50), Colors::LightYellow, 0.f, origin);
+	backend->DrawString(highScoreText, 900, 50, lightYellow, originX, originY);
 
-	m_font->DrawString(m_spriteBatch.get(), highScoreOutput,
-		DirectX::SimpleMath::Vector2::Vector2(1180, 50), Colors::LightYellow, 0.f, origin);
+	backend->DrawString(highScoreOutput, 1180, 50, lightYellow, originX, originY);
 
 	if (playerDead) {
-		m_font->DrawString(m_spriteBatch.get(), gameOver,
-			DirectX::SimpleMath::Vector2::Vector2(200, 500), Colors::Red, 0.f, origin);
+		backend->DrawString(gameOver, 200, 500, red, originX, originY);
 	}
 
-	m_spriteBatch->End();
+	backend->EndText();
+
+	//the text binds its own shaders, buffers and states
+	stateCache->Invalidate();
 
 	
 
@@ -799,11 +1112,25 @@ void Game::Draw(float deltaTime, float totalTime)
 	// Present the back buffer to the user
 	//  - Puts the final frame we're drawing into the window so the user can see it
 	//  - Do this exactly ONCE PER FRAME (always at the very end of the frame)
-	swapChain->Present(0, 0);
-
-	// Due to the usage of a more sophisticated swap chain,
-	// the render target must be re-bound after every call to Present()
-	context->OMSetRenderTargets(1, backBufferRTV.GetAddressOf(), depthStencilView.Get());
+	//  - The backend re-binds the render target afterwards, as the swap chain requires
+	backend->Present();
 
 	
+}
+
+//last frame's draws and view and sampler binds in the title bar: calls that
+//reached the backend, the slots they covered, and the slots the state cache dropped,
+//then the governor's resolution and lod scales
+std::string Game::GetTitleBarStats()
+{
+	const StateCacheStats& stats = stateCache->GetStats();
+	return "    Draws: " + std::to_string(stats.draws) +
+		"    SRV calls: " + std::to_string(stats.forwarded[STATE_CALL_SHADER_RESOURCE]) +
+		" (" + std::to_string(stats.forwardedSlots[STATE_CALL_SHADER_RESOURCE]) + " slots, " +
+		std::to_string(stats.filtered[STATE_CALL_SHADER_RESOURCE]) + " skipped)" +
+		"    Sampler calls: " + std::to_string(stats.forwarded[STATE_CALL_SAMPLER]) +
+		" (" + std::to_string(stats.forwardedSlots[STATE_CALL_SAMPLER]) + " slots, " +
+		std::to_string(stats.filtered[STATE_CALL_SAMPLER]) + " skipped)" +
+		"    Resolution: " + std::to_string((int)(governor.GetResolutionScale() * 100 + 0.5f)) + "%" +
+		"    LOD: " + std::to_string((int)(governor.GetLodScale() * 100 + 0.5f)) + "%";
 }
\ No newline at end of file
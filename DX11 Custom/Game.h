@@ -2,20 +2,27 @@
 
 #include "DXCore.h"
 #include <DirectXMath.h>
-#include <wrl/client.h> // Used for ComPtr - a smart pointer for COM objects
 #include "Mesh.h"
 #include "gameEntity.h"
 #include <vector>
 #include "Camera.h"
 #include "Material.h"
 #include "SimpleShader.h"
-#include "Lights.h"
-#include "PointLight.h"
-#include "WICTextureLoader.h"
+#include "LightList.h"
 #include "Sky.h"
-#include "DDSTextureLoader.h"
-#include "SpriteFont.h"
-#include "SimpleMath.h"
+#include "RenderQueue.h"
+#include "StateCache.h"
+#include "ConstantBufferRing.h"
+#include "ShaderVariantCache.h"
+#include "OcclusionCuller.h"
+#include "LightClusters.h"
+#include "FramePipeline.h"
+#include "PipelineState.h"
+#include "EnvironmentLighting.h"
+#include "StaticBatch.h"
+#include "FrameGovernor.h"
+#include "DynamicResolution.h"
+#include "SoftwareRenderer.h"
 
 class Game 
 	: public DXCore
@@ -31,6 +38,10 @@ public:
 	void OnResize();
 	void Update(float deltaTime, float totalTime);
 	void Draw(float deltaTime, float totalTime);
+	std::string GetTitleBarStats();
+
+	//draws every frame on the cpu too, so headless runs still make images - call before Init()
+	void SetSoftwareRendering(bool enabled) { softwareRendering = enabled; }
 
 	float angle;
 	float scaleSize;
@@ -54,46 +65,67 @@ private:
 	// Initialization helper methods - feel free to customize, combine, etc.
 	void LoadShaders(); 
 	void CreateBasicGeometry();
+	void GatherClusterLights();
 
-	
-	// Note the usage of ComPtr below
-	//  - This is a smart pointer for objects that abide by the
-	//    Component Object Model, which DirectX objects do
-	//  - More info here: https://github.com/Microsoft/DirectXTK/wiki/ComPtr
 
-	// Buffers to hold actual geometry data
-	Microsoft::WRL::ComPtr<ID3D11Buffer> vertexBuffer;
-	Microsoft::WRL::ComPtr<ID3D11Buffer> indexBuffer;
+	//textures and the sampler are render backend handles, which release themselves
+	RenderRef<RenderTexture> textureSRV;
+	RenderRef<RenderTexture> texture2SRV;
+	RenderRef<RenderTexture> normalSRV;
 
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> textureSRV;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> texture2SRV;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> normalSRV;
+	RenderRef<RenderTexture> cobbleA, cobbleN, cobbleR, cobbleM;
+	RenderRef<RenderTexture> floorA, floorN, floorR, floorM;
+	RenderRef<RenderTexture> paintA, paintN, paintR, paintM;
+	RenderRef<RenderTexture> scratchedA, scratchedN, scratchedR, scratchedM;
+	RenderRef<RenderTexture> bronzeA, bronzeN, bronzeR, bronzeM;
+	RenderRef<RenderTexture> roughA, roughN, roughR, roughM;
+	RenderRef<RenderTexture> woodA, woodN, woodR, woodM;
 
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> cobbleA, cobbleN, cobbleR, cobbleM;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> floorA, floorN, floorR, floorM;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> paintA, paintN, paintR, paintM;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> scratchedA, scratchedN, scratchedR, scratchedM;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> bronzeA, bronzeN, bronzeR, bronzeM;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> roughA, roughN, roughR, roughM;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> woodA, woodN, woodR, woodM;
+	RenderRef<RenderSamplerState> sampler;
 
-	Microsoft::WRL::ComPtr<ID3D11SamplerState> sampler;
+	//texture arrays holding the pbr materials' maps, null if it couldn't be built
+	MaterialAtlas* materialAtlas;
 
-	// Shaders and shader-related constructs
-	//Microsoft::WRL::ComPtr<ID3D11PixelShader> pixelShader;
-//	Microsoft::WRL::ComPtr<ID3D11VertexShader> vertexShader;
-	SimplePixelShader* pixelShader;
-	SimpleVertexShader* vertexShader;
-	SimplePixelShader* pixelShaderNormal;
-	SimpleVertexShader* vertexShaderNormal;
+	//ambient light prefiltered from the sky cubemap, null if it couldn't be built
+	EnvironmentLighting* environment;
 
-	//Microsoft::WRL::ComPtr<ID3D11InputLayout> inputLayout;
+	// Shaders and shader-related constructs
+	//material shader variants, compiled per feature set on first use
+	ShaderVariantCache* shaderVariants;
 
 	Sky* skyObj;
 
+	//watches the frame times and picks the render scale and draw distance
+	FrameGovernor governor;
+
+	//the scene drawn offscreen at the governor's scale and stretched over the back buffer
+	DynamicResolution* dynamicResolution;
+
+	//the same queue drawn on the cpu, null unless software rendering is on
+	bool softwareRendering;
+	SoftwareRenderer* softwareRenderer;
+
 	//camera
 	Camera* cam;
 
+	//sorts each frame's draws by state and depth
+	RenderQueue renderQueue;
+
+	//depth prepass, opaque, sky and transparent passes over the queue
+	FramePipeline* framePipeline;
+
+	//cpu depth buffer of the walls and tall obstacles, tested before queueing
+	OcclusionCuller occlusion;
+
+	//drops redundant binds in the draw path
+	StateCache* stateCache;
+
+	//deduplicated pipeline state objects and shared input layouts
+	PipelineStateCache* pipelineStates;
+
+	//shared constant buffer that per-draw constants are suballocated from
+	ConstantBufferRing* cbRing;
+
 	//mesh objects
 	Mesh* obj1;
 	Mesh* obj2;
@@ -102,6 +134,17 @@ private:
 	Mesh* obj5;
 	Mesh* obj6;
 
+	//one vertex and index buffer that every compact mesh is suballocated from
+	GeometryArena* geometryArena;
+
+	//a terrain segment's ground, platform and walls merged into one mesh per
+	//material, shared by every segment
+	StaticBatch* terrainBatch;
+
+	//each drawn terrain part's offset from its segment's ground piece, as the batch was
+	//built - the parts are the occluders for the batch, so they keep to the same layout
+	std::vector<DirectX::XMFLOAT3> terrainPartOffsets;
+
 
 	//game entities
 	gameEntity* g1;
@@ -122,17 +165,12 @@ private:
 	Material* mat6;
 	Material* mat7;
 
-	//directional light objs
-	DirectionalLight light;
-	DirectionalLight light2;
-	DirectionalLight light3;
-
-	PointLight point1;
+	//directional and point lights, their counts pick the material shader variants
+	LightList lightList;
 
-	std::unique_ptr<DirectX::SpriteFont> m_font;
-
-	DirectX::SimpleMath::Vector2 m_fontPos;
-	std::unique_ptr<DirectX::SpriteBatch> m_spriteBatch;
+	//lane lights and obstacle glows, binned per frame so each pixel only lights with the ones near it
+	LightClusters* lightClusters;
+	std::vector<ClusterLight> clusterLights;
 
 	bool playerDead;
 
@@ -142,5 +180,7 @@ private:
 	float speedMult;
 
 	float highScore;
+
+	bool benchmarksDone;
 };
 
@@ -0,0 +1,166 @@
+#include "GeometryArena.h"
+
+GeometryFreeList::GeometryFreeList(unsigned int capacity)
+{
+	this->capacity = capacity;
+	used = 0;
+	if (capacity > 0)
+		ranges.push_back({ 0, capacity });
+}
+
+// --------------------------------------------------------
+// Best fit: an exact fit takes a range away entirely, and
+// otherwise the smallest range that fits is trimmed from
+// its front, keeping the large ranges whole for large meshes
+// --------------------------------------------------------
+bool GeometryFreeList::Allocate(unsigned int count, unsigned int* offset)
+{
+	size_t best = ranges.size();
+	for (size_t i = 0; i < ranges.size(); i++)
+	{
+		if (ranges[i].count >= count && (best == ranges.size() || ranges[i].count < ranges[best].count))
+		{
+			best = i;
+			if (ranges[i].count == count)
+				break;
+		}
+	}
+	if (best == ranges.size())
+		return false;
+
+	*offset = ranges[best].offset;
+	ranges[best].offset += count;
+	ranges[best].count -= count;
+	if (ranges[best].count == 0)
+		ranges.erase(ranges.begin() + best);
+
+	used += count;
+	return true;
+}
+
+void GeometryFreeList::Free(unsigned int offset, unsigned int count)
+{
+	if (count == 0)
+		return;
+
+	// First range after the freed one
+	size_t next = 0;
+	while (next < ranges.size() && ranges[next].offset < offset)
+		next++;
+
+	bool joinsPrevious = next > 0 && ranges[next - 1].offset + ranges[next - 1].count == offset;
+	bool joinsNext = next < ranges.size() && offset + count == ranges[next].offset;
+
+	if (joinsPrevious && joinsNext)
+	{
+		ranges[next - 1].count += count + ranges[next].count;
+		ranges.erase(ranges.begin() + next);
+	}
+	else if (joinsPrevious)
+	{
+		ranges[next - 1].count += count;
+	}
+	else if (joinsNext)
+	{
+		ranges[next].offset = offset;
+		ranges[next].count += count;
+	}
+	else
+	{
+		ranges.insert(ranges.begin() + next, { offset, count });
+	}
+
+	used -= count;
+}
+
+unsigned int GeometryFreeList::GetLargestFree()
+{
+	unsigned int largest = 0;
+	for (const Range& r : ranges)
+	{
+		if (r.count > largest)
+			largest = r.count;
+	}
+	return largest;
+}
+
+float GeometryFreeList::GetFragmentation()
+{
+	unsigned int freeCount = capacity - used;
+	if (freeCount == 0)
+		return 0;
+	return 1.0f - (float)GetLargestFree() / freeCount;
+}
+
+GeometryArena::GeometryArena(RenderBackend* backend, unsigned int stride, DXGI_FORMAT indexFormat, unsigned int vertexCapacity, unsigned int indexCapacity)
+	: vertices(vertexCapacity), indices(indexCapacity)
+{
+	this->backend = backend;
+	this->stride = stride;
+	this->indexFormat = indexFormat;
+	indexSize = indexFormat == DXGI_FORMAT_R16_UINT ? 2 : 4;
+	allocations = 0;
+	failedAllocations = 0;
+
+	BufferDesc desc = {};
+	desc.Usage = RENDER_USAGE_DEFAULT;
+	desc.ByteWidth = stride * vertexCapacity;
+	desc.BindFlags = RENDER_BIND_VERTEX_BUFFER;
+	backend->CreateBuffer(desc, 0, vertexBuffer.GetAddressOf());
+
+	desc.ByteWidth = indexSize * indexCapacity;
+	desc.BindFlags = RENDER_BIND_INDEX_BUFFER;
+	backend->CreateBuffer(desc, 0, indexBuffer.GetAddressOf());
+}
+
+GeometryArena::~GeometryArena()
+{
+}
+
+bool GeometryArena::Allocate(const void* vertexData, unsigned int vertexCount, const void* indexData, unsigned int indexCount, GeometryAllocation* allocation)
+{
+	if (!vertexBuffer || !indexBuffer || !vertices.Allocate(vertexCount, &allocation->baseVertex))
+	{
+		failedAllocations++;
+		return false;
+	}
+	if (!indices.Allocate(indexCount, &allocation->startIndex))
+	{
+		vertices.Free(allocation->baseVertex, vertexCount);
+		failedAllocations++;
+		return false;
+	}
+	allocation->vertexCount = vertexCount;
+	allocation->indexCount = indexCount;
+
+	backend->UpdateBuffer(vertexBuffer.Get(), allocation->baseVertex * stride, vertexData, vertexCount * stride);
+	backend->UpdateBuffer(indexBuffer.Get(), allocation->startIndex * indexSize, indexData, indexCount * indexSize);
+	allocations++;
+	return true;
+}
+
+void GeometryArena::Free(const GeometryAllocation& allocation)
+{
+	vertices.Free(allocation.baseVertex, allocation.vertexCount);
+	indices.Free(allocation.startIndex, allocation.indexCount);
+	allocations--;
+}
+
+GeometryArenaStats GeometryArena::GetStats()
+{
+	GeometryArenaStats stats;
+	stats.vertexCapacity = vertices.GetCapacity();
+	stats.verticesUsed = vertices.GetUsed();
+	stats.vertexFreeRanges = vertices.GetRangeCount();
+	stats.vertexFragmentation = vertices.GetFragmentation();
+
+	stats.indexCapacity = indices.GetCapacity();
+	stats.indicesUsed = indices.GetUsed();
+	stats.indexFreeRanges = indices.GetRangeCount();
+	stats.indexFragmentation = indices.GetFragmentation();
+
+	stats.allocations = allocations;
+	stats.failedAllocations = failedAllocations;
+	stats.bytes = stats.vertexCapacity * stride + stats.indexCapacity * indexSize;
+	return stats;
+}
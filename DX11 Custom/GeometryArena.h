@@ -0,0 +1,120 @@
+#pragma once
+#include <vector>
+#include "RenderBackend.h"
+
+// --------------------------------------------------------
+// Ranges of a fixed size pool, in elements.  Allocations
+// take the smallest free range they fit (best fit), and
+// freed ranges merge with their neighbours, so the list
+// only holds the gaps between live allocations.
+// --------------------------------------------------------
+class GeometryFreeList
+{
+public:
+	GeometryFreeList(unsigned int capacity = 0);
+
+	// False if no free range is large enough
+	bool Allocate(unsigned int count, unsigned int* offset);
+	void Free(unsigned int offset, unsigned int count);
+
+	unsigned int GetCapacity() { return capacity; }
+	unsigned int GetUsed() { return used; }
+	unsigned int GetRangeCount() { return (unsigned int)ranges.size(); }
+	unsigned int GetLargestFree();
+
+	// 0 when the free space is one range, towards 1 as it
+	// splits into ranges too small to use
+	float GetFragmentation();
+
+private:
+	struct Range
+	{
+		unsigned int offset;
+		unsigned int count;
+	};
+
+	// Sorted by offset, never adjacent
+	std::vector<Range> ranges;
+	unsigned int capacity;
+	unsigned int used;
+};
+
+// --------------------------------------------------------
+// Where a mesh sits in the arena: what DrawIndexed needs as
+// its start index and base vertex, and the counts to free
+// --------------------------------------------------------
+struct GeometryAllocation
+{
+	unsigned int baseVertex;
+	unsigned int vertexCount;
+	unsigned int startIndex;
+	unsigned int indexCount;
+};
+
+// --------------------------------------------------------
+// Utilisation and fragmentation of both buffers, in
+// elements, plus the meshes that didn't fit
+// --------------------------------------------------------
+struct GeometryArenaStats
+{
+	unsigned int vertexCapacity;
+	unsigned int verticesUsed;
+	unsigned int vertexFreeRanges;
+	float vertexFragmentation;
+
+	unsigned int indexCapacity;
+	unsigned int indicesUsed;
+	unsigned int indexFreeRanges;
+	float indexFragmentation;
+
+	unsigned int allocations;		// Live
+	unsigned int failedAllocations;
+	unsigned int bytes;				// Both buffers
+};
+
+// --------------------------------------------------------
+// One large vertex buffer and one large index buffer that
+// meshes are suballocated from, so every mesh in the arena
+// draws with the same input assembler bindings and only the
+// draw's start index and base vertex differ.  The state
+// cache then drops the IA binds between them.
+//
+// Every vertex has the arena's stride, and indices are
+// relative to the mesh's base vertex in the arena's index
+// format, so 16 bit indices work for any arena size.
+//
+// The buffers are default usage rather than immutable so
+// meshes can be written into them after creation, and freed
+// ranges reused.
+// --------------------------------------------------------
+class GeometryArena
+{
+public:
+	GeometryArena(RenderBackend* backend, unsigned int stride, DXGI_FORMAT indexFormat, unsigned int vertexCapacity, unsigned int indexCapacity);
+	~GeometryArena();
+
+	// Copies a mesh in.  False if either buffer is out of room,
+	// leaving the arena as it was.
+	bool Allocate(const void* vertices, unsigned int vertexCount, const void* indices, unsigned int indexCount, GeometryAllocation* allocation);
+	void Free(const GeometryAllocation& allocation);
+
+	RenderBuffer* GetVertexBuffer() { return vertexBuffer.Get(); }
+	RenderBuffer* GetIndexBuffer() { return indexBuffer.Get(); }
+	unsigned int GetStride() { return stride; }
+	DXGI_FORMAT GetIndexFormat() { return indexFormat; }
+
+	GeometryArenaStats GetStats();
+
+private:
+	RenderBackend* backend;
+	RenderRef<RenderBuffer> vertexBuffer;
+	RenderRef<RenderBuffer> indexBuffer;
+	unsigned int stride;
+	unsigned int indexSize;
+	DXGI_FORMAT indexFormat;
+
+	GeometryFreeList vertices;
+	GeometryFreeList indices;
+	unsigned int allocations;
+	unsigned int failedAllocations;
+};
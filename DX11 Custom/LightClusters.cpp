@@ -0,0 +1,353 @@
+#include "LightClusters.h"
+#include <xmmintrin.h>
+#include <chrono>
+#include <math.h>
+#include <string.h>
+
+using namespace DirectX;
+
+// Below this many lights the threads cost more than they save
+#define LIGHT_CLUSTERS_THREAD_THRESHOLD 64
+
+LightClusters::LightClusters(RenderBackend* backend, unsigned int threadCount)
+	: pool(1)
+{
+	this->backend = backend;
+
+	SetThreadCount(threadCount);
+
+	memset(&params, 0, sizeof(params));
+	memset(&stats, 0, sizeof(stats));
+
+	clusterLights.resize(LIGHT_CLUSTER_COUNT * LIGHT_CLUSTERS_MAX_PER_CLUSTER);
+	clusterCounts.resize(LIGHT_CLUSTER_COUNT, 0);
+	indices.resize(LIGHT_CLUSTER_COUNT * LIGHT_CLUSTERS_MAX_PER_CLUSTER);
+	grid.resize(LIGHT_CLUSTER_COUNT * 2, 0);
+
+	if (backend)
+		CreateBuffers();
+}
+
+LightClusters::~LightClusters()
+{
+}
+
+// --------------------------------------------------------
+// Restarts the pool with this many threads.  There's no point
+// in more threads than depth slices, since those are what's
+// split.
+// --------------------------------------------------------
+void LightClusters::SetThreadCount(unsigned int count)
+{
+	if (count == 0)
+		count = WorkerPool::GetCoreCount();
+	if (count > LIGHT_CLUSTERS_Z)
+		count = LIGHT_CLUSTERS_Z;
+
+	pool.SetThreadCount(count);
+	workerDropped.assign(count, 0);
+}
+
+void LightClusters::Build(const XMFLOAT4X4& view, const XMFLOAT4X4& proj, float nearClip, float farClip, unsigned int screenWidth, unsigned int screenHeight, const ClusterLight* lights, unsigned int count)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+	memset(&stats, 0, sizeof(stats));
+	stats.lights = count;
+
+	if (count > LIGHT_CLUSTERS_MAX_LIGHTS)
+	{
+		stats.dropped = count - LIGHT_CLUSTERS_MAX_LIGHTS;
+		count = LIGHT_CLUSTERS_MAX_LIGHTS;
+	}
+	this->lights.assign(lights, lights + count);
+
+	// What the pixel shader needs to undo the binning.  View space
+	// z runs along the third column of the view matrix.
+	params.cameraForward = XMFLOAT3(view._13, view._23, view._33);
+	params.zScale = LIGHT_CLUSTERS_Z / logf(farClip / nearClip);
+	params.zBias = -logf(nearClip) * params.zScale;
+	params.tileScale = XMFLOAT2((float)LIGHT_CLUSTERS_X / screenWidth, (float)LIGHT_CLUSTERS_Y / screenHeight);
+	params.clustersX = LIGHT_CLUSTERS_X;
+	params.clustersY = LIGHT_CLUSTERS_Y;
+	params.clustersZ = LIGHT_CLUSTERS_Z;
+
+	projScaleX = proj._11;
+	projScaleY = proj._22;
+	for (unsigned int z = 0; z <= LIGHT_CLUSTERS_Z; z++)
+		sliceDepths[z] = nearClip * powf(farClip / nearClip, (float)z / LIGHT_CLUSTERS_Z);
+
+	ComputeBounds(view, proj, nearClip, farClip);
+
+	// Each thread bins (and clears) its own run of depth slices,
+	// so no two threads ever touch the same cluster
+	unsigned int threadCount = pool.GetThreadCount();
+	if (threadCount <= 1 || count < LIGHT_CLUSTERS_THREAD_THRESHOLD)
+	{
+		stats.dropped += BinSlices(0, LIGHT_CLUSTERS_Z);
+	}
+	else
+	{
+		pool.Run([&](unsigned int run) { workerDropped[run] = BinRun(run, threadCount); }, threadCount);
+		for (unsigned int d : workerDropped)
+			stats.dropped += d;
+	}
+
+	Pack();
+
+	auto end = std::chrono::high_resolution_clock::now();
+	stats.binMilliseconds = std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+// --------------------------------------------------------
+// Finds the clusters each light's sphere could reach, 4
+// lights at a time.  The sphere's view space box is clipped
+// to the depth range; x/z and y/z are then extreme at its
+// corners, which gives the screen tiles it covers.
+// --------------------------------------------------------
+void LightClusters::ComputeBounds(const XMFLOAT4X4& view, const XMFLOAT4X4& proj, float nearClip, float farClip)
+{
+	unsigned int count = (unsigned int)lights.size();
+	bounds.resize(count);
+
+	__m128 v11 = _mm_set1_ps(view._11), v21 = _mm_set1_ps(view._21), v31 = _mm_set1_ps(view._31), v41 = _mm_set1_ps(view._41);
+	__m128 v12 = _mm_set1_ps(view._12), v22 = _mm_set1_ps(view._22), v32 = _mm_set1_ps(view._32), v42 = _mm_set1_ps(view._42);
+	__m128 v13 = _mm_set1_ps(view._13), v23 = _mm_set1_ps(view._23), v33 = _mm_set1_ps(view._33), v43 = _mm_set1_ps(view._43);
+	__m128 projX = _mm_set1_ps(proj._11);
+	__m128 projY = _mm_set1_ps(proj._22);
+	__m128 nearV = _mm_set1_ps(nearClip);
+	__m128 farV = _mm_set1_ps(farClip);
+
+	// NDC to tiles - y flips, since tile rows go down the screen
+	__m128 halfX = _mm_set1_ps(LIGHT_CLUSTERS_X * 0.5f);
+	__m128 halfY = _mm_set1_ps(LIGHT_CLUSTERS_Y * 0.5f);
+	__m128 lastX = _mm_set1_ps(LIGHT_CLUSTERS_X - 1.0f);
+	__m128 lastY = _mm_set1_ps(LIGHT_CLUSTERS_Y - 1.0f);
+	__m128 tilesX = _mm_set1_ps((float)LIGHT_CLUSTERS_X);
+	__m128 tilesY = _mm_set1_ps((float)LIGHT_CLUSTERS_Y);
+	__m128 zero = _mm_setzero_ps();
+
+	for (unsigned int i = 0; i < count; i += 4)
+	{
+		unsigned int lanes = count - i < 4 ? count - i : 4;
+
+		// (position, range) rows to x, y, z, r columns
+		__m128 x = zero, y = zero, z = zero, r = zero;
+		if (lanes > 0) x = _mm_loadu_ps(&lights[i].position.x);
+		if (lanes > 1) y = _mm_loadu_ps(&lights[i + 1].position.x);
+		if (lanes > 2) z = _mm_loadu_ps(&lights[i + 2].position.x);
+		if (lanes > 3) r = _mm_loadu_ps(&lights[i + 3].position.x);
+		_MM_TRANSPOSE4_PS(x, y, z, r);
+
+		__m128 vx = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, v11), _mm_mul_ps(y, v21)), _mm_add_ps(_mm_mul_ps(z, v31), v41));
+		__m128 vy = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, v12), _mm_mul_ps(y, v22)), _mm_add_ps(_mm_mul_ps(z, v32), v42));
+		__m128 vz = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, v13), _mm_mul_ps(y, v23)), _mm_add_ps(_mm_mul_ps(z, v33), v43));
+
+		// Depth range, clipped - empty if the sphere is outside the planes
+		__m128 zMin = _mm_max_ps(_mm_sub_ps(vz, r), nearV);
+		__m128 zMax = _mm_min_ps(_mm_add_ps(vz, r), farV);
+		__m128 visible = _mm_cmplt_ps(zMin, zMax);
+		__m128 invNear = _mm_div_ps(_mm_set1_ps(1.0f), zMin);
+		__m128 invFar = _mm_div_ps(_mm_set1_ps(1.0f), zMax);
+
+		__m128 xLo = _mm_sub_ps(vx, r), xHi = _mm_add_ps(vx, r);
+		__m128 yLo = _mm_sub_ps(vy, r), yHi = _mm_add_ps(vy, r);
+		__m128 ndcMinX = _mm_mul_ps(_mm_min_ps(_mm_mul_ps(xLo, invNear), _mm_mul_ps(xLo, invFar)), projX);
+		__m128 ndcMaxX = _mm_mul_ps(_mm_max_ps(_mm_mul_ps(xHi, invNear), _mm_mul_ps(xHi, invFar)), projX);
+		__m128 ndcMinY = _mm_mul_ps(_mm_min_ps(_mm_mul_ps(yLo, invNear), _mm_mul_ps(yLo, invFar)), projY);
+		__m128 ndcMaxY = _mm_mul_ps(_mm_max_ps(_mm_mul_ps(yHi, invNear), _mm_mul_ps(yHi, invFar)), projY);
+
+		__m128 minX = _mm_add_ps(_mm_mul_ps(ndcMinX, halfX), halfX);
+		__m128 maxX = _mm_add_ps(_mm_mul_ps(ndcMaxX, halfX), halfX);
+		__m128 minY = _mm_sub_ps(halfY, _mm_mul_ps(ndcMaxY, halfY));
+		__m128 maxY = _mm_sub_ps(halfY, _mm_mul_ps(ndcMinY, halfY));
+
+		// Off screen entirely?
+		visible = _mm_and_ps(visible, _mm_and_ps(_mm_cmplt_ps(minX, tilesX), _mm_cmpge_ps(maxX, zero)));
+		visible = _mm_and_ps(visible, _mm_and_ps(_mm_cmplt_ps(minY, tilesY), _mm_cmpge_ps(maxY, zero)));
+
+		minX = _mm_min_ps(_mm_max_ps(minX, zero), lastX);
+		maxX = _mm_min_ps(_mm_max_ps(maxX, zero), lastX);
+		minY = _mm_min_ps(_mm_max_ps(minY, zero), lastY);
+		maxY = _mm_min_ps(_mm_max_ps(maxY, zero), lastY);
+
+		float outX[4], outY[4], outZ[4], outR[4];
+		_mm_storeu_ps(outX, vx);
+		_mm_storeu_ps(outY, vy);
+		_mm_storeu_ps(outZ, vz);
+		_mm_storeu_ps(outR, r);
+
+		float outMinX[4], outMaxX[4], outMinY[4], outMaxY[4], outMinZ[4], outMaxZ[4];
+		_mm_storeu_ps(outMinX, minX);
+		_mm_storeu_ps(outMaxX, maxX);
+		_mm_storeu_ps(outMinY, minY);
+		_mm_storeu_ps(outMaxY, maxY);
+		_mm_storeu_ps(outMinZ, zMin);
+		_mm_storeu_ps(outMaxZ, zMax);
+		int visibleMask = _mm_movemask_ps(visible);
+
+		// No SSE log, so the slices are done per light
+		for (unsigned int l = 0; l < lanes; l++)
+		{
+			LightBounds& b = bounds[i + l];
+			b.visible = (visibleMask & (1 << l)) != 0;
+			if (!b.visible)
+				continue;
+
+			b.viewPos = XMFLOAT3(outX[l], outY[l], outZ[l]);
+			b.radius = outR[l];
+
+			int minZ = (int)(logf(outMinZ[l]) * params.zScale + params.zBias);
+			int maxZ = (int)(logf(outMaxZ[l]) * params.zScale + params.zBias);
+			b.minX = (unsigned char)outMinX[l];
+			b.maxX = (unsigned char)outMaxX[l];
+			b.minY = (unsigned char)outMinY[l];
+			b.maxY = (unsigned char)outMaxY[l];
+			b.minZ = (unsigned char)(minZ < 0 ? 0 : (minZ >= LIGHT_CLUSTERS_Z ? LIGHT_CLUSTERS_Z - 1 : minZ));
+			b.maxZ = (unsigned char)(maxZ < 0 ? 0 : (maxZ >= LIGHT_CLUSTERS_Z ? LIGHT_CLUSTERS_Z - 1 : maxZ));
+		}
+	}
+}
+
+// --------------------------------------------------------
+// Tiles covered by view space [lo, hi] (x or y) anywhere
+// between depths zLo and zHi.  False if none are.
+// --------------------------------------------------------
+static bool TileRange(float lo, float hi, float zLo, float zHi, float projScale, int tiles, unsigned int& first, unsigned int& last)
+{
+	float half = tiles * 0.5f;
+	float ndcLo = fminf(lo / zLo, lo / zHi) * projScale;
+	float ndcHi = fmaxf(hi / zLo, hi / zHi) * projScale;
+	int a = (int)floorf(ndcLo * half + half);
+	int b = (int)floorf(ndcHi * half + half);
+	if (a >= tiles || b < 0)
+		return false;
+
+	first = a < 0 ? 0 : a;
+	last = b >= tiles ? tiles - 1 : b;
+	return true;
+}
+
+unsigned int LightClusters::BinRun(unsigned int run, unsigned int runCount)
+{
+	return BinSlices(LIGHT_CLUSTERS_Z * run / runCount, LIGHT_CLUSTERS_Z * (run + 1) / runCount);
+}
+
+// --------------------------------------------------------
+// Adds every light to the clusters it reaches within slices
+// [firstSlice, endSlice).  Returns how many didn't fit.
+// --------------------------------------------------------
+unsigned int LightClusters::BinSlices(unsigned int firstSlice, unsigned int endSlice)
+{
+	unsigned int planeSize = LIGHT_CLUSTERS_X * LIGHT_CLUSTERS_Y;
+	memset(&clusterCounts[firstSlice * planeSize], 0, (endSlice - firstSlice) * planeSize * sizeof(unsigned int));
+
+	unsigned int dropped = 0;
+	unsigned int count = (unsigned int)bounds.size();
+	for (unsigned int i = 0; i < count; i++)
+	{
+		const LightBounds& b = bounds[i];
+		if (!b.visible || b.maxZ < firstSlice || b.minZ >= endSlice)
+			continue;
+
+		unsigned int z0 = b.minZ > firstSlice ? b.minZ : firstSlice;
+		unsigned int z1 = b.maxZ + 1u < endSlice ? b.maxZ + 1u : endSlice;
+		for (unsigned int z = z0; z < z1; z++)
+		{
+			// The part of the sphere's box inside this slice covers
+			// fewer tiles than the whole box, at least near the camera.
+			// Tile rows go down the screen, so y is flipped.
+			float zLo = fmaxf(sliceDepths[z], b.viewPos.z - b.radius);
+			float zHi = fminf(sliceDepths[z + 1], b.viewPos.z + b.radius);
+			unsigned int minX, maxX, minY, maxY;
+			if (!TileRange(b.viewPos.x - b.radius, b.viewPos.x + b.radius, zLo, zHi, projScaleX, LIGHT_CLUSTERS_X, minX, maxX) ||
+				!TileRange(-b.viewPos.y - b.radius, -b.viewPos.y + b.radius, zLo, zHi, projScaleY, LIGHT_CLUSTERS_Y, minY, maxY))
+				continue;
+
+			for (unsigned int y = minY; y <= maxY; y++)
+			{
+				unsigned int cluster = (z * LIGHT_CLUSTERS_Y + y) * LIGHT_CLUSTERS_X + minX;
+				for (unsigned int x = minX; x <= maxX; x++, cluster++)
+				{
+					unsigned int& n = clusterCounts[cluster];
+					if (n < LIGHT_CLUSTERS_MAX_PER_CLUSTER)
+						clusterLights[cluster * LIGHT_CLUSTERS_MAX_PER_CLUSTER + n++] = (unsigned short)i;
+					else
+						dropped++;
+				}
+			}
+		}
+	}
+
+	return dropped;
+}
+
+// --------------------------------------------------------
+// Packs each cluster's lights end to end, recording where
+// each cluster's run starts and how long it is
+// --------------------------------------------------------
+void LightClusters::Pack()
+{
+	unsigned int offset = 0;
+	for (unsigned int c = 0; c < LIGHT_CLUSTER_COUNT; c++)
+	{
+		unsigned int n = clusterCounts[c];
+		const unsigned short* src = &clusterLights[c * LIGHT_CLUSTERS_MAX_PER_CLUSTER];
+		for (unsigned int i = 0; i < n; i++)
+			indices[offset + i] = src[i];
+
+		grid[c * 2] = offset;
+		grid[c * 2 + 1] = n;
+		offset += n;
+
+		if (n > stats.maxPerCluster)
+			stats.maxPerCluster = n;
+	}
+
+	stats.indices = offset;
+	for (auto& b : bounds)
+		if (b.visible)
+			stats.visibleLights++;
+}
+
+void LightClusters::Upload()
+{
+	if (!backend)
+		return;
+
+	Write(lightBuffer.Get(), lights.data(), lights.size() * sizeof(ClusterLight));
+	Write(indexBuffer.Get(), indices.data(), stats.indices * sizeof(unsigned int));
+	Write(gridBuffer.Get(), grid.data(), grid.size() * sizeof(unsigned int));
+}
+
+void LightClusters::Write(RenderBuffer* buffer, const void* data, size_t size)
+{
+	if (!buffer || size == 0)
+		return;
+
+	void* dest = backend->Map(buffer, RENDER_MAP_WRITE_DISCARD);
+	if (!dest)
+		return;
+	memcpy(dest, data, size);
+	backend->Unmap(buffer);
+}
+
+// --------------------------------------------------------
+// The buffers are sized for the limits, so they're never
+// recreated
+// --------------------------------------------------------
+void LightClusters::CreateBuffers()
+{
+	CreateStructuredBuffer(sizeof(ClusterLight), LIGHT_CLUSTERS_MAX_LIGHTS, lightBuffer.ReleaseAndGetAddressOf());
+	CreateStructuredBuffer(sizeof(unsigned int), LIGHT_CLUSTER_COUNT * LIGHT_CLUSTERS_MAX_PER_CLUSTER, indexBuffer.ReleaseAndGetAddressOf());
+	CreateStructuredBuffer(sizeof(unsigned int) * 2, LIGHT_CLUSTER_COUNT, gridBuffer.ReleaseAndGetAddressOf());
+}
+
+void LightClusters::CreateStructuredBuffer(unsigned int stride, unsigned int count, RenderBuffer** buffer)
+{
+	BufferDesc desc = {};
+	desc.ByteWidth = stride * count;
+	desc.Usage = RENDER_USAGE_DYNAMIC;
+	desc.BindFlags = RENDER_BIND_SHADER_RESOURCE;
+	desc.StructureByteStride = stride;
+	backend->CreateBuffer(desc, 0, buffer);
+}
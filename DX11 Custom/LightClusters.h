@@ -0,0 +1,121 @@
+#pragma once
+#include <DirectXMath.h>
+#include <vector>
+#include "ClusterLight.h"
+#include "RenderBackend.h"
+#include "ShaderConstants.h"
+#include "WorkerPool.h"
+
+// Froxel grid dimensions: screen tiles across and down, and
+// depth slices (exponentially spaced between the clip planes)
+#define LIGHT_CLUSTERS_X			16
+#define LIGHT_CLUSTERS_Y			9
+#define LIGHT_CLUSTERS_Z			24
+#define LIGHT_CLUSTER_COUNT			(LIGHT_CLUSTERS_X * LIGHT_CLUSTERS_Y * LIGHT_CLUSTERS_Z)
+
+// Lights past these are dropped (and counted in the stats)
+#define LIGHT_CLUSTERS_MAX_LIGHTS		4096
+#define LIGHT_CLUSTERS_MAX_PER_CLUSTER	128
+
+// --------------------------------------------------------
+// Per-build numbers
+// --------------------------------------------------------
+struct LightClusterStats
+{
+	unsigned int lights;
+	unsigned int visibleLights;
+	unsigned int indices;			// Light references across all clusters
+	unsigned int maxPerCluster;
+	unsigned int dropped;			// Over either limit
+
+	double binMilliseconds;
+};
+
+// --------------------------------------------------------
+// Clustered forward light culling.  Each frame the lights are
+// binned on the CPU into a froxel grid built from the camera's
+// projection, then uploaded as three structured buffers:
+//  - the lights themselves
+//  - a packed list of light indices, cluster by cluster
+//  - per cluster, its offset and count in that list
+// so a pixel shader only loops over its own cluster's lights.
+//
+// Light bounds are found 4 lights at a time with SSE, and the
+// depth slices are split between a pool of worker threads for
+// the binning.
+// Without a backend only the CPU binning runs (benchmarks).
+// --------------------------------------------------------
+class LightClusters
+{
+public:
+	LightClusters(RenderBackend* backend, unsigned int threadCount = 0);
+	~LightClusters();
+
+	// Bins the lights for this view.  Assumes a symmetric
+	// perspective projection (as Camera makes).
+	void Build(const DirectX::XMFLOAT4X4& view, const DirectX::XMFLOAT4X4& proj, float nearClip, float farClip, unsigned int screenWidth, unsigned int screenHeight, const ClusterLight* lights, unsigned int count);
+
+	// Copies the last build into the structured buffers
+	void Upload();
+
+	RenderBuffer* GetLightBuffer() { return lightBuffer.Get(); }
+	RenderBuffer* GetIndexBuffer() { return indexBuffer.Get(); }
+	RenderBuffer* GetGridBuffer() { return gridBuffer.Get(); }
+	const ClusterParams& GetParams() { return params; }
+
+	const LightClusterStats& GetStats() { return stats; }
+
+	// 1 runs everything on the calling thread; 0 is one per core
+	void SetThreadCount(unsigned int count);
+	unsigned int GetThreadCount() { return pool.GetThreadCount(); }
+
+private:
+	RenderBackend* backend;
+
+	// Each pool thread bins one run of slices; the thread
+	// calling Build() does run 0
+	WorkerPool pool;
+	std::vector<unsigned int> workerDropped;
+
+	RenderRef<RenderBuffer> lightBuffer;
+	RenderRef<RenderBuffer> indexBuffer;
+	RenderRef<RenderBuffer> gridBuffer;
+
+	ClusterParams params;
+	LightClusterStats stats;
+
+	// Cluster ranges each light touches, inclusive, plus its view
+	// space sphere for tightening the tiles slice by slice
+	struct LightBounds
+	{
+		DirectX::XMFLOAT3 viewPos;
+		float radius;
+		unsigned char minX, maxX;
+		unsigned char minY, maxY;
+		unsigned char minZ, maxZ;
+		bool visible;
+	};
+
+	float projScaleX;
+	float projScaleY;
+	float sliceDepths[LIGHT_CLUSTERS_Z + 1];	// View space z of each slice boundary
+
+	std::vector<ClusterLight> lights;
+	std::vector<LightBounds> bounds;
+
+	// Binning output: fixed room per cluster, then packed into
+	// indices/grid for the upload
+	std::vector<unsigned short> clusterLights;
+	std::vector<unsigned int> clusterCounts;
+	std::vector<unsigned int> indices;
+	std::vector<unsigned int> grid;		// (offset, count) pairs
+
+	void ComputeBounds(const DirectX::XMFLOAT4X4& view, const DirectX::XMFLOAT4X4& proj, float nearClip, float farClip);
+	unsigned int BinSlices(unsigned int firstSlice, unsigned int endSlice);
+	unsigned int BinRun(unsigned int run, unsigned int runCount);
+	void Pack();
+
+	void CreateBuffers();
+	void CreateStructuredBuffer(unsigned int stride, unsigned int count, RenderBuffer** buffer);
+	void Write(RenderBuffer* buffer, const void* data, size_t size);
+};
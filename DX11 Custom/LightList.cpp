@@ -0,0 +1,59 @@
+#include "LightList.h"
+#include "ShaderVariantCache.h"
+#include <string.h>
+
+using namespace DirectX;
+
+LightList::LightList()
+{
+	Clear();
+}
+
+void LightList::Clear()
+{
+	memset(dirLights, 0, sizeof(dirLights));
+	memset(pointLights, 0, sizeof(pointLights));
+	dirCount = 0;
+	pointCount = 0;
+}
+
+int LightList::AddDirectional(XMFLOAT3 ambientColor, XMFLOAT3 diffuseColor, XMFLOAT3 direction)
+{
+	if (dirCount >= MAX_DIR_LIGHTS)
+		return -1;
+
+	DirectionalLight& l = dirLights[dirCount];
+	l.ambientColor = ambientColor;
+	l.diffuseColor = diffuseColor;
+	XMStoreFloat3(&l.direction, XMVector3Normalize(XMLoadFloat3(&direction)));
+	return dirCount++;
+}
+
+int LightList::AddPoint(XMFLOAT3 ambientColor, XMFLOAT3 diffuseColor, XMFLOAT3 position)
+{
+	if (pointCount >= MAX_POINT_LIGHTS)
+		return -1;
+
+	PointLight& l = pointLights[pointCount];
+	l.ambientColor = ambientColor;
+	l.diffuseColor = diffuseColor;
+	l.position = position;
+	return pointCount++;
+}
+
+unsigned int LightList::GetFeatures()
+{
+	return ShaderVariantCache::MakeFeatures(false, false, dirCount, pointCount);
+}
+
+// --------------------------------------------------------
+// The whole arrays go across, since the cbuffer is set at
+// once; past the counts they're zeroed and never read
+// --------------------------------------------------------
+void LightList::Apply(MaterialPSExternalData* data)
+{
+	static_assert(MAX_DIR_LIGHTS * sizeof(DirectionalLight) == sizeof(data->dirLights), "MAX_DIR_LIGHTS doesn't match MaterialCommon.hlsli");
+	static_assert(MAX_POINT_LIGHTS * sizeof(PointLight) == sizeof(data->pointLights), "MAX_POINT_LIGHTS doesn't match MaterialCommon.hlsli");
+	memcpy(data->dirLights, dirLights, sizeof(dirLights));
+	memcpy(data->pointLights, pointLights, sizeof(pointLights));
+}
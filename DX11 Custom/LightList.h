@@ -0,0 +1,47 @@
+#pragma once
+#include <DirectXMath.h>
+#include "ShaderConstants.h"
+
+// Length of the light arrays in MaterialPS.hlsl's cbuffer.  Must
+// match MaterialCommon.hlsli, and fit the 2-bit light counts in a
+// material variant's features.
+#define MAX_DIR_LIGHTS		3
+#define MAX_POINT_LIGHTS	3
+
+// --------------------------------------------------------
+// The scene's fixed lights, in arrays laid out the way the
+// material pixel shaders' cbuffer expects.  Only the first
+// Count of each are active; the counts also pick the shader
+// variant, so a variant only evaluates the lights in use.
+//
+// Materials pick their variant when created, so the lights
+// should be set up before the materials.
+// --------------------------------------------------------
+class LightList
+{
+public:
+	LightList();
+
+	// Direction is normalized here, so the shader doesn't have to.
+	// Return the new light's index, or -1 if that array is full.
+	int AddDirectional(DirectX::XMFLOAT3 ambientColor, DirectX::XMFLOAT3 diffuseColor, DirectX::XMFLOAT3 direction);
+	int AddPoint(DirectX::XMFLOAT3 ambientColor, DirectX::XMFLOAT3 diffuseColor, DirectX::XMFLOAT3 position);
+	void Clear();
+
+	DirectionalLight& GetDirectional(unsigned int index) { return dirLights[index]; }
+	PointLight& GetPoint(unsigned int index) { return pointLights[index]; }
+	unsigned int GetDirectionalCount() { return dirCount; }
+	unsigned int GetPointCount() { return pointCount; }
+
+	// Light count bits of the variant that evaluates exactly these lights
+	unsigned int GetFeatures();
+
+	// Copies the lights into a material pixel shader cbuffer's arrays
+	void Apply(MaterialPSExternalData* data);
+
+private:
+	DirectionalLight dirLights[MAX_DIR_LIGHTS];
+	PointLight pointLights[MAX_POINT_LIGHTS];
+	unsigned int dirCount;
+	unsigned int pointCount;
+};
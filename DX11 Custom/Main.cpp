@@ -1,27 +1,37 @@
 
+#ifdef _WIN32
 #include <Windows.h>
+#endif
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
 #include "Game.h"
 
 // --------------------------------------------------------
-// Entry point for a graphical (non-console) Windows application
+// Runs the game with the options in the command line, and
+// returns the result of the game loop
 // --------------------------------------------------------
-int WINAPI WinMain(
-	_In_ HINSTANCE hInstance,			// The handle to this app's instance
-	_In_opt_ HINSTANCE hPrevInstance,	// A handle to the previous instance of the app (always NULL)
-	_In_ LPSTR lpCmdLine,				// Command line params
-	_In_ int nCmdShow)					// How the window should be shown (we ignore this)
+static int RunGame(HINSTANCE hInstance, const char* lpCmdLine)
 {
-#if defined(DEBUG) | defined(_DEBUG)
-	// Enable memory leak detection as a quick and dirty
-	// way of determining if we forgot to clean something up
-	//  - You may want to use something more advanced, like Visual Leak Detector
-	_CrtSetDbgFlag( _CRTDBG_ALLOC_MEM_DF | _CRTDBG_LEAK_CHECK_DF );
-#endif
-
 	// Create the Game object using
-	// the app handle we got from WinMain
+	// the app handle we got from the entry point
 	Game dxGame(hInstance);
 
+	// "-headless [frames]" runs the game loop without
+	// showing the window or rendering anything
+	const char* headlessArg = strstr(lpCmdLine, "-headless");
+	if (headlessArg)
+	{
+		int frames = atoi(headlessArg + strlen("-headless"));
+		dxGame.SetHeadless(frames > 0 ? frames : 1000);
+	}
+
+	// "-software" draws each frame on the CPU as well (the
+	// only images a headless run makes), and saves the last
+	if (strstr(lpCmdLine, "-software"))
+		dxGame.SetSoftwareRendering(true);
+
 	// Result variable for function calls below
 	HRESULT hr = S_OK;
 
@@ -37,5 +47,50 @@ int WINAPI WinMain(
 
 	// Begin the message and game loop, and then return
 	// whatever we get back once the game loop is over
-	return dxGame.Run();
+	hr = dxGame.Run();
+	if (headlessArg)
+	{
+		printf("Headless: %u frames, %.4f ms CPU per frame\n",
+			dxGame.GetHeadlessFramesRun(), dxGame.GetHeadlessFrameMilliseconds());
+	}
+	return hr;
+}
+
+#ifdef _WIN32
+// --------------------------------------------------------
+// Entry point for a graphical (non-console) Windows application
+// --------------------------------------------------------
+int WINAPI WinMain(
+	_In_ HINSTANCE hInstance,			// The handle to this app's instance
+	_In_opt_ HINSTANCE hPrevInstance,	// A handle to the previous instance of the app (always NULL)
+	_In_ LPSTR lpCmdLine,				// Command line params
+	_In_ int nCmdShow)					// How the window should be shown (we ignore this)
+{
+#if defined(DEBUG) | defined(_DEBUG)
+	// Enable memory leak detection as a quick and dirty
+	// way of determining if we forgot to clean something up
+	//  - You may want to use something more advanced, like Visual Leak Detector
+	_CrtSetDbgFlag( _CRTDBG_ALLOC_MEM_DF | _CRTDBG_LEAK_CHECK_DF );
+#endif
+
+	return RunGame(hInstance, lpCmdLine);
+}
+#else
+// --------------------------------------------------------
+// Entry point everywhere else - there's no window, so only
+// "-headless" runs get past InitDirectX()
+// --------------------------------------------------------
+int main(int argc, char* argv[])
+{
+	// Rejoin the arguments into one command line, as WinMain gets it
+	std::string cmdLine;
+	for (int i = 1; i < argc; i++)
+	{
+		cmdLine += argv[i];
+		cmdLine += ' ';
+	}
+
+	// HRESULTs are negative on failure, which isn't a usable exit code
+	return FAILED(RunGame(0, cmdLine.c_str())) ? 1 : 0;
 }
+#endif
@@ -1,10 +1,9 @@
 #include "Material.h"
+#include <stdexcept>
 
-Material::Material(DirectX::XMFLOAT4 tint, SimplePixelShader* pixShader, SimpleVertexShader* vertShader, float spec, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv, Microsoft::WRL::ComPtr<ID3D11SamplerState> sample, bool normal, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> norm, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> metal, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> roughness)
+Material::Material(DirectX::XMFLOAT4 tint, ShaderVariantCache* variants, unsigned int baseFeatures, float spec, RenderRef<RenderTexture> srv, RenderRef<RenderSamplerState> sample, bool normal, RenderRef<RenderTexture> norm, RenderRef<RenderTexture> metal, RenderRef<RenderTexture> roughness)
 {
     colorTint = tint;
-    pixelShader = pixShader;
-    vertexShader = vertShader;
     specExponent = spec;
     sampler = sample;
     SRV = srv;
@@ -12,6 +11,105 @@ Material::Material(DirectX::XMFLOAT4 tint, SimplePixelShader* pixShader, SimpleV
     if (hasNormal) { normalMap = norm; }
     metalMap = metal;
     roughnessMap = roughness;
+    atlas = 0;
+    atlasSlice = 0;
+
+    //pick the variant that only samples the maps this material has
+    features = baseFeatures;
+    if (hasNormal) { features |= MATERIAL_FEATURE_NORMAL_MAP; }
+    if (metal && roughness) { features |= MATERIAL_FEATURE_PBR_MAPS; }
+    ResolveHandles(variants);
+}
+
+Material::Material(DirectX::XMFLOAT4 tint, ShaderVariantCache* variants, unsigned int baseFeatures, float spec, MaterialAtlas* atlas, unsigned int slice, RenderRef<RenderSamplerState> sample)
+{
+    colorTint = tint;
+    specExponent = spec;
+    sampler = sample;
+    hasNormal = true;
+    this->atlas = atlas;
+    atlasSlice = slice;
+
+    //the same three arrays for every atlas material, so the state cache drops the rebinds
+    SRV = atlas->GetSRV(MATERIAL_ATLAS_ALBEDO);
+    normalMap = atlas->GetSRV(MATERIAL_ATLAS_NORMAL);
+    surfaceMap = atlas->GetSRV(MATERIAL_ATLAS_SURFACE);
+
+    features = baseFeatures | MATERIAL_FEATURE_NORMAL_MAP | MATERIAL_FEATURE_PBR_MAPS | MATERIAL_FEATURE_MATERIAL_ATLAS;
+    ResolveHandles(variants);
+}
+
+//gets the variant for the features and looks up its handles
+void Material::ResolveHandles(ShaderVariantCache* variants)
+{
+    vertexShader = variants->GetVertexShader(features);
+    pixelShader = variants->GetPixelShader(features);
+
+    //the cache already fell back to the last good variant, so there's nothing left to draw with
+    if (!vertexShader || !pixelShader)
+    {
+        throw std::runtime_error("No material shader variant compiled or loaded, check MaterialVS.hlsl and MaterialPS.hlsl");
+    }
+    for (unsigned int i = 0; i < MATERIAL_PIPELINE_COUNT; i++) { pipelineStates[i] = 0; }
+
+    vertexDataHandle = vertexShader->GetBufferHandle("ExternalData");
+
+    specHandle = pixelShader->GetVariableHandle("specExponent");
+    albedoHandle = pixelShader->GetSRVHandle("Albedo");
+    normalHandle = pixelShader->GetSRVHandle("NormalMap");
+    roughnessHandle = pixelShader->GetSRVHandle("RoughnessMap");
+    metalnessHandle = pixelShader->GetSRVHandle("MetalnessMap");
+    surfaceHandle = pixelShader->GetSRVHandle("SurfaceMap");
+    samplerHandle = pixelShader->GetSamplerHandle("samplerOptions");
+
+    BakeBindings();
+}
+
+//flattens the handles and maps into the table draw() walks, dropping compiled out maps
+void Material::BakeBindings()
+{
+    const int handles[MATERIAL_MAX_TEXTURES] = { albedoHandle, normalHandle, roughnessHandle, metalnessHandle, surfaceHandle };
+    RenderResource* const srvs[MATERIAL_MAX_TEXTURES] = { SRV.Get(), normalMap.Get(), roughnessMap.Get(), metalMap.Get(), surfaceMap.Get() };
+
+    bindings.textureCount = 0;
+    for (unsigned int i = 0; i < MATERIAL_MAX_TEXTURES; i++)
+    {
+        if (handles[i] < 0) { continue; }
+        bindings.textures[bindings.textureCount].handle = handles[i];
+        bindings.textures[bindings.textureCount].srv = srvs[i];
+        bindings.textureCount++;
+    }
+    bindings.samplerHandle = samplerHandle;
+    bindings.sampler = sampler.Get();
+}
+
+const MaterialBindings& Material::GetBindings()
+{
+    return bindings;
+}
+
+//materials sharing a variant end up with the same psos, the cache dedups them
+const PipelineState* Material::GetPipelineState(PipelineStateCache* cache, MaterialPipeline pipeline)
+{
+    if (pipelineStates[pipeline]) { return pipelineStates[pipeline]; }
+
+    PipelineStateDesc desc;
+    desc.vertexShader = vertexShader->GetDirectXShader();
+    desc.inputLayout = vertexShader->GetInputLayout();
+    if (pipeline != MATERIAL_PIPELINE_DEPTH_ONLY) { desc.pixelShader = pixelShader->GetDirectXShader(); }
+    if (pipeline == MATERIAL_PIPELINE_OPAQUE_EQUAL)
+    {
+        desc.depthStencil.DepthWrite = false;
+        desc.depthStencil.DepthFunc = RENDER_COMPARISON_EQUAL;
+    }
+    if (pipeline == MATERIAL_PIPELINE_TRANSPARENT)
+    {
+        desc.depthStencil.DepthWrite = false;
+        desc.depthStencil.DepthFunc = RENDER_COMPARISON_LESS_EQUAL;
+    }
+
+    pipelineStates[pipeline] = cache->GetPipelineState(desc);
+    return pipelineStates[pipeline];
 }
 
 DirectX::XMFLOAT4 Material::getTint()
@@ -34,12 +132,18 @@ SimpleVertexShader* Material::getVertex()
     return vertexShader;
 }
 
-Microsoft::WRL::ComPtr<ID3D11SamplerState> Material::getSampler()
+RenderSamplerState* Material::getSampler()
+{
+    return sampler.Get();
+}
+
+RenderTexture* Material::getSRV()
 {
-    return sampler;
+    return SRV.Get();
 }
 
-Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> Material::getSRV()
+const void* Material::GetBindingKey()
 {
-    return SRV;
+    if (atlas) { return atlas; }
+    return this;
 }
@@ -1,8 +1,40 @@
 #pragma once
 #include <DirectXMath.h>
-#include <wrl/event.h>
-#include <d3d11.h>
 #include "SimpleShader.h"
+#include "ShaderVariantCache.h"
+#include "MaterialAtlas.h"
+#include "PipelineState.h"
+
+//albedo, normal, roughness, metalness and the atlas's surface map
+#define MATERIAL_MAX_TEXTURES 5
+
+//one texture the material's pixel shader samples, and where
+struct MaterialTextureBinding
+{
+	int handle;
+	RenderResource* srv;
+};
+
+//the textures and sampler a draw binds, baked once the variant is known.
+//only maps the variant samples are in it, and the pointers are borrowed
+//from the material, so the draw path does no refcounting
+struct MaterialBindings
+{
+	MaterialTextureBinding textures[MATERIAL_MAX_TEXTURES];
+	unsigned int textureCount;
+	int samplerHandle;
+	RenderSamplerState* sampler;
+};
+
+//the fixed function setups a material is drawn with, one pso each
+enum MaterialPipeline
+{
+	MATERIAL_PIPELINE_DEPTH_ONLY,		//prepass: no pixel shader, LESS with writes
+	MATERIAL_PIPELINE_OPAQUE,			//LESS with writes
+	MATERIAL_PIPELINE_OPAQUE_EQUAL,		//after a prepass: EQUAL, no writes
+	MATERIAL_PIPELINE_TRANSPARENT,		//LESS_EQUAL, no writes
+	MATERIAL_PIPELINE_COUNT
+};
 
 class Material
 {
@@ -12,21 +44,54 @@ public:
 	SimpleVertexShader* vertexShader;
 	SimplePixelShader* pixelShader;
 
-	Material(DirectX::XMFLOAT4 tint, SimplePixelShader* pixShader, SimpleVertexShader* vertShader, float spec, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv, Microsoft::WRL::ComPtr<ID3D11SamplerState> sample, bool normal, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> norm, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> metal, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> roughness );
+	Material(DirectX::XMFLOAT4 tint, ShaderVariantCache* variants, unsigned int baseFeatures, float spec, RenderRef<RenderTexture> srv, RenderRef<RenderSamplerState> sample, bool normal, RenderRef<RenderTexture> norm, RenderRef<RenderTexture> metal, RenderRef<RenderTexture> roughness );
+	//maps come from a slice of the atlas, so every material in it binds the same textures
+	Material(DirectX::XMFLOAT4 tint, ShaderVariantCache* variants, unsigned int baseFeatures, float spec, MaterialAtlas* atlas, unsigned int slice, RenderRef<RenderSamplerState> sample);
 	DirectX::XMFLOAT4 getTint();
 	void setTint(DirectX::XMFLOAT4 tint);
 	SimplePixelShader* getPixel();
 	SimpleVertexShader* getVertex();
 	float specExponent;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> SRV;
-	Microsoft::WRL::ComPtr<ID3D11SamplerState> sampler;
-	Microsoft::WRL::ComPtr<ID3D11SamplerState> getSampler();
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> getSRV();
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> normalMap;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> roughnessMap;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> metalMap;
+	RenderRef<RenderTexture> SRV;
+	RenderRef<RenderSamplerState> sampler;
+	RenderSamplerState* getSampler();
+	RenderTexture* getSRV();
+	RenderRef<RenderTexture> normalMap;
+	RenderRef<RenderTexture> roughnessMap;
+	RenderRef<RenderTexture> metalMap;
+	//atlas only: roughness, metalness and ao packed together
+	RenderRef<RenderTexture> surfaceMap;
 
 	bool hasNormal;
 
+	//null unless the maps are in an atlas
+	MaterialAtlas* atlas;
+	unsigned int atlasSlice;
+
+	//materials that bind the same textures share this, for sorting
+	const void* GetBindingKey();
+
+	//what draw() binds, rebake if the maps or sampler are changed
+	const MaterialBindings& GetBindings();
+	void BakeBindings();
+
+	//the pso for drawing with this material's variant, looked up once per pipeline
+	const PipelineState* GetPipelineState(PipelineStateCache* cache, MaterialPipeline pipeline);
+
+	//feature bits of the shader variant this material uses
+	unsigned int features;
+
+	//shader handles, resolved once so drawing skips the name lookups.
+	//the vertex shader's cbuffer is set whole, as a MaterialVSExternalData
+	int vertexDataHandle;
+	int specHandle;
+	int albedoHandle, normalHandle, roughnessHandle, metalnessHandle, surfaceHandle;
+	int samplerHandle;
+
+private:
+	void ResolveHandles(ShaderVariantCache* variants);
+
+	MaterialBindings bindings;
+	const PipelineState* pipelineStates[MATERIAL_PIPELINE_COUNT];
 };
 
@@ -0,0 +1,396 @@
+#include "MaterialAtlas.h"
+#include "ShaderReflectionCache.h"
+#include "Texels.h"
+#include "FilePath.h"
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <string.h>
+
+#ifdef _WIN32
+#include <wincodec.h>
+#include <wrl/client.h>
+
+using namespace Microsoft::WRL;
+#endif
+
+// Bump whenever the cooked layout changes, so old files are recooked
+static const uint32_t ATLAS_MAGIC = 0x4C54414D; // "MATL"
+static const uint32_t ATLAS_VERSION = 3;
+
+// Per cooked map
+static const unsigned int MAP_CHANNELS[MATERIAL_ATLAS_MAP_COUNT] = { 4, 2, 4 };
+static const bool MAP_SRGB[MATERIAL_ATLAS_MAP_COUNT] = { true, false, false };
+static const DXGI_FORMAT MAP_FORMATS[MATERIAL_ATLAS_MAP_COUNT] =
+{
+	DXGI_FORMAT_R8G8B8A8_UNORM_SRGB,
+	DXGI_FORMAT_R8G8_UNORM,
+	DXGI_FORMAT_R8G8B8A8_UNORM,
+};
+
+// --------------------------------------------------------
+// Cooked file header, followed by each map's pixels in order
+// and then each slice's MaterialAtlasSliceStats
+// --------------------------------------------------------
+struct AtlasFileHeader
+{
+	uint32_t Magic;
+	uint32_t Version;
+	uint64_t Hash;
+	uint32_t Size;
+	uint32_t MipLevels;
+	uint32_t Slices;
+	uint32_t Pad;
+};
+
+MaterialAtlas::MaterialAtlas(unsigned int size)
+{
+	this->size = size;
+
+	mipLevels = 1;
+	while ((size >> mipLevels) > 0)
+		mipLevels++;
+	keepPixels = false;
+
+	memset(&stats, 0, sizeof(stats));
+}
+
+unsigned int MaterialAtlas::AddMaterial(const std::wstring& albedo, const std::wstring& normal, const std::wstring& roughness, const std::wstring& metalness, const std::wstring& ao)
+{
+	std::vector<std::wstring> files(MATERIAL_SOURCE_COUNT);
+	files[MATERIAL_SOURCE_ALBEDO] = albedo;
+	files[MATERIAL_SOURCE_NORMAL] = normal;
+	files[MATERIAL_SOURCE_ROUGHNESS] = roughness;
+	files[MATERIAL_SOURCE_METALNESS] = metalness;
+	files[MATERIAL_SOURCE_AO] = ao;
+	sources.push_back(files);
+	return (unsigned int)sources.size() - 1;
+}
+
+size_t MaterialAtlas::GetSliceBytes(unsigned int map)
+{
+	size_t bytes = 0;
+	for (unsigned int m = 0; m < mipLevels; m++)
+	{
+		size_t s = size >> m;
+		bytes += s * s * MAP_CHANNELS[map];
+	}
+	return bytes;
+}
+
+const unsigned char* MaterialAtlas::GetSlicePixels(MaterialAtlasMap map, unsigned int slice)
+{
+	if (slice >= GetSliceCount() || pixels[map].empty())
+		return 0;
+	return &pixels[map][GetSliceBytes(map) * slice];
+}
+
+unsigned int MaterialAtlas::GetMapChannels(MaterialAtlasMap map)
+{
+	return MAP_CHANNELS[map];
+}
+
+bool MaterialAtlas::IsMapSRGB(MaterialAtlasMap map)
+{
+	return MAP_SRGB[map];
+}
+
+// --------------------------------------------------------
+// Hashes the atlas size and every source's path and last
+// write time, so editing or swapping a map forces a recook
+// --------------------------------------------------------
+uint64_t MaterialAtlas::HashSources()
+{
+	std::vector<unsigned char> key;
+	key.insert(key.end(), (unsigned char*)&size, (unsigned char*)&size + sizeof(size));
+
+	for (auto& slice : sources)
+	{
+		for (auto& file : slice)
+		{
+			key.insert(key.end(), (const unsigned char*)file.c_str(), (const unsigned char*)(file.c_str() + file.size()));
+
+			unsigned long long writeTime = GetFileWriteTime(file);
+			key.insert(key.end(), (unsigned char*)&writeTime, (unsigned char*)&writeTime + sizeof(writeTime));
+		}
+	}
+
+	return ShaderReflectionCache::Hash(key.data(), key.size());
+}
+
+bool MaterialAtlas::Build(RenderBackend* backend, const std::wstring& cookedFile)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	uint64_t hash = HashSources();
+	stats.cooked = false;
+	if (!Load(cookedFile, hash))
+	{
+		if (!Cook())
+			return false;
+
+		stats.cooked = true;
+		Save(cookedFile, hash);
+	}
+
+	stats.bytes = 0;
+	for (unsigned int map = 0; map < MATERIAL_ATLAS_MAP_COUNT; map++)
+		stats.bytes += pixels[map].size();
+
+	bool ok = CreateArrays(backend);
+
+	auto end = std::chrono::high_resolution_clock::now();
+	stats.slices = GetSliceCount();
+	stats.size = size;
+	stats.mipLevels = mipLevels;
+	stats.buildMilliseconds = std::chrono::duration<double, std::milli>(end - start).count();
+	return ok;
+}
+
+// --------------------------------------------------------
+// Bytes of an RGBA8 texture with a full mip chain, what the
+// texture loader would have made of a source
+// --------------------------------------------------------
+static uint64_t GetSourceBytes(unsigned int width, unsigned int height)
+{
+	uint64_t bytes = 0;
+	while (true)
+	{
+		bytes += (uint64_t)width * height * 4;
+		if (width == 1 && height == 1)
+			return bytes;
+		if (width > 1) width /= 2;
+		if (height > 1) height /= 2;
+	}
+}
+
+#ifdef _WIN32
+// --------------------------------------------------------
+// Decodes an image through WIC, converted to RGBA8 and
+// resized to size x size.  Its original size is returned.
+// --------------------------------------------------------
+static bool DecodeResized(IWICImagingFactory* factory, const wchar_t* file, unsigned int size, unsigned char* out, UINT* width, UINT* height)
+{
+	ComPtr<IWICBitmapDecoder> decoder;
+	if (FAILED(factory->CreateDecoderFromFilename(file, 0, GENERIC_READ, WICDecodeMetadataCacheOnDemand, decoder.GetAddressOf())))
+		return false;
+
+	ComPtr<IWICBitmapFrameDecode> frame;
+	if (FAILED(decoder->GetFrame(0, frame.GetAddressOf())) ||
+		FAILED(frame->GetSize(width, height)))
+		return false;
+
+	ComPtr<IWICFormatConverter> converter;
+	if (FAILED(factory->CreateFormatConverter(converter.GetAddressOf())) ||
+		FAILED(converter->Initialize(frame.Get(), GUID_WICPixelFormat32bppRGBA, WICBitmapDitherTypeNone, 0, 0.0, WICBitmapPaletteTypeCustom)))
+		return false;
+
+	ComPtr<IWICBitmapScaler> scaler;
+	if (FAILED(factory->CreateBitmapScaler(scaler.GetAddressOf())) ||
+		FAILED(scaler->Initialize(converter.Get(), size, size, WICBitmapInterpolationModeFant)))
+		return false;
+
+	return SUCCEEDED(scaler->CopyPixels(0, size * 4, size * size * 4, out));
+}
+
+// --------------------------------------------------------
+// Decodes and resizes every source, packs the channels into
+// the cooked maps, then builds their mips
+// --------------------------------------------------------
+bool MaterialAtlas::Cook()
+{
+	// Fine if COM is already up on this thread, in either mode
+	HRESULT coInit = CoInitializeEx(0, COINIT_MULTITHREADED);
+
+	ComPtr<IWICImagingFactory> factory;
+	bool ok = SUCCEEDED(CoCreateInstance(CLSID_WICImagingFactory, 0, CLSCTX_INPROC_SERVER, IID_PPV_ARGS(factory.GetAddressOf())));
+
+	for (unsigned int map = 0; map < MATERIAL_ATLAS_MAP_COUNT; map++)
+		pixels[map].resize(GetSliceBytes(map) * sources.size());
+	sliceStats.resize(sources.size());
+
+	size_t texels = size * size;
+	std::vector<unsigned char> decoded[MATERIAL_SOURCE_COUNT];
+	for (size_t slice = 0; ok && slice < sources.size(); slice++)
+	{
+		MaterialAtlasSliceStats& sliceStat = sliceStats[slice];
+		sliceStat.sourceBytes = 0;
+		sliceStat.cookedBytes = 0;
+
+		for (unsigned int src = 0; ok && src < MATERIAL_SOURCE_COUNT; src++)
+		{
+			decoded[src].assign(texels * 4, 255);
+			if (sources[slice][src].empty() && src == MATERIAL_SOURCE_AO)
+				continue;
+
+			UINT width = 0, height = 0;
+			ok = DecodeResized(factory.Get(), sources[slice][src].c_str(), size, decoded[src].data(), &width, &height);
+			sliceStat.sourceBytes += GetSourceBytes(width, height);
+		}
+		if (!ok)
+			break;
+
+		// Top mip of each map, from the red channel of the single channel sources
+		unsigned char* albedo = &pixels[MATERIAL_ATLAS_ALBEDO][GetSliceBytes(MATERIAL_ATLAS_ALBEDO) * slice];
+		unsigned char* normal = &pixels[MATERIAL_ATLAS_NORMAL][GetSliceBytes(MATERIAL_ATLAS_NORMAL) * slice];
+		unsigned char* surface = &pixels[MATERIAL_ATLAS_SURFACE][GetSliceBytes(MATERIAL_ATLAS_SURFACE) * slice];
+		memcpy(albedo, decoded[MATERIAL_SOURCE_ALBEDO].data(), texels * 4);
+		for (size_t t = 0; t < texels; t++)
+		{
+			normal[t * 2 + 0] = decoded[MATERIAL_SOURCE_NORMAL][t * 4 + 0];
+			normal[t * 2 + 1] = decoded[MATERIAL_SOURCE_NORMAL][t * 4 + 1];
+
+			surface[t * 4 + 0] = decoded[MATERIAL_SOURCE_ROUGHNESS][t * 4];
+			surface[t * 4 + 1] = decoded[MATERIAL_SOURCE_METALNESS][t * 4];
+			surface[t * 4 + 2] = decoded[MATERIAL_SOURCE_AO][t * 4];
+			surface[t * 4 + 3] = 255;
+		}
+
+		for (unsigned int map = 0; map < MATERIAL_ATLAS_MAP_COUNT; map++)
+		{
+			unsigned char* mip = &pixels[map][GetSliceBytes(map) * slice];
+			for (unsigned int m = 1; m < mipLevels; m++)
+			{
+				unsigned int mipSize = size >> (m - 1);
+				unsigned char* next = mip + mipSize * mipSize * MAP_CHANNELS[map];
+				DownsampleMip(mip, mipSize, MAP_CHANNELS[map], next, MAP_SRGB[map]);
+				mip = next;
+			}
+			sliceStat.cookedBytes += GetSliceBytes(map);
+		}
+	}
+
+	factory.Reset();
+	if (SUCCEEDED(coInit))
+		CoUninitialize();
+
+	if (!ok)
+		ClearPixels();
+	return ok;
+}
+#else
+bool MaterialAtlas::Cook()
+{
+	// Nothing to decode the sources with
+	return false;
+}
+#endif
+
+void MaterialAtlas::ClearPixels()
+{
+	for (unsigned int map = 0; map < MATERIAL_ATLAS_MAP_COUNT; map++)
+	{
+		pixels[map].clear();
+		pixels[map].shrink_to_fit();
+	}
+}
+
+// --------------------------------------------------------
+// Reads a cooked file, failing if it is missing, from another
+// version or was cooked from different sources
+// --------------------------------------------------------
+bool MaterialAtlas::Load(const std::wstring& cookedFile, uint64_t hash)
+{
+	std::ifstream file(ToNativePath(cookedFile).c_str(), std::ios::binary);
+	if (!file)
+		return false;
+
+	AtlasFileHeader header;
+	file.read((char*)&header, sizeof(header));
+	if (!file.good() ||
+		header.Magic != ATLAS_MAGIC ||
+		header.Version != ATLAS_VERSION ||
+		header.Hash != hash ||
+		header.Size != size ||
+		header.MipLevels != mipLevels ||
+		header.Slices != sources.size())
+		return false;
+
+	for (unsigned int map = 0; map < MATERIAL_ATLAS_MAP_COUNT; map++)
+	{
+		pixels[map].resize(GetSliceBytes(map) * sources.size());
+		file.read((char*)pixels[map].data(), pixels[map].size());
+	}
+
+	sliceStats.resize(sources.size());
+	file.read((char*)sliceStats.data(), sizeof(MaterialAtlasSliceStats) * sliceStats.size());
+
+	// A truncated file is as good as no file
+	if (!file.good())
+	{
+		ClearPixels();
+		return false;
+	}
+	return true;
+}
+
+bool MaterialAtlas::Save(const std::wstring& cookedFile, uint64_t hash)
+{
+	std::ofstream file(ToNativePath(cookedFile).c_str(), std::ios::binary | std::ios::trunc);
+	if (!file)
+		return false;
+
+	AtlasFileHeader header = {};
+	header.Magic = ATLAS_MAGIC;
+	header.Version = ATLAS_VERSION;
+	header.Hash = hash;
+	header.Size = size;
+	header.MipLevels = mipLevels;
+	header.Slices = (uint32_t)sources.size();
+	file.write((const char*)&header, sizeof(header));
+
+	for (unsigned int map = 0; map < MATERIAL_ATLAS_MAP_COUNT; map++)
+		file.write((const char*)pixels[map].data(), pixels[map].size());
+	file.write((const char*)sliceStats.data(), sizeof(MaterialAtlasSliceStats) * sliceStats.size());
+	return file.good();
+}
+
+// --------------------------------------------------------
+// One immutable texture array per map.  The CPU
+// copies are dropped once the GPU has them, unless they're
+// being kept for the software rasterizer.
+// --------------------------------------------------------
+bool MaterialAtlas::CreateArrays(RenderBackend* backend)
+{
+	unsigned int slices = GetSliceCount();
+
+	TextureDesc desc = {};
+	desc.Type = RENDER_TEXTURE_2D_ARRAY;
+	desc.Width = size;
+	desc.Height = size;
+	desc.MipLevels = mipLevels;
+	desc.ArraySize = slices;
+	desc.Usage = RENDER_USAGE_IMMUTABLE;
+	desc.BindFlags = RENDER_BIND_SHADER_RESOURCE;
+
+	// Subresources go mip by mip within each slice
+	std::vector<SubresourceData> data(slices * mipLevels);
+
+	bool ok = true;
+	for (unsigned int map = 0; map < MATERIAL_ATLAS_MAP_COUNT; map++)
+	{
+		unsigned int channels = MAP_CHANNELS[map];
+		size_t sliceBytes = GetSliceBytes(map);
+		for (unsigned int slice = 0; slice < slices; slice++)
+		{
+			const unsigned char* mip = &pixels[map][sliceBytes * slice];
+			for (unsigned int m = 0; m < mipLevels; m++)
+			{
+				unsigned int mipSize = size >> m;
+				SubresourceData& sub = data[slice * mipLevels + m];
+				sub.Data = mip;
+				sub.RowPitch = mipSize * channels;
+				sub.SlicePitch = mipSize * mipSize * channels;
+				mip += mipSize * mipSize * channels;
+			}
+		}
+
+		desc.Format = MAP_FORMATS[map];
+		if (!backend->CreateTexture(desc, data.data(), srvs[map].ReleaseAndGetAddressOf()))
+			ok = false;
+	}
+
+	if (!keepPixels)
+		ClearPixels();
+	return ok;
+}
@@ -0,0 +1,128 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "RenderBackend.h"
+
+// --------------------------------------------------------
+// The cooked maps, one texture array each.  Order matches
+// registers t0 - t2 of the atlas variant in MaterialPS.hlsl.
+// --------------------------------------------------------
+enum MaterialAtlasMap
+{
+	MATERIAL_ATLAS_ALBEDO,		// RGBA8 sRGB
+	MATERIAL_ATLAS_NORMAL,		// RG8 tangent space x and y, z is rebuilt in the shader
+	MATERIAL_ATLAS_SURFACE,		// RGBA8 roughness, metalness, ambient occlusion
+	MATERIAL_ATLAS_MAP_COUNT
+};
+
+// --------------------------------------------------------
+// The source images of a material, before packing
+// --------------------------------------------------------
+enum MaterialAtlasSource
+{
+	MATERIAL_SOURCE_ALBEDO,
+	MATERIAL_SOURCE_NORMAL,
+	MATERIAL_SOURCE_ROUGHNESS,
+	MATERIAL_SOURCE_METALNESS,
+	MATERIAL_SOURCE_AO,			// Optional, white without it
+	MATERIAL_SOURCE_COUNT
+};
+
+// --------------------------------------------------------
+// What packing saved on one material: its sources as a
+// texture per map (RGBA8, full mips, at their own size)
+// against its slice of the cooked arrays
+// --------------------------------------------------------
+struct MaterialAtlasSliceStats
+{
+	uint64_t sourceBytes;
+	uint64_t cookedBytes;
+};
+
+// --------------------------------------------------------
+// Numbers from the last Build()
+// --------------------------------------------------------
+struct MaterialAtlasStats
+{
+	bool cooked;				// False if the cooked file was reused
+	unsigned int slices;
+	unsigned int size;
+	unsigned int mipLevels;
+	size_t bytes;				// Across all the arrays
+
+	double buildMilliseconds;
+};
+
+// --------------------------------------------------------
+// Packs the maps of several PBR materials into one
+// Texture2DArray per cooked map, so every material in the
+// atlas binds the same SRVs and differs only by its slice.
+//
+// Building cooks each material once: its sources are decoded,
+// resized to the atlas size and channel packed - normals down
+// to x and y, and roughness, metalness and AO into one
+// texture - then mipmapped on the CPU and written to a cooked
+// file keyed by a hash of the sources.  Later builds load that
+// file as-is until a source changes.  Sources are decoded with
+// WIC, so off Windows only a cooked file can be loaded.
+// --------------------------------------------------------
+class MaterialAtlas
+{
+public:
+	// size - Width and height of every slice, a power of 2
+	MaterialAtlas(unsigned int size = 512);
+
+	// Queues a material's maps and returns its slice.  All but
+	// the AO map are required.
+	unsigned int AddMaterial(const std::wstring& albedo, const std::wstring& normal, const std::wstring& roughness, const std::wstring& metalness, const std::wstring& ao = L"");
+
+	// Cooks (or loads) the maps and creates the arrays.  False
+	// if a source couldn't be read, leaving the atlas empty.
+	bool Build(RenderBackend* backend, const std::wstring& cookedFile);
+
+	RenderRef<RenderTexture> GetSRV(MaterialAtlasMap map) { return srvs[map]; }
+	unsigned int GetSliceCount() { return (unsigned int)sources.size(); }
+	unsigned int GetSize() { return size; }
+
+	const MaterialAtlasStats& GetStats() { return stats; }
+	const MaterialAtlasSliceStats& GetSliceStats(unsigned int slice) { return sliceStats[slice]; }
+
+	// Keeps the CPU copies of the maps after Build() for the
+	// software rasterizer, instead of dropping them once the GPU
+	// has them.  Set before building.
+	void SetKeepPixels(bool keep) { keepPixels = keep; }
+
+	// A slice's mip chain of one map, largest first and tightly
+	// packed, or null if the pixels weren't kept
+	const unsigned char* GetSlicePixels(MaterialAtlasMap map, unsigned int slice);
+	unsigned int GetMipLevels() { return mipLevels; }
+	static unsigned int GetMapChannels(MaterialAtlasMap map);
+	static bool IsMapSRGB(MaterialAtlasMap map);
+
+private:
+	unsigned int size;
+	unsigned int mipLevels;
+	bool keepPixels;
+
+	// Per slice, one file per source
+	std::vector<std::vector<std::wstring>> sources;
+
+	// Per map, every slice's full mip chain back to back
+	std::vector<unsigned char> pixels[MATERIAL_ATLAS_MAP_COUNT];
+	std::vector<MaterialAtlasSliceStats> sliceStats;
+
+	RenderRef<RenderTexture> srvs[MATERIAL_ATLAS_MAP_COUNT];
+
+	MaterialAtlasStats stats;
+
+	// Bytes of one slice's mip chain of a map
+	size_t GetSliceBytes(unsigned int map);
+	uint64_t HashSources();
+
+	bool Cook();
+	bool Load(const std::wstring& cookedFile, uint64_t hash);
+	bool Save(const std::wstring& cookedFile, uint64_t hash);
+	bool CreateArrays(RenderBackend* backend);
+	void ClearPixels();
+};
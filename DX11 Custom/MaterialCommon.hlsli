@@ -0,0 +1,94 @@
+#ifndef __MATERIAL_COMMON_HLSLI__
+#define __MATERIAL_COMMON_HLSLI__
+
+// Feature switches for the material shaders.  ShaderVariantCache
+// compiles each combination it needs by defining these; the
+// defaults below are the full-featured variant that the project
+// build compiles to MaterialVS.cso / MaterialPS.cso.
+#ifndef HAS_NORMAL_MAP
+#define HAS_NORMAL_MAP 1
+#endif
+
+#ifndef HAS_PBR_MAPS
+#define HAS_PBR_MAPS 1
+#endif
+
+#ifndef NUM_DIR_LIGHTS
+#define NUM_DIR_LIGHTS 3
+#endif
+
+#ifndef NUM_POINT_LIGHTS
+#define NUM_POINT_LIGHTS 1
+#endif
+
+#ifndef USE_INSTANCING
+#define USE_INSTANCING 0
+#endif
+
+// Adds the lights binned by LightClusters on top of the fixed ones
+#ifndef USE_CLUSTERED_LIGHTS
+#define USE_CLUSTERED_LIGHTS 0
+#endif
+
+// Samples the maps from MaterialAtlas's texture arrays, at the
+// material's slice, instead of from the material's own textures.
+// The atlas holds normals and the PBR maps, so it needs both flags above.
+#ifndef USE_MATERIAL_ATLAS
+#define USE_MATERIAL_ATLAS 0
+#endif
+
+#if USE_MATERIAL_ATLAS && !(HAS_NORMAL_MAP && HAS_PBR_MAPS)
+#error USE_MATERIAL_ATLAS needs HAS_NORMAL_MAP and HAS_PBR_MAPS
+#endif
+
+// Reads CompactVertex (Vertex.h): half float positions and uvs,
+// octahedral encoded normals and tangents.  Vertex shader only.
+#ifndef USE_COMPACT_VERTICES
+#define USE_COMPACT_VERTICES 0
+#endif
+
+// Ambient light from EnvironmentLighting's prefiltered sky:
+// irradiance and specular cubes plus the split sum BRDF LUT.
+// Pixel shader only.
+#ifndef USE_IMAGE_LIGHTING
+#define USE_IMAGE_LIGHTING 0
+#endif
+
+// The cbuffer's light arrays are this long.  Must match
+// MAX_DIR_LIGHTS and MAX_POINT_LIGHTS in LightList.h, and fit the
+// 2-bit counts in the variant features.
+#define MAX_DIR_LIGHTS 3
+#define MAX_POINT_LIGHTS 3
+
+#if NUM_DIR_LIGHTS > MAX_DIR_LIGHTS
+#error NUM_DIR_LIGHTS must be 0 to MAX_DIR_LIGHTS
+#endif
+
+#if NUM_POINT_LIGHTS > MAX_POINT_LIGHTS
+#error NUM_POINT_LIGHTS must be 0 to MAX_POINT_LIGHTS
+#endif
+
+// Struct representing the data we're sending down the pipeline
+// - The vertex shader's output and the pixel shader's input
+// - Each variable must have a semantic, which defines its usage
+struct VertexToPixel
+{
+	// Data type
+	//  |
+	//  |   Name          Semantic
+	//  |    |                |
+	//  v    v                v
+	float4 position		: SV_POSITION;	// XYZW position (System Value Position)
+	float4 color		: COLOR;        // RGBA color
+	float3 normal		: NORMAL;
+	float3 worldPos		: POSITION;
+	float2 uv			: TEXCOORD;
+#if HAS_NORMAL_MAP
+	float3 tangent		: TANGENT;
+#endif
+#if USE_MATERIAL_ATLAS
+	nointerpolation uint materialSlice	: SLICE;
+#endif
+};
+
+#endif
@@ -0,0 +1,346 @@
+#include "MaterialCommon.hlsli"
+
+// Padded out to whole float4s so arrays of them have the same
+// stride in C++.  The C++ side of these and of every cbuffer is
+// generated into ShaderConstants.h by generate_shader_constants.py.
+struct DirectionalLight
+{
+	float3 ambientColor;
+	float padding1;
+	float3 diffuseColor;
+	float padding2;
+	float3 direction;		// Normalized by LightList
+	float padding3;
+};
+
+struct PointLight
+{
+	float3 ambientColor;
+	float padding1;
+	float3 diffuseColor;
+	float padding2;
+	float3 position;
+	float padding3;
+};
+
+#if USE_CLUSTERED_LIGHTS
+// Match ClusterLight in LightClusters.h
+struct ClusterLight
+{
+	float3 position;
+	float range;
+	float3 color;
+	float intensity;
+};
+
+struct ClusterParams
+{
+	float3 cameraForward;
+	float zScale;			// slice = log(viewZ) * zScale + zBias
+	float2 tileScale;		// Pixels to tiles
+	float zBias;
+	uint clustersX;
+	uint clustersY;
+	uint clustersZ;
+};
+#endif
+
+static const float F0_NON_METAL = 0.04f;// Minimum roughness for when spec distribution function denominator goes to zero
+static const float MIN_ROUGHNESS = 0.0000001f; // 6 zeros after decimal
+// Handy to have this as a constant
+static const float PI = 3.14159265359f;
+
+// Without PBR maps the surface is smooth and non-metal - the
+// same values sampling an unbound map used to give
+static const float DEFAULT_ROUGHNESS = 0.0f;
+static const float DEFAULT_METALNESS = 0.0f;
+
+SamplerState samplerOptions : register(s0);
+#if USE_MATERIAL_ATLAS
+// MaterialAtlas's channel packed arrays, sampled at the material's slice:
+// normals as x and y only, and roughness, metalness and AO in one map
+// (AO only darkens the image based ambient light)
+#define MATERIAL_UV(input) float3((input).uv, (input).materialSlice)
+Texture2DArray Albedo		: register(t0);
+Texture2DArray NormalMap	: register(t1);
+Texture2DArray SurfaceMap	: register(t2);
+#else
+#define MATERIAL_UV(input) (input).uv
+Texture2D Albedo			: register(t0);
+#if HAS_NORMAL_MAP
+Texture2D NormalMap			: register(t1);
+#endif
+#if HAS_PBR_MAPS
+Texture2D RoughnessMap		: register(t2);
+Texture2D MetalnessMap		: register(t3);
+#endif
+#endif
+#if USE_CLUSTERED_LIGHTS
+StructuredBuffer<ClusterLight> ClusterLights	: register(t4);
+StructuredBuffer<uint> ClusterLightIndices		: register(t5);
+StructuredBuffer<uint2> ClusterGrid				: register(t6);	// (offset, count) into ClusterLightIndices
+#endif
+#if USE_IMAGE_LIGHTING
+// Made by EnvironmentLighting: irradiance over pi, GGX prefiltered
+// radiance with roughness spread over the mips, and the BRDF's scale
+// and bias on F0 by (NdotV, roughness)
+TextureCube IrradianceMap		: register(t7);
+TextureCube SpecularMap			: register(t8);
+Texture2D BrdfLut				: register(t9);
+SamplerState EnvironmentSampler	: register(s1);	// Clamped, for the LUT's edges
+#endif
+
+// Calculates diffuse amount based on energy conservation
+//
+// diffuse - Diffuse amount
+// specular - Specular color (including light color)
+// metalness - surface metalness amount
+//
+// Metals should have an albedo of (0,0,0)...mostly
+// See slide 65: http://blog.selfshadow.com/publications/s2014-shading-course/hoffman/s2014_pbs_physics_math_slides.pdf
+float3 DiffuseEnergyConserve(float diffuse, float3 specular, float metalness)
+{
+	return diffuse * ((1 - saturate(specular)) * (1 - metalness));
+}
+
+// Fresnel term - Schlick approx.
+//
+// v - View vector
+// h - Half vector
+// f0 - Value when l = n (full specular color)
+//
+// F(v,h,f0) = f0 + (1-f0)(1 - (v dot h))^5
+float3 Fresnel(float3 v, float3 h, float3 f0)
+{
+	// Pre-calculations
+	float VdotH = saturate(dot(v, h));
+
+	// Final value
+	return f0 + (1 - f0) * pow(1 - VdotH, 5);
+}
+
+// Geometric Shadowing - Schlick-GGX (based on Schlick-Beckmann)
+// - k is remapped to a / 2, roughness remapped to (r+1)/2
+//
+// NdotX - Saturated dot of the normal with the light or view vector
+// k - From SurfacePoint
+//
+// G(l,v,h)
+float GeometricShadowing(float NdotX, float k)
+{
+	return NdotX / (NdotX * (1 - k) + k);
+}
+
+// Everything about the pixel that doesn't depend on the light,
+// worked out once before the light loops rather than per light
+struct SurfacePoint
+{
+	float3 normal;
+	float3 toCam;
+	float3 worldPos;
+	float3 albedo;
+	float3 specColor;
+	float metal;
+
+	float NdotV;		// Unsaturated, for the BRDF denominator
+	float a2;			// GGX alpha squared (roughness remapped, then clamped)
+	float k;			// Schlick-GGX k
+	float shadowingV;	// Schlick-GGX for the view vector
+};
+
+SurfacePoint MakeSurfacePoint(float3 normal, float3 toCam, float3 worldPos, float3 albedo, float roughness, float metal)
+{
+	SurfacePoint s;
+	s.normal = normal;
+	s.toCam = toCam;
+	s.worldPos = worldPos;
+	s.albedo = albedo;
+	s.specColor = lerp(F0_NON_METAL.rrr, albedo, metal);
+	s.metal = metal;
+
+	float a = roughness * roughness;
+	s.a2 = max(a * a, MIN_ROUGHNESS); // Applied after remap!
+	s.k = pow(roughness + 1, 2) / 8.0f;
+	s.NdotV = dot(normal, toCam);
+	s.shadowingV = GeometricShadowing(saturate(s.NdotV), s.k);
+	return s;
+}
+
+// Lambert diffuse plus the microfacet specular BRDF for one light
+//
+// f(l,v) = D(h)F(v,h)G(l,v,h) / 4(n dot l)(n dot v)
+// - part of the denominator are canceled out by numerator (see below)
+//
+// D() - Spec Dist - Trowbridge-Reitz (GGX)
+// F() - Fresnel - Schlick approx
+// G() - Geometric Shadowing - Schlick-GGX
+//
+// l - NORMALIZED direction to the light
+float3 ShadeLight(SurfacePoint s, float3 l, float3 lightColor)
+{
+	float3 h = normalize(s.toCam + l);
+	float NdotL = dot(s.normal, l);
+	float diffuse = saturate(NdotL);
+
+	// GGX (Trowbridge-Reitz): D(h, n) = a^2 / pi * ((n dot h)^2 * (a^2 - 1) + 1)^2
+	// Can go to zero if roughness is 0 and NdotH is 1
+	float NdotH = saturate(dot(s.normal, h));
+	float denomToSquare = NdotH * NdotH * (s.a2 - 1) + 1;
+	float D = s.a2 / (PI * denomToSquare * denomToSquare);
+
+	float3 F = Fresnel(s.toCam, h, s.specColor);
+	float G = s.shadowingV * GeometricShadowing(diffuse, s.k);
+
+	// Denominator dot products partially canceled by G()!
+	// See page 16: http://blog.selfshadow.com/publications/s2012-shading-course/hoffman/s2012_pbs_physics_math_notes.pdf
+	float3 specularity = (D * F * G) / (4 * max(s.NdotV, NdotL));
+	float3 balanced = DiffuseEnergyConserve(diffuse, specularity, s.metal);
+
+	return (balanced * s.albedo + specularity) * lightColor;
+}
+
+#if USE_IMAGE_LIGHTING
+// Ambient light from the sky, split sum style: the prefiltered
+// radiance along the reflection, scaled by the BRDF's response
+// to this view, plus irradiance for the diffuse part
+//
+// roughness - Before the GGX remap, as the maps were filtered
+// ao - Ambient occlusion, only applied here
+float3 ShadeEnvironment(SurfacePoint s, float roughness, float ao)
+{
+	float NdotV = saturate(s.NdotV);
+	float3 r = reflect(-s.toCam, s.normal);
+
+	uint width, height, mips;
+	SpecularMap.GetDimensions(0, width, height, mips);
+	float3 prefiltered = SpecularMap.SampleLevel(EnvironmentSampler, r, roughness * (mips - 1)).rgb;
+	float2 brdf = BrdfLut.SampleLevel(EnvironmentSampler, float2(NdotV, roughness), 0).rg;
+	float3 specular = s.specColor * brdf.x + brdf.y;
+
+	float3 irradiance = IrradianceMap.SampleLevel(EnvironmentSampler, s.normal, 0).rgb;
+	float3 diffuse = irradiance * s.albedo * (1 - specular) * (1 - s.metal);
+
+	return (diffuse + prefiltered * specular) * ao;
+}
+#endif
+
+// The arrays are sized for the most lights any variant takes, so the
+// layout is the same for every variant and the C++ side never has to
+// care how many a variant actually reads
+cbuffer ExternalData : register(b0)
+{
+	DirectionalLight dirLights[MAX_DIR_LIGHTS];
+	PointLight pointLights[MAX_POINT_LIGHTS];
+	float3 cameraPos;
+	float specExponent;
+}
+
+#if USE_CLUSTERED_LIGHTS
+cbuffer ClusterData : register(b1)
+{
+	ClusterParams clusterParams;
+}
+
+//the cluster this pixel falls in - same mapping LightClusters bins with
+uint getCluster(float2 pixel, float3 worldPos)
+{
+	float viewZ = max(dot(worldPos - cameraPos, clusterParams.cameraForward), 0.0001f);
+	uint x = min((uint)(pixel.x * clusterParams.tileScale.x), clusterParams.clustersX - 1);
+	uint y = min((uint)(pixel.y * clusterParams.tileScale.y), clusterParams.clustersY - 1);
+	uint z = (uint)clamp(log(viewZ) * clusterParams.zScale + clusterParams.zBias, 0.0f, (float)(clusterParams.clustersZ - 1));
+	return (z * clusterParams.clustersY + y) * clusterParams.clustersX + x;
+}
+#endif
+
+// --------------------------------------------------------
+// The entry point (main method) for our pixel shader
+//
+// - Input is the data coming down the pipeline (defined by the struct)
+// - Output is a single color (float4)
+// - Has a special semantic (SV_TARGET), which means
+//    "put the output of this into the current render target"
+// - Named "main" because that's the default the shader compiler looks for
+// --------------------------------------------------------
+float4 main(VertexToPixel input) : SV_TARGET
+{
+	float3 n = normalize(input.normal);
+
+#if HAS_NORMAL_MAP
+	//calculate the normal from the normal map
+#if USE_MATERIAL_ATLAS
+	//tangent space normals always face out, so z is the positive root
+	float2 packedNormal = NormalMap.Sample(samplerOptions, MATERIAL_UV(input)).rg * 2 - 1;
+	float3 unpackedNormal = float3(packedNormal, sqrt(saturate(1 - dot(packedNormal, packedNormal))));
+#else
+	float3 unpackedNormal = NormalMap.Sample(samplerOptions, MATERIAL_UV(input)).rgb * 2 - 1;
+#endif
+
+	float3 t = input.tangent;
+	t = normalize(t - n * dot(t, n));
+	float3 b = cross(t, n);
+	float3x3 tbn = float3x3(t, b, n);
+
+	n = normalize(mul(unpackedNormal, tbn));
+#endif
+
+	//albedo is an srgb texture, so this is already linear
+	float3 surfaceColor = Albedo.Sample(samplerOptions, MATERIAL_UV(input)).rgb;
+
+#if USE_MATERIAL_ATLAS
+	float3 surfaceMaps = SurfaceMap.Sample(samplerOptions, MATERIAL_UV(input)).rgb;
+	float roughness = surfaceMaps.r;
+	float metal = surfaceMaps.g;
+	float ao = surfaceMaps.b;
+#elif HAS_PBR_MAPS
+	float roughness = RoughnessMap.Sample(samplerOptions, MATERIAL_UV(input)).r;
+	float metal = MetalnessMap.Sample(samplerOptions, MATERIAL_UV(input)).r;
+	float ao = 1.0f;
+#else
+	float roughness = DEFAULT_ROUGHNESS;
+	float metal = DEFAULT_METALNESS;
+	float ao = 1.0f;
+#endif
+
+	float3 toCam = normalize(cameraPos - input.worldPos);
+	SurfacePoint surface = MakeSurfacePoint(n, toCam, input.worldPos, surfaceColor, roughness, metal);
+
+	//the loop counts are compile time constants, so each variant only
+	//evaluates (and unrolls) the lights it was compiled for
+	float3 finalColor = float3(0, 0, 0);
+
+#if USE_IMAGE_LIGHTING
+	finalColor += ShadeEnvironment(surface, roughness, ao);
+#endif
+
+	[unroll]
+	for (uint d = 0; d < NUM_DIR_LIGHTS; d++)
+	{
+		finalColor += ShadeLight(surface, -dirLights[d].direction, dirLights[d].ambientColor);
+	}
+
+	[unroll]
+	for (uint p = 0; p < NUM_POINT_LIGHTS; p++)
+	{
+		finalColor += ShadeLight(surface, normalize(pointLights[p].position - input.worldPos), pointLights[p].ambientColor);
+	}
+
+#if USE_CLUSTERED_LIGHTS
+	//only the lights binned into this pixel's cluster
+	uint2 cluster = ClusterGrid[getCluster(input.position.xy, input.worldPos)];
+	for (uint i = 0; i < cluster.y; i++)
+	{
+		ClusterLight cl = ClusterLights[ClusterLightIndices[cluster.x + i]];
+		float3 toLight = cl.position - input.worldPos;
+		float dist = length(toLight);
+
+		//fades to nothing at the range the light was binned with
+		float atten = saturate(1 - (dist * dist) / (cl.range * cl.range));
+		atten *= atten;
+
+		finalColor += ShadeLight(surface, toLight / max(dist, 0.0001f), cl.color * (cl.intensity * atten));
+	}
+#endif
+
+	//the back buffer view is srgb, so the output merger gamma encodes this
+	return float4(finalColor, 1);
+}
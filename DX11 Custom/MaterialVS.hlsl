@@ -0,0 +1,129 @@
+#include "MaterialCommon.hlsli"
+
+cbuffer ExternalData : register(b0)
+{
+	float4 colorTint;
+	float4x4 world;
+	float4x4 worldInverseTranspose;	// For normals, right under non-uniform scale
+	float4x4 viewProj;				// Cached by the camera, once per frame
+	uint materialSlice;		// Atlas only, and unused when instancing - it comes per instance
+}
+
+// Struct representing a single vertex worth of data
+// - This should match the vertex definition in our C++ code
+// - By "match", I mean the size, order and number of members
+// - The name of the struct itself is unimportant, but should be descriptive
+// - Each variable must have a semantic, which defines its usage
+struct VertexShaderInput
+{
+	// Data type
+	//  |
+	//  |   Name          Semantic
+	//  |    |                |
+	//  v    v                v
+	float3 position		: POSITION;     // XYZ position
+#if USE_COMPACT_VERTICES
+	float2 normal		: NORMAL;		// Octahedral
+	float2 uv			: TEXCOORD;
+	float4 tangent		: TANGENT;		// Octahedral in xy, handedness in w
+#else
+	float3 normal		: NORMAL;
+	float2 uv			: TEXCOORD;
+	float3 tangent		: TANGENT;
+#endif
+#if USE_INSTANCING
+	// "_PER_INSTANCE" puts this in input slot 1, one step per instance
+	float4x4 instanceWorld	: WORLD_PER_INSTANCE;
+#if USE_MATERIAL_ATLAS
+	uint instanceSlice		: SLICE_PER_INSTANCE;
+#endif
+#endif
+};
+
+#if USE_COMPACT_VERTICES
+// --------------------------------------------------------
+// Unit vector back from its octahedral encoding in [-1, 1]^2
+// (the inverse of OctEncode in Mesh.cpp)
+// --------------------------------------------------------
+float3 OctDecode(float2 e)
+{
+	float3 n = float3(e, 1.0f - abs(e.x) - abs(e.y));
+	float t = saturate(-n.z);
+	n.xy += n.xy >= 0.0f ? -t : t;
+	return normalize(n);
+}
+#endif
+
+#if USE_INSTANCING
+// --------------------------------------------------------
+// Transforms normals for a world matrix with no inverse
+// transpose at hand: the cofactors are the inverse transpose
+// times the determinant, so only the determinant's sign is
+// needed once the normal is normalized
+// --------------------------------------------------------
+float3x3 NormalMatrix(float3x3 m)
+{
+	float3x3 cofactors = float3x3(cross(m[1], m[2]), cross(m[2], m[0]), cross(m[0], m[1]));
+	return dot(m[0], cofactors[0]) < 0.0f ? -cofactors : cofactors;
+}
+#endif
+
+// --------------------------------------------------------
+// The entry point (main method) for our vertex shader
+//
+// - Input is exactly one vertex worth of data (defined by a struct)
+// - Output is a single struct of data to pass down the pipeline
+// - Named "main" because that's the default the shader compiler looks for
+// --------------------------------------------------------
+VertexToPixel main(VertexShaderInput input)
+{
+	// Set up output struct
+	VertexToPixel output;
+
+#if USE_INSTANCING
+	// Vertex data arrives row by row, unlike the column_major
+	// cbuffer matrix, so flip it to match
+	float4x4 objWorld = transpose(input.instanceWorld);
+	float3x3 normalWorld = NormalMatrix((float3x3)objWorld);
+#else
+	float4x4 objWorld = world;
+	float3x3 normalWorld = (float3x3)worldInverseTranspose;
+#endif
+
+#if USE_COMPACT_VERTICES
+	float3 normal = OctDecode(input.normal);
+	float3 tangent = OctDecode(input.tangent.xy);
+#else
+	float3 normal = input.normal;
+	float3 tangent = input.tangent;
+#endif
+
+	// To world space, then to clip space with the camera's combined
+	// matrix - two matrix-vector products, no matrix-matrix ones
+	float4 worldPos = mul(objWorld, float4(input.position, 1.0f));
+	output.position = mul(viewProj, worldPos);
+
+	// Pass the color through
+	// - The values will be interpolated per-pixel by the rasterizer
+	output.color = colorTint;
+
+	output.normal = mul(normalWorld, normal);
+
+	output.worldPos = worldPos.xyz;
+	output.uv = input.uv;
+
+#if HAS_NORMAL_MAP
+	output.tangent = mul((float3x3)objWorld, tangent);
+	output.tangent = normalize(output.tangent);
+#endif
+
+#if USE_MATERIAL_ATLAS && USE_INSTANCING
+	output.materialSlice = input.instanceSlice;
+#elif USE_MATERIAL_ATLAS
+	output.materialSlice = materialSlice;
+#endif
+
+	// Whatever we return will make its way through the pipeline to the
+	// next programmable stage we're using (the pixel shader for now)
+	return output;
+}
@@ -1,9 +1,27 @@
 #include "Mesh.h"
+#include <DirectXPackedVector.h>
 #include <vector>
+#include <math.h>
+#include <stdio.h>
+
+#ifndef _WIN32
+#define sscanf_s sscanf
+#endif
+
 using namespace DirectX;
+using namespace DirectX::PackedVector;
 
-Mesh::Mesh(const char* file, Microsoft::WRL::ComPtr<ID3D11Device> d3Device)
+Mesh::Mesh(const char* file, RenderBackend* backend, MeshVertexFormat format, GeometryArena* arena, bool keepSource)
 {
+	//empty until the buffers are made, in case the file doesn't open
+	bindings = {};
+	stats = {};
+	indices = 0;
+	boundsMin = boundsMax = XMFLOAT3(0, 0, 0);
+	this->format = format;
+	this->keepSource = keepSource;
+	this->arena = 0;
+
 	// NOTE: You'll need to #include <fstream>
 
 // File input object
@@ -18,7 +36,7 @@ Mesh::Mesh(const char* file, Microsoft::WRL::ComPtr<ID3D11Device> d3Device)
 	std::vector<XMFLOAT3> normals;       // Normals from the file
 	std::vector<XMFLOAT2> uvs;           // UVs from the file
 	std::vector<Vertex> verts;           // Verts we're assembling
-	std::vector<UINT> indices;           // Indices of these verts
+	std::vector<unsigned int> indices;          // Indices of these verts
 	unsigned int vertCounter = 0;        // Count of vertices/indices
 	char chars[100];                     // String for line reading
 
@@ -169,7 +187,7 @@ Mesh::Mesh(const char* file, Microsoft::WRL::ComPtr<ID3D11Device> d3Device)
 	//calculate tangent vectors
 	CalculateTangents(&verts[0], vertCounter, &indices[0], indices.size());
 	//create the buffers using the data
-	createBuffers(&verts[0], vertCounter, &indices[0], indices.size(), d3Device);
+	createBuffers(&verts[0], vertCounter, &indices[0], indices.size(), backend, arena);
 	// - At this point, "verts" is a vector of Vertex structs, and can be used
 	//    directly to create a vertex buffer:  &verts[0] is the address of the first vert
 	//
@@ -182,26 +200,34 @@ Mesh::Mesh(const char* file, Microsoft::WRL::ComPtr<ID3D11Device> d3Device)
 	//    one, you'll need to write some extra code to handle cases when you don't.
 }
 
-Mesh::Mesh(Vertex v[], int verts, unsigned int inds[], int numInds, Microsoft::WRL::ComPtr<ID3D11Device> d3Device) {
+Mesh::Mesh(Vertex v[], int verts, unsigned int inds[], int numInds, RenderBackend* backend, MeshVertexFormat format, GeometryArena* arena, bool keepSource) {
+	bindings = {};
+	stats = {};
+	this->format = format;
+	this->keepSource = keepSource;
+	this->arena = 0;
+
 	//create index and vertex buffers
-	createBuffers(v, verts, inds, numInds, d3Device);
+	createBuffers(v, verts, inds, numInds, backend, arena);
 }
 
 Mesh::~Mesh()
 {
-	
+	//hand the ranges back for the next mesh loaded
+	if (arena)
+		arena->Free(allocation);
 }
 
 
 
-Microsoft::WRL::ComPtr<ID3D11Buffer> Mesh::GetVertexBuffer()
+RenderBuffer* Mesh::GetVertexBuffer()
 {
-	return vertexBuffer;
+	return vertexBuffer.Get();
 }
 
-Microsoft::WRL::ComPtr<ID3D11Buffer> Mesh::GetIndexBuffer()
+RenderBuffer* Mesh::GetIndexBuffer()
 {
-	return indexBuffer;
+	return indexBuffer.Get();
 }
 
 int Mesh::GetIndexCount()
@@ -209,39 +235,116 @@ int Mesh::GetIndexCount()
 	return indices;
 }
 
+const MeshBindings& Mesh::GetBindings()
+{
+	return bindings;
+}
+
+const MeshVertexStats& Mesh::GetVertexStats()
+{
+	return stats;
+}
+
+const std::vector<Vertex>& Mesh::GetSourceVertices()
+{
+	return sourceVertices;
+}
+
+const std::vector<unsigned int>& Mesh::GetSourceIndices()
+{
+	return sourceIndices;
+}
+
+void Mesh::ReleaseSource()
+{
+	//swap with empties, clear() keeps the capacity
+	std::vector<Vertex>().swap(sourceVertices);
+	std::vector<unsigned int>().swap(sourceIndices);
+}
+
 //helper function to create the buffers
-void Mesh::createBuffers(Vertex v[], int verts, unsigned int inds[], int numInds, Microsoft::WRL::ComPtr<ID3D11Device> d3Device)
+void Mesh::createBuffers(Vertex v[], int verts, unsigned int inds[], int numInds, RenderBackend* backend, GeometryArena* arena)
 {
-	D3D11_BUFFER_DESC vbd;
-	vbd.Usage = D3D11_USAGE_IMMUTABLE;
-	vbd.ByteWidth = sizeof(Vertex) * verts;
-	vbd.BindFlags = D3D11_BIND_VERTEX_BUFFER;
-	vbd.CPUAccessFlags = 0;
-	vbd.MiscFlags = 0;
-	vbd.StructureByteStride = 0;
+	//compact meshes upload packed copies of the vertices
+	std::vector<CompactVertex> compact;
+	const void* vertexData = v;
+	unsigned int stride = sizeof(Vertex);
+	if (format == MESH_VERTEX_COMPACT) {
+		compact.resize(verts);
+		Compact(v, verts, compact.data());
+		vertexData = compact.data();
+		stride = sizeof(CompactVertex);
+	}
+
+	//16 bit indices whenever every vertex can be reached with them
+	std::vector<unsigned short> shortIndices;
+	const void* indexData = inds;
+	unsigned int indexSize = sizeof(unsigned int);
+	DXGI_FORMAT indexFormat = DXGI_FORMAT_R32_UINT;
+	if (verts <= 65536) {
+		shortIndices.assign(inds, inds + numInds);
+		indexData = shortIndices.data();
+		indexSize = sizeof(unsigned short);
+		indexFormat = DXGI_FORMAT_R16_UINT;
+	}
 
-	D3D11_SUBRESOURCE_DATA initialVertexData;
-	initialVertexData.pSysMem = v;
+	indices = numInds;
+	bindings.stride = stride;
+	bindings.offset = 0;
+	bindings.indexFormat = indexFormat;
+	bindings.indexCount = numInds;
+
+	//into the arena if it takes this layout and has room, sharing its buffers
+	if (arena && arena->GetStride() == stride && arena->GetIndexFormat() == indexFormat &&
+		arena->Allocate(vertexData, verts, indexData, numInds, &allocation)) {
+		this->arena = arena;
+		vertexBuffer = arena->GetVertexBuffer();
+		indexBuffer = arena->GetIndexBuffer();
+		bindings.startIndex = allocation.startIndex;
+		bindings.baseVertex = (int)allocation.baseVertex;
+	}
+	else {
+		BufferDesc vbd = {};
+		vbd.Usage = RENDER_USAGE_IMMUTABLE;
+		vbd.ByteWidth = stride * verts;
+		vbd.BindFlags = RENDER_BIND_VERTEX_BUFFER;
 
-	d3Device->CreateBuffer(&vbd, &initialVertexData, vertexBuffer.GetAddressOf());
+		backend->CreateBuffer(vbd, vertexData, vertexBuffer.ReleaseAndGetAddressOf());
 
-	//index buffer
-	D3D11_BUFFER_DESC ibd;
-	ibd.Usage = D3D11_USAGE_IMMUTABLE;
-	ibd.ByteWidth = sizeof(unsigned int) * numInds;
-	ibd.BindFlags = D3D11_BIND_INDEX_BUFFER;
-	ibd.CPUAccessFlags = 0;
-	ibd.MiscFlags = 0;
-	ibd.StructureByteStride = 0;
+		//index buffer
+		BufferDesc ibd = {};
+		ibd.Usage = RENDER_USAGE_IMMUTABLE;
+		ibd.ByteWidth = indexSize * numInds;
+		ibd.BindFlags = RENDER_BIND_INDEX_BUFFER;
 
+		backend->CreateBuffer(ibd, indexData, indexBuffer.ReleaseAndGetAddressOf());
 
-	D3D11_SUBRESOURCE_DATA initialIndexData;
-	initialIndexData.pSysMem = inds;
+		bindings.startIndex = 0;
+		bindings.baseVertex = 0;
+	}
 
+	//bake the bindings, the buffers outlive every draw that borrows them
+	bindings.vertexBuffer = vertexBuffer.Get();
+	bindings.indexBuffer = indexBuffer.Get();
 
-	d3Device->CreateBuffer(&ibd, &initialIndexData, indexBuffer.GetAddressOf());
+	stats.format = format;
+	stats.vertexCount = verts;
+	stats.indexCount = numInds;
+	stats.vertexBytes = stride * verts;
+	stats.indexBytes = indexSize * numInds;
+	stats.fullBytes = sizeof(Vertex) * verts + sizeof(unsigned int) * numInds;
 
-	indices = numInds;
+	if (keepSource) {
+		sourceVertices.assign(v, v + verts);
+		sourceIndices.assign(inds, inds + numInds);
+	}
+
+	//bounding box of the vertex positions
+	boundsMin = boundsMax = verts > 0 ? v[0].Position : XMFLOAT3(0, 0, 0);
+	for (int i = 1; i < verts; i++) {
+		XMStoreFloat3(&boundsMin, XMVectorMin(XMLoadFloat3(&boundsMin), XMLoadFloat3(&v[i].Position)));
+		XMStoreFloat3(&boundsMax, XMVectorMax(XMLoadFloat3(&boundsMax), XMLoadFloat3(&v[i].Position)));
+	}
 }
 
 void Mesh::CalculateTangents(Vertex* verts, int numVerts, unsigned int* indices, int numIndices)
@@ -315,3 +418,120 @@ void Mesh::CalculateTangents(Vertex* verts, int numVerts, unsigned int* indices,
 		XMStoreFloat3(&verts[i].tangent, tangent);
 	}
 }
+
+//octahedral encoding: project onto the octahedron |x|+|y|+|z| = 1,
+//then fold the lower half over the diagonals so it fits in a square
+XMFLOAT2 Mesh::OctEncode(XMFLOAT3 n)
+{
+	float sum = fabsf(n.x) + fabsf(n.y) + fabsf(n.z);
+	if (sum <= 0.0f)
+		return XMFLOAT2(0, 0);
+
+	float x = n.x / sum;
+	float y = n.y / sum;
+	if (n.z < 0.0f) {
+		float foldX = (1.0f - fabsf(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+		float foldY = (1.0f - fabsf(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+		x = foldX;
+		y = foldY;
+	}
+	return XMFLOAT2(x, y);
+}
+
+//matches OctDecode in MaterialVS.hlsl
+XMFLOAT3 Mesh::OctDecode(XMFLOAT2 e)
+{
+	XMFLOAT3 n(e.x, e.y, 1.0f - fabsf(e.x) - fabsf(e.y));
+	float t = n.z < 0.0f ? -n.z : 0.0f;
+	n.x += n.x >= 0.0f ? -t : t;
+	n.y += n.y >= 0.0f ? -t : t;
+	XMStoreFloat3(&n, XMVector3Normalize(XMLoadFloat3(&n)));
+	return n;
+}
+
+//snorm conversions, rounded to nearest like the hardware expects
+static short ToSnorm16(float v)
+{
+	v = v < -1.0f ? -1.0f : (v > 1.0f ? 1.0f : v);
+	return (short)floorf(v * 32767.0f + 0.5f);
+}
+
+static signed char ToSnorm8(float v)
+{
+	v = v < -1.0f ? -1.0f : (v > 1.0f ? 1.0f : v);
+	return (signed char)floorf(v * 127.0f + 0.5f);
+}
+
+static float FromSnorm16(short v)
+{
+	float f = v / 32767.0f;
+	return f < -1.0f ? -1.0f : f;
+}
+
+static float FromSnorm8(signed char v)
+{
+	float f = v / 127.0f;
+	return f < -1.0f ? -1.0f : f;
+}
+
+//angle between two unit vectors, in degrees
+static float AngleDegrees(XMFLOAT3 a, XMFLOAT3 b)
+{
+	float d = XMVectorGetX(XMVector3Dot(XMVector3Normalize(XMLoadFloat3(&a)), XMVector3Normalize(XMLoadFloat3(&b))));
+	d = d < -1.0f ? -1.0f : (d > 1.0f ? 1.0f : d);
+	return XMConvertToDegrees(acosf(d));
+}
+
+//packs each vertex, then decodes it again the way the vertex shader
+//will and keeps the worst error of each attribute
+void Mesh::Compact(const Vertex v[], int verts, CompactVertex* compact)
+{
+	stats.maxPositionError = 0;
+	stats.maxNormalDegrees = 0;
+	stats.maxTangentDegrees = 0;
+	stats.maxUVError = 0;
+
+	for (int i = 0; i < verts; i++) {
+		const Vertex& src = v[i];
+		CompactVertex& dst = compact[i];
+
+		dst.Position[0] = XMConvertFloatToHalf(src.Position.x);
+		dst.Position[1] = XMConvertFloatToHalf(src.Position.y);
+		dst.Position[2] = XMConvertFloatToHalf(src.Position.z);
+		dst.Position[3] = XMConvertFloatToHalf(1.0f);
+
+		XMFLOAT2 normal = OctEncode(src.normal);
+		dst.normal[0] = ToSnorm16(normal.x);
+		dst.normal[1] = ToSnorm16(normal.y);
+
+		dst.uv[0] = XMConvertFloatToHalf(src.uv.x);
+		dst.uv[1] = XMConvertFloatToHalf(src.uv.y);
+
+		//the shaders rebuild the bitangent as cross(tangent, normal),
+		//so the handedness is always +1 for now
+		XMFLOAT2 tangent = OctEncode(src.tangent);
+		dst.tangent[0] = ToSnorm8(tangent.x);
+		dst.tangent[1] = ToSnorm8(tangent.y);
+		dst.tangent[2] = 0;
+		dst.tangent[3] = 127;
+
+		//decode and compare
+		XMFLOAT3 position(
+			XMConvertHalfToFloat(dst.Position[0]),
+			XMConvertHalfToFloat(dst.Position[1]),
+			XMConvertHalfToFloat(dst.Position[2]));
+		float positionError = XMVectorGetX(XMVector3Length(XMVectorSubtract(XMLoadFloat3(&position), XMLoadFloat3(&src.Position))));
+
+		XMFLOAT3 decodedNormal = OctDecode(XMFLOAT2(FromSnorm16(dst.normal[0]), FromSnorm16(dst.normal[1])));
+		XMFLOAT3 decodedTangent = OctDecode(XMFLOAT2(FromSnorm8(dst.tangent[0]), FromSnorm8(dst.tangent[1])));
+
+		float uvError = fmaxf(
+			fabsf(XMConvertHalfToFloat(dst.uv[0]) - src.uv.x),
+			fabsf(XMConvertHalfToFloat(dst.uv[1]) - src.uv.y));
+
+		stats.maxPositionError = fmaxf(stats.maxPositionError, positionError);
+		stats.maxNormalDegrees = fmaxf(stats.maxNormalDegrees, AngleDegrees(src.normal, decodedNormal));
+		stats.maxTangentDegrees = fmaxf(stats.maxTangentDegrees, AngleDegrees(src.tangent, decodedTangent));
+		stats.maxUVError = fmaxf(stats.maxUVError, uvError);
+	}
+}
@@ -1,27 +1,102 @@
 #pragma once
 #include <DirectXMath.h>
-#include <wrl/event.h>
-#include <d3d11.h>
 #include "Vertex.h"
+#include "GeometryArena.h"
 #include <fstream>
+#include <vector>
 
+//everything a draw of the mesh binds, baked when the buffers are made.
+//the pointers are borrowed from the mesh, so copying this costs no refcounting.
+//a mesh in a geometry arena binds the arena's buffers and draws from its
+//start index and base vertex, both 0 for a mesh with its own buffers
+struct MeshBindings
+{
+	RenderBuffer* vertexBuffer;
+	RenderBuffer* indexBuffer;
+	unsigned int stride;
+	unsigned int offset;
+	DXGI_FORMAT indexFormat;
+	unsigned int indexCount;
+	unsigned int startIndex;
+	int baseVertex;
+};
+
+//which vertex struct the vertex buffer holds.  compact meshes need
+//shader variants with MATERIAL_FEATURE_COMPACT_VERTICES
+enum MeshVertexFormat
+{
+	MESH_VERTEX_FULL,		//Vertex
+	MESH_VERTEX_COMPACT		//CompactVertex
+};
+
+//buffer sizes against full floats and 32 bit indices, and how far the
+//compact vertices drift from the originals once decoded
+struct MeshVertexStats
+{
+	MeshVertexFormat format;
+	unsigned int vertexCount;
+	unsigned int indexCount;
+	unsigned int vertexBytes;
+	unsigned int indexBytes;
+	unsigned int fullBytes;			//same mesh as Vertex with 32 bit indices
+
+	float maxPositionError;			//object space units
+	float maxNormalDegrees;
+	float maxTangentDegrees;
+	float maxUVError;
+};
 
 class Mesh
 {
 public:
-	Mesh(const char* file, Microsoft::WRL::ComPtr<ID3D11Device> d3Device);
-	Mesh(Vertex v[], int verts, unsigned int inds[], int numInds, Microsoft::WRL::ComPtr<ID3D11Device> d3Device);
+	//with an arena, the mesh is suballocated from it when the vertex stride and
+	//index format match and there's room, and gets its own buffers otherwise.
+	//keepSource holds on to the full float vertices and indices after upload,
+	//for callers that batch the mesh or draw it in software
+	Mesh(const char* file, RenderBackend* backend, MeshVertexFormat format = MESH_VERTEX_FULL, GeometryArena* arena = 0, bool keepSource = false);
+	Mesh(Vertex v[], int verts, unsigned int inds[], int numInds, RenderBackend* backend, MeshVertexFormat format = MESH_VERTEX_FULL, GeometryArena* arena = 0, bool keepSource = false);
 	~Mesh();
-	//vertex and index buffers
-	Microsoft::WRL::ComPtr<ID3D11Buffer> vertexBuffer;
-	Microsoft::WRL::ComPtr<ID3D11Buffer> indexBuffer;
+	//vertex and index buffers, the arena's when the mesh is in one
+	RenderRef<RenderBuffer> vertexBuffer;
+	RenderRef<RenderBuffer> indexBuffer;
 	int indices;
 
-	//vertext index buffer get functions
-	Microsoft::WRL::ComPtr<ID3D11Buffer> GetVertexBuffer();
-	Microsoft::WRL::ComPtr<ID3D11Buffer> GetIndexBuffer();
+	//object space bounding box, for culling
+	DirectX::XMFLOAT3 boundsMin;
+	DirectX::XMFLOAT3 boundsMax;
+
+	//vertext index buffer get functions, non-owning
+	RenderBuffer* GetVertexBuffer();
+	RenderBuffer* GetIndexBuffer();
 	int GetIndexCount();
-	void createBuffers(Vertex v[], int verts, unsigned int inds[], int numInds, Microsoft::WRL::ComPtr<ID3D11Device> d3Device);
+	const MeshBindings& GetBindings();
+	const MeshVertexStats& GetVertexStats();
+
+	//the full float vertices and indices the buffers were made from, empty
+	//unless the mesh was made with keepSource or once they're released
+	const std::vector<Vertex>& GetSourceVertices();
+	const std::vector<unsigned int>& GetSourceIndices();
+	void ReleaseSource();
+	void createBuffers(Vertex v[], int verts, unsigned int inds[], int numInds, RenderBackend* backend, GeometryArena* arena = 0);
 	void CalculateTangents(Vertex* verts, int numVerts, unsigned int* indices, int numIndices);
+
+	//octahedral encoding of a unit vector into [-1, 1]^2, and back
+	static DirectX::XMFLOAT2 OctEncode(DirectX::XMFLOAT3 n);
+	static DirectX::XMFLOAT3 OctDecode(DirectX::XMFLOAT2 e);
+
+private:
+	MeshBindings bindings;
+	MeshVertexFormat format;
+	MeshVertexStats stats;
+	bool keepSource;
+	std::vector<Vertex> sourceVertices;
+	std::vector<unsigned int> sourceIndices;
+
+	//the arena the mesh was allocated from, null if it has its own buffers
+	GeometryArena* arena;
+	GeometryAllocation allocation;
+
+	//packs v into compact, filling in the precision stats
+	void Compact(const Vertex v[], int verts, CompactVertex* compact);
 };
 
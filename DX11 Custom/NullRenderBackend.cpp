@@ -0,0 +1,266 @@
+#include "NullRenderBackend.h"
+#include <string.h>
+#include <wchar.h>
+
+// --------------------------------------------------------
+// The objects the null backend hands out.  Buffers keep
+// their size so maps can hand out enough memory.
+// --------------------------------------------------------
+template<typename Handle>
+class NullObject : public Handle
+{
+};
+
+class NullBuffer : public RenderBuffer
+{
+public:
+	NullBuffer(unsigned int byteWidth) : byteWidth(byteWidth) {}
+	unsigned int byteWidth;
+};
+
+class NullTexture : public RenderTexture
+{
+};
+
+NullRenderBackend::NullRenderBackend()
+{
+	this->recording = false;
+	this->frames = 0;
+	this->backBuffer = new NullTexture();
+	this->depthBuffer = new NullTexture();
+	memset(counts, 0, sizeof(counts));
+	memset(lastFrameCounts, 0, sizeof(lastFrameCounts));
+}
+
+NullRenderBackend::~NullRenderBackend()
+{
+	backBuffer->Release();
+	depthBuffer->Release();
+}
+
+// --------------------------------------------------------
+// The stand in targets don't hold any pixels, so they're
+// kept as they are
+// --------------------------------------------------------
+bool NullRenderBackend::Resize(unsigned int width, unsigned int height)
+{
+	SetRenderTargets(backBuffer, depthBuffer);
+	SetViewport((float)width, (float)height);
+	return true;
+}
+
+// --------------------------------------------------------
+// Counts the command, and keeps it if recording
+// --------------------------------------------------------
+void NullRenderBackend::Record(RenderCommand type, const void* object, unsigned int arg0, unsigned int arg1, unsigned int arg2)
+{
+	counts[type]++;
+	if (!recording)
+		return;
+
+	RecordedCommand command;
+	command.Type = type;
+	command.Object = object;
+	command.Args[0] = arg0;
+	command.Args[1] = arg1;
+	command.Args[2] = arg2;
+	commands.push_back(command);
+}
+
+// --------------------------------------------------------
+// Creation always succeeds
+// --------------------------------------------------------
+bool NullRenderBackend::CreateBuffer(const BufferDesc& desc, const void* initialData, RenderBuffer** buffer)
+{
+	*buffer = new NullBuffer(desc.ByteWidth);
+	return true;
+}
+
+void* NullRenderBackend::Map(RenderBuffer* buffer, RenderMap mapType)
+{
+	unsigned int byteWidth = static_cast<NullBuffer*>(buffer)->byteWidth;
+	if (scratch.size() < byteWidth)
+		scratch.resize(byteWidth);
+
+	Record(RENDER_COMMAND_MAP, buffer, mapType, byteWidth);
+	return scratch.data();
+}
+
+void NullRenderBackend::Unmap(RenderBuffer* buffer)
+{
+}
+
+void NullRenderBackend::UpdateBuffer(RenderBuffer* buffer, unsigned int offset, const void* data, unsigned int size)
+{
+	Record(RENDER_COMMAND_UPDATE_BUFFER, buffer, offset, size);
+}
+
+bool NullRenderBackend::LoadTexture(const wchar_t* file, RenderTexture** texture, bool srgb)
+{
+	*texture = new NullTexture();
+	return true;
+}
+
+bool NullRenderBackend::CreateTexture(const TextureDesc& desc, const SubresourceData* initialData, RenderTexture** texture)
+{
+	*texture = new NullTexture();
+	return true;
+}
+
+bool NullRenderBackend::CreateVertexShader(const void* byteCode, size_t byteCodeSize, RenderVertexShader** shader)
+{
+	*shader = new NullObject<RenderVertexShader>();
+	return true;
+}
+
+bool NullRenderBackend::CreatePixelShader(const void* byteCode, size_t byteCodeSize, RenderPixelShader** shader)
+{
+	*shader = new NullObject<RenderPixelShader>();
+	return true;
+}
+
+bool NullRenderBackend::CreateInputLayout(const InputElementDesc* elements, unsigned int elementCount, const void* byteCode, size_t byteCodeSize, RenderInputLayout** layout)
+{
+	*layout = new NullObject<RenderInputLayout>();
+	return true;
+}
+
+bool NullRenderBackend::CreateSamplerState(const SamplerDesc& desc, RenderSamplerState** state)
+{
+	*state = new NullObject<RenderSamplerState>();
+	return true;
+}
+
+bool NullRenderBackend::CreateRasterizerState(const RasterizerDesc& desc, RenderRasterizerState** state)
+{
+	*state = new NullObject<RenderRasterizerState>();
+	return true;
+}
+
+bool NullRenderBackend::CreateDepthStencilState(const DepthStencilDesc& desc, RenderDepthStencilState** state)
+{
+	*state = new NullObject<RenderDepthStencilState>();
+	return true;
+}
+
+bool NullRenderBackend::CreateBlendState(const BlendDesc& desc, RenderBlendState** state)
+{
+	*state = new NullObject<RenderBlendState>();
+	return true;
+}
+
+// --------------------------------------------------------
+// Binding and drawing are only recorded
+// --------------------------------------------------------
+void NullRenderBackend::SetInputLayout(RenderInputLayout* layout)
+{
+	Record(RENDER_COMMAND_SET_INPUT_LAYOUT, layout);
+}
+
+void NullRenderBackend::SetVertexShader(RenderVertexShader* shader)
+{
+	Record(RENDER_COMMAND_SET_VERTEX_SHADER, shader);
+}
+
+void NullRenderBackend::SetPixelShader(RenderPixelShader* shader)
+{
+	Record(RENDER_COMMAND_SET_PIXEL_SHADER, shader);
+}
+
+void NullRenderBackend::SetConstantBuffer(ShaderStage stage, unsigned int slot, RenderBuffer* buffer, unsigned int firstConstant, unsigned int numConstants)
+{
+	Record(RENDER_COMMAND_SET_CONSTANT_BUFFER, buffer, stage, slot, firstConstant);
+}
+
+void NullRenderBackend::SetShaderResources(ShaderStage stage, unsigned int startSlot, unsigned int count, RenderResource* const* resources)
+{
+	Record(RENDER_COMMAND_SET_SHADER_RESOURCE, count > 0 ? resources[0] : 0, stage, startSlot, count);
+}
+
+void NullRenderBackend::SetSamplers(ShaderStage stage, unsigned int startSlot, unsigned int count, RenderSamplerState* const* samplers)
+{
+	Record(RENDER_COMMAND_SET_SAMPLER, count > 0 ? samplers[0] : 0, stage, startSlot, count);
+}
+
+void NullRenderBackend::SetVertexBuffers(unsigned int startSlot, unsigned int numBuffers, RenderBuffer* const* buffers, const unsigned int* strides, const unsigned int* offsets)
+{
+	Record(RENDER_COMMAND_SET_VERTEX_BUFFERS, numBuffers > 0 ? buffers[0] : 0, startSlot, numBuffers);
+}
+
+void NullRenderBackend::SetIndexBuffer(RenderBuffer* buffer, DXGI_FORMAT format, unsigned int offset)
+{
+	Record(RENDER_COMMAND_SET_INDEX_BUFFER, buffer, format, offset);
+}
+
+void NullRenderBackend::SetPrimitiveTopology(RenderTopology topology)
+{
+	Record(RENDER_COMMAND_SET_TOPOLOGY, 0, topology);
+}
+
+void NullRenderBackend::SetRasterizerState(RenderRasterizerState* state)
+{
+	Record(RENDER_COMMAND_SET_RASTERIZER, state);
+}
+
+void NullRenderBackend::SetDepthStencilState(RenderDepthStencilState* state, unsigned int stencilRef)
+{
+	Record(RENDER_COMMAND_SET_DEPTH_STENCIL, state, stencilRef);
+}
+
+void NullRenderBackend::SetBlendState(RenderBlendState* state)
+{
+	Record(RENDER_COMMAND_SET_BLEND, state);
+}
+
+void NullRenderBackend::SetRenderTargets(RenderTexture* renderTarget, RenderTexture* depthTarget)
+{
+	Record(RENDER_COMMAND_SET_RENDER_TARGETS, renderTarget);
+}
+
+void NullRenderBackend::SetViewport(float width, float height)
+{
+	Record(RENDER_COMMAND_SET_VIEWPORT, 0, (unsigned int)width, (unsigned int)height);
+}
+
+// --------------------------------------------------------
+// Characters are measured at half the height wide
+// --------------------------------------------------------
+void NullRenderBackend::MeasureString(const wchar_t* text, float* width, float* height)
+{
+	*width = wcslen(text) * 16.0f;
+	*height = 32.0f;
+}
+
+void NullRenderBackend::DrawString(const wchar_t* text, float x, float y, const float color[4], float originX, float originY)
+{
+	Record(RENDER_COMMAND_DRAW_STRING, text, (unsigned int)wcslen(text));
+}
+
+void NullRenderBackend::Clear(const float color[4], float depth)
+{
+	Record(RENDER_COMMAND_CLEAR, 0);
+}
+
+void NullRenderBackend::DrawIndexed(unsigned int indexCount, unsigned int startIndex, int baseVertex)
+{
+	Record(RENDER_COMMAND_DRAW_INDEXED, 0, indexCount, startIndex, (unsigned int)baseVertex);
+}
+
+void NullRenderBackend::Draw(unsigned int vertexCount, unsigned int startVertex)
+{
+	Record(RENDER_COMMAND_DRAW, 0, vertexCount, startVertex);
+}
+
+// --------------------------------------------------------
+// Ends the frame - publishes its counts and commands
+// --------------------------------------------------------
+void NullRenderBackend::Present()
+{
+	memcpy(lastFrameCounts, counts, sizeof(counts));
+	memset(counts, 0, sizeof(counts));
+
+	lastFrameCommands.swap(commands);
+	commands.clear();
+
+	frames++;
+}
@@ -0,0 +1,132 @@
+#pragma once
+#include <vector>
+#include "RenderBackend.h"
+
+// --------------------------------------------------------
+// The kinds of commands the null backend counts and records
+// --------------------------------------------------------
+enum RenderCommand
+{
+	RENDER_COMMAND_MAP,
+	RENDER_COMMAND_UPDATE_BUFFER,
+	RENDER_COMMAND_SET_INPUT_LAYOUT,
+	RENDER_COMMAND_SET_VERTEX_SHADER,
+	RENDER_COMMAND_SET_PIXEL_SHADER,
+	RENDER_COMMAND_SET_CONSTANT_BUFFER,
+	RENDER_COMMAND_SET_SHADER_RESOURCE,
+	RENDER_COMMAND_SET_SAMPLER,
+	RENDER_COMMAND_SET_VERTEX_BUFFERS,
+	RENDER_COMMAND_SET_INDEX_BUFFER,
+	RENDER_COMMAND_SET_TOPOLOGY,
+	RENDER_COMMAND_SET_RASTERIZER,
+	RENDER_COMMAND_SET_DEPTH_STENCIL,
+	RENDER_COMMAND_SET_BLEND,
+	RENDER_COMMAND_SET_RENDER_TARGETS,
+	RENDER_COMMAND_SET_VIEWPORT,
+	RENDER_COMMAND_CLEAR,
+	RENDER_COMMAND_DRAW_INDEXED,
+	RENDER_COMMAND_DRAW,
+	RENDER_COMMAND_DRAW_STRING,
+	RENDER_COMMAND_COUNT
+};
+
+// --------------------------------------------------------
+// One recorded command.  Object is whatever was bound (or
+// mapped); the args are slot/stage/counts as the command uses
+// them.
+// --------------------------------------------------------
+struct RecordedCommand
+{
+	RenderCommand Type;
+	const void* Object;
+	unsigned int Args[3];
+};
+
+// --------------------------------------------------------
+// A backend that renders nothing, and needs neither a GPU
+// nor Windows.  Creation always succeeds with empty objects
+// (shaders accept any byte code, textures aren't read), and
+// every context call is dropped and counted, and optionally
+// recorded, so the frame loop's CPU cost can be measured on
+// its own.
+// --------------------------------------------------------
+class NullRenderBackend : public RenderBackend
+{
+public:
+	NullRenderBackend();
+	~NullRenderBackend();
+
+	// Keep a full command list per frame, not just counts
+	void SetRecording(bool record) { recording = record; }
+	const std::vector<RecordedCommand>& GetCommands() { return lastFrameCommands; }
+
+	// Counts for the last presented frame
+	unsigned int GetCommandCount(RenderCommand type) { return lastFrameCounts[type]; }
+	unsigned int GetFrameCount() { return frames; }
+
+	RenderTexture* GetBackBuffer() { return backBuffer; }
+	RenderTexture* GetDepthBuffer() { return depthBuffer; }
+	bool Resize(unsigned int width, unsigned int height);
+
+	bool CreateBuffer(const BufferDesc& desc, const void* initialData, RenderBuffer** buffer);
+	void* Map(RenderBuffer* buffer, RenderMap mapType);
+	void Unmap(RenderBuffer* buffer);
+	void UpdateBuffer(RenderBuffer* buffer, unsigned int offset, const void* data, unsigned int size);
+	bool SupportsConstantBufferOffsets() { return true; }
+
+	bool LoadTexture(const wchar_t* file, RenderTexture** texture, bool srgb = false);
+	bool CreateTexture(const TextureDesc& desc, const SubresourceData* initialData, RenderTexture** texture);
+
+	bool CreateVertexShader(const void* byteCode, size_t byteCodeSize, RenderVertexShader** shader);
+	bool CreatePixelShader(const void* byteCode, size_t byteCodeSize, RenderPixelShader** shader);
+	bool CreateInputLayout(const InputElementDesc* elements, unsigned int elementCount, const void* byteCode, size_t byteCodeSize, RenderInputLayout** layout);
+
+	bool CreateSamplerState(const SamplerDesc& desc, RenderSamplerState** state);
+	bool CreateRasterizerState(const RasterizerDesc& desc, RenderRasterizerState** state);
+	bool CreateDepthStencilState(const DepthStencilDesc& desc, RenderDepthStencilState** state);
+	bool CreateBlendState(const BlendDesc& desc, RenderBlendState** state);
+
+	void SetInputLayout(RenderInputLayout* layout);
+	void SetVertexShader(RenderVertexShader* shader);
+	void SetPixelShader(RenderPixelShader* shader);
+	void SetConstantBuffer(ShaderStage stage, unsigned int slot, RenderBuffer* buffer, unsigned int firstConstant, unsigned int numConstants);
+	void SetShaderResources(ShaderStage stage, unsigned int startSlot, unsigned int count, RenderResource* const* resources);
+	void SetSamplers(ShaderStage stage, unsigned int startSlot, unsigned int count, RenderSamplerState* const* samplers);
+	void SetVertexBuffers(unsigned int startSlot, unsigned int numBuffers, RenderBuffer* const* buffers, const unsigned int* strides, const unsigned int* offsets);
+	void SetIndexBuffer(RenderBuffer* buffer, DXGI_FORMAT format, unsigned int offset);
+	void SetPrimitiveTopology(RenderTopology topology);
+	void SetRasterizerState(RenderRasterizerState* state);
+	void SetDepthStencilState(RenderDepthStencilState* state, unsigned int stencilRef);
+	void SetBlendState(RenderBlendState* state);
+
+	void SetRenderTargets(RenderTexture* renderTarget, RenderTexture* depthTarget);
+	void SetViewport(float width, float height);
+
+	// Text is measured as if every character were a fixed size
+	bool LoadFont(const wchar_t* file) { return true; }
+	void MeasureString(const wchar_t* text, float* width, float* height);
+	void BeginText() {}
+	void DrawString(const wchar_t* text, float x, float y, const float color[4], float originX, float originY);
+	void EndText() {}
+
+	void Clear(const float color[4], float depth);
+	void DrawIndexed(unsigned int indexCount, unsigned int startIndex, int baseVertex);
+	void Draw(unsigned int vertexCount, unsigned int startVertex);
+	void Present();
+
+private:
+	RenderTexture* backBuffer;
+	RenderTexture* depthBuffer;
+
+	bool recording;
+	std::vector<RecordedCommand> commands;
+	std::vector<RecordedCommand> lastFrameCommands;
+	unsigned int counts[RENDER_COMMAND_COUNT];
+	unsigned int lastFrameCounts[RENDER_COMMAND_COUNT];
+	unsigned int frames;
+
+	// Maps hand out this memory, so writes still cost what they would
+	std::vector<unsigned char> scratch;
+
+	void Record(RenderCommand type, const void* object, unsigned int arg0 = 0, unsigned int arg1 = 0, unsigned int arg2 = 0);
+};
@@ -0,0 +1,349 @@
+#include "OcclusionCuller.h"
+#include <xmmintrin.h>
+#include <algorithm>
+#include <chrono>
+#include <math.h>
+#include <float.h>
+#include <string.h>
+
+using namespace DirectX;
+
+// Corner indices of the 12 triangles of a box, where corner i
+// takes max x if bit 0 is set, max y for bit 1 and max z for bit 2
+static const unsigned char BOX_TRIANGLES[12][3] =
+{
+	{ 0, 2, 6 }, { 0, 6, 4 },	// -x
+	{ 1, 5, 7 }, { 1, 7, 3 },	// +x
+	{ 0, 4, 5 }, { 0, 5, 1 },	// -y
+	{ 2, 3, 7 }, { 2, 7, 6 },	// +y
+	{ 0, 1, 3 }, { 0, 3, 2 },	// -z
+	{ 4, 6, 7 }, { 4, 7, 5 },	// +z
+};
+
+OcclusionCuller::OcclusionCuller(unsigned int width, unsigned int height)
+{
+	this->width = width;
+	this->height = height;
+	this->tilesX = width / OCCLUSION_TILE_WIDTH;
+	this->tilesY = height / OCCLUSION_TILE_HEIGHT;
+
+	depth.resize(width * height, 1.0f);
+	tileMax.resize(tilesX * tilesY, 1.0f);
+	tilesDirty = false;
+
+	XMStoreFloat4x4(&viewProj, XMMatrixIdentity());
+	memset(&stats, 0, sizeof(stats));
+}
+
+void OcclusionCuller::BeginFrame(const XMFLOAT4X4& view, const XMFLOAT4X4& proj)
+{
+	XMStoreFloat4x4(&viewProj, XMMatrixMultiply(XMLoadFloat4x4(&view), XMLoadFloat4x4(&proj)));
+
+	std::fill(depth.begin(), depth.end(), 1.0f);
+	std::fill(tileMax.begin(), tileMax.end(), 1.0f);
+	tilesDirty = false;
+
+	memset(&stats, 0, sizeof(stats));
+}
+
+void OcclusionCuller::TransformBox(const XMFLOAT4X4& world, const XMFLOAT3& boundsMin, const XMFLOAT3& boundsMax, XMFLOAT4* clip)
+{
+	XMMATRIX wvp = XMMatrixMultiply(XMLoadFloat4x4(&world), XMLoadFloat4x4(&viewProj));
+	for (unsigned int i = 0; i < 8; i++)
+	{
+		XMVECTOR corner = XMVectorSet(
+			(i & 1) ? boundsMax.x : boundsMin.x,
+			(i & 2) ? boundsMax.y : boundsMin.y,
+			(i & 4) ? boundsMax.z : boundsMin.z,
+			1.0f);
+		XMStoreFloat4(&clip[i], XMVector4Transform(corner, wvp));
+	}
+}
+
+// --------------------------------------------------------
+// Rasterizes the box's 12 triangles into the depth buffer
+// --------------------------------------------------------
+void OcclusionCuller::RenderOccluder(const XMFLOAT4X4& world, const XMFLOAT3& boundsMin, const XMFLOAT3& boundsMax)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	XMFLOAT4 clip[8];
+	TransformBox(world, boundsMin, boundsMax, clip);
+	for (unsigned int t = 0; t < 12; t++)
+		ClipAndRasterize(clip[BOX_TRIANGLES[t][0]], clip[BOX_TRIANGLES[t][1]], clip[BOX_TRIANGLES[t][2]]);
+
+	tilesDirty = true;
+	stats.occluders++;
+	stats.rasterMilliseconds += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+void OcclusionCuller::RenderOccluder(gameEntity* entity)
+{
+	Mesh* mesh = entity->GetMesh();
+	RenderOccluder(entity->GetTransform()->GetWorldMatrix(), mesh->boundsMin, mesh->boundsMax);
+}
+
+// --------------------------------------------------------
+// Clips a clip space triangle to the near plane (z >= 0),
+// then projects and rasterizes what's left
+// --------------------------------------------------------
+void OcclusionCuller::ClipAndRasterize(const XMFLOAT4& a, const XMFLOAT4& b, const XMFLOAT4& c)
+{
+	const XMFLOAT4* in[3] = { &a, &b, &c };
+	XMFLOAT4 poly[4];
+	unsigned int count = 0;
+
+	if (a.z >= 0 && b.z >= 0 && c.z >= 0)
+	{
+		poly[0] = a; poly[1] = b; poly[2] = c;
+		count = 3;
+	}
+	else
+	{
+		// Sutherland-Hodgman against the one plane - a triangle
+		// clipped by a plane has at most 4 vertices
+		for (unsigned int i = 0; i < 3; i++)
+		{
+			const XMFLOAT4& cur = *in[i];
+			const XMFLOAT4& next = *in[(i + 1) % 3];
+
+			if (cur.z >= 0)
+				poly[count++] = cur;
+
+			if ((cur.z >= 0) != (next.z >= 0))
+			{
+				float t = cur.z / (cur.z - next.z);
+				XMStoreFloat4(&poly[count++], XMVectorLerp(XMLoadFloat4(&cur), XMLoadFloat4(&next), t));
+			}
+		}
+
+		if (count < 3)
+			return;
+	}
+
+	// Project to pixels, y down
+	XMFLOAT3 screen[4];
+	for (unsigned int i = 0; i < count; i++)
+	{
+		float invW = 1.0f / poly[i].w;
+		screen[i].x = (poly[i].x * invW * 0.5f + 0.5f) * width;
+		screen[i].y = (0.5f - poly[i].y * invW * 0.5f) * height;
+		screen[i].z = poly[i].z * invW;
+	}
+
+	RasterizeTriangle(screen);
+	if (count == 4)
+	{
+		XMFLOAT3 second[3] = { screen[0], screen[2], screen[3] };
+		RasterizeTriangle(second);
+	}
+}
+
+// --------------------------------------------------------
+// Edge function rasterizer, 4 pixels per step.  Depth is
+// interpolated linearly in screen space (z/w is affine there)
+// and the nearest value is kept.
+// --------------------------------------------------------
+void OcclusionCuller::RasterizeTriangle(const XMFLOAT3* screen)
+{
+	XMFLOAT3 v0 = screen[0];
+	XMFLOAT3 v1 = screen[1];
+	XMFLOAT3 v2 = screen[2];
+
+	// Make the winding consistent so inside is positive on every edge
+	float area = (v1.x - v0.x) * (v2.y - v0.y) - (v1.y - v0.y) * (v2.x - v0.x);
+	if (fabsf(area) < 1e-6f)
+		return;
+	if (area < 0)
+	{
+		std::swap(v1, v2);
+		area = -area;
+	}
+
+	// Pixel bounds, clamped to the buffer.  Columns start on a
+	// multiple of 4 so each step is one aligned group of pixels.
+	int minX = (int)floorf(fminf(v0.x, fminf(v1.x, v2.x)));
+	int maxX = (int)floorf(fmaxf(v0.x, fmaxf(v1.x, v2.x)));
+	int minY = (int)floorf(fminf(v0.y, fminf(v1.y, v2.y)));
+	int maxY = (int)floorf(fmaxf(v0.y, fmaxf(v1.y, v2.y)));
+	if (minX < 0) minX = 0;
+	if (minY < 0) minY = 0;
+	if (maxX > (int)width - 1) maxX = (int)width - 1;
+	if (maxY > (int)height - 1) maxY = (int)height - 1;
+	if (minX > maxX || minY > maxY)
+		return;
+	minX &= ~3;
+
+	stats.occluderTriangles++;
+
+	// Edge i is opposite vertex i: E(x, y) = A * x + B * y + C
+	float A0 = -(v2.y - v1.y), B0 = v2.x - v1.x, C0 = -(A0 * v1.x + B0 * v1.y);
+	float A1 = -(v0.y - v2.y), B1 = v0.x - v2.x, C1 = -(A1 * v2.x + B1 * v2.y);
+	float A2 = -(v1.y - v0.y), B2 = v1.x - v0.x, C2 = -(A2 * v0.x + B2 * v0.y);
+
+	// Depth plane from the barycentric weights
+	float invArea = 1.0f / area;
+	float zA = (A0 * v0.z + A1 * v1.z + A2 * v2.z) * invArea;
+	float zB = (B0 * v0.z + B1 * v1.z + B2 * v2.z) * invArea;
+	float zC = (C0 * v0.z + C1 * v1.z + C2 * v2.z) * invArea;
+
+	__m128 a0 = _mm_set1_ps(A0), a1 = _mm_set1_ps(A1), a2 = _mm_set1_ps(A2), za = _mm_set1_ps(zA);
+	__m128 zero = _mm_setzero_ps();
+	__m128 centers = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+
+	for (int y = minY; y <= maxY; y++)
+	{
+		float py = y + 0.5f;
+		__m128 row0 = _mm_set1_ps(B0 * py + C0);
+		__m128 row1 = _mm_set1_ps(B1 * py + C1);
+		__m128 row2 = _mm_set1_ps(B2 * py + C2);
+		__m128 rowZ = _mm_set1_ps(zB * py + zC);
+
+		float* depthRow = &depth[y * width];
+		for (int x = minX; x <= maxX; x += 4)
+		{
+			__m128 px = _mm_add_ps(_mm_set1_ps((float)x), centers);
+
+			__m128 e0 = _mm_add_ps(_mm_mul_ps(a0, px), row0);
+			__m128 e1 = _mm_add_ps(_mm_mul_ps(a1, px), row1);
+			__m128 e2 = _mm_add_ps(_mm_mul_ps(a2, px), row2);
+			__m128 inside = _mm_and_ps(
+				_mm_and_ps(_mm_cmpge_ps(e0, zero), _mm_cmpge_ps(e1, zero)),
+				_mm_cmpge_ps(e2, zero));
+			if (_mm_movemask_ps(inside) == 0)
+				continue;
+
+			__m128 z = _mm_add_ps(_mm_mul_ps(za, px), rowZ);
+			__m128 old = _mm_loadu_ps(depthRow + x);
+			__m128 nearest = _mm_min_ps(old, z);
+			_mm_storeu_ps(depthRow + x, _mm_or_ps(_mm_and_ps(inside, nearest), _mm_andnot_ps(inside, old)));
+		}
+	}
+}
+
+// --------------------------------------------------------
+// Recomputes each tile's farthest depth
+// --------------------------------------------------------
+void OcclusionCuller::UpdateTiles()
+{
+	for (unsigned int ty = 0; ty < tilesY; ty++)
+	{
+		for (unsigned int tx = 0; tx < tilesX; tx++)
+		{
+			__m128 farthest = _mm_setzero_ps();
+			for (unsigned int y = 0; y < OCCLUSION_TILE_HEIGHT; y++)
+			{
+				const float* row = &depth[(ty * OCCLUSION_TILE_HEIGHT + y) * width + tx * OCCLUSION_TILE_WIDTH];
+				for (unsigned int x = 0; x < OCCLUSION_TILE_WIDTH; x += 4)
+					farthest = _mm_max_ps(farthest, _mm_loadu_ps(row + x));
+			}
+
+			// Horizontal max of the 4 lanes
+			farthest = _mm_max_ps(farthest, _mm_shuffle_ps(farthest, farthest, _MM_SHUFFLE(2, 3, 0, 1)));
+			farthest = _mm_max_ps(farthest, _mm_shuffle_ps(farthest, farthest, _MM_SHUFFLE(1, 0, 3, 2)));
+			tileMax[ty * tilesX + tx] = _mm_cvtss_f32(farthest);
+		}
+	}
+
+	tilesDirty = false;
+}
+
+// --------------------------------------------------------
+// Tests the box's screen rectangle at its nearest depth.
+// Tiles whose farthest depth is nearer are skipped whole;
+// the rest are checked pixel by pixel.
+// --------------------------------------------------------
+bool OcclusionCuller::IsVisible(const XMFLOAT4X4& world, const XMFLOAT3& boundsMin, const XMFLOAT3& boundsMax)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+	stats.tested++;
+
+	XMFLOAT4 clip[8];
+	TransformBox(world, boundsMin, boundsMax, clip);
+
+	bool visible = false;
+	float minX = FLT_MAX, minY = FLT_MAX, maxX = -FLT_MAX, maxY = -FLT_MAX, minZ = FLT_MAX;
+	for (unsigned int i = 0; i < 8; i++)
+	{
+		// Crossing the near plane - can't bound it on screen
+		if (clip[i].z < 0)
+		{
+			visible = true;
+			break;
+		}
+
+		float invW = 1.0f / clip[i].w;
+		float sx = (clip[i].x * invW * 0.5f + 0.5f) * width;
+		float sy = (0.5f - clip[i].y * invW * 0.5f) * height;
+		minX = fminf(minX, sx); maxX = fmaxf(maxX, sx);
+		minY = fminf(minY, sy); maxY = fmaxf(maxY, sy);
+		minZ = fminf(minZ, clip[i].z * invW);
+	}
+
+	int x0 = (int)floorf(minX);
+	int x1 = (int)floorf(maxX);
+	int y0 = (int)floorf(minY);
+	int y1 = (int)floorf(maxY);
+	if (x0 < 0) x0 = 0;
+	if (y0 < 0) y0 = 0;
+	if (x1 > (int)width - 1) x1 = (int)width - 1;
+	if (y1 > (int)height - 1) y1 = (int)height - 1;
+
+	// Off screen is for frustum culling to decide, not this
+	if (!visible && (x0 > x1 || y0 > y1))
+		visible = true;
+
+	if (!visible)
+	{
+		if (tilesDirty)
+			UpdateTiles();
+
+		__m128 boxZ = _mm_set1_ps(minZ);
+		__m128 lanes = _mm_setr_ps(0, 1, 2, 3);
+		__m128 first = _mm_set1_ps((float)x0);
+		__m128 last = _mm_set1_ps((float)x1);
+
+		for (int ty = y0 / OCCLUSION_TILE_HEIGHT; ty <= y1 / OCCLUSION_TILE_HEIGHT && !visible; ty++)
+		{
+			for (int tx = x0 / OCCLUSION_TILE_WIDTH; tx <= x1 / OCCLUSION_TILE_WIDTH && !visible; tx++)
+			{
+				// Everything in the tile is nearer than the box
+				if (minZ > tileMax[ty * tilesX + tx])
+					continue;
+
+				int rowStart = y0 > ty * OCCLUSION_TILE_HEIGHT ? y0 : ty * OCCLUSION_TILE_HEIGHT;
+				int rowEnd = y1 < ty * OCCLUSION_TILE_HEIGHT + OCCLUSION_TILE_HEIGHT - 1 ? y1 : ty * OCCLUSION_TILE_HEIGHT + OCCLUSION_TILE_HEIGHT - 1;
+				int colStart = tx * OCCLUSION_TILE_WIDTH;
+
+				for (int y = rowStart; y <= rowEnd && !visible; y++)
+				{
+					const float* row = &depth[y * width];
+					for (int x = colStart; x < colStart + OCCLUSION_TILE_WIDTH; x += 4)
+					{
+						// Only the columns inside the rectangle count
+						__m128 px = _mm_add_ps(_mm_set1_ps((float)x), lanes);
+						__m128 inRect = _mm_and_ps(_mm_cmpge_ps(px, first), _mm_cmple_ps(px, last));
+						__m128 inFront = _mm_cmple_ps(boxZ, _mm_loadu_ps(row + x));
+						if (_mm_movemask_ps(_mm_and_ps(inRect, inFront)) != 0)
+						{
+							visible = true;
+							break;
+						}
+					}
+				}
+			}
+		}
+	}
+
+	if (!visible)
+		stats.occluded++;
+
+	stats.testMilliseconds += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	return visible;
+}
+
+bool OcclusionCuller::IsVisible(gameEntity* entity)
+{
+	Mesh* mesh = entity->GetMesh();
+	return IsVisible(entity->GetTransform()->GetWorldMatrix(), mesh->boundsMin, mesh->boundsMax);
+}
@@ -0,0 +1,79 @@
+#pragma once
+#include <DirectXMath.h>
+#include <vector>
+#include "gameEntity.h"
+
+// The depth buffer is split into tiles that each keep their
+// farthest depth, so a test can pass over a whole tile at once.
+// Tile width must be a multiple of 4 (one SSE register of pixels).
+#define OCCLUSION_TILE_WIDTH	8
+#define OCCLUSION_TILE_HEIGHT	8
+
+// --------------------------------------------------------
+// Per-frame numbers, reset by BeginFrame()
+// --------------------------------------------------------
+struct OcclusionStats
+{
+	unsigned int occluders;
+	unsigned int occluderTriangles;	// After near plane clipping
+	unsigned int tested;
+	unsigned int occluded;
+
+	double rasterMilliseconds;
+	double testMilliseconds;
+};
+
+// --------------------------------------------------------
+// Software occlusion culling.  A designated set of occluders
+// is rasterized (4 pixels at a time, with SSE) into a small
+// CPU depth buffer; the screen space bounds of everything else
+// are then tested against it before being queued for drawing.
+//
+// Occluders are drawn as their bounding box, so they must
+// actually fill it - the track's walls and obstacles are all
+// cubes.  Anything the tests can't be sure about (crossing the
+// near plane, off screen) counts as visible.
+// --------------------------------------------------------
+class OcclusionCuller
+{
+public:
+	// Width must be a multiple of OCCLUSION_TILE_WIDTH and
+	// height of OCCLUSION_TILE_HEIGHT
+	OcclusionCuller(unsigned int width = 256, unsigned int height = 128);
+
+	// Clears the depth buffer for a new view
+	void BeginFrame(const DirectX::XMFLOAT4X4& view, const DirectX::XMFLOAT4X4& proj);
+
+	void RenderOccluder(const DirectX::XMFLOAT4X4& world, const DirectX::XMFLOAT3& boundsMin, const DirectX::XMFLOAT3& boundsMax);
+	void RenderOccluder(gameEntity* entity);
+
+	// False only if the whole box is behind what's been rasterized
+	bool IsVisible(const DirectX::XMFLOAT4X4& world, const DirectX::XMFLOAT3& boundsMin, const DirectX::XMFLOAT3& boundsMax);
+	bool IsVisible(gameEntity* entity);
+
+	const OcclusionStats& GetStats() { return stats; }
+
+	unsigned int GetWidth() { return width; }
+	unsigned int GetHeight() { return height; }
+	const float* GetDepth() { return depth.data(); }
+
+private:
+	unsigned int width;
+	unsigned int height;
+	unsigned int tilesX;
+	unsigned int tilesY;
+
+	DirectX::XMFLOAT4X4 viewProj;
+	std::vector<float> depth;		// Post-projection z, 0 = near plane
+	std::vector<float> tileMax;		// Farthest depth in each tile
+	bool tilesDirty;
+
+	OcclusionStats stats;
+
+	// Transforms the 8 corners of a box to clip space
+	void TransformBox(const DirectX::XMFLOAT4X4& world, const DirectX::XMFLOAT3& boundsMin, const DirectX::XMFLOAT3& boundsMax, DirectX::XMFLOAT4* clip);
+
+	void ClipAndRasterize(const DirectX::XMFLOAT4& a, const DirectX::XMFLOAT4& b, const DirectX::XMFLOAT4& c);
+	void RasterizeTriangle(const DirectX::XMFLOAT3* screen);
+	void UpdateTiles();
+};
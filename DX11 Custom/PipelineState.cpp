@@ -0,0 +1,166 @@
+#include "PipelineState.h"
+#include "ShaderReflectionCache.h"
+#include <string.h>
+
+PipelineStateDesc::PipelineStateDesc()
+{
+	memset(this, 0, sizeof(*this));
+
+	topology = RENDER_TOPOLOGY_TRIANGLE_LIST;
+
+	rasterizer.CullMode = RENDER_CULL_BACK;
+	rasterizer.DepthClipEnable = true;
+
+	depthStencil.DepthEnable = true;
+	depthStencil.DepthWrite = true;
+	depthStencil.DepthFunc = RENDER_COMPARISON_LESS;
+
+	blend.BlendEnable = false;
+	blend.SrcBlend = RENDER_BLEND_ONE;
+	blend.DestBlend = RENDER_BLEND_ZERO;
+}
+
+PipelineStateCache::PipelineStateCache(RenderBackend* backend)
+{
+	this->backend = backend;
+	memset(&stats, 0, sizeof(stats));
+}
+
+PipelineStateCache::~PipelineStateCache()
+{
+}
+
+// --------------------------------------------------------
+// Hashes the whole desc, then compares against every entry
+// with that hash before making a new one
+// --------------------------------------------------------
+const PipelineState* PipelineStateCache::GetPipelineState(const PipelineStateDesc& desc)
+{
+	stats.lookups++;
+
+	uint64_t hash = ShaderReflectionCache::Hash(&desc, sizeof(desc));
+	auto range = pipelines.equal_range(hash);
+	for (auto it = range.first; it != range.second; ++it)
+	{
+		if (memcmp(&it->second->desc, &desc, sizeof(desc)) == 0)
+			return &it->second->state;
+	}
+
+	// Copied as bytes, so the padding still matches
+	std::unique_ptr<PipelineEntry> entry(new PipelineEntry());
+	memcpy(&entry->desc, &desc, sizeof(desc));
+
+	PipelineState& state = entry->state;
+	state.vertexShader = desc.vertexShader;
+	state.pixelShader = desc.pixelShader;
+	state.inputLayout = desc.inputLayout;
+	state.topology = desc.topology;
+	state.rasterizerState = GetRasterizerState(desc.rasterizer);
+	state.depthStencilState = GetDepthStencilState(desc.depthStencil);
+	state.blendState = GetBlendState(desc.blend);
+	state.hash = hash;
+	state.id = stats.pipelineStates++;
+
+	const PipelineState* result = &entry->state;
+	pipelines.emplace(hash, std::move(entry));
+	return result;
+}
+
+// --------------------------------------------------------
+// State objects by desc.  D3D also hands back an existing
+// object for an identical desc, but only after a trip through
+// the runtime - these lookups stay on our side.  As with the
+// PSOs, a hash hit only counts if the whole desc matches.
+// --------------------------------------------------------
+template<typename Map, typename Desc>
+static typename Map::mapped_type* FindState(Map& states, uint64_t hash, const Desc& desc)
+{
+	auto range = states.equal_range(hash);
+	for (auto it = range.first; it != range.second; ++it)
+	{
+		if (memcmp(&it->second.desc, &desc, sizeof(desc)) == 0)
+			return &it->second;
+	}
+	return 0;
+}
+
+RenderRasterizerState* PipelineStateCache::GetRasterizerState(const RasterizerDesc& desc)
+{
+	uint64_t hash = ShaderReflectionCache::Hash(&desc, sizeof(desc));
+	auto found = FindState(rasterizerStates, hash, desc);
+	if (found)
+		return found->state.Get();
+
+	StateEntry<RasterizerDesc, RenderRasterizerState> entry;
+	memcpy(&entry.desc, &desc, sizeof(desc));
+	backend->CreateRasterizerState(desc, entry.state.GetAddressOf());
+	stats.rasterizerStates++;
+	return rasterizerStates.emplace(hash, entry)->second.state.Get();
+}
+
+RenderDepthStencilState* PipelineStateCache::GetDepthStencilState(const DepthStencilDesc& desc)
+{
+	uint64_t hash = ShaderReflectionCache::Hash(&desc, sizeof(desc));
+	auto found = FindState(depthStencilStates, hash, desc);
+	if (found)
+		return found->state.Get();
+
+	StateEntry<DepthStencilDesc, RenderDepthStencilState> entry;
+	memcpy(&entry.desc, &desc, sizeof(desc));
+	backend->CreateDepthStencilState(desc, entry.state.GetAddressOf());
+	stats.depthStencilStates++;
+	return depthStencilStates.emplace(hash, entry)->second.state.Get();
+}
+
+RenderBlendState* PipelineStateCache::GetBlendState(const BlendDesc& desc)
+{
+	uint64_t hash = ShaderReflectionCache::Hash(&desc, sizeof(desc));
+	auto found = FindState(blendStates, hash, desc);
+	if (found)
+		return found->state.Get();
+
+	StateEntry<BlendDesc, RenderBlendState> entry;
+	memcpy(&entry.desc, &desc, sizeof(desc));
+	backend->CreateBlendState(desc, entry.state.GetAddressOf());
+	stats.blendStates++;
+	return blendStates.emplace(hash, entry)->second.state.Get();
+}
+
+// --------------------------------------------------------
+// Flattens the element list (semantic names by value) into a
+// signature string, and shares one layout per signature
+// --------------------------------------------------------
+RenderInputLayout* PipelineStateCache::GetInputLayout(const InputElementDesc* elements, unsigned int elementCount, const void* byteCode, size_t byteCodeSize)
+{
+	stats.layoutRequests++;
+
+	std::string signature;
+	for (unsigned int i = 0; i < elementCount; i++)
+	{
+		const InputElementDesc& e = elements[i];
+		uint32_t fields[6] = { e.SemanticIndex, (uint32_t)e.Format, e.InputSlot, e.AlignedByteOffset, (uint32_t)e.PerInstance, e.InstanceDataStepRate };
+		signature.append(e.SemanticName);
+		signature.push_back('\0');
+		signature.append((const char*)fields, sizeof(fields));
+	}
+
+	LayoutEntry& entry = inputLayouts[ShaderReflectionCache::Hash(signature.data(), signature.size())];
+	if (entry.layout && entry.signature == signature)
+		return entry.layout.Get();
+
+	RenderRef<RenderInputLayout> layout;
+	if (!backend->CreateInputLayout(elements, elementCount, byteCode, byteCodeSize, layout.GetAddressOf()))
+		return 0;
+	stats.inputLayouts++;
+
+	if (!entry.layout)
+	{
+		entry.signature = signature;
+		entry.layout = layout;
+	}
+	else
+	{
+		unsharedLayouts.push_back(layout);
+	}
+	return layout.Get();
+}
@@ -0,0 +1,132 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "RenderBackend.h"
+
+// --------------------------------------------------------
+// Everything a pipeline state object bundles.  Shaders and
+// the input layout are compared by identity, fixed function
+// state by its full description.  The constructor zeroes the
+// whole struct (padding included, since descs are hashed as
+// bytes) and fills in the defaults D3D would:
+//  - solid fill, back face culling, depth clip
+//  - LESS depth test with writes, no stencil
+//  - no blending, all channels written
+// --------------------------------------------------------
+struct PipelineStateDesc
+{
+	RenderVertexShader* vertexShader;
+	RenderPixelShader* pixelShader;		// Null for depth only
+	RenderInputLayout* inputLayout;
+	RenderTopology topology;
+
+	RasterizerDesc rasterizer;
+	DepthStencilDesc depthStencil;
+	BlendDesc blend;
+
+	PipelineStateDesc();
+};
+
+// --------------------------------------------------------
+// A deduplicated PSO.  The state objects are owned by the
+// cache, which hands out the same one for equal descs.
+// --------------------------------------------------------
+struct PipelineState
+{
+	RenderVertexShader* vertexShader;
+	RenderPixelShader* pixelShader;
+	RenderInputLayout* inputLayout;
+	RenderTopology topology;
+	RenderRasterizerState* rasterizerState;
+	RenderDepthStencilState* depthStencilState;
+	RenderBlendState* blendState;
+
+	uint64_t hash;
+	unsigned int id;		// Creation order, 0 first
+};
+
+// --------------------------------------------------------
+// Lookups and what they turned into
+// --------------------------------------------------------
+struct PipelineStateCacheStats
+{
+	unsigned int lookups;
+	unsigned int pipelineStates;		// Distinct PSOs made
+	unsigned int rasterizerStates;
+	unsigned int depthStencilStates;
+	unsigned int blendStates;
+
+	unsigned int layoutRequests;
+	unsigned int inputLayouts;			// Distinct layouts made
+};
+
+// --------------------------------------------------------
+// Hashes and deduplicates pipeline state objects, and the
+// rasterizer, depth-stencil and blend states inside them.
+//
+// Also shares input layouts between vertex shaders: layouts
+// are keyed by a hash of the element list built from each
+// shader's input signature, so every shader with the same
+// signature gets the same RenderInputLayout.
+//
+// Everything lives until the cache is destroyed.
+// --------------------------------------------------------
+class PipelineStateCache
+{
+public:
+	PipelineStateCache(RenderBackend* backend);
+	~PipelineStateCache();
+
+	// The PSO for this desc, created on first request
+	const PipelineState* GetPipelineState(const PipelineStateDesc& desc);
+
+	// A layout for these elements, created against the first
+	// byte code to ask for it.  The cache keeps its reference.
+	RenderInputLayout* GetInputLayout(const InputElementDesc* elements, unsigned int elementCount, const void* byteCode, size_t byteCodeSize);
+
+	const PipelineStateCacheStats& GetStats() { return stats; }
+
+private:
+	RenderBackend* backend;
+	PipelineStateCacheStats stats;
+
+	struct PipelineEntry
+	{
+		PipelineStateDesc desc;
+		PipelineState state;
+	};
+
+	// A state object and the desc it was made from, compared
+	// on a hash hit like the PSOs
+	template<typename Desc, typename State>
+	struct StateEntry
+	{
+		Desc desc;
+		RenderRef<State> state;
+	};
+
+	struct LayoutEntry
+	{
+		std::string signature;	// Checked on a hash hit
+		RenderRef<RenderInputLayout> layout;
+	};
+
+	// Entries are never moved once made, so the PipelineState
+	// pointers handed out stay valid
+	std::unordered_multimap<uint64_t, std::unique_ptr<PipelineEntry>> pipelines;
+	std::unordered_multimap<uint64_t, StateEntry<RasterizerDesc, RenderRasterizerState>> rasterizerStates;
+	std::unordered_multimap<uint64_t, StateEntry<DepthStencilDesc, RenderDepthStencilState>> depthStencilStates;
+	std::unordered_multimap<uint64_t, StateEntry<BlendDesc, RenderBlendState>> blendStates;
+	std::unordered_map<uint64_t, LayoutEntry> inputLayouts;
+
+	// Layouts whose hash collided with a different signature,
+	// kept only so they're released with the cache
+	std::vector<RenderRef<RenderInputLayout>> unsharedLayouts;
+
+	RenderRasterizerState* GetRasterizerState(const RasterizerDesc& desc);
+	RenderDepthStencilState* GetDepthStencilState(const DepthStencilDesc& desc);
+	RenderBlendState* GetBlendState(const BlendDesc& desc);
+};
@@ -0,0 +1,361 @@
+#pragma once
+#include <dxgiformat.h>
+#include <atomic>
+#include <stddef.h>
+
+// --------------------------------------------------------
+// Shader stages the backend binds resources to
+// --------------------------------------------------------
+enum ShaderStage
+{
+	SHADER_STAGE_VERTEX,
+	SHADER_STAGE_PIXEL,
+	SHADER_STAGE_COUNT
+};
+
+// --------------------------------------------------------
+// Reference counted base of everything a backend creates.
+// Objects start with one reference, owned by whoever asked
+// for them; RenderRef manages them like ComPtr does.
+// --------------------------------------------------------
+class RenderObject
+{
+public:
+	void AddRef() { references++; }
+	void Release() { if (--references == 0) delete this; }
+
+protected:
+	RenderObject() : references(1) {}
+	virtual ~RenderObject() {}
+
+private:
+	std::atomic<unsigned int> references;
+
+	RenderObject(const RenderObject&);
+	RenderObject& operator=(const RenderObject&);
+};
+
+// Anything a shader can read: textures, and buffers made
+// with RENDER_BIND_SHADER_RESOURCE
+class RenderResource : public RenderObject
+{
+public:
+	bool IsBuffer() const { return buffer; }
+
+protected:
+	RenderResource(bool buffer) : buffer(buffer) {}
+
+private:
+	bool buffer;
+};
+
+class RenderBuffer : public RenderResource
+{
+protected:
+	RenderBuffer() : RenderResource(true) {}
+};
+
+// Textures are also render and depth targets, as their bind
+// flags allow
+class RenderTexture : public RenderResource
+{
+protected:
+	RenderTexture() : RenderResource(false) {}
+};
+
+class RenderVertexShader : public RenderObject {};
+class RenderPixelShader : public RenderObject {};
+class RenderInputLayout : public RenderObject {};
+class RenderSamplerState : public RenderObject {};
+class RenderRasterizerState : public RenderObject {};
+class RenderDepthStencilState : public RenderObject {};
+class RenderBlendState : public RenderObject {};
+
+// --------------------------------------------------------
+// Owning pointer to a RenderObject, with the parts of
+// ComPtr's interface the engine uses
+// --------------------------------------------------------
+template<typename T>
+class RenderRef
+{
+public:
+	RenderRef() : object(0) {}
+	RenderRef(T* object) : object(object) { if (object) object->AddRef(); }
+	RenderRef(const RenderRef& other) : object(other.object) { if (object) object->AddRef(); }
+	~RenderRef() { Reset(); }
+
+	RenderRef& operator=(const RenderRef& other)
+	{
+		if (other.object)
+			other.object->AddRef();
+		Reset();
+		object = other.object;
+		return *this;
+	}
+
+	T* Get() const { return object; }
+	T* operator->() const { return object; }
+	explicit operator bool() const { return object != 0; }
+
+	T** GetAddressOf() { return &object; }
+	T** ReleaseAndGetAddressOf() { Reset(); return &object; }
+
+	void Reset()
+	{
+		if (object)
+			object->Release();
+		object = 0;
+	}
+
+private:
+	T* object;
+};
+
+// --------------------------------------------------------
+// Creation descriptions
+// --------------------------------------------------------
+enum RenderUsage
+{
+	RENDER_USAGE_DEFAULT,	// GPU read/write, updated with UpdateBuffer()
+	RENDER_USAGE_IMMUTABLE,	// Filled once at creation
+	RENDER_USAGE_DYNAMIC	// Written by the CPU through Map()
+};
+
+enum RenderBindFlags
+{
+	RENDER_BIND_VERTEX_BUFFER = 1 << 0,
+	RENDER_BIND_INDEX_BUFFER = 1 << 1,
+	RENDER_BIND_CONSTANT_BUFFER = 1 << 2,
+	RENDER_BIND_SHADER_RESOURCE = 1 << 3,
+	RENDER_BIND_RENDER_TARGET = 1 << 4,
+	RENDER_BIND_DEPTH_STENCIL = 1 << 5
+};
+
+// A non-zero StructureByteStride makes a structured buffer
+struct BufferDesc
+{
+	unsigned int ByteWidth;
+	RenderUsage Usage;
+	unsigned int BindFlags;
+	unsigned int StructureByteStride;
+};
+
+enum RenderTextureType
+{
+	RENDER_TEXTURE_2D,
+	RENDER_TEXTURE_2D_ARRAY,
+	RENDER_TEXTURE_CUBE		// ArraySize 6
+};
+
+struct TextureDesc
+{
+	RenderTextureType Type;
+	unsigned int Width;
+	unsigned int Height;
+	unsigned int MipLevels;
+	unsigned int ArraySize;
+	DXGI_FORMAT Format;
+	RenderUsage Usage;
+	unsigned int BindFlags;
+};
+
+// Initial contents, one per subresource (mip by mip within
+// each slice for textures)
+struct SubresourceData
+{
+	const void* Data;
+	unsigned int RowPitch;
+	unsigned int SlicePitch;
+};
+
+enum RenderMap
+{
+	RENDER_MAP_WRITE_DISCARD,		// Whole buffer, previous contents dropped
+	RENDER_MAP_WRITE_NO_OVERWRITE	// Only to parts the GPU isn't reading
+};
+
+enum RenderFilter
+{
+	RENDER_FILTER_LINEAR,			// Trilinear
+	RENDER_FILTER_LINEAR_MIP_POINT,	// Bilinear
+	RENDER_FILTER_POINT
+};
+
+enum RenderAddressMode
+{
+	RENDER_ADDRESS_WRAP,
+	RENDER_ADDRESS_CLAMP
+};
+
+// Every mip is allowed
+struct SamplerDesc
+{
+	RenderFilter Filter;
+	RenderAddressMode AddressMode;
+};
+
+enum RenderCullMode
+{
+	RENDER_CULL_NONE,
+	RENDER_CULL_FRONT,
+	RENDER_CULL_BACK
+};
+
+enum RenderComparison
+{
+	RENDER_COMPARISON_NEVER,
+	RENDER_COMPARISON_LESS,
+	RENDER_COMPARISON_EQUAL,
+	RENDER_COMPARISON_LESS_EQUAL,
+	RENDER_COMPARISON_GREATER,
+	RENDER_COMPARISON_GREATER_EQUAL,
+	RENDER_COMPARISON_ALWAYS
+};
+
+enum RenderBlend
+{
+	RENDER_BLEND_ZERO,
+	RENDER_BLEND_ONE,
+	RENDER_BLEND_SRC_ALPHA,
+	RENDER_BLEND_INV_SRC_ALPHA
+};
+
+// The state descs are hashed as bytes by PipelineStateCache,
+// so they hold nothing but plain fields
+struct RasterizerDesc
+{
+	RenderCullMode CullMode;
+	bool DepthClipEnable;
+};
+
+struct DepthStencilDesc
+{
+	bool DepthEnable;
+	bool DepthWrite;
+	RenderComparison DepthFunc;
+};
+
+// Alpha blends as color does; every channel is written
+struct BlendDesc
+{
+	bool BlendEnable;
+	RenderBlend SrcBlend;
+	RenderBlend DestBlend;
+};
+
+// An AlignedByteOffset that follows on from the element before
+// (D3D11_APPEND_ALIGNED_ELEMENT)
+#define RENDER_APPEND_ALIGNED_ELEMENT 0xffffffff
+
+struct InputElementDesc
+{
+	const char* SemanticName;
+	unsigned int SemanticIndex;
+	DXGI_FORMAT Format;
+	unsigned int InputSlot;
+	unsigned int AlignedByteOffset;
+	bool PerInstance;
+	unsigned int InstanceDataStepRate;
+};
+
+// Same values as D3D11_PRIMITIVE_TOPOLOGY
+enum RenderTopology
+{
+	RENDER_TOPOLOGY_UNDEFINED = 0,
+	RENDER_TOPOLOGY_POINT_LIST = 1,
+	RENDER_TOPOLOGY_LINE_LIST = 2,
+	RENDER_TOPOLOGY_LINE_STRIP = 3,
+	RENDER_TOPOLOGY_TRIANGLE_LIST = 4,
+	RENDER_TOPOLOGY_TRIANGLE_STRIP = 5
+};
+
+// --------------------------------------------------------
+// The narrow set of device and context operations the frame
+// loop uses: buffers, textures, shaders, state, draws, text
+// and present.  Everything above the backends goes through
+// this and the handles above rather than D3D, so the loop
+// builds and runs without a GPU (or Windows) against the
+// NullRenderBackend.
+//
+// Creation returns false on failure, leaving the out param
+// null.  Bind calls take the objects they create.
+// --------------------------------------------------------
+class RenderBackend
+{
+public:
+	virtual ~RenderBackend() {}
+
+	// The window's targets: an srgb back buffer and a depth
+	// buffer of the same size, both bound to begin with
+	virtual RenderTexture* GetBackBuffer() = 0;
+	virtual RenderTexture* GetDepthBuffer() = 0;
+
+	// Remakes the back and depth buffers at a new window size,
+	// and binds them
+	virtual bool Resize(unsigned int width, unsigned int height) = 0;
+
+	// Buffers
+	virtual bool CreateBuffer(const BufferDesc& desc, const void* initialData, RenderBuffer** buffer) = 0;
+	virtual void* Map(RenderBuffer* buffer, RenderMap mapType) = 0;
+	virtual void Unmap(RenderBuffer* buffer) = 0;
+
+	// Copies size bytes into a default usage buffer at offset
+	virtual void UpdateBuffer(RenderBuffer* buffer, unsigned int offset, const void* data, unsigned int size) = 0;
+
+	// Binding a window of a constant buffer needs D3D 11.1
+	virtual bool SupportsConstantBufferOffsets() = 0;
+
+	// Textures - .dds files are loaded as DDS, anything else through WIC.
+	// Color textures should be srgb, so sampling returns linear values.
+	virtual bool LoadTexture(const wchar_t* file, RenderTexture** texture, bool srgb = false) = 0;
+
+	// Textures filled from memory (texture arrays, cooked data),
+	// or render targets.  initialData is one per subresource.
+	virtual bool CreateTexture(const TextureDesc& desc, const SubresourceData* initialData, RenderTexture** texture) = 0;
+
+	// Shaders
+	virtual bool CreateVertexShader(const void* byteCode, size_t byteCodeSize, RenderVertexShader** shader) = 0;
+	virtual bool CreatePixelShader(const void* byteCode, size_t byteCodeSize, RenderPixelShader** shader) = 0;
+	virtual bool CreateInputLayout(const InputElementDesc* elements, unsigned int elementCount, const void* byteCode, size_t byteCodeSize, RenderInputLayout** layout) = 0;
+
+	// State objects
+	virtual bool CreateSamplerState(const SamplerDesc& desc, RenderSamplerState** state) = 0;
+	virtual bool CreateRasterizerState(const RasterizerDesc& desc, RenderRasterizerState** state) = 0;
+	virtual bool CreateDepthStencilState(const DepthStencilDesc& desc, RenderDepthStencilState** state) = 0;
+	virtual bool CreateBlendState(const BlendDesc& desc, RenderBlendState** state) = 0;
+
+	// Binding.  A non-zero numConstants binds a window of the buffer.
+	virtual void SetInputLayout(RenderInputLayout* layout) = 0;
+	virtual void SetVertexShader(RenderVertexShader* shader) = 0;
+	virtual void SetPixelShader(RenderPixelShader* shader) = 0;
+	virtual void SetConstantBuffer(ShaderStage stage, unsigned int slot, RenderBuffer* buffer, unsigned int firstConstant, unsigned int numConstants) = 0;
+	virtual void SetShaderResources(ShaderStage stage, unsigned int startSlot, unsigned int count, RenderResource* const* resources) = 0;
+	virtual void SetSamplers(ShaderStage stage, unsigned int startSlot, unsigned int count, RenderSamplerState* const* samplers) = 0;
+	virtual void SetVertexBuffers(unsigned int startSlot, unsigned int numBuffers, RenderBuffer* const* buffers, const unsigned int* strides, const unsigned int* offsets) = 0;
+	virtual void SetIndexBuffer(RenderBuffer* buffer, DXGI_FORMAT format, unsigned int offset) = 0;
+	virtual void SetPrimitiveTopology(RenderTopology topology) = 0;
+	virtual void SetRasterizerState(RenderRasterizerState* state) = 0;
+	virtual void SetDepthStencilState(RenderDepthStencilState* state, unsigned int stencilRef) = 0;
+	virtual void SetBlendState(RenderBlendState* state) = 0;
+
+	// The targets Clear() clears and Present() rebinds
+	virtual void SetRenderTargets(RenderTexture* renderTarget, RenderTexture* depthTarget) = 0;
+
+	// Draws into the top left width x height pixels of the targets
+	virtual void SetViewport(float width, float height) = 0;
+
+	// Text, in the one sprite font the game uses.  Strings are
+	// drawn between BeginText() and EndText(), at x, y less the
+	// origin; color is linear RGBA.
+	virtual bool LoadFont(const wchar_t* file) = 0;
+	virtual void MeasureString(const wchar_t* text, float* width, float* height) = 0;
+	virtual void BeginText() = 0;
+	virtual void DrawString(const wchar_t* text, float x, float y, const float color[4], float originX, float originY) = 0;
+	virtual void EndText() = 0;
+
+	// Frame
+	virtual void Clear(const float color[4], float depth) = 0;
+	virtual void DrawIndexed(unsigned int indexCount, unsigned int startIndex, int baseVertex) = 0;
+	virtual void Draw(unsigned int vertexCount, unsigned int startVertex) = 0;
+	virtual void Present() = 0;
+};
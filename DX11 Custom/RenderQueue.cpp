@@ -0,0 +1,296 @@
+#include "RenderQueue.h"
+#include <chrono>
+#include <random>
+#include <cstring>
+
+using namespace DirectX;
+
+// Bit layout of the sort key, most significant first
+static const unsigned int PASS_BITS = 4;
+static const unsigned int SHADER_BITS = 8;
+static const unsigned int MATERIAL_BITS = 12;
+static const unsigned int MESH_BITS = 12;
+static const unsigned int DEPTH_BITS = 28;
+
+static const unsigned int DEPTH_SHIFT = 0;
+static const unsigned int MESH_SHIFT = DEPTH_SHIFT + DEPTH_BITS;
+static const unsigned int MATERIAL_SHIFT = MESH_SHIFT + MESH_BITS;
+static const unsigned int SHADER_SHIFT = MATERIAL_SHIFT + MATERIAL_BITS;
+static const unsigned int PASS_SHIFT = SHADER_SHIFT + SHADER_BITS;
+
+static_assert(PASS_SHIFT + PASS_BITS == 64, "Sort key fields must fill exactly 64 bits");
+
+// The state bits (shader, material and mesh) as one field, used
+// when the transparent pass swaps them below the depth
+static const unsigned int STATE_BITS = SHADER_BITS + MATERIAL_BITS + MESH_BITS;
+
+RenderQueue::RenderQueue()
+{
+	stats = {};
+}
+
+// --------------------------------------------------------
+// Empties the queue for a new frame.  Id tables are kept,
+// so a material keeps the same id from frame to frame.
+// --------------------------------------------------------
+void RenderQueue::Clear()
+{
+	packets.clear();
+}
+
+void RenderQueue::Reset()
+{
+	packets.clear();
+	shaderIds.clear();
+	materialIds.clear();
+	meshIds.clear();
+}
+
+// --------------------------------------------------------
+// Looks up (or assigns) a compact id for a pointer
+// --------------------------------------------------------
+unsigned int RenderQueue::GetId(std::vector<const void*>& table, const void* ptr, unsigned int maxId)
+{
+	for (unsigned int i = 0; i < table.size(); i++)
+	{
+		if (table[i] == ptr)
+			return i;
+	}
+
+	// Out of ids - share the last one rather than overflow into other fields
+	if (table.size() > maxId)
+		return maxId;
+
+	table.push_back(ptr);
+	return (unsigned int)table.size() - 1;
+}
+
+// --------------------------------------------------------
+// Builds a key from its fields
+//
+// depth01 - view depth remapped to [0, 1] between the near and far planes
+// --------------------------------------------------------
+uint64_t RenderQueue::MakeKey(RenderPass pass, unsigned int shader, unsigned int material, unsigned int mesh, float depth01)
+{
+	if (depth01 < 0.0f) depth01 = 0.0f;
+	if (depth01 > 1.0f) depth01 = 1.0f;
+
+	uint64_t maxDepth = (1ull << DEPTH_BITS) - 1;
+	uint64_t depth = (uint64_t)(depth01 * (double)maxDepth);
+
+	uint64_t state =
+		((uint64_t)(shader & ((1u << SHADER_BITS) - 1)) << (MATERIAL_BITS + MESH_BITS)) |
+		((uint64_t)(material & ((1u << MATERIAL_BITS) - 1)) << MESH_BITS) |
+		((uint64_t)(mesh & ((1u << MESH_BITS) - 1)));
+
+	uint64_t key = (uint64_t)(pass & ((1u << PASS_BITS) - 1)) << PASS_SHIFT;
+
+	if (pass == RENDER_PASS_TRANSPARENT)
+	{
+		// Back to front: inverted depth takes the high bits, state the low bits
+		key |= (maxDepth - depth) << STATE_BITS;
+		key |= state;
+	}
+	else
+	{
+		// Grouped by state, then front to back
+		key |= state << MESH_SHIFT;
+		key |= depth << DEPTH_SHIFT;
+	}
+
+	return key;
+}
+
+RenderPass RenderQueue::GetKeyPass(uint64_t key)
+{
+	return (RenderPass)(key >> PASS_SHIFT);
+}
+
+unsigned int RenderQueue::GetKeyShader(uint64_t key)
+{
+	if ((key >> PASS_SHIFT) == RENDER_PASS_TRANSPARENT)
+		return (unsigned int)(key >> (MATERIAL_BITS + MESH_BITS)) & ((1u << SHADER_BITS) - 1);
+	return (unsigned int)(key >> SHADER_SHIFT) & ((1u << SHADER_BITS) - 1);
+}
+
+unsigned int RenderQueue::GetKeyMaterial(uint64_t key)
+{
+	if ((key >> PASS_SHIFT) == RENDER_PASS_TRANSPARENT)
+		return (unsigned int)(key >> MESH_BITS) & ((1u << MATERIAL_BITS) - 1);
+	return (unsigned int)(key >> MATERIAL_SHIFT) & ((1u << MATERIAL_BITS) - 1);
+}
+
+unsigned int RenderQueue::GetKeyMesh(uint64_t key)
+{
+	if ((key >> PASS_SHIFT) == RENDER_PASS_TRANSPARENT)
+		return (unsigned int)key & ((1u << MESH_BITS) - 1);
+	return (unsigned int)(key >> MESH_SHIFT) & ((1u << MESH_BITS) - 1);
+}
+
+// --------------------------------------------------------
+// Queues an entity for drawing this frame
+// --------------------------------------------------------
+void RenderQueue::Submit(gameEntity* entity, Camera* cam, RenderPass pass)
+{
+	// Depth of the entity's origin in view space
+	XMFLOAT4X4 view = cam->getView();
+	XMFLOAT3 pos = entity->GetTransform()->GetPosition();
+	XMVECTOR viewPos = XMVector3Transform(XMLoadFloat3(&pos), XMLoadFloat4x4(&view));
+	float viewZ = XMVectorGetZ(viewPos);
+	float depth01 = (viewZ - cam->GetNearClip()) / (cam->GetFarClip() - cam->GetNearClip());
+
+	// The pixel shader is what actually differs between the material shader pairs
+	unsigned int shader = GetId(shaderIds, entity->mat->getPixel(), (1u << SHADER_BITS) - 1);
+	// Materials sharing an atlas bind the same textures, so they group as one
+	unsigned int material = GetId(materialIds, entity->mat->GetBindingKey(), (1u << MATERIAL_BITS) - 1);
+	unsigned int mesh = GetId(meshIds, entity->GetMesh(), (1u << MESH_BITS) - 1);
+
+	DrawPacket packet;
+	packet.key = MakeKey(pass, shader, material, mesh, depth01);
+	packet.entity = entity;
+	packets.push_back(packet);
+}
+
+// --------------------------------------------------------
+// Counts how often shader, material and mesh change when
+// walking the packets in their current order
+// --------------------------------------------------------
+void RenderQueue::CountStateChanges(const std::vector<DrawPacket>& packets, unsigned int& shader, unsigned int& material, unsigned int& mesh)
+{
+	shader = 0;
+	material = 0;
+	mesh = 0;
+
+	for (size_t i = 0; i < packets.size(); i++)
+	{
+		uint64_t key = packets[i].key;
+		if (i == 0)
+		{
+			// The first draw always binds everything
+			shader++; material++; mesh++;
+			continue;
+		}
+
+		uint64_t prev = packets[i - 1].key;
+		if (GetKeyShader(key) != GetKeyShader(prev)) shader++;
+		if (GetKeyMaterial(key) != GetKeyMaterial(prev)) material++;
+		if (GetKeyMesh(key) != GetKeyMesh(prev)) mesh++;
+	}
+}
+
+// --------------------------------------------------------
+// Sorts this frame's packets and updates the stats
+// --------------------------------------------------------
+void RenderQueue::Sort()
+{
+	stats.packetCount = (unsigned int)packets.size();
+	CountStateChanges(packets, stats.unsortedShaderChanges, stats.unsortedMaterialChanges, stats.unsortedMeshChanges);
+
+	auto start = std::chrono::high_resolution_clock::now();
+	RadixSort(packets, scratch);
+	auto end = std::chrono::high_resolution_clock::now();
+	stats.sortMilliseconds = std::chrono::duration<double, std::milli>(end - start).count();
+
+	CountStateChanges(packets, stats.shaderChanges, stats.materialChanges, stats.meshChanges);
+}
+
+// --------------------------------------------------------
+// Least-significant-digit radix sort, one byte per pass.
+// All eight histograms are built in a single read of the
+// keys, and any pass where every key shares the same byte
+// is skipped entirely (common for the pass and shader bits).
+// --------------------------------------------------------
+void RenderQueue::RadixSort(std::vector<DrawPacket>& packets, std::vector<DrawPacket>& scratch)
+{
+	size_t count = packets.size();
+	if (count < 2)
+		return;
+
+	scratch.resize(count);
+
+	// Histograms for all 8 bytes at once
+	unsigned int histograms[8][256];
+	memset(histograms, 0, sizeof(histograms));
+	for (size_t i = 0; i < count; i++)
+	{
+		uint64_t key = packets[i].key;
+		for (unsigned int b = 0; b < 8; b++)
+			histograms[b][(key >> (b * 8)) & 0xFF]++;
+	}
+
+	DrawPacket* src = packets.data();
+	DrawPacket* dst = scratch.data();
+
+	for (unsigned int b = 0; b < 8; b++)
+	{
+		unsigned int* histogram = histograms[b];
+
+		// Skip the pass if every key lands in the same bucket
+		unsigned int firstByte = (unsigned int)((src[0].key >> (b * 8)) & 0xFF);
+		if (histogram[firstByte] == count)
+			continue;
+
+		// Turn counts into starting offsets
+		unsigned int offsets[256];
+		unsigned int sum = 0;
+		for (unsigned int i = 0; i < 256; i++)
+		{
+			offsets[i] = sum;
+			sum += histogram[i];
+		}
+
+		// Scatter (stable)
+		unsigned int shift = b * 8;
+		for (size_t i = 0; i < count; i++)
+		{
+			unsigned int bucket = (unsigned int)((src[i].key >> shift) & 0xFF);
+			dst[offsets[bucket]++] = src[i];
+		}
+
+		DrawPacket* temp = src;
+		src = dst;
+		dst = temp;
+	}
+
+	// An odd number of passes leaves the result in the scratch buffer
+	if (src != packets.data())
+		packets.swap(scratch);
+}
+
+// --------------------------------------------------------
+// Sorts packetCount randomly keyed packets several times and
+// returns the average time per sort in milliseconds.  Keys are
+// spread over a realistic number of shaders/materials/meshes.
+// --------------------------------------------------------
+double RenderQueue::BenchmarkSort(unsigned int packetCount, unsigned int iterations)
+{
+	std::mt19937 rng(1234);
+	std::uniform_int_distribution<unsigned int> shaderDist(0, 7);
+	std::uniform_int_distribution<unsigned int> materialDist(0, 63);
+	std::uniform_int_distribution<unsigned int> meshDist(0, 127);
+	std::uniform_real_distribution<float> depthDist(0.0f, 1.0f);
+
+	std::vector<DrawPacket> source(packetCount);
+	for (unsigned int i = 0; i < packetCount; i++)
+	{
+		source[i].key = MakeKey(RENDER_PASS_OPAQUE, shaderDist(rng), materialDist(rng), meshDist(rng), depthDist(rng));
+		source[i].entity = 0;
+	}
+
+	std::vector<DrawPacket> packets;
+	std::vector<DrawPacket> scratch;
+	double total = 0.0;
+
+	for (unsigned int i = 0; i < iterations; i++)
+	{
+		packets = source;
+
+		auto start = std::chrono::high_resolution_clock::now();
+		RadixSort(packets, scratch);
+		auto end = std::chrono::high_resolution_clock::now();
+
+		total += std::chrono::duration<double, std::milli>(end - start).count();
+	}
+
+	return iterations > 0 ? total / iterations : 0.0;
+}
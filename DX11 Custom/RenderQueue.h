@@ -0,0 +1,102 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include "gameEntity.h"
+#include "Camera.h"
+
+// --------------------------------------------------------
+// Render passes, in the order their packets are drawn.
+// The pass occupies the top bits of the sort key, so every
+// packet of an earlier pass sorts before any later one.
+// --------------------------------------------------------
+enum RenderPass : unsigned int
+{
+	RENDER_PASS_OPAQUE = 0,
+	RENDER_PASS_TRANSPARENT = 1,
+};
+
+// --------------------------------------------------------
+// A single queued draw: the 64-bit sort key and the
+// entity that will be drawn when the packet is reached
+// --------------------------------------------------------
+struct DrawPacket
+{
+	uint64_t key;
+	gameEntity* entity;
+};
+
+// --------------------------------------------------------
+// Per-frame numbers about the queue, filled in by Sort()
+// --------------------------------------------------------
+struct RenderQueueStats
+{
+	unsigned int packetCount;
+
+	// State changes when drawing in submission order
+	unsigned int unsortedShaderChanges;
+	unsigned int unsortedMaterialChanges;
+	unsigned int unsortedMeshChanges;
+
+	// State changes when drawing in sorted order
+	unsigned int shaderChanges;
+	unsigned int materialChanges;
+	unsigned int meshChanges;
+
+	double sortMilliseconds;
+};
+
+// --------------------------------------------------------
+// Collects draw packets each frame and radix sorts them by
+// a key laid out (most significant first) as:
+//
+//   pass (4) | shader (8) | material (12) | mesh (12) | depth (28)
+//
+// Opaque packets are therefore grouped by state and drawn
+// front to back within each group.  Transparent packets move
+// the inverted depth above the state bits so they draw back
+// to front regardless of state.
+// --------------------------------------------------------
+class RenderQueue
+{
+public:
+	RenderQueue();
+
+	void Clear();
+
+	// Forgets every id as well, for when the shaders, materials
+	// and meshes they were handed to are deleted - a new object
+	// at a freed one's address would otherwise inherit its id
+	void Reset();
+	void Submit(gameEntity* entity, Camera* cam, RenderPass pass = RENDER_PASS_OPAQUE);
+	void Sort();
+
+	const std::vector<DrawPacket>& GetPackets() { return packets; }
+	const RenderQueueStats& GetStats() { return stats; }
+
+	// Key helpers
+	static uint64_t MakeKey(RenderPass pass, unsigned int shader, unsigned int material, unsigned int mesh, float depth01);
+	static RenderPass GetKeyPass(uint64_t key);
+	static unsigned int GetKeyShader(uint64_t key);
+	static unsigned int GetKeyMaterial(uint64_t key);
+	static unsigned int GetKeyMesh(uint64_t key);
+
+	// Stable LSD radix sort on the packet keys, using scratch as the ping-pong buffer
+	static void RadixSort(std::vector<DrawPacket>& packets, std::vector<DrawPacket>& scratch);
+
+	// Sorts packetCount random packets and returns the average sort time in milliseconds
+	static double BenchmarkSort(unsigned int packetCount, unsigned int iterations);
+
+private:
+	std::vector<DrawPacket> packets;
+	std::vector<DrawPacket> scratch;
+	RenderQueueStats stats;
+
+	// Small id tables - a handful of shaders, materials and meshes
+	// exist at once, so a linear search beats hashing here
+	std::vector<const void*> shaderIds;
+	std::vector<const void*> materialIds;
+	std::vector<const void*> meshIds;
+
+	static unsigned int GetId(std::vector<const void*>& table, const void* ptr, unsigned int maxId);
+	static void CountStateChanges(const std::vector<DrawPacket>& packets, unsigned int& shader, unsigned int& material, unsigned int& mesh);
+};
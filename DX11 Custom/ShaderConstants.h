@@ -0,0 +1,125 @@
+// Generated by generate_shader_constants.py - don't edit, rerun it
+// after changing a cbuffer or a struct one uses.
+//
+// Each cbuffer's struct is its shader's prefix plus the cbuffer's
+// name, padded out to the size D3D reflects for the buffer, so the
+// whole thing can go to SimpleShader::SetBufferData() at once.
+#pragma once
+#include <DirectXMath.h>
+#include <cstddef>
+
+// HLSL struct DirectionalLight, 48 bytes
+struct DirectionalLight
+{
+	DirectX::XMFLOAT3 ambientColor;
+	float padding1;
+	DirectX::XMFLOAT3 diffuseColor;
+	float padding2;
+	DirectX::XMFLOAT3 direction;
+	float padding3;
+};
+static_assert(offsetof(DirectionalLight, ambientColor) == 0, "DirectionalLight.ambientColor doesn't match HLSL");
+static_assert(offsetof(DirectionalLight, padding1) == 12, "DirectionalLight.padding1 doesn't match HLSL");
+static_assert(offsetof(DirectionalLight, diffuseColor) == 16, "DirectionalLight.diffuseColor doesn't match HLSL");
+static_assert(offsetof(DirectionalLight, padding2) == 28, "DirectionalLight.padding2 doesn't match HLSL");
+static_assert(offsetof(DirectionalLight, direction) == 32, "DirectionalLight.direction doesn't match HLSL");
+static_assert(offsetof(DirectionalLight, padding3) == 44, "DirectionalLight.padding3 doesn't match HLSL");
+static_assert(sizeof(DirectionalLight) == 48, "DirectionalLight doesn't match HLSL");
+
+// HLSL struct PointLight, 48 bytes
+struct PointLight
+{
+	DirectX::XMFLOAT3 ambientColor;
+	float padding1;
+	DirectX::XMFLOAT3 diffuseColor;
+	float padding2;
+	DirectX::XMFLOAT3 position;
+	float padding3;
+};
+static_assert(offsetof(PointLight, ambientColor) == 0, "PointLight.ambientColor doesn't match HLSL");
+static_assert(offsetof(PointLight, padding1) == 12, "PointLight.padding1 doesn't match HLSL");
+static_assert(offsetof(PointLight, diffuseColor) == 16, "PointLight.diffuseColor doesn't match HLSL");
+static_assert(offsetof(PointLight, padding2) == 28, "PointLight.padding2 doesn't match HLSL");
+static_assert(offsetof(PointLight, position) == 32, "PointLight.position doesn't match HLSL");
+static_assert(offsetof(PointLight, padding3) == 44, "PointLight.padding3 doesn't match HLSL");
+static_assert(sizeof(PointLight) == 48, "PointLight doesn't match HLSL");
+
+// HLSL struct ClusterParams, 40 bytes
+struct ClusterParams
+{
+	DirectX::XMFLOAT3 cameraForward;
+	float zScale;
+	DirectX::XMFLOAT2 tileScale;
+	float zBias;
+	unsigned int clustersX;
+	unsigned int clustersY;
+	unsigned int clustersZ;
+};
+static_assert(offsetof(ClusterParams, cameraForward) == 0, "ClusterParams.cameraForward doesn't match HLSL");
+static_assert(offsetof(ClusterParams, zScale) == 12, "ClusterParams.zScale doesn't match HLSL");
+static_assert(offsetof(ClusterParams, tileScale) == 16, "ClusterParams.tileScale doesn't match HLSL");
+static_assert(offsetof(ClusterParams, zBias) == 24, "ClusterParams.zBias doesn't match HLSL");
+static_assert(offsetof(ClusterParams, clustersX) == 28, "ClusterParams.clustersX doesn't match HLSL");
+static_assert(offsetof(ClusterParams, clustersY) == 32, "ClusterParams.clustersY doesn't match HLSL");
+static_assert(offsetof(ClusterParams, clustersZ) == 36, "ClusterParams.clustersZ doesn't match HLSL");
+static_assert(sizeof(ClusterParams) == 40, "ClusterParams doesn't match HLSL");
+
+// cbuffer ExternalData : register(b0) in MaterialVS.hlsl
+struct MaterialVSExternalData
+{
+	DirectX::XMFLOAT4 colorTint;
+	DirectX::XMFLOAT4X4 world;
+	DirectX::XMFLOAT4X4 worldInverseTranspose;
+	DirectX::XMFLOAT4X4 viewProj;
+	unsigned int materialSlice;
+	float _pad0[3];
+};
+static_assert(offsetof(MaterialVSExternalData, colorTint) == 0, "MaterialVSExternalData.colorTint doesn't match HLSL");
+static_assert(offsetof(MaterialVSExternalData, world) == 16, "MaterialVSExternalData.world doesn't match HLSL");
+static_assert(offsetof(MaterialVSExternalData, worldInverseTranspose) == 80, "MaterialVSExternalData.worldInverseTranspose doesn't match HLSL");
+static_assert(offsetof(MaterialVSExternalData, viewProj) == 144, "MaterialVSExternalData.viewProj doesn't match HLSL");
+static_assert(offsetof(MaterialVSExternalData, materialSlice) == 208, "MaterialVSExternalData.materialSlice doesn't match HLSL");
+static_assert(sizeof(MaterialVSExternalData) == 224, "MaterialVSExternalData doesn't match HLSL");
+
+// cbuffer ExternalData : register(b0) in MaterialPS.hlsl
+struct MaterialPSExternalData
+{
+	DirectionalLight dirLights[3];
+	PointLight pointLights[3];
+	DirectX::XMFLOAT3 cameraPos;
+	float specExponent;
+};
+static_assert(offsetof(MaterialPSExternalData, dirLights) == 0, "MaterialPSExternalData.dirLights doesn't match HLSL");
+static_assert(offsetof(MaterialPSExternalData, pointLights) == 144, "MaterialPSExternalData.pointLights doesn't match HLSL");
+static_assert(offsetof(MaterialPSExternalData, cameraPos) == 288, "MaterialPSExternalData.cameraPos doesn't match HLSL");
+static_assert(offsetof(MaterialPSExternalData, specExponent) == 300, "MaterialPSExternalData.specExponent doesn't match HLSL");
+static_assert(sizeof(MaterialPSExternalData) == 304, "MaterialPSExternalData doesn't match HLSL");
+
+// cbuffer ClusterData : register(b1) in MaterialPS.hlsl
+struct MaterialPSClusterData
+{
+	ClusterParams clusterParams;
+	float _pad0[2];
+};
+static_assert(offsetof(MaterialPSClusterData, clusterParams) == 0, "MaterialPSClusterData.clusterParams doesn't match HLSL");
+static_assert(sizeof(MaterialPSClusterData) == 48, "MaterialPSClusterData doesn't match HLSL");
+
+// cbuffer ExternalData : register(b0) in vertexShaderSky.hlsl
+struct SkyVSExternalData
+{
+	DirectX::XMFLOAT4X4 view;
+	DirectX::XMFLOAT4X4 proj;
+};
+static_assert(offsetof(SkyVSExternalData, view) == 0, "SkyVSExternalData.view doesn't match HLSL");
+static_assert(offsetof(SkyVSExternalData, proj) == 64, "SkyVSExternalData.proj doesn't match HLSL");
+static_assert(sizeof(SkyVSExternalData) == 128, "SkyVSExternalData doesn't match HLSL");
+
+// cbuffer ExternalData : register(b0) in pixelShaderUpscale.hlsl
+struct UpscalePSExternalData
+{
+	DirectX::XMFLOAT2 uvScale;
+	DirectX::XMFLOAT2 uvMax;
+};
+static_assert(offsetof(UpscalePSExternalData, uvScale) == 0, "UpscalePSExternalData.uvScale doesn't match HLSL");
+static_assert(offsetof(UpscalePSExternalData, uvMax) == 8, "UpscalePSExternalData.uvMax doesn't match HLSL");
+static_assert(sizeof(UpscalePSExternalData) == 16, "UpscalePSExternalData doesn't match HLSL");
@@ -0,0 +1,311 @@
+#include "ShaderReflectionCache.h"
+#include "FilePath.h"
+#include <fstream>
+#include <string>
+#include <string.h>
+
+#ifdef _WIN32
+#include <d3d11.h>
+#include <d3dcompiler.h>
+#endif
+
+// Bump whenever the record layout changes, so old sidecars are ignored
+static const uint32_t REFL_MAGIC = 0x4C464552; // "REFL"
+static const uint32_t REFL_VERSION = 1;
+
+// --------------------------------------------------------
+// Sidecar file header, followed by each table in order
+// --------------------------------------------------------
+struct ReflectionFileHeader
+{
+	uint32_t Magic;
+	uint32_t Version;
+	uint64_t Hash;
+	uint32_t ConstantBufferCount;
+	uint32_t VariableCount;
+	uint32_t ResourceCount;
+	uint32_t InputCount;
+	uint32_t NameBytes;
+	uint32_t Pad;
+};
+
+bool ShaderReflectionCache::enabled = true;
+unsigned int ShaderReflectionCache::hits = 0;
+unsigned int ShaderReflectionCache::misses = 0;
+
+void ShaderReflectionData::Clear()
+{
+	ConstantBuffers.clear();
+	Variables.clear();
+	Resources.clear();
+	Inputs.clear();
+	Names.clear();
+}
+
+uint64_t ShaderReflectionCache::Hash(const void* data, size_t size)
+{
+	const unsigned char* bytes = (const unsigned char*)data;
+	uint64_t hash = 14695981039346656037ull;
+	for (size_t i = 0; i < size; i++)
+	{
+		hash ^= bytes[i];
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+// --------------------------------------------------------
+// Gets the reflection tables for a loaded shader
+//
+// shaderFile - The .cso the code came from; the sidecar is
+//              the same path with ".refl" appended
+// --------------------------------------------------------
+bool ShaderReflectionCache::GetReflection(const wchar_t* shaderFile, const void* byteCode, size_t byteCodeSize, ShaderReflectionData* data)
+{
+	std::wstring sidecar = std::wstring(shaderFile) + L".refl";
+	uint64_t hash = Hash(byteCode, byteCodeSize);
+
+	if (enabled && Load(sidecar.c_str(), hash, data))
+	{
+		hits++;
+		return true;
+	}
+
+	misses++;
+	if (!Reflect(byteCode, byteCodeSize, data))
+		return false;
+
+	// A failed save just means we reflect again next time
+	if (enabled)
+		Save(sidecar.c_str(), hash, *data);
+
+	return true;
+}
+
+uint32_t ShaderReflectionCache::AddName(ShaderReflectionData* data, const char* name)
+{
+	uint32_t offset = (uint32_t)data->Names.size();
+	data->Names.insert(data->Names.end(), name, name + strlen(name) + 1);
+	return offset;
+}
+
+// --------------------------------------------------------
+// Runs D3DReflect() on the code and flattens the parts
+// SimpleShader uses: constant buffers and their variables,
+// bound resources and the input signature
+// --------------------------------------------------------
+bool ShaderReflectionCache::Reflect(const void* byteCode, size_t byteCodeSize, ShaderReflectionData* data)
+{
+	data->Clear();
+
+#ifdef _WIN32
+	ID3D11ShaderReflection* refl;
+	HRESULT hr = D3DReflect(
+		byteCode,
+		byteCodeSize,
+		IID_ID3D11ShaderReflection,
+		(void**)&refl);
+	if (FAILED(hr))
+		return false;
+
+	D3D11_SHADER_DESC shaderDesc;
+	refl->GetDesc(&shaderDesc);
+
+	// Bound resources (textures, samplers, the cbuffers themselves...)
+	for (unsigned int r = 0; r < shaderDesc.BoundResources; r++)
+	{
+		D3D11_SHADER_INPUT_BIND_DESC resourceDesc;
+		refl->GetResourceBindingDesc(r, &resourceDesc);
+
+		ReflectedResource resource;
+		resource.NameOffset = AddName(data, resourceDesc.Name);
+		resource.Type = resourceDesc.Type;
+		resource.BindIndex = resourceDesc.BindPoint;
+		data->Resources.push_back(resource);
+	}
+
+	// Constant buffers and their variables
+	for (unsigned int b = 0; b < shaderDesc.ConstantBuffers; b++)
+	{
+		ID3D11ShaderReflectionConstantBuffer* cb = refl->GetConstantBufferByIndex(b);
+
+		D3D11_SHADER_BUFFER_DESC bufferDesc;
+		cb->GetDesc(&bufferDesc);
+
+		D3D11_SHADER_INPUT_BIND_DESC bindDesc;
+		refl->GetResourceBindingDescByName(bufferDesc.Name, &bindDesc);
+
+		ReflectedConstantBuffer buffer;
+		buffer.NameOffset = AddName(data, bufferDesc.Name);
+		buffer.Type = bufferDesc.Type;
+		buffer.Size = bufferDesc.Size;
+		buffer.BindIndex = bindDesc.BindPoint;
+		buffer.FirstVariable = (uint32_t)data->Variables.size();
+		buffer.VariableCount = bufferDesc.Variables;
+		data->ConstantBuffers.push_back(buffer);
+
+		for (unsigned int v = 0; v < bufferDesc.Variables; v++)
+		{
+			D3D11_SHADER_VARIABLE_DESC varDesc;
+			cb->GetVariableByIndex(v)->GetDesc(&varDesc);
+
+			ReflectedVariable var;
+			var.NameOffset = AddName(data, varDesc.Name);
+			var.ByteOffset = varDesc.StartOffset;
+			var.Size = varDesc.Size;
+			data->Variables.push_back(var);
+		}
+	}
+
+	// Input signature, for building input layouts
+	for (unsigned int i = 0; i < shaderDesc.InputParameters; i++)
+	{
+		D3D11_SIGNATURE_PARAMETER_DESC paramDesc;
+		refl->GetInputParameterDesc(i, &paramDesc);
+
+		ReflectedInput input;
+		input.SemanticNameOffset = AddName(data, paramDesc.SemanticName);
+		input.SemanticIndex = paramDesc.SemanticIndex;
+		input.ComponentType = paramDesc.ComponentType;
+		input.Mask = paramDesc.Mask;
+		data->Inputs.push_back(input);
+	}
+
+	refl->Release();
+	return true;
+#else
+	return false;
+#endif
+}
+
+// --------------------------------------------------------
+// Helpers for reading/writing a whole table at once
+// --------------------------------------------------------
+template<typename T>
+static bool ReadTable(std::ifstream& file, std::vector<T>& table, uint32_t count)
+{
+	table.resize(count);
+	if (count > 0)
+		file.read((char*)table.data(), sizeof(T) * count);
+	return file.good();
+}
+
+template<typename T>
+static void WriteTable(std::ofstream& file, const std::vector<T>& table)
+{
+	if (!table.empty())
+		file.write((const char*)table.data(), sizeof(T) * table.size());
+}
+
+// --------------------------------------------------------
+// Checks every name offset lands inside the name pool, and
+// every cbuffer's variables inside the variable table.  The
+// pool has to end in a null, so each name is terminated
+// before the pool runs out.
+// --------------------------------------------------------
+static bool IsNameValid(const ShaderReflectionData& data, uint32_t offset)
+{
+	return offset < data.Names.size();
+}
+
+static bool IsValid(const ShaderReflectionData& data)
+{
+	if (data.Names.empty() || data.Names.back() != '\0')
+		return data.ConstantBuffers.empty() && data.Resources.empty() && data.Inputs.empty() && data.Variables.empty();
+
+	for (const ReflectedConstantBuffer& buffer : data.ConstantBuffers)
+	{
+		if (!IsNameValid(data, buffer.NameOffset) ||
+			buffer.FirstVariable > data.Variables.size() ||
+			buffer.VariableCount > data.Variables.size() - buffer.FirstVariable)
+			return false;
+	}
+	for (const ReflectedVariable& var : data.Variables)
+	{
+		if (!IsNameValid(data, var.NameOffset))
+			return false;
+	}
+	for (const ReflectedResource& resource : data.Resources)
+	{
+		if (!IsNameValid(data, resource.NameOffset))
+			return false;
+	}
+	for (const ReflectedInput& input : data.Inputs)
+	{
+		if (!IsNameValid(data, input.SemanticNameOffset))
+			return false;
+	}
+	return true;
+}
+
+// --------------------------------------------------------
+// Reads a sidecar, failing if it is missing, from another
+// version, made from a different shader, or not the size
+// its header says or pointing outside its own tables (cut
+// short or corrupted)
+// --------------------------------------------------------
+bool ShaderReflectionCache::Load(const wchar_t* sidecarFile, uint64_t hash, ShaderReflectionData* data)
+{
+	std::ifstream file(ToNativePath(sidecarFile).c_str(), std::ios::binary | std::ios::ate);
+	if (!file)
+		return false;
+	uint64_t fileBytes = (uint64_t)file.tellg();
+	file.seekg(0);
+
+	ReflectionFileHeader header;
+	file.read((char*)&header, sizeof(header));
+	if (!file.good() ||
+		header.Magic != REFL_MAGIC ||
+		header.Version != REFL_VERSION ||
+		header.Hash != hash)
+		return false;
+
+	// Before sizing any table from the header's counts
+	uint64_t expectedBytes = sizeof(header) +
+		(uint64_t)header.ConstantBufferCount * sizeof(ReflectedConstantBuffer) +
+		(uint64_t)header.VariableCount * sizeof(ReflectedVariable) +
+		(uint64_t)header.ResourceCount * sizeof(ReflectedResource) +
+		(uint64_t)header.InputCount * sizeof(ReflectedInput) +
+		header.NameBytes;
+	if (expectedBytes != fileBytes)
+		return false;
+
+	bool ok =
+		ReadTable(file, data->ConstantBuffers, header.ConstantBufferCount) &&
+		ReadTable(file, data->Variables, header.VariableCount) &&
+		ReadTable(file, data->Resources, header.ResourceCount) &&
+		ReadTable(file, data->Inputs, header.InputCount) &&
+		ReadTable(file, data->Names, header.NameBytes);
+
+	// A truncated or corrupt file is as good as no file
+	if (ok && !IsValid(*data))
+		ok = false;
+	if (!ok)
+		data->Clear();
+	return ok;
+}
+
+bool ShaderReflectionCache::Save(const wchar_t* sidecarFile, uint64_t hash, const ShaderReflectionData& data)
+{
+	std::ofstream file(ToNativePath(sidecarFile).c_str(), std::ios::binary | std::ios::trunc);
+	if (!file)
+		return false;
+
+	ReflectionFileHeader header = {};
+	header.Magic = REFL_MAGIC;
+	header.Version = REFL_VERSION;
+	header.Hash = hash;
+	header.ConstantBufferCount = (uint32_t)data.ConstantBuffers.size();
+	header.VariableCount = (uint32_t)data.Variables.size();
+	header.ResourceCount = (uint32_t)data.Resources.size();
+	header.InputCount = (uint32_t)data.Inputs.size();
+	header.NameBytes = (uint32_t)data.Names.size();
+	file.write((const char*)&header, sizeof(header));
+
+	WriteTable(file, data.ConstantBuffers);
+	WriteTable(file, data.Variables);
+	WriteTable(file, data.Resources);
+	WriteTable(file, data.Inputs);
+	WriteTable(file, data.Names);
+	return file.good();
+}
@@ -0,0 +1,124 @@
+#pragma once
+#include <cstdint>
+#include <stddef.h>
+#include <vector>
+
+// --------------------------------------------------------
+// The reflection values the records below hold.  They're
+// D3D's own (D3D_CBUFFER_TYPE, D3D_SHADER_INPUT_TYPE and
+// D3D_REGISTER_COMPONENT_TYPE), so sidecars read the same
+// without the D3D headers.
+// --------------------------------------------------------
+enum ReflectedBufferType : uint32_t
+{
+	REFLECTED_BUFFER_CBUFFER = 0,
+	REFLECTED_BUFFER_TBUFFER = 1,
+};
+
+enum ReflectedResourceType : uint32_t
+{
+	REFLECTED_RESOURCE_CBUFFER = 0,
+	REFLECTED_RESOURCE_TBUFFER = 1,
+	REFLECTED_RESOURCE_TEXTURE = 2,
+	REFLECTED_RESOURCE_SAMPLER = 3,
+	REFLECTED_RESOURCE_STRUCTURED = 5,
+	REFLECTED_RESOURCE_BYTEADDRESS = 7,
+};
+
+enum ReflectedComponentType : uint32_t
+{
+	REFLECTED_COMPONENT_UINT32 = 1,
+	REFLECTED_COMPONENT_SINT32 = 2,
+	REFLECTED_COMPONENT_FLOAT32 = 3,
+};
+
+// --------------------------------------------------------
+// Flat reflection records.  Names are offsets into the
+// data's name pool, so every table is plain old data and
+// can be written to (and read from) disk as-is.
+// --------------------------------------------------------
+struct ReflectedConstantBuffer
+{
+	uint32_t NameOffset;
+	uint32_t Type;			// ReflectedBufferType
+	uint32_t Size;
+	uint32_t BindIndex;
+	uint32_t FirstVariable;	// Index into Variables
+	uint32_t VariableCount;
+};
+
+struct ReflectedVariable
+{
+	uint32_t NameOffset;
+	uint32_t ByteOffset;
+	uint32_t Size;
+};
+
+struct ReflectedResource
+{
+	uint32_t NameOffset;
+	uint32_t Type;			// ReflectedResourceType
+	uint32_t BindIndex;
+};
+
+struct ReflectedInput
+{
+	uint32_t SemanticNameOffset;
+	uint32_t SemanticIndex;
+	uint32_t ComponentType;	// ReflectedComponentType
+	uint32_t Mask;
+};
+
+// --------------------------------------------------------
+// Everything SimpleShader needs from reflection
+// --------------------------------------------------------
+struct ShaderReflectionData
+{
+	std::vector<ReflectedConstantBuffer> ConstantBuffers;
+	std::vector<ReflectedVariable> Variables;
+	std::vector<ReflectedResource> Resources;
+	std::vector<ReflectedInput> Inputs;
+	std::vector<char> Names;
+
+	const char* GetName(uint32_t offset) const { return &Names[offset]; }
+	void Clear();
+};
+
+// --------------------------------------------------------
+// Sidecar cache of shader reflection results.  Each .cso
+// gets a ".refl" file next to it holding the flat tables
+// above, keyed by a hash of the compiled shader, so loads
+// skip D3DReflect() entirely until the shader is rebuilt.
+// Reflecting needs the D3D compiler, so off Windows only
+// sidecars can be read.
+// --------------------------------------------------------
+class ShaderReflectionCache
+{
+public:
+	// Fills data from the shader's sidecar if it matches the code, and
+	// otherwise reflects the code (writing a new sidecar if enabled)
+	static bool GetReflection(const wchar_t* shaderFile, const void* byteCode, size_t byteCodeSize, ShaderReflectionData* data);
+
+	// Reflects a compiled shader into flat tables
+	static bool Reflect(const void* byteCode, size_t byteCodeSize, ShaderReflectionData* data);
+
+	// FNV-1a, 64 bit
+	static uint64_t Hash(const void* data, size_t size);
+
+	// Turning the cache off makes every load reflect (used for timing)
+	static void SetEnabled(bool enabled) { ShaderReflectionCache::enabled = enabled; }
+	static bool IsEnabled() { return enabled; }
+
+	static unsigned int GetHitCount() { return hits; }
+	static unsigned int GetMissCount() { return misses; }
+	static void ResetCounts() { hits = 0; misses = 0; }
+
+private:
+	static bool enabled;
+	static unsigned int hits;
+	static unsigned int misses;
+
+	static bool Load(const wchar_t* sidecarFile, uint64_t hash, ShaderReflectionData* data);
+	static bool Save(const wchar_t* sidecarFile, uint64_t hash, const ShaderReflectionData& data);
+	static uint32_t AddName(ShaderReflectionData* data, const char* name);
+};
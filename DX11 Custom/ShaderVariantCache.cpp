@@ -0,0 +1,184 @@
+#include "ShaderVariantCache.h"
+#include "FilePath.h"
+#include <stdio.h>
+
+#ifdef _WIN32
+#include <d3dcompiler.h>
+#pragma comment(lib, "d3dcompiler.lib")
+#endif
+
+ShaderVariantCache::ShaderVariantCache(RenderBackend* backend, std::wstring sourceDir, std::wstring outputDir)
+{
+	this->backend = backend;
+	this->sourceDir = sourceDir;
+	this->outputDir = outputDir;
+	lastGoodVertexShader[0] = 0;
+	lastGoodVertexShader[1] = 0;
+	lastGoodPixelShader = 0;
+}
+
+ShaderVariantCache::~ShaderVariantCache()
+{
+	for (auto& v : vertexShaders)
+		delete v.second;
+	for (auto& p : pixelShaders)
+		delete p.second;
+}
+
+unsigned int ShaderVariantCache::MakeFeatures(bool normalMap, bool pbrMaps, unsigned int dirLights, unsigned int pointLights, bool instancing)
+{
+	unsigned int features = 0;
+	if (normalMap) features |= MATERIAL_FEATURE_NORMAL_MAP;
+	if (pbrMaps) features |= MATERIAL_FEATURE_PBR_MAPS;
+	if (instancing) features |= MATERIAL_FEATURE_INSTANCING;
+	features |= (dirLights & 3) << MATERIAL_FEATURE_DIR_LIGHT_SHIFT;
+	features |= (pointLights & 3) << MATERIAL_FEATURE_POINT_LIGHT_SHIFT;
+	return features;
+}
+
+SimpleVertexShader* ShaderVariantCache::GetVertexShader(unsigned int features)
+{
+	features &= MATERIAL_FEATURE_VERTEX_MASK;
+	unsigned int compact = (features & MATERIAL_FEATURE_COMPACT_VERTICES) ? 1 : 0;
+
+	// Failed variants stay in the map as null, so they're only tried once
+	auto found = vertexShaders.find(features);
+	if (found != vertexShaders.end())
+		return found->second ? found->second : lastGoodVertexShader[compact];
+
+	std::wstring cso = BuildVariant(L"MaterialVS", "vs_5_0", features);
+	// Compact meshes feed packed formats to the same float inputs
+	SimpleVertexShader* vs = compact ?
+		new SimpleVertexShader(backend, cso.c_str(), CompactVertexElements, COMPACT_VERTEX_ELEMENT_COUNT) :
+		new SimpleVertexShader(backend, cso.c_str());
+	if (!vs->IsShaderValid())
+	{
+		delete vs;
+		vs = 0;
+	}
+
+	vertexShaders[features] = vs;
+	if (vs)
+	{
+		lastGoodVertexShader[compact] = vs;
+		return vs;
+	}
+
+	printf("ERROR: MaterialVS variant 0x%02x neither compiled nor loaded, %s\n", features,
+		lastGoodVertexShader[compact] ? "using the last good variant" : "and there's no variant to fall back to");
+	return lastGoodVertexShader[compact];
+}
+
+SimplePixelShader* ShaderVariantCache::GetPixelShader(unsigned int features)
+{
+	// Instancing and the vertex format only change the vertex shader
+	features &= ~(MATERIAL_FEATURE_INSTANCING | MATERIAL_FEATURE_COMPACT_VERTICES);
+
+	auto found = pixelShaders.find(features);
+	if (found != pixelShaders.end())
+		return found->second ? found->second : lastGoodPixelShader;
+
+	std::wstring cso = BuildVariant(L"MaterialPS", "ps_5_0", features);
+	SimplePixelShader* ps = new SimplePixelShader(backend, cso.c_str());
+	if (!ps->IsShaderValid())
+	{
+		delete ps;
+		ps = 0;
+	}
+
+	pixelShaders[features] = ps;
+	if (ps)
+	{
+		pixelShaderList.push_back(ps);
+		lastGoodPixelShader = ps;
+		return ps;
+	}
+
+	printf("ERROR: MaterialPS variant 0x%02x neither compiled nor loaded, %s\n", features,
+		lastGoodPixelShader ? "using the last good variant" : "and there's no variant to fall back to");
+	return lastGoodPixelShader;
+}
+
+// --------------------------------------------------------
+// Compiles sourceName.hlsl with the defines for these
+// features and writes it to sourceName_<features>.cso,
+// unless that .cso is already newer than the sources.
+// The path is returned even if compiling fails, so a .cso
+// left by an earlier run can still be loaded.
+// --------------------------------------------------------
+std::wstring ShaderVariantCache::BuildVariant(const wchar_t* sourceName, const char* target, unsigned int features)
+{
+	wchar_t suffix[16];
+	swprintf(suffix, 16, L"_%02x.cso", features);
+	std::wstring csoPath = outputDir + L"\\" + sourceName + suffix;
+	std::wstring sourcePath = sourceDir + L"\\" + sourceName + L".hlsl";
+
+	// Skip the compile if nothing changed since the last run
+	unsigned long long csoTime = GetFileWriteTime(csoPath);
+	if (csoTime != 0 &&
+		csoTime > GetFileWriteTime(sourcePath) &&
+		csoTime > GetFileWriteTime(sourceDir + L"\\MaterialCommon.hlsli"))
+		return csoPath;
+
+#ifdef _WIN32
+	// Defines for each feature
+	char normalMap[2], pbrMaps[2], dirLights[2], pointLights[2], instancing[2], clustered[2], atlas[2], compact[2], imageLighting[2];
+	snprintf(normalMap, sizeof(normalMap), "%u", (features & MATERIAL_FEATURE_NORMAL_MAP) ? 1 : 0);
+	snprintf(pbrMaps, sizeof(pbrMaps), "%u", (features & MATERIAL_FEATURE_PBR_MAPS) ? 1 : 0);
+	snprintf(dirLights, sizeof(dirLights), "%u", (features >> MATERIAL_FEATURE_DIR_LIGHT_SHIFT) & 3);
+	snprintf(pointLights, sizeof(pointLights), "%u", (features >> MATERIAL_FEATURE_POINT_LIGHT_SHIFT) & 3);
+	snprintf(instancing, sizeof(instancing), "%u", (features & MATERIAL_FEATURE_INSTANCING) ? 1 : 0);
+	snprintf(clustered, sizeof(clustered), "%u", (features & MATERIAL_FEATURE_CLUSTERED_LIGHTS) ? 1 : 0);
+	snprintf(atlas, sizeof(atlas), "%u", (features & MATERIAL_FEATURE_MATERIAL_ATLAS) ? 1 : 0);
+	snprintf(compact, sizeof(compact), "%u", (features & MATERIAL_FEATURE_COMPACT_VERTICES) ? 1 : 0);
+	snprintf(imageLighting, sizeof(imageLighting), "%u", (features & MATERIAL_FEATURE_IMAGE_LIGHTING) ? 1 : 0);
+
+	D3D_SHADER_MACRO defines[] =
+	{
+		{ "HAS_NORMAL_MAP", normalMap },
+		{ "HAS_PBR_MAPS", pbrMaps },
+		{ "NUM_DIR_LIGHTS", dirLights },
+		{ "NUM_POINT_LIGHTS", pointLights },
+		{ "USE_INSTANCING", instancing },
+		{ "USE_CLUSTERED_LIGHTS", clustered },
+		{ "USE_MATERIAL_ATLAS", atlas },
+		{ "USE_COMPACT_VERTICES", compact },
+		{ "USE_IMAGE_LIGHTING", imageLighting },
+		{ 0, 0 }
+	};
+
+	UINT flags = D3DCOMPILE_ENABLE_STRICTNESS;
+#if defined(DEBUG) || defined(_DEBUG)
+	flags |= D3DCOMPILE_DEBUG | D3DCOMPILE_SKIP_OPTIMIZATION;
+#else
+	flags |= D3DCOMPILE_OPTIMIZATION_LEVEL3;
+#endif
+
+	ID3DBlob* code = 0;
+	ID3DBlob* errors = 0;
+	HRESULT hr = D3DCompileFromFile(
+		sourcePath.c_str(),
+		defines,
+		D3D_COMPILE_STANDARD_FILE_INCLUDE,
+		"main",
+		target,
+		flags,
+		0,
+		&code,
+		&errors);
+
+	if (errors)
+	{
+		printf("%ls (features 0x%02x):\n%s\n", sourceName, features, (const char*)errors->GetBufferPointer());
+		errors->Release();
+	}
+
+	if (SUCCEEDED(hr))
+		D3DWriteBlobToFile(code, csoPath.c_str(), TRUE);
+
+	if (code)
+		code->Release();
+#endif
+
+	return csoPath;
+}
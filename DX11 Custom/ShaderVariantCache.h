@@ -0,0 +1,82 @@
+#pragma once
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "SimpleShader.h"
+#include "VertexLayouts.h"
+
+// --------------------------------------------------------
+// Feature bits of a material shader variant.  Each maps to a
+// define in MaterialCommon.hlsli.
+// --------------------------------------------------------
+enum MaterialFeature : unsigned int
+{
+	MATERIAL_FEATURE_NORMAL_MAP = 1 << 0,	// HAS_NORMAL_MAP
+	MATERIAL_FEATURE_PBR_MAPS = 1 << 1,		// HAS_PBR_MAPS (roughness + metalness)
+	MATERIAL_FEATURE_INSTANCING = 1 << 2,	// USE_INSTANCING
+	MATERIAL_FEATURE_CLUSTERED_LIGHTS = 1 << 7,	// USE_CLUSTERED_LIGHTS (above the light counts)
+	MATERIAL_FEATURE_MATERIAL_ATLAS = 1 << 8,	// USE_MATERIAL_ATLAS (needs NORMAL_MAP and PBR_MAPS)
+	MATERIAL_FEATURE_COMPACT_VERTICES = 1 << 9,	// USE_COMPACT_VERTICES (meshes made with MESH_VERTEX_COMPACT)
+	MATERIAL_FEATURE_IMAGE_LIGHTING = 1 << 10,	// USE_IMAGE_LIGHTING (EnvironmentLighting's maps)
+};
+
+// The light counts are 2-bit fields above the flags
+#define MATERIAL_FEATURE_DIR_LIGHT_SHIFT	3	// NUM_DIR_LIGHTS
+#define MATERIAL_FEATURE_POINT_LIGHT_SHIFT	5	// NUM_POINT_LIGHTS
+
+// Only these bits change the vertex shader, so variants that differ
+// in anything else share one
+#define MATERIAL_FEATURE_VERTEX_MASK (MATERIAL_FEATURE_NORMAL_MAP | MATERIAL_FEATURE_INSTANCING | MATERIAL_FEATURE_MATERIAL_ATLAS | MATERIAL_FEATURE_COMPACT_VERTICES)
+
+// --------------------------------------------------------
+// Compiles material shader variants from MaterialVS.hlsl and
+// MaterialPS.hlsl on first use and keeps them, keyed by their
+// feature bits.  The sources are copied next to the
+// executable by the build, like the .cso files, and compiled
+// variants are written out there too, so they also go through
+// the reflection cache.  If the sources can't be found (or
+// fail to compile) a previously written .cso is loaded
+// instead, and failing that, the last variant that did work.
+// Compiling needs the D3D compiler, so off Windows only
+// written .cso files are loaded.
+// --------------------------------------------------------
+class ShaderVariantCache
+{
+public:
+	// sourceDir - Folder holding the .hlsl sources
+	// outputDir - Folder the variant .cso files are written to
+	ShaderVariantCache(RenderBackend* backend, std::wstring sourceDir, std::wstring outputDir);
+	~ShaderVariantCache();
+
+	static unsigned int MakeFeatures(bool normalMap, bool pbrMaps, unsigned int dirLights, unsigned int pointLights, bool instancing = false);
+
+	// Variants are created on first request.  One that neither
+	// compiles nor loads is reported, and stood in for by the
+	// last good variant (with the same vertex format, for vertex
+	// shaders); null only if there hasn't been one yet.
+	SimpleVertexShader* GetVertexShader(unsigned int features);
+	SimplePixelShader* GetPixelShader(unsigned int features);
+
+	// Every pixel shader variant created so far, for per-frame data
+	// shared by all of them (lights, camera)
+	const std::vector<SimplePixelShader*>& GetPixelShaders() { return pixelShaderList; }
+
+	unsigned int GetVariantCount() { return (unsigned int)(vertexShaders.size() + pixelShaders.size()); }
+
+private:
+	RenderBackend* backend;
+	std::wstring sourceDir;
+	std::wstring outputDir;
+
+	std::unordered_map<unsigned int, SimpleVertexShader*> vertexShaders;
+	std::unordered_map<unsigned int, SimplePixelShader*> pixelShaders;
+	std::vector<SimplePixelShader*> pixelShaderList;
+
+	// The last variants that worked, vertex shaders by whether
+	// they take compact vertices
+	SimpleVertexShader* lastGoodVertexShader[2];
+	SimplePixelShader* lastGoodPixelShader;
+
+	// Compiles one variant to a .cso and returns its path
+	std::wstring BuildVariant(const wchar_t* sourceName, const char* target, unsigned int features);
+};
@@ -1,23 +1,52 @@
 #include "SimpleShader.h"
+#include "StateCache.h"
+#include "ConstantBufferRing.h"
+#include "RenderBackend.h"
+#include "PipelineState.h"
+#include "FilePath.h"
+#include <fstream>
+#include <string.h>
+
+#ifndef _WIN32
+#include <strings.h>
+#define _stricmp strcasecmp
+#define _strnicmp strncasecmp
+#endif
+
+// Shared by all shaders - see SetStateCache(), SetConstantBufferRing()
+// and SetPipelineStateCache()
+StateCache* ISimpleShader::stateCache = 0;
+ConstantBufferRing* ISimpleShader::cbRing = 0;
+PipelineStateCache* ISimpleShader::pipelineStates = 0;
+SimpleShaderUploadStats ISimpleShader::uploadStats = {};
+
+// --------------------------------------------------------
+// Zeroes the shared upload counts
+// --------------------------------------------------------
+void ISimpleShader::ResetUploadStats()
+{
+	uploadStats = {};
+}
 
 ///////////////////////////////////////////////////////////////////////////////
 // ------ BASE SIMPLE SHADER --------------------------------------------------
 ///////////////////////////////////////////////////////////////////////////////
 
 // --------------------------------------------------------
-// Constructor accepts DirectX device & context
+// Constructor accepts the backend the shader is made with
 // --------------------------------------------------------
-ISimpleShader::ISimpleShader(ID3D11Device* device, ID3D11DeviceContext* context)
+ISimpleShader::ISimpleShader(RenderBackend* backend)
 {
-	// Save the device
-	this->device = device;
-	this->deviceContext = context;
+	// Save the backend
+	this->backend = backend;
 
 	// Set up fields
 	this->constantBufferCount = 0;
 	this->constantBuffers = 0;
-	this->shaderBlob = 0;
 	this->shaderValid = false;
+	this->useRing = false;
+	this->stagedSRVMask = 0;
+	this->stagedSamplerMask = 0;
 }
 
 // --------------------------------------------------------
@@ -26,8 +55,6 @@ ISimpleShader::ISimpleShader(ID3D11Device* device, ID3D11DeviceContext* context)
 ISimpleShader::~ISimpleShader()
 {
 	// Derived class destructors will call this class's CleanUp method
-	if(shaderBlob)
-		shaderBlob->Release();
 }
 
 // --------------------------------------------------------
@@ -39,7 +66,9 @@ void ISimpleShader::CleanUp()
 	// Handle constant buffers and local data buffers
 	for (unsigned int i = 0; i < constantBufferCount; i++)
 	{
-		constantBuffers[i].ConstantBuffer->Release();
+		// Ring-backed buffers point into the shared ring, which isn't ours
+		if (!useRing && constantBuffers[i].ConstantBuffer)
+			constantBuffers[i].ConstantBuffer->Release();
 		delete[] constantBuffers[i].LocalDataBuffer;
 	}
 
@@ -55,7 +84,12 @@ void ISimpleShader::CleanUp()
 	for (unsigned int i = 0; i < samplerStates.size(); i++)
 		delete samplerStates[i];
 
+	// Staged slots may not exist in a reloaded shader
+	stagedSRVMask = 0;
+	stagedSamplerMask = 0;
+
 	// Clean up tables
+	variables.clear();
 	varTable.clear();
 	cbTable.clear();
 	samplerTable.clear();
@@ -70,71 +104,80 @@ void ISimpleShader::CleanUp()
 // 
 // Returns true if shader is loaded properly, false otherwise
 // --------------------------------------------------------
-bool ISimpleShader::LoadShaderFile(LPCWSTR shaderFile)
+bool ISimpleShader::LoadShaderFile(const wchar_t* shaderFile)
 {
-	// Load the shader to a blob and ensure it worked
-	HRESULT hr = D3DReadFileToBlob(shaderFile, &shaderBlob);
-	if (hr != S_OK)
+	// Read the compiled shader.  A missing file leaves no code
+	// and nothing to reflect, which only a backend that runs no
+	// shaders (the null one, where nothing is compiled) accepts.
+	byteCode.clear();
+	reflection.Clear();
+	std::ifstream file(ToNativePath(shaderFile).c_str(), std::ios::binary | std::ios::ate);
+	if (file)
 	{
-		return false;
+		byteCode.resize((size_t)file.tellg());
+		file.seekg(0);
+		file.read((char*)byteCode.data(), byteCode.size());
+		if (!file.good())
+			return false;
+
+		// Get the reflection tables for this shader, from its
+		// sidecar cache if the shader hasn't changed since
+		if (!ShaderReflectionCache::GetReflection(shaderFile, byteCode.data(), byteCode.size(), &reflection))
+		{
+			return false;
+		}
 	}
 
 	// Create the shader - Calls an overloaded version of this abstract
 	// method in the appropriate child class
-	shaderValid = CreateShader(shaderBlob);
+	shaderValid = CreateShader();
 	if (!shaderValid)
 	{
 		return false;
 	}
 
-	// Set up shader reflection to get information about
-	// this shader and its variables,  buffers, etc.
-	ID3D11ShaderReflection* refl;
-	D3DReflect(
-		shaderBlob->GetBufferPointer(),
-		shaderBlob->GetBufferSize(),
-		IID_ID3D11ShaderReflection,
-		(void**)&refl);
-	
-	// Get the description of the shader
-	D3D11_SHADER_DESC shaderDesc;
-	refl->GetDesc(&shaderDesc);
+	// Share the constant buffer ring if this stage can bind windows of it
+	useRing =
+		cbRing && cbRing->IsSupported() &&
+		stateCache &&
+		SupportsConstantBufferRing();
 
 	// Create resource arrays
-	constantBufferCount = shaderDesc.ConstantBuffers;
+	constantBufferCount = (unsigned int)reflection.ConstantBuffers.size();
 	constantBuffers = new SimpleConstantBuffer[constantBufferCount];
 	
 	// Handle bound resources (like shaders and samplers)
-	unsigned int resourceCount = shaderDesc.BoundResources;
-	for (unsigned int r = 0; r < resourceCount; r++)
+	for (unsigned int r = 0; r < reflection.Resources.size(); r++)
 	{
-		// Get this resource's description
-		D3D11_SHADER_INPUT_BIND_DESC resourceDesc;
-		refl->GetResourceBindingDesc(r, &resourceDesc);
+		const ReflectedResource& resourceDesc = reflection.Resources[r];
+		const char* resourceName = reflection.GetName(resourceDesc.NameOffset);
 
 		// Check the type
 		switch (resourceDesc.Type)
 		{
-		case D3D_SIT_TEXTURE: // A texture resource
+		case REFLECTED_RESOURCE_TEXTURE: // A texture resource
+		case REFLECTED_RESOURCE_TBUFFER: // Buffers also bound as views
+		case REFLECTED_RESOURCE_STRUCTURED:
+		case REFLECTED_RESOURCE_BYTEADDRESS:
 		{
 			// Create the SRV wrapper
 			SimpleSRV* srv = new SimpleSRV();
-			srv->BindIndex = resourceDesc.BindPoint;				// Shader bind point
+			srv->BindIndex = resourceDesc.BindIndex;				// Shader bind point
 			srv->Index = (unsigned int)shaderResourceViews.size();	// Raw index
 
-			textureTable.insert(std::pair<std::string, SimpleSRV*>(resourceDesc.Name, srv));
+			textureTable.insert(std::pair<std::string, SimpleSRV*>(resourceName, srv));
 			shaderResourceViews.push_back(srv);
 		}
 			break;
 
-		case D3D_SIT_SAMPLER: // A sampler resource
+		case REFLECTED_RESOURCE_SAMPLER: // A sampler resource
 		{
 			// Create the sampler wrapper
 			SimpleSampler* samp = new SimpleSampler();
-			samp->BindIndex = resourceDesc.BindPoint;			// Shader bind point
+			samp->BindIndex = resourceDesc.BindIndex;			// Shader bind point
 			samp->Index = (unsigned int)samplerStates.size();	// Raw index
 
-			samplerTable.insert(std::pair<std::string, SimpleSampler*>(resourceDesc.Name, samp));
+			samplerTable.insert(std::pair<std::string, SimpleSampler*>(resourceName, samp));
 			samplerStates.push_back(samp);
 		}
 			break;
@@ -144,70 +187,58 @@ bool ISimpleShader::LoadShaderFile(LPCWSTR shaderFile)
 	// Loop through all constant buffers
 	for (unsigned int b = 0; b < constantBufferCount; b++)
 	{
-		// Get this buffer
-		ID3D11ShaderReflectionConstantBuffer* cb =
-			refl->GetConstantBufferByIndex(b);
-		
 		// Get the description of this buffer
-		D3D11_SHADER_BUFFER_DESC bufferDesc;
-		cb->GetDesc(&bufferDesc);
+		const ReflectedConstantBuffer& bufferDesc = reflection.ConstantBuffers[b];
+		const char* bufferName = reflection.GetName(bufferDesc.NameOffset);
 
 		// Save the type, which we reference when setting these buffers
-		constantBuffers[b].Type = bufferDesc.Type;
-		
-		// Get the description of the resource binding, so
-		// we know exactly how it's bound in the shader
-		D3D11_SHADER_INPUT_BIND_DESC bindDesc;
-		refl->GetResourceBindingDescByName(bufferDesc.Name, &bindDesc);
+		constantBuffers[b].Type = (ReflectedBufferType)bufferDesc.Type;
 		
 		// Set up the buffer and put its pointer in the table
-		constantBuffers[b].BindIndex = bindDesc.BindPoint;
-		constantBuffers[b].Name = bufferDesc.Name;
-		cbTable.insert(std::pair<std::string, SimpleConstantBuffer*>(bufferDesc.Name, &constantBuffers[b]));
-
-		// Create this constant buffer
-		D3D11_BUFFER_DESC newBuffDesc;
-		newBuffDesc.Usage = D3D11_USAGE_DEFAULT;
-		newBuffDesc.ByteWidth = bufferDesc.Size;
-		newBuffDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
-		newBuffDesc.CPUAccessFlags = 0;
-		newBuffDesc.MiscFlags = 0;
-		newBuffDesc.StructureByteStride = 0;
-		device->CreateBuffer(&newBuffDesc, 0, &constantBuffers[b].ConstantBuffer);
+		constantBuffers[b].BindIndex = bufferDesc.BindIndex;
+		constantBuffers[b].Name = bufferName;
+		cbTable.insert(std::pair<std::string, SimpleConstantBuffer*>(bufferName, &constantBuffers[b]));
+
+		// Create this constant buffer, unless it will live in the ring.
+		// Dynamic so uploads can Map(DISCARD) rather than UpdateSubresource.
+		if (!useRing)
+		{
+			BufferDesc newBuffDesc = {};
+			newBuffDesc.Usage = RENDER_USAGE_DYNAMIC;
+			newBuffDesc.ByteWidth = bufferDesc.Size;
+			newBuffDesc.BindFlags = RENDER_BIND_CONSTANT_BUFFER;
+			backend->CreateBuffer(newBuffDesc, 0, &constantBuffers[b].ConstantBuffer);
+		}
 
 		// Set up the data buffer for this constant buffer
 		constantBuffers[b].Size = bufferDesc.Size;
 		constantBuffers[b].LocalDataBuffer = new unsigned char[bufferDesc.Size];
-		ZeroMemory(constantBuffers[b].LocalDataBuffer, bufferDesc.Size);
+		memset(constantBuffers[b].LocalDataBuffer, 0, bufferDesc.Size);
 
 		// Loop through all variables in this buffer
-		for (unsigned int v = 0; v < bufferDesc.Variables; v++)
+		for (unsigned int v = 0; v < bufferDesc.VariableCount; v++)
 		{
-			// Get this variable
-			ID3D11ShaderReflectionVariable* var =
-				cb->GetVariableByIndex(v);
-			
-			// Get the description of the variable and its type
-			D3D11_SHADER_VARIABLE_DESC varDesc;
-			var->GetDesc(&varDesc);
+			const ReflectedVariable& varDesc = reflection.Variables[bufferDesc.FirstVariable + v];
 
 			// Create the variable struct
 			SimpleShaderVariable varStruct;
 			varStruct.ConstantBufferIndex = b;
-			varStruct.ByteOffset = varDesc.StartOffset;
+			varStruct.ByteOffset = varDesc.ByteOffset;
 			varStruct.Size = varDesc.Size;
 			
 			// Get a string version
-			std::string varName(varDesc.Name);
+			std::string varName(reflection.GetName(varDesc.NameOffset));
 
-			// Add this variable to the table and the constant buffer
-			varTable.insert(std::pair<std::string, SimpleShaderVariable>(varName, varStruct));
+			// Add this variable to the table and the constant buffer.  Its
+			// position in the variable list doubles as its handle.
+			if (varTable.insert(std::pair<std::string, unsigned int>(varName, (unsigned int)variables.size())).second)
+				variables.push_back(varStruct);
 			constantBuffers[b].Variables.push_back(varStruct);
 		}
 	}
 
-	// All set
-	refl->Release();
+	// All set - the tables above hold everything we need
+	reflection.Clear();
 	return true;
 }
 
@@ -218,10 +249,10 @@ bool ISimpleShader::LoadShaderFile(LPCWSTR shaderFile)
 // name - the name of the variable to look for
 // size - the size of the variable (for verification), or -1 to bypass
 // --------------------------------------------------------
-SimpleShaderVariable* ISimpleShader::FindVariable(std::string name, int size)
+SimpleShaderVariable* ISimpleShader::FindVariable(const std::string& name, int size)
 {
 	// Look for the key
-	std::unordered_map<std::string, SimpleShaderVariable>::iterator result =
+	std::unordered_map<std::string, unsigned int>::iterator result =
 		varTable.find(name);
 
 	// Did we find the key?
@@ -229,7 +260,7 @@ SimpleShaderVariable* ISimpleShader::FindVariable(std::string name, int size)
 		return 0;
 
 	// Grab the result from the iterator
-	SimpleShaderVariable* var = &(result->second);
+	SimpleShaderVariable* var = &variables[result->second];
 
 	// Is the data size correct ?
 	if (size > 0 && var->Size != size)
@@ -242,7 +273,7 @@ SimpleShaderVariable* ISimpleShader::FindVariable(std::string name, int size)
 // --------------------------------------------------------
 // Helper for looking up a constant buffer by name
 // --------------------------------------------------------
-SimpleConstantBuffer* ISimpleShader::FindConstantBuffer(std::string name)
+SimpleConstantBuffer* ISimpleShader::FindConstantBuffer(const std::string& name)
 {
 	// Look for the key
 	std::unordered_map<std::string, SimpleConstantBuffer*>::iterator result =
@@ -281,12 +312,7 @@ void ISimpleShader::CopyAllBufferData()
 
 	// Loop through the constant buffers and copy all data
 	for (unsigned int i = 0; i < constantBufferCount; i++)
-	{
-		// Copy the entire local data buffer
-		deviceContext->UpdateSubresource(
-			constantBuffers[i].ConstantBuffer, 0, 0,
-			constantBuffers[i].LocalDataBuffer, 0, 0);
-	}
+		CopyBufferData(i);
 }
 
 // --------------------------------------------------------
@@ -313,10 +339,43 @@ void ISimpleShader::CopyBufferData(unsigned int index)
 	SimpleConstantBuffer* cb = &this->constantBuffers[index];
 	if (!cb) return;
 
-	// Copy the data and get out
-	deviceContext->UpdateSubresource(
-		cb->ConstantBuffer, 0, 0, 
-		cb->LocalDataBuffer, 0, 0);
+	// Nothing changed since the last upload?  A ring upload also has
+	// to be from the ring's current generation to still hold its data.
+	if (!cb->Dirty && (!useRing || cb->RingGeneration == cbRing->GetGeneration()))
+	{
+		uploadStats.skippedUploads++;
+		return;
+	}
+
+	if (useRing)
+	{
+		// Append to the ring and point the buffer at the new window
+		ConstantBufferRange range;
+		if (!cbRing->Upload(cb->LocalDataBuffer, cb->Size, &range))
+			return;
+
+		cb->ConstantBuffer = range.Buffer;
+		cb->RingFirstConstant = range.FirstConstant;
+		cb->RingNumConstants = range.NumConstants;
+		cb->RingGeneration = cbRing->GetGeneration();
+
+		// Already bound at the old window?  Move the binding too.
+		RebindConstantBuffer(index);
+	}
+	else
+	{
+		// Copy the data into this buffer's own (dynamic) constant buffer
+		void* mapped = backend->Map(cb->ConstantBuffer, RENDER_MAP_WRITE_DISCARD);
+		if (!mapped)
+			return;
+
+		memcpy(mapped, cb->LocalDataBuffer, cb->Size);
+		backend->Unmap(cb->ConstantBuffer);
+	}
+
+	cb->Dirty = false;
+	uploadStats.uploads++;
+	uploadStats.uploadBytes += cb->Size;
 }
 
 // --------------------------------------------------------
@@ -326,7 +385,7 @@ void ISimpleShader::CopyBufferData(unsigned int index)
 //              Useful for updating more frequently-changing
 //              variables without having to re-copy all buffers.
 // --------------------------------------------------------
-void ISimpleShader::CopyBufferData(std::string bufferName)
+void ISimpleShader::CopyBufferData(const std::string& bufferName)
 {
 	// Ensure the shader is valid
 	if (!shaderValid) return;
@@ -336,9 +395,7 @@ void ISimpleShader::CopyBufferData(std::string bufferName)
 	if (!cb) return;
 
 	// Copy the data and get out
-	deviceContext->UpdateSubresource(
-		cb->ConstantBuffer, 0, 0, 
-		cb->LocalDataBuffer, 0, 0);
+	CopyBufferData((unsigned int)(cb - constantBuffers));
 }
 
 
@@ -351,23 +408,42 @@ void ISimpleShader::CopyBufferData(std::string bufferName)
 //
 // Returns true if data is copied, false if variable doesn't exist
 // --------------------------------------------------------
-bool ISimpleShader::SetData(std::string name, const void* data, unsigned int size)
+bool ISimpleShader::SetData(const std::string& name, const void* data, unsigned int size)
 {
-	// Look for the variable and verify
-	SimpleShaderVariable* var = FindVariable(name, -1);
-	if (var == 0)
+	return SetData(GetVariableHandle(name), data, size);
+}
+
+// --------------------------------------------------------
+// Sets a variable by handle with arbitrary data of the specified size.
+// Same as setting by name, minus the string hashing.
+//
+// handle - The variable's handle, from GetVariableHandle()
+// data - The data to set in the buffer
+// size - The size of the data (this must be less than or equal to the variable's size)
+//
+// Returns true if data is copied, false if the handle is invalid
+// --------------------------------------------------------
+bool ISimpleShader::SetData(int handle, const void* data, unsigned int size)
+{
+	// Validate the handle
+	if (handle < 0 || (unsigned int)handle >= variables.size())
 		return false;
+	SimpleShaderVariable* var = &variables[handle];
 
 	// Ensure we're not trying to copy more data than the variable can hold
 	// Note: We can copy less data, in the case of a subset of an array
 	if (size > var->Size)
 		return false;
 
-	// Set the data in the local data buffer
-	memcpy(
-		constantBuffers[var->ConstantBufferIndex].LocalDataBuffer + var->ByteOffset,
-		data,
-		size);
+	// Set the data in the local data buffer, flagging the buffer
+	// for upload only if the value actually changed
+	SimpleConstantBuffer* cb = &constantBuffers[var->ConstantBufferIndex];
+	unsigned char* dest = cb->LocalDataBuffer + var->ByteOffset;
+	if (memcmp(dest, data, size) != 0)
+	{
+		memcpy(dest, data, size);
+		cb->Dirty = true;
+	}
 
 	// Success
 	return true;
@@ -376,7 +452,7 @@ bool ISimpleShader::SetData(std::string name, const void* data, unsigned int siz
 // --------------------------------------------------------
 // Sets INTEGER data
 // --------------------------------------------------------
-bool ISimpleShader::SetInt(std::string name, int data)
+bool ISimpleShader::SetInt(const std::string& name, int data)
 {
 	return this->SetData(name, (void*)(&data), sizeof(int));
 }
@@ -384,7 +460,7 @@ bool ISimpleShader::SetInt(std::string name, int data)
 // --------------------------------------------------------
 // Sets a FLOAT variable by name in the local data buffer
 // --------------------------------------------------------
-bool ISimpleShader::SetFloat(std::string name, float data)
+bool ISimpleShader::SetFloat(const std::string& name, float data)
 {
 	return this->SetData(name, (void*)(&data), sizeof(float));
 }
@@ -392,7 +468,7 @@ bool ISimpleShader::SetFloat(std::string name, float data)
 // --------------------------------------------------------
 // Sets a FLOAT2 variable by name in the local data buffer
 // --------------------------------------------------------
-bool ISimpleShader::SetFloat2(std::string name, const float data[2])
+bool ISimpleShader::SetFloat2(const std::string& name, const float data[2])
 {
 	return this->SetData(name, (void*)data, sizeof(float) * 2);
 }
@@ -400,7 +476,7 @@ bool ISimpleShader::SetFloat2(std::string name, const float data[2])
 // --------------------------------------------------------
 // Sets a FLOAT2 variable by name in the local data buffer
 // --------------------------------------------------------
-bool ISimpleShader::SetFloat2(std::string name, const DirectX::XMFLOAT2 data)
+bool ISimpleShader::SetFloat2(const std::string& name, const DirectX::XMFLOAT2 data)
 {
 	return this->SetData(name, &data, sizeof(float) * 2);
 }
@@ -408,7 +484,7 @@ bool ISimpleShader::SetFloat2(std::string name, const DirectX::XMFLOAT2 data)
 // --------------------------------------------------------
 // Sets a FLOAT3 variable by name in the local data buffer
 // --------------------------------------------------------
-bool ISimpleShader::SetFloat3(std::string name, const float data[3])
+bool ISimpleShader::SetFloat3(const std::string& name, const float data[3])
 {
 	return this->SetData(name, (void*)data, sizeof(float) * 3);
 }
@@ -416,7 +492,7 @@ bool ISimpleShader::SetFloat3(std::string name, const float data[3])
 // --------------------------------------------------------
 // Sets a FLOAT3 variable by name in the local data buffer
 // --------------------------------------------------------
-bool ISimpleShader::SetFloat3(std::string name, const DirectX::XMFLOAT3 data)
+bool ISimpleShader::SetFloat3(const std::string& name, const DirectX::XMFLOAT3 data)
 {
 	return this->SetData(name, &data, sizeof(float) * 3);
 }
@@ -424,7 +500,7 @@ bool ISimpleShader::SetFloat3(std::string name, const DirectX::XMFLOAT3 data)
 // --------------------------------------------------------
 // Sets a FLOAT4 variable by name in the local data buffer
 // --------------------------------------------------------
-bool ISimpleShader::SetFloat4(std::string name, const float data[4])
+bool ISimpleShader::SetFloat4(const std::string& name, const float data[4])
 {
 	return this->SetData(name, (void*)data, sizeof(float) * 4);
 }
@@ -432,7 +508,7 @@ bool ISimpleShader::SetFloat4(std::string name, const float data[4])
 // --------------------------------------------------------
 // Sets a FLOAT4 variable by name in the local data buffer
 // --------------------------------------------------------
-bool ISimpleShader::SetFloat4(std::string name, const DirectX::XMFLOAT4 data)
+bool ISimpleShader::SetFloat4(const std::string& name, const DirectX::XMFLOAT4 data)
 {
 	return this->SetData(name, &data, sizeof(float) * 4);
 }
@@ -440,7 +516,7 @@ bool ISimpleShader::SetFloat4(std::string name, const DirectX::XMFLOAT4 data)
 // --------------------------------------------------------
 // Sets a MATRIX (4x4) variable by name in the local data buffer
 // --------------------------------------------------------
-bool ISimpleShader::SetMatrix4x4(std::string name, const float data[16])
+bool ISimpleShader::SetMatrix4x4(const std::string& name, const float data[16])
 {
 	return this->SetData(name, (void*)data, sizeof(float) * 16);
 }
@@ -448,25 +524,260 @@ bool ISimpleShader::SetMatrix4x4(std::string name, const float data[16])
 // --------------------------------------------------------
 // Sets a MATRIX (4x4) variable by name in the local data buffer
 // --------------------------------------------------------
-bool ISimpleShader::SetMatrix4x4(std::string name, const DirectX::XMFLOAT4X4 data)
+bool ISimpleShader::SetMatrix4x4(const std::string& name, const DirectX::XMFLOAT4X4 data)
 {
 	return this->SetData(name, &data, sizeof(float) * 16);
 }
 
+// --------------------------------------------------------
+// Sets INTEGER data by handle
+// --------------------------------------------------------
+bool ISimpleShader::SetInt(int handle, int data)
+{
+	return this->SetData(handle, (void*)(&data), sizeof(int));
+}
+
+// --------------------------------------------------------
+// Sets a FLOAT variable by handle in the local data buffer
+// --------------------------------------------------------
+bool ISimpleShader::SetFloat(int handle, float data)
+{
+	return this->SetData(handle, (void*)(&data), sizeof(float));
+}
+
+// --------------------------------------------------------
+// Sets a FLOAT3 variable by handle in the local data buffer
+// --------------------------------------------------------
+bool ISimpleShader::SetFloat3(int handle, const DirectX::XMFLOAT3& data)
+{
+	return this->SetData(handle, &data, sizeof(float) * 3);
+}
+
+// --------------------------------------------------------
+// Sets a FLOAT4 variable by handle in the local data buffer
+// --------------------------------------------------------
+bool ISimpleShader::SetFloat4(int handle, const DirectX::XMFLOAT4& data)
+{
+	return this->SetData(handle, &data, sizeof(float) * 4);
+}
+
+// --------------------------------------------------------
+// Sets a MATRIX (4x4) variable by handle in the local data buffer
+// --------------------------------------------------------
+bool ISimpleShader::SetMatrix4x4(int handle, const DirectX::XMFLOAT4X4& data)
+{
+	return this->SetData(handle, &data, sizeof(float) * 16);
+}
+
+// --------------------------------------------------------
+// Sets a whole constant buffer by name
+// --------------------------------------------------------
+bool ISimpleShader::SetBufferData(const std::string& name, const void* data, unsigned int size)
+{
+	return SetBufferData(GetBufferHandle(name), data, size);
+}
+
+// --------------------------------------------------------
+// Sets a whole constant buffer's local data at once
+//
+// handle - The buffer's handle, from GetBufferHandle()
+// data - The data to set in the buffer
+// size - The size of the data (this must equal the buffer's size)
+//
+// Returns true if data is copied, false if the handle is invalid
+// or the size doesn't match
+// --------------------------------------------------------
+bool ISimpleShader::SetBufferData(int handle, const void* data, unsigned int size)
+{
+	if (handle < 0 || (unsigned int)handle >= constantBufferCount)
+		return false;
+	SimpleConstantBuffer* cb = &constantBuffers[handle];
+	if (size != cb->Size)
+		return false;
+
+	if (memcmp(cb->LocalDataBuffer, data, size) != 0)
+	{
+		memcpy(cb->LocalDataBuffer, data, size);
+		cb->Dirty = true;
+	}
+	return true;
+}
+
+// --------------------------------------------------------
+// Sets a shader resource view by name
+//
+// name - The name of the texture resource in the shader
+// srv - The shader resource view of the texture in GPU memory
+//
+// Returns true if a texture of the given name was found, false otherwise
+// --------------------------------------------------------
+bool ISimpleShader::SetShaderResourceView(const std::string& name, RenderResource* srv)
+{
+	return SetShaderResourceView(GetSRVHandle(name), srv);
+}
+
+// --------------------------------------------------------
+// Sets a shader resource view by handle
+//
+// handle - The texture's handle, from GetSRVHandle()
+// srv - The shader resource view of the texture in GPU memory
+//
+// Returns true if the handle is valid, false otherwise
+// --------------------------------------------------------
+bool ISimpleShader::SetShaderResourceView(int handle, RenderResource* srv)
+{
+	if (handle < 0 || (unsigned int)handle >= shaderResourceViews.size())
+		return false;
+
+	unsigned int slot = shaderResourceViews[handle]->BindIndex;
+	if (slot < SIMPLE_SHADER_STAGED_SLOTS)
+	{
+		stagedSRVs[slot] = srv;
+		stagedSRVMask |= 1u << slot;
+	}
+	else
+	{
+		BindShaderResourceViews(slot, 1, &srv);
+	}
+	return true;
+}
+
+// --------------------------------------------------------
+// Sets a sampler state by name
+//
+// name - The name of the sampler state in the shader
+// samplerState - The sampler state in GPU memory
+//
+// Returns true if a sampler of the given name was found, false otherwise
+// --------------------------------------------------------
+bool ISimpleShader::SetSamplerState(const std::string& name, RenderSamplerState* samplerState)
+{
+	return SetSamplerState(GetSamplerHandle(name), samplerState);
+}
+
+// --------------------------------------------------------
+// Sets a sampler state by handle
+//
+// handle - The sampler's handle, from GetSamplerHandle()
+// samplerState - The sampler state in GPU memory
+//
+// Returns true if the handle is valid, false otherwise
+// --------------------------------------------------------
+bool ISimpleShader::SetSamplerState(int handle, RenderSamplerState* samplerState)
+{
+	if (handle < 0 || (unsigned int)handle >= samplerStates.size())
+		return false;
+
+	unsigned int slot = samplerStates[handle]->BindIndex;
+	if (slot < SIMPLE_SHADER_STAGED_SLOTS)
+	{
+		stagedSamplers[slot] = samplerState;
+		stagedSamplerMask |= 1u << slot;
+	}
+	else
+	{
+		BindSamplerStates(slot, 1, &samplerState);
+	}
+	return true;
+}
+
+// --------------------------------------------------------
+// Calls bind(start, count) for each run of set bits in mask
+// --------------------------------------------------------
+template<typename Bind>
+static void ForEachRun(unsigned int mask, const Bind& bind)
+{
+	unsigned int slot = 0;
+	while (mask >> slot)
+	{
+		if (!(mask & (1u << slot)))
+		{
+			slot++;
+			continue;
+		}
+
+		unsigned int start = slot;
+		while (mask & (1u << slot))
+			slot++;
+		bind(start, slot - start);
+	}
+}
+
+// --------------------------------------------------------
+// Binds the staged tables.  The whole table goes every time,
+// not only what was set since the last flush - other shaders
+// on this stage may have bound over the same slots since.
+// --------------------------------------------------------
+void ISimpleShader::FlushBindings()
+{
+	ForEachRun(stagedSRVMask, [this](unsigned int start, unsigned int count)
+	{
+		BindShaderResourceViews(start, count, &stagedSRVs[start]);
+	});
+	ForEachRun(stagedSamplerMask, [this](unsigned int start, unsigned int count)
+	{
+		BindSamplerStates(start, count, &stagedSamplers[start]);
+	});
+}
+
 // --------------------------------------------------------
 // Gets info about a shader variable, if it exists
 // --------------------------------------------------------
-const SimpleShaderVariable* ISimpleShader::GetVariableInfo(std::string name)
+const SimpleShaderVariable* ISimpleShader::GetVariableInfo(const std::string& name)
 {
 	return FindVariable(name, -1);
 }
 
+// --------------------------------------------------------
+// Gets a handle for a variable, to set it later without
+// a name lookup.  Handles stay valid for the shader's lifetime.
+//
+// Returns -1 if no variable has that name
+// --------------------------------------------------------
+int ISimpleShader::GetVariableHandle(const std::string& name)
+{
+	std::unordered_map<std::string, unsigned int>::iterator result =
+		varTable.find(name);
+
+	if (result == varTable.end())
+		return -1;
+
+	return (int)result->second;
+}
+
+// --------------------------------------------------------
+// Gets a handle for a constant buffer (its index), or -1
+// --------------------------------------------------------
+int ISimpleShader::GetBufferHandle(const std::string& name)
+{
+	SimpleConstantBuffer* cb = FindConstantBuffer(name);
+	return cb ? (int)(cb - constantBuffers) : -1;
+}
+
+// --------------------------------------------------------
+// Gets a handle for an SRV (its raw index), or -1
+// --------------------------------------------------------
+int ISimpleShader::GetSRVHandle(const std::string& name)
+{
+	const SimpleSRV* srv = GetShaderResourceViewInfo(name);
+	return srv ? (int)srv->Index : -1;
+}
+
+// --------------------------------------------------------
+// Gets a handle for a sampler (its raw index), or -1
+// --------------------------------------------------------
+int ISimpleShader::GetSamplerHandle(const std::string& name)
+{
+	const SimpleSampler* samp = GetSamplerInfo(name);
+	return samp ? (int)samp->Index : -1;
+}
+
 // --------------------------------------------------------
 // Gets info about an SRV in the shader (or null)
 //
 // name - the name of the SRV
 // --------------------------------------------------------
-const SimpleSRV* ISimpleShader::GetShaderResourceViewInfo(std::string name)
+const SimpleSRV* ISimpleShader::GetShaderResourceViewInfo(const std::string& name)
 {
 	// Look for the key
 	std::unordered_map<std::string, SimpleSRV*>::iterator result =
@@ -501,7 +812,7 @@ const SimpleSRV* ISimpleShader::GetShaderResourceViewInfo(unsigned int index)
 // 
 // name - the name of the sampler
 // --------------------------------------------------------
-const SimpleSampler* ISimpleShader::GetSamplerInfo(std::string name)
+const SimpleSampler* ISimpleShader::GetSamplerInfo(const std::string& name)
 {
 	// Look for the key
 	std::unordered_map<std::string, SimpleSampler*>::iterator result =
@@ -554,7 +865,7 @@ unsigned int ISimpleShader::GetBufferSize(unsigned int index)
 // Gets info about a particular constant buffer 
 // by name, if it exists
 // --------------------------------------------------------
-const SimpleConstantBuffer * ISimpleShader::GetBufferInfo(std::string name)
+const SimpleConstantBuffer * ISimpleShader::GetBufferInfo(const std::string& name)
 {
 	return FindConstantBuffer(name);
 }
@@ -584,8 +895,8 @@ const SimpleConstantBuffer * ISimpleShader::GetBufferInfo(unsigned int index)
 // --------------------------------------------------------
 // Constructor just calls the base
 // --------------------------------------------------------
-SimpleVertexShader::SimpleVertexShader(ID3D11Device* device, ID3D11DeviceContext* context, LPCWSTR shaderFile)
-	: ISimpleShader(device, context) 
+SimpleVertexShader::SimpleVertexShader(RenderBackend* backend, const wchar_t* shaderFile)
+	: ISimpleShader(backend) 
 { 
 	// Ensure we set to zero to successfully trigger
 	// the Input Layout creation during LoadShaderFile()
@@ -603,8 +914,8 @@ SimpleVertexShader::SimpleVertexShader(ID3D11Device* device, ID3D11DeviceContext
 // Passing in a valid input layout will stop LoadShaderFile()
 // from creating an input layout from shader reflection
 // --------------------------------------------------------
-SimpleVertexShader::SimpleVertexShader(ID3D11Device * device, ID3D11DeviceContext * context, LPCWSTR shaderFile, ID3D11InputLayout * inputLayout, bool perInstanceCompatible)
-	: ISimpleShader(device, context)
+SimpleVertexShader::SimpleVertexShader(RenderBackend* backend, const wchar_t* shaderFile, RenderInputLayout* inputLayout, bool perInstanceCompatible)
+	: ISimpleShader(backend)
 {
 	// Save the custom input layout
 	this->inputLayout = inputLayout;
@@ -617,6 +928,26 @@ SimpleVertexShader::SimpleVertexShader(ID3D11Device * device, ID3D11DeviceContex
 	this->LoadShaderFile(shaderFile);
 }
 
+// --------------------------------------------------------
+// Constructor overload for packed vertex streams
+//
+// The input layout is still built from reflection, but any
+// per vertex input whose semantic matches one of vertexElements
+// takes that element's format and byte offset, since reflection
+// only knows the shader sees it as floats
+// --------------------------------------------------------
+SimpleVertexShader::SimpleVertexShader(RenderBackend* backend, const wchar_t* shaderFile, const InputElementDesc* vertexElements, unsigned int vertexElementCount)
+	: ISimpleShader(backend)
+{
+	this->inputLayout = 0;
+	this->shader = 0;
+	this->perInstanceCompatible = false;
+	this->vertexElements.assign(vertexElements, vertexElements + vertexElementCount);
+
+	// Load the actual compiled shader file
+	this->LoadShaderFile(shaderFile);
+}
+
 // --------------------------------------------------------
 // Destructor - Clean up actual shader (base will be called automatically)
 // --------------------------------------------------------
@@ -636,27 +967,18 @@ void SimpleVertexShader::CleanUp()
 }
 
 // --------------------------------------------------------
-// Creates the DirectX vertex shader
-//
-// shaderBlob - The shader's compiled code
+// Creates the vertex shader from the loaded byte code
 //
 // Returns true if shader is created correctly, false otherwise
 // --------------------------------------------------------
-bool SimpleVertexShader::CreateShader(ID3DBlob* shaderBlob)
+bool SimpleVertexShader::CreateShader()
 {
 	// Clean up first, in the event this method is
 	// called more than once on the same object
 	this->CleanUp();
 
-	// Create the shader from the blob
-	HRESULT result = device->CreateVertexShader(
-		shaderBlob->GetBufferPointer(),
-		shaderBlob->GetBufferSize(),
-		0,
-		&shader);
-
-	// Did the creation work?
-	if (result != S_OK)
+	// Create the shader from the byte code
+	if (!backend->CreateVertexShader(byteCode.data(), byteCode.size(), &shader))
 		return false;
 
 	// Do we already have an input layout?
@@ -665,51 +987,45 @@ bool SimpleVertexShader::CreateShader(ID3DBlob* shaderBlob)
 		return true;
 
 	// Vertex shader was created successfully, so we now use the
-	// shader code to re-reflect and create an input layout that 
+	// reflected input signature to create an input layout that 
 	// matches what the vertex shader expects.  Code adapted from:
 	// https://takinginitiative.wordpress.com/2011/12/11/directx-1011-basic-shader-reflection-automatic-input-layout-creation/
 
-	// Reflect shader info
-	ID3D11ShaderReflection* refl;
-	D3DReflect(
-		shaderBlob->GetBufferPointer(),
-		shaderBlob->GetBufferSize(),
-		IID_ID3D11ShaderReflection,
-		(void**)&refl);
-	
-	// Get shader info
-	D3D11_SHADER_DESC shaderDesc;
-	refl->GetDesc(&shaderDesc);
-
-	// Read input layout description from shader info
-	std::vector<D3D11_INPUT_ELEMENT_DESC> inputLayoutDesc;
-	for (unsigned int i = 0; i< shaderDesc.InputParameters; i++)
+	// Read input layout description from the reflected input signature
+	std::vector<InputElementDesc> inputLayoutDesc;
+	for (unsigned int i = 0; i < reflection.Inputs.size(); i++)
 	{
-		D3D11_SIGNATURE_PARAMETER_DESC paramDesc;
-		refl->GetInputParameterDesc(i, &paramDesc);
+		const ReflectedInput& paramDesc = reflection.Inputs[i];
+		const char* semanticName = reflection.GetName(paramDesc.SemanticNameOffset);
+
+		// System values (SV_VertexID and the like) come from the
+		// input assembler itself, not from a vertex buffer
+		if (_strnicmp(semanticName, "SV_", 3) == 0)
+			continue;
 
 		// Check the semantic name for "_PER_INSTANCE"
 		std::string perInstanceStr = "_PER_INSTANCE";
-		std::string sem = paramDesc.SemanticName;
+		std::string sem = semanticName;
 		int lenDiff = (int)sem.size() - (int)perInstanceStr.size();
 		bool isPerInstance = 
 			lenDiff >= 0 &&
 			sem.compare(lenDiff, perInstanceStr.size(), perInstanceStr) == 0;
 
 		// Fill out input element desc
-		D3D11_INPUT_ELEMENT_DESC elementDesc;
-		elementDesc.SemanticName = paramDesc.SemanticName;
+		InputElementDesc elementDesc = {};
+		elementDesc.SemanticName = semanticName;
 		elementDesc.SemanticIndex = paramDesc.SemanticIndex;
+		elementDesc.Format = DXGI_FORMAT_UNKNOWN;
 		elementDesc.InputSlot = 0;
-		elementDesc.AlignedByteOffset = D3D11_APPEND_ALIGNED_ELEMENT;
-		elementDesc.InputSlotClass = D3D11_INPUT_PER_VERTEX_DATA;
+		elementDesc.AlignedByteOffset = RENDER_APPEND_ALIGNED_ELEMENT;
+		elementDesc.PerInstance = false;
 		elementDesc.InstanceDataStepRate = 0;
 
 		// Replace anything affected by "per instance" data
 		if (isPerInstance)
 		{
 			elementDesc.InputSlot = 1; // Assume per instance data comes from another input slot!
-			elementDesc.InputSlotClass = D3D11_INPUT_PER_INSTANCE_DATA;
+			elementDesc.PerInstance = true;
 			elementDesc.InstanceDataStepRate = 1;
 
 			perInstanceCompatible = true;
@@ -718,43 +1034,64 @@ bool SimpleVertexShader::CreateShader(ID3DBlob* shaderBlob)
 		// Determine DXGI format
 		if (paramDesc.Mask == 1)
 		{
-			if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_UINT32) elementDesc.Format = DXGI_FORMAT_R32_UINT;
-			else if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_SINT32) elementDesc.Format = DXGI_FORMAT_R32_SINT;
-			else if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_FLOAT32) elementDesc.Format = DXGI_FORMAT_R32_FLOAT;
+			if (paramDesc.ComponentType == REFLECTED_COMPONENT_UINT32) elementDesc.Format = DXGI_FORMAT_R32_UINT;
+			else if (paramDesc.ComponentType == REFLECTED_COMPONENT_SINT32) elementDesc.Format = DXGI_FORMAT_R32_SINT;
+			else if (paramDesc.ComponentType == REFLECTED_COMPONENT_FLOAT32) elementDesc.Format = DXGI_FORMAT_R32_FLOAT;
 		}
 		else if (paramDesc.Mask <= 3)
 		{
-			if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_UINT32) elementDesc.Format = DXGI_FORMAT_R32G32_UINT;
-			else if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_SINT32) elementDesc.Format = DXGI_FORMAT_R32G32_SINT;
-			else if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_FLOAT32) elementDesc.Format = DXGI_FORMAT_R32G32_FLOAT;
+			if (paramDesc.ComponentType == REFLECTED_COMPONENT_UINT32) elementDesc.Format = DXGI_FORMAT_R32G32_UINT;
+			else if (paramDesc.ComponentType == REFLECTED_COMPONENT_SINT32) elementDesc.Format = DXGI_FORMAT_R32G32_SINT;
+			else if (paramDesc.ComponentType == REFLECTED_COMPONENT_FLOAT32) elementDesc.Format = DXGI_FORMAT_R32G32_FLOAT;
 		}
 		else if (paramDesc.Mask <= 7)
 		{
-			if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_UINT32) elementDesc.Format = DXGI_FORMAT_R32G32B32_UINT;
-			else if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_SINT32) elementDesc.Format = DXGI_FORMAT_R32G32B32_SINT;
-			else if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_FLOAT32) elementDesc.Format = DXGI_FORMAT_R32G32B32_FLOAT;
+			if (paramDesc.ComponentType == REFLECTED_COMPONENT_UINT32) elementDesc.Format = DXGI_FORMAT_R32G32B32_UINT;
+			else if (paramDesc.ComponentType == REFLECTED_COMPONENT_SINT32) elementDesc.Format = DXGI_FORMAT_R32G32B32_SINT;
+			else if (paramDesc.ComponentType == REFLECTED_COMPONENT_FLOAT32) elementDesc.Format = DXGI_FORMAT_R32G32B32_FLOAT;
 		}
 		else if (paramDesc.Mask <= 15)
 		{
-			if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_UINT32) elementDesc.Format = DXGI_FORMAT_R32G32B32A32_UINT;
-			else if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_SINT32) elementDesc.Format = DXGI_FORMAT_R32G32B32A32_SINT;
-			else if (paramDesc.ComponentType == D3D_REGISTER_COMPONENT_FLOAT32) elementDesc.Format = DXGI_FORMAT_R32G32B32A32_FLOAT;
+			if (paramDesc.ComponentType == REFLECTED_COMPONENT_UINT32) elementDesc.Format = DXGI_FORMAT_R32G32B32A32_UINT;
+			else if (paramDesc.ComponentType == REFLECTED_COMPONENT_SINT32) elementDesc.Format = DXGI_FORMAT_R32G32B32A32_SINT;
+			else if (paramDesc.ComponentType == REFLECTED_COMPONENT_FLOAT32) elementDesc.Format = DXGI_FORMAT_R32G32B32A32_FLOAT;
+		}
+
+		// Packed per vertex elements override the float formats
+		if (!isPerInstance)
+		{
+			for (const InputElementDesc& packed : vertexElements)
+			{
+				if (packed.SemanticIndex == elementDesc.SemanticIndex && _stricmp(packed.SemanticName, semanticName) == 0)
+				{
+					elementDesc.Format = packed.Format;
+					elementDesc.AlignedByteOffset = packed.AlignedByteOffset;
+				}
+			}
 		}
 
 		// Save element desc
 		inputLayoutDesc.push_back(elementDesc);
 	}
 
+	// Nothing read from vertex buffers (a fullscreen triangle made
+	// from SV_VertexID), so there's no layout to make
+	if (inputLayoutDesc.empty())
+		return true;
+
+	// Share a layout with any shader that has the same signature.
+	// The cache keeps its own reference, this is the shader's.
+	if (pipelineStates)
+	{
+		inputLayout = pipelineStates->GetInputLayout(&inputLayoutDesc[0], (unsigned int)inputLayoutDesc.size(), byteCode.data(), byteCode.size());
+		if (inputLayout) inputLayout->AddRef();
+		return true;
+	}
+
 	// Try to create Input Layout
-	HRESULT hr = device->CreateInputLayout(
-		&inputLayoutDesc[0], 
-		(unsigned int)inputLayoutDesc.size(), 
-		shaderBlob->GetBufferPointer(), 
-		shaderBlob->GetBufferSize(),
-		&inputLayout);
-
-	// All done, clean up
-	refl->Release();
+	backend->CreateInputLayout(&inputLayoutDesc[0], (unsigned int)inputLayoutDesc.size(), byteCode.data(), byteCode.size(), &inputLayout);
+
+	// All done
 	return true;
 }
 
@@ -768,66 +1105,93 @@ void SimpleVertexShader::SetShaderAndCBs()
 	if (!shaderValid) return;
 
 	// Set the shader and input layout
-	deviceContext->IASetInputLayout(inputLayout);
-	deviceContext->VSSetShader(shader, 0, 0);
+	if (stateCache)
+	{
+		stateCache->IASetInputLayout(inputLayout);
+		stateCache->VSSetShader(shader);
+	}
+	else
+	{
+		backend->SetInputLayout(inputLayout);
+		backend->SetVertexShader(shader);
+	}
 
 	// Set the constant buffers
 	for (unsigned int i = 0; i < constantBufferCount; i++)
 	{
 		// Skip "buffers" that aren't true constant buffers
-		if (constantBuffers[i].Type != D3D11_CT_CBUFFER)
+		if (constantBuffers[i].Type != REFLECTED_BUFFER_CBUFFER)
 			continue;
 
 		// This is a real constant buffer, so set it
-		deviceContext->VSSetConstantBuffers(
+		if (stateCache)
+		{
+			stateCache->VSSetConstantBuffer(
+				constantBuffers[i].BindIndex,
+				constantBuffers[i].ConstantBuffer,
+				constantBuffers[i].RingFirstConstant,
+				constantBuffers[i].RingNumConstants);
+			continue;
+		}
+
+		backend->SetConstantBuffer(SHADER_STAGE_VERTEX,
 			constantBuffers[i].BindIndex,
-			1,
-			&constantBuffers[i].ConstantBuffer);
+			constantBuffers[i].ConstantBuffer,
+			0,
+			0);
 	}
 }
 
 // --------------------------------------------------------
-// Sets a shader resource view in the vertex shader stage
-//
-// name - The name of the texture resource in the shader
-// srv - The shader resource view of the texture in GPU memory
-//
-// Returns true if a texture of the given name was found, false otherwise
+// Points the buffer's slot at its latest ring upload, if
+// this shader is the one currently bound
 // --------------------------------------------------------
-bool SimpleVertexShader::SetShaderResourceView(std::string name, ID3D11ShaderResourceView* srv)
+void SimpleVertexShader::RebindConstantBuffer(unsigned int index)
 {
-	// Look for the variable and verify
-	const SimpleSRV* srvInfo = GetShaderResourceViewInfo(name);
-	if (srvInfo == 0)
-		return false;
+	if (!stateCache || stateCache->GetVertexShader() != shader)
+		return;
 
-	// Set the shader resource view
-	deviceContext->VSSetShaderResources(srvInfo->BindIndex, 1, &srv);
+	SimpleConstantBuffer* cb = &constantBuffers[index];
+	if (cb->Type != REFLECTED_BUFFER_CBUFFER)
+		return;
 
-	// Success
-	return true;
+	stateCache->VSSetConstantBuffer(
+		cb->BindIndex,
+		cb->ConstantBuffer,
+		cb->RingFirstConstant,
+		cb->RingNumConstants);
 }
 
 // --------------------------------------------------------
-// Sets a sampler state in the vertex shader stage
+// Binds a run of shader resource views in the vertex shader stage
 //
-// name - The name of the sampler state in the shader
-// samplerState - The sampler state in GPU memory
-//
-// Returns true if a sampler of the given name was found, false otherwise
+// startSlot - The register of the first texture resource
+// count - How many consecutive registers to bind
+// srvs - The shader resource views of the textures in GPU memory
 // --------------------------------------------------------
-bool SimpleVertexShader::SetSamplerState(std::string name, ID3D11SamplerState* samplerState)
+void SimpleVertexShader::BindShaderResourceViews(unsigned int startSlot, unsigned int count, RenderResource* const* srvs)
 {
-	// Look for the variable and verify
-	const SimpleSampler* sampInfo = GetSamplerInfo(name);
-	if (sampInfo == 0)
-		return false;
-
-	// Set the shader resource view
-	deviceContext->VSSetSamplers(sampInfo->BindIndex, 1, &samplerState);
+	// Set the shader resource views
+	if (stateCache)
+		stateCache->VSSetShaderResources(startSlot, count, srvs);
+	else
+		backend->SetShaderResources(SHADER_STAGE_VERTEX, startSlot, count, srvs);
+}
 
-	// Success
-	return true;
+// --------------------------------------------------------
+// Binds a run of sampler states in the vertex shader stage
+//
+// startSlot - The register of the first sampler state
+// count - How many consecutive registers to bind
+// samplers - The sampler states in GPU memory
+// --------------------------------------------------------
+void SimpleVertexShader::BindSamplerStates(unsigned int startSlot, unsigned int count, RenderSamplerState* const* samplers)
+{
+	// Set the sampler states
+	if (stateCache)
+		stateCache->VSSetSamplers(startSlot, count, samplers);
+	else
+		backend->SetSamplers(SHADER_STAGE_VERTEX, startSlot, count, samplers);
 }
 
 
@@ -838,8 +1202,8 @@ bool SimpleVertexShader::SetSamplerState(std::string name, ID3D11SamplerState* s
 // --------------------------------------------------------
 // Constructor just calls the base
 // --------------------------------------------------------
-SimplePixelShader::SimplePixelShader(ID3D11Device* device, ID3D11DeviceContext* context, LPCWSTR shaderFile)
-	: ISimpleShader(device, context) 
+SimplePixelShader::SimplePixelShader(RenderBackend* backend, const wchar_t* shaderFile)
+	: ISimpleShader(backend) 
 { 
 	this->shader = 0;
 
@@ -865,27 +1229,18 @@ void SimplePixelShader::CleanUp()
 }
 
 // --------------------------------------------------------
-// Creates the DirectX pixel shader
-//
-// shaderBlob - The shader's compiled code
+// Creates the pixel shader from the loaded byte code
 //
 // Returns true if shader is created correctly, false otherwise
 // --------------------------------------------------------
-bool SimplePixelShader::CreateShader(ID3DBlob* shaderBlob)
+bool SimplePixelShader::CreateShader()
 {
 	// Clean up first, in the event this method is
 	// called more than once on the same object
 	this->CleanUp();
 
-	// Create the shader from the blob
-	HRESULT result = device->CreatePixelShader(
-		shaderBlob->GetBufferPointer(),
-		shaderBlob->GetBufferSize(),
-		0,
-		&shader);
-
-	// Check the result
-	return (result == S_OK);
+	// Create the shader from the byte code
+	return backend->CreatePixelShader(byteCode.data(), byteCode.size(), &shader);
 }
 
 // --------------------------------------------------------
@@ -898,867 +1253,85 @@ void SimplePixelShader::SetShaderAndCBs()
 	if (!shaderValid) return;
 	
 	// Set the shader
-	deviceContext->PSSetShader(shader, 0, 0);
+	if (stateCache)
+		stateCache->PSSetShader(shader);
+	else
+		backend->SetPixelShader(shader);
 
 	// Set the constant buffers
 	for (unsigned int i = 0; i < constantBufferCount; i++)
 	{
 		// Skip "buffers" that aren't true constant buffers
-		if (constantBuffers[i].Type != D3D11_CT_CBUFFER)
+		if (constantBuffers[i].Type != REFLECTED_BUFFER_CBUFFER)
 			continue;
 
 		// This is a real constant buffer, so set it
-		deviceContext->PSSetConstantBuffers(
+		if (stateCache)
+		{
+			stateCache->PSSetConstantBuffer(
+				constantBuffers[i].BindIndex,
+				constantBuffers[i].ConstantBuffer,
+				constantBuffers[i].RingFirstConstant,
+				constantBuffers[i].RingNumConstants);
+			continue;
+		}
+
+		backend->SetConstantBuffer(SHADER_STAGE_PIXEL,
 			constantBuffers[i].BindIndex,
-			1,
-			&constantBuffers[i].ConstantBuffer);
+			constantBuffers[i].ConstantBuffer,
+			0,
+			0);
 	}
 }
 
 // --------------------------------------------------------
-// Sets a shader resource view in the pixel shader stage
-//
-// name - The name of the texture resource in the shader
-// srv - The shader resource view of the texture in GPU memory
-//
-// Returns true if a texture of the given name was found, false otherwise
+// Points the buffer's slot at its latest ring upload, if
+// this shader is the one currently bound
 // --------------------------------------------------------
-bool SimplePixelShader::SetShaderResourceView(std::string name, ID3D11ShaderResourceView* srv)
+void SimplePixelShader::RebindConstantBuffer(unsigned int index)
 {
-	// Look for the variable and verify
-	const SimpleSRV* srvInfo = GetShaderResourceViewInfo(name);
-	if (srvInfo == 0)
-		return false;
+	if (!stateCache || stateCache->GetPixelShader() != shader)
+		return;
 
-	// Set the shader resource view
-	deviceContext->PSSetShaderResources(srvInfo->BindIndex, 1, &srv);
+	SimpleConstantBuffer* cb = &constantBuffers[index];
+	if (cb->Type != REFLECTED_BUFFER_CBUFFER)
+		return;
 
-	// Success
-	return true;
-}
-
-// --------------------------------------------------------
-// Sets a sampler state in the pixel shader stage
-//
-// name - The name of the sampler state in the shader
-// samplerState - The sampler state in GPU memory
-//
-// Returns true if a sampler of the given name was found, false otherwise
-// --------------------------------------------------------
-bool SimplePixelShader::SetSamplerState(std::string name, ID3D11SamplerState* samplerState)
-{
-	// Look for the variable and verify
-	const SimpleSampler* sampInfo = GetSamplerInfo(name);
-	if (sampInfo == 0)
-		return false;
-
-	// Set the shader resource view
-	deviceContext->PSSetSamplers(sampInfo->BindIndex, 1, &samplerState);
-
-	// Success
-	return true;
-}
-
-
-
-
-///////////////////////////////////////////////////////////////////////////////
-// ------ SIMPLE DOMAIN SHADER ------------------------------------------------
-///////////////////////////////////////////////////////////////////////////////
-
-// --------------------------------------------------------
-// Constructor just calls the base
-// --------------------------------------------------------
-SimpleDomainShader::SimpleDomainShader(ID3D11Device* device, ID3D11DeviceContext* context, LPCWSTR shaderFile)
-	: ISimpleShader(device, context) 
-{ 
-	this->shader = 0;
-
-	// Load the actual compiled shader file
-	this->LoadShaderFile(shaderFile);
-}
-
-// --------------------------------------------------------
-// Destructor - Clean up actual shader (base will be called automatically)
-// --------------------------------------------------------
-SimpleDomainShader::~SimpleDomainShader()
-{
-	CleanUp();
-}
-
-// --------------------------------------------------------
-// Handles cleaning up shader and base class clean up
-// --------------------------------------------------------
-void SimpleDomainShader::CleanUp()
-{
-	ISimpleShader::CleanUp();
-	if (shader) { shader->Release(); shader = 0; }
-}
-
-// --------------------------------------------------------
-// Creates the DirectX domain shader
-//
-// shaderBlob - The shader's compiled code
-//
-// Returns true if shader is created correctly, false otherwise
-// --------------------------------------------------------
-bool SimpleDomainShader::CreateShader(ID3DBlob* shaderBlob)
-{
-	// Clean up first, in the event this method is
-	// called more than once on the same object
-	this->CleanUp();
-
-	// Create the shader from the blob
-	HRESULT result = device->CreateDomainShader(
-		shaderBlob->GetBufferPointer(),
-		shaderBlob->GetBufferSize(),
-		0,
-		&shader);
-
-	// Check the result
-	return (result == S_OK);
-}
-
-// --------------------------------------------------------
-// Sets the domain shader and constant buffers for
-// future DirectX drawing
-// --------------------------------------------------------
-void SimpleDomainShader::SetShaderAndCBs()
-{
-	// Is shader valid?
-	if (!shaderValid) return;
-
-	// Set the shader
-	deviceContext->DSSetShader(shader, 0, 0);
-
-	// Set the constant buffers
-	for (unsigned int i = 0; i < constantBufferCount; i++)
-	{
-		// Skip "buffers" that aren't true constant buffers
-		if (constantBuffers[i].Type != D3D11_CT_CBUFFER)
-			continue;
-
-		// This is a real constant buffer, so set it
-		deviceContext->DSSetConstantBuffers(
-			constantBuffers[i].BindIndex,
-			1,
-			&constantBuffers[i].ConstantBuffer);
-	}
-}
-
-// --------------------------------------------------------
-// Sets a shader resource view in the domain shader stage
-//
-// name - The name of the texture resource in the shader
-// srv - The shader resource view of the texture in GPU memory
-//
-// Returns true if a texture of the given name was found, false otherwise
-// --------------------------------------------------------
-bool SimpleDomainShader::SetShaderResourceView(std::string name, ID3D11ShaderResourceView* srv)
-{
-	// Look for the variable and verify
-	const SimpleSRV* srvInfo = GetShaderResourceViewInfo(name);
-	if (srvInfo == 0)
-		return false;
-
-	// Set the shader resource view
-	deviceContext->DSSetShaderResources(srvInfo->BindIndex, 1, &srv);
-
-	// Success
-	return true;
-}
-
-// --------------------------------------------------------
-// Sets a sampler state in the domain shader stage
-//
-// name - The name of the sampler state in the shader
-// samplerState - The sampler state in GPU memory
-//
-// Returns true if a sampler of the given name was found, false otherwise
-// --------------------------------------------------------
-bool SimpleDomainShader::SetSamplerState(std::string name, ID3D11SamplerState* samplerState)
-{
-	// Look for the variable and verify
-	const SimpleSampler* sampInfo = GetSamplerInfo(name);
-	if (sampInfo == 0)
-		return false;
-
-	// Set the shader resource view
-	deviceContext->DSSetSamplers(sampInfo->BindIndex, 1, &samplerState);
-
-	// Success
-	return true;
-}
-
-
-
-///////////////////////////////////////////////////////////////////////////////
-// ------ SIMPLE HULL SHADER --------------------------------------------------
-///////////////////////////////////////////////////////////////////////////////
-
-// --------------------------------------------------------
-// Constructor just calls the base
-// --------------------------------------------------------
-SimpleHullShader::SimpleHullShader(ID3D11Device* device, ID3D11DeviceContext* context, LPCWSTR shaderFile)
-	: ISimpleShader(device, context) 
-{ 
-	this->shader = 0;
-
-	// Load the actual compiled shader file
-	this->LoadShaderFile(shaderFile);
-}
-
-// --------------------------------------------------------
-// Destructor - Clean up actual shader (base will be called automatically)
-// --------------------------------------------------------
-SimpleHullShader::~SimpleHullShader()
-{
-	CleanUp();
-}
-
-// --------------------------------------------------------
-// Handles cleaning up shader and base class clean up
-// --------------------------------------------------------
-void SimpleHullShader::CleanUp()
-{
-	ISimpleShader::CleanUp();
-	if (shader) { shader->Release(); shader = 0; }
-}
-
-// --------------------------------------------------------
-// Creates the DirectX hull shader
-//
-// shaderBlob - The shader's compiled code
-//
-// Returns true if shader is created correctly, false otherwise
-// --------------------------------------------------------
-bool SimpleHullShader::CreateShader(ID3DBlob* shaderBlob)
-{
-	// Clean up first, in the event this method is
-	// called more than once on the same object
-	this->CleanUp();
-
-	// Create the shader from the blob
-	HRESULT result = device->CreateHullShader(
-		shaderBlob->GetBufferPointer(),
-		shaderBlob->GetBufferSize(),
-		0,
-		&shader);
-
-	// Check the result
-	return (result == S_OK);
-}
-
-// --------------------------------------------------------
-// Sets the hull shader and constant buffers for
-// future DirectX drawing
-// --------------------------------------------------------
-void SimpleHullShader::SetShaderAndCBs()
-{
-	// Is shader valid?
-	if (!shaderValid) return;
-
-	// Set the shader
-	deviceContext->HSSetShader(shader, 0, 0);
-
-	// Set the constant buffers?
-	for (unsigned int i = 0; i < constantBufferCount; i++)
-	{
-		// Skip "buffers" that aren't true constant buffers
-		if (constantBuffers[i].Type != D3D11_CT_CBUFFER)
-			continue;
-
-		// This is a real constant buffer, so set it
-		deviceContext->HSSetConstantBuffers(
-			constantBuffers[i].BindIndex,
-			1,
-			&constantBuffers[i].ConstantBuffer);
-	}
-}
-
-// --------------------------------------------------------
-// Sets a shader resource view in the hull shader stage
-//
-// name - The name of the texture resource in the shader
-// srv - The shader resource view of the texture in GPU memory
-//
-// Returns true if a texture of the given name was found, false otherwise
-// --------------------------------------------------------
-bool SimpleHullShader::SetShaderResourceView(std::string name, ID3D11ShaderResourceView* srv)
-{
-	// Look for the variable and verify
-	const SimpleSRV* srvInfo = GetShaderResourceViewInfo(name);
-	if (srvInfo == 0)
-		return false;
-
-	// Set the shader resource view
-	deviceContext->HSSetShaderResources(srvInfo->BindIndex, 1, &srv);
-
-	// Success
-	return true;
-}
-
-// --------------------------------------------------------
-// Sets a sampler state in the hull shader stage
-//
-// name - The name of the sampler state in the shader
-// samplerState - The sampler state in GPU memory
-//
-// Returns true if a sampler of the given name was found, false otherwise
-// --------------------------------------------------------
-bool SimpleHullShader::SetSamplerState(std::string name, ID3D11SamplerState* samplerState)
-{
-	// Look for the variable and verify
-	const SimpleSampler* sampInfo = GetSamplerInfo(name);
-	if (sampInfo == 0)
-		return false;
-
-	// Set the shader resource view
-	deviceContext->HSSetSamplers(sampInfo->BindIndex, 1, &samplerState);
-
-	// Success
-	return true;
-}
-
-
-
-
-///////////////////////////////////////////////////////////////////////////////
-// ------ SIMPLE GEOMETRY SHADER ----------------------------------------------
-///////////////////////////////////////////////////////////////////////////////
-
-// --------------------------------------------------------
-// Constructor calls the base and sets up potential stream-out options
-// --------------------------------------------------------
-SimpleGeometryShader::SimpleGeometryShader(ID3D11Device* device, ID3D11DeviceContext* context, LPCWSTR shaderFile, bool useStreamOut, bool allowStreamOutRasterization)
-	: ISimpleShader(device, context) 
-{ 
-	this->shader = 0;
-	this->streamOutVertexSize = 0;
-	this->useStreamOut = useStreamOut;
-	this->allowStreamOutRasterization = allowStreamOutRasterization;
-
-	// Load the actual compiled shader file
-	this->LoadShaderFile(shaderFile);
-}
-
-// --------------------------------------------------------
-// Destructor - Clean up actual shader (base will be called automatically)
-// --------------------------------------------------------
-SimpleGeometryShader::~SimpleGeometryShader()
-{
-	CleanUp();
-}
-
-// --------------------------------------------------------
-// Handles cleaning up shader and base class clean up
-// --------------------------------------------------------
-void SimpleGeometryShader::CleanUp()
-{
-	ISimpleShader::CleanUp();
-	if (shader) { shader->Release(); shader = 0; }
-}
-
-// --------------------------------------------------------
-// Creates the DirectX Geometry shader
-//
-// shaderBlob - The shader's compiled code
-//
-// Returns true if shader is created correctly, false otherwise
-// --------------------------------------------------------
-bool SimpleGeometryShader::CreateShader(ID3DBlob* shaderBlob)
-{
-	// Clean up first, in the event this method is
-	// called more than once on the same object
-	this->CleanUp();
-
-	// Using stream out?
-	if (useStreamOut)
-		return this->CreateShaderWithStreamOut(shaderBlob);
-
-	// Create the shader from the blob
-	HRESULT result = device->CreateGeometryShader(
-		shaderBlob->GetBufferPointer(),
-		shaderBlob->GetBufferSize(),
-		0,
-		&shader);
-
-	// Check the result
-	return (result == S_OK);
-}
-
-// --------------------------------------------------------
-// Creates the DirectX Geometry shader and sets it up for
-// stream output, if possible.
-//
-// shaderBlob - The shader's compiled code
-//
-// Returns true if shader is created correctly, false otherwise
-// --------------------------------------------------------
-bool SimpleGeometryShader::CreateShaderWithStreamOut(ID3DBlob* shaderBlob)
-{
-	// Clean up first, in the event this method is
-	// called more than once on the same object
-	this->CleanUp();
-
-	// Reflect shader info
-	ID3D11ShaderReflection* refl;
-	D3DReflect(
-		shaderBlob->GetBufferPointer(),
-		shaderBlob->GetBufferSize(),
-		IID_ID3D11ShaderReflection,
-		(void**)&refl);
-
-	// Get shader info
-	D3D11_SHADER_DESC shaderDesc;
-	refl->GetDesc(&shaderDesc);
-
-	// Set up the output signature
-	streamOutVertexSize = 0;
-	std::vector<D3D11_SO_DECLARATION_ENTRY> soDecl;
-	for (unsigned int i = 0; i < shaderDesc.OutputParameters; i++)
-	{
-		// Get the info about this entry
-		D3D11_SIGNATURE_PARAMETER_DESC paramDesc;
-		refl->GetOutputParameterDesc(i, &paramDesc);
-		
-		// Create the SO Declaration
-		D3D11_SO_DECLARATION_ENTRY entry;
-		entry.SemanticIndex  = paramDesc.SemanticIndex;
-		entry.SemanticName   = paramDesc.SemanticName;
-		entry.Stream         = paramDesc.Stream;
-		entry.StartComponent = 0; // Assume starting at 0
-		entry.OutputSlot     = 0; // Assume the first output slot
-
-		// Check the mask to determine how many components are used
-		entry.ComponentCount = CalcComponentCount(paramDesc.Mask);
-	
-		// Increment the size
-		streamOutVertexSize += entry.ComponentCount * sizeof(float);
-
-		// Add to the declaration
-		soDecl.push_back(entry);
-	}
-
-	// Rasterization allowed?
-	unsigned int rast = allowStreamOutRasterization ? 0 : D3D11_SO_NO_RASTERIZED_STREAM;
-
-	// Create the shader
-	HRESULT result = device->CreateGeometryShaderWithStreamOutput(
-		shaderBlob->GetBufferPointer(), // Shader blob pointer
-		shaderBlob->GetBufferSize(),    // Shader blob size
-		&soDecl[0],                     // Stream out declaration
-		(unsigned int)soDecl.size(),    // Number of declaration entries
-		NULL,                           // Buffer strides (not used - assume tightly packed?)
-		0,                              // No buffer strides
-		rast,                           // Index of the stream to rasterize (if any)
-		NULL,                           // Not using class linkage
-		&shader);
-	
-	return (result == S_OK);
-}
-
-// --------------------------------------------------------
-// Creates a vertex buffer that is compatible with the stream output
-// delcaration that was used to create the shader.  This buffer will
-// not be cleaned up (Released) by the simple shader - you must clean
-// it up yourself when you're done with it.  Immediately returns
-// false if the shader was not created with stream output, the shader
-// isn't valid or the determined stream out vertex size is zero.
-//
-// buffer - Pointer to an ID3D11Buffer pointer to hold the buffer ref
-// vertexCount - Amount of vertices the buffer should hold
-//
-// Returns true if buffer is created successfully AND stream output
-// was used to create the shader.  False otherwise.
-// --------------------------------------------------------
-bool SimpleGeometryShader::CreateCompatibleStreamOutBuffer(ID3D11Buffer** buffer, int vertexCount)
-{
-	// Was stream output actually used?
-	if (!this->useStreamOut || !shaderValid || streamOutVertexSize == 0)
-		return false;
-
-	// Set up the buffer description
-	D3D11_BUFFER_DESC desc;
-	desc.BindFlags           = D3D11_BIND_STREAM_OUTPUT | D3D11_BIND_VERTEX_BUFFER;
-	desc.ByteWidth           = streamOutVertexSize * vertexCount;
-	desc.CPUAccessFlags      = 0;
-	desc.MiscFlags           = 0;
-	desc.StructureByteStride = 0;
-	desc.Usage               = D3D11_USAGE_DEFAULT;
-
-	// Attempt to create the buffer and return the result
-	HRESULT result = device->CreateBuffer(&desc, 0, buffer);
-	return (result == S_OK);
-}
-
-// --------------------------------------------------------
-// Helper method to unbind all stream out buffers from the SO stage
-// --------------------------------------------------------
-void SimpleGeometryShader::UnbindStreamOutStage(ID3D11DeviceContext* deviceContext)
-{
-	unsigned int offset = 0;
-	ID3D11Buffer* unset[1] = { 0 };
-	deviceContext->SOSetTargets(1, unset, &offset);
-}
-
-// --------------------------------------------------------
-// Sets the geometry shader and constant buffers for
-// future DirectX drawing
-// --------------------------------------------------------
-void SimpleGeometryShader::SetShaderAndCBs()
-{
-	// Is shader valid?
-	if (!shaderValid) return;
-
-	// Set the shader
-	deviceContext->GSSetShader(shader, 0, 0);
-
-	// Set the constant buffers?
-	for (unsigned int i = 0; i < constantBufferCount; i++)
-	{
-		// Skip "buffers" that aren't true constant buffers
-		if (constantBuffers[i].Type != D3D11_CT_CBUFFER)
-			continue;
-
-		// This is a real constant buffer, so set it
-		deviceContext->GSSetConstantBuffers(
-			constantBuffers[i].BindIndex,
-			1,
-			&constantBuffers[i].ConstantBuffer);
-	}
-}
-
-// --------------------------------------------------------
-// Sets a shader resource view in the Geometry shader stage
-//
-// name - The name of the texture resource in the shader
-// srv - The shader resource view of the texture in GPU memory
-//
-// Returns true if a texture of the given name was found, false otherwise
-// --------------------------------------------------------
-bool SimpleGeometryShader::SetShaderResourceView(std::string name, ID3D11ShaderResourceView* srv)
-{
-	// Look for the variable and verify
-	const SimpleSRV* srvInfo = GetShaderResourceViewInfo(name);
-	if (srvInfo == 0)
-		return false;
-
-	// Set the shader resource view
-	deviceContext->GSSetShaderResources(srvInfo->BindIndex, 1, &srv);
-
-	// Success
-	return true;
+	stateCache->PSSetConstantBuffer(
+		cb->BindIndex,
+		cb->ConstantBuffer,
+		cb->RingFirstConstant,
+		cb->RingNumConstants);
 }
 
 // --------------------------------------------------------
-// Sets a sampler state in the Geometry shader stage
-//
-// name - The name of the sampler state in the shader
-// samplerState - The sampler state in GPU memory
+// Binds a run of shader resource views in the pixel shader stage
 //
-// Returns true if a sampler of the given name was found, false otherwise
+// startSlot - The register of the first texture resource
+// count - How many consecutive registers to bind
+// srvs - The shader resource views of the textures in GPU memory
 // --------------------------------------------------------
-bool SimpleGeometryShader::SetSamplerState(std::string name, ID3D11SamplerState* samplerState)
+void SimplePixelShader::BindShaderResourceViews(unsigned int startSlot, unsigned int count, RenderResource* const* srvs)
 {
-	// Look for the variable and verify
-	const SimpleSampler* sampInfo = GetSamplerInfo(name);
-	if (sampInfo == 0)
-		return false;
-
-	// Set the shader resource view
-	deviceContext->GSSetSamplers(sampInfo->BindIndex, 1, &samplerState);
-
-	// Success
-	return true;
+	// Set the shader resource views
+	if (stateCache)
+		stateCache->PSSetShaderResources(startSlot, count, srvs);
+	else
+		backend->SetShaderResources(SHADER_STAGE_PIXEL, startSlot, count, srvs);
 }
 
 // --------------------------------------------------------
-// Calculates the number of components specified by a parameter description mask
-//
-// mask - The mask to check (only values 0 - 15 are considered)
+// Binds a run of sampler states in the pixel shader stage
 //
-// Returns an integer between 0 - 4 inclusive
+// startSlot - The register of the first sampler state
+// count - How many consecutive registers to bind
+// samplers - The sampler states in GPU memory
 // --------------------------------------------------------
-unsigned int SimpleGeometryShader::CalcComponentCount(unsigned int mask)
+void SimplePixelShader::BindSamplerStates(unsigned int startSlot, unsigned int count, RenderSamplerState* const* samplers)
 {
-	unsigned int result = 0;
-	result += (unsigned int)((mask & 1) == 1);
-	result += (unsigned int)((mask & 2) == 2);
-	result += (unsigned int)((mask & 4) == 4);
-	result += (unsigned int)((mask & 8) == 8);
-	return result;
+	// Set the sampler states
+	if (stateCache)
+		stateCache->PSSetSamplers(startSlot, count, samplers);
+	else
+		backend->SetSamplers(SHADER_STAGE_PIXEL, startSlot, count, samplers);
 }
-
-
-
-///////////////////////////////////////////////////////////////////////////////
-// ------ SIMPLE COMPUTE SHADER -----------------------------------------------
-///////////////////////////////////////////////////////////////////////////////
-
-// --------------------------------------------------------
-// Constructor just calls the base
-// --------------------------------------------------------
-SimpleComputeShader::SimpleComputeShader(ID3D11Device* device, ID3D11DeviceContext* context, LPCWSTR shaderFile)
-	: ISimpleShader(device, context) 
-{ 
-	this->threadsTotal = 0;
-	this->threadsX = 0;
-	this->threadsY = 0;
-	this->threadsZ = 0;
-	this->shader = 0;
-
-	// Load the actual compiled shader file
-	this->LoadShaderFile(shaderFile);
-}
-
-// --------------------------------------------------------
-// Destructor - Clean up actual shader (base will be called automatically)
-// --------------------------------------------------------
-SimpleComputeShader::~SimpleComputeShader()
-{
-	CleanUp();
-}
-
-// --------------------------------------------------------
-// Handles cleaning up shader and base class clean up
-// --------------------------------------------------------
-void SimpleComputeShader::CleanUp()
-{
-	ISimpleShader::CleanUp();
-	if (shader) { shader->Release(); shader = 0; }
-
-	uavTable.clear();
-}
-
-// --------------------------------------------------------
-// Creates the DirectX Compute shader
-//
-// shaderBlob - The shader's compiled code
-//
-// Returns true if shader is created correctly, false otherwise
-// --------------------------------------------------------
-bool SimpleComputeShader::CreateShader(ID3DBlob* shaderBlob)
-{
-	// Clean up first, in the event this method is
-	// called more than once on the same object
-	this->CleanUp();
-
-	// Create the shader from the blob
-	HRESULT result = device->CreateComputeShader(
-		shaderBlob->GetBufferPointer(),
-		shaderBlob->GetBufferSize(),
-		0,
-		&shader);
-
-	// Was the shader created correctly?
-	if (result != S_OK)
-		return false;
-
-	// Set up shader reflection to get information about UAV's
-	ID3D11ShaderReflection* refl;
-	D3DReflect(
-		shaderBlob->GetBufferPointer(),
-		shaderBlob->GetBufferSize(),
-		IID_ID3D11ShaderReflection,
-		(void**)&refl);
-
-	// Get the description of the shader
-	D3D11_SHADER_DESC shaderDesc;
-	refl->GetDesc(&shaderDesc);
-	
-	// Grab the thread info
-	threadsTotal = refl->GetThreadGroupSize(
-		&threadsX,
-		&threadsY,
-		&threadsZ);
-
-	// Loop and get all UAV resources
-	unsigned int resourceCount = shaderDesc.BoundResources;
-	for (unsigned int r = 0; r < resourceCount; r++)
-	{
-		// Get this resource's description
-		D3D11_SHADER_INPUT_BIND_DESC resourceDesc;
-		refl->GetResourceBindingDesc(r, &resourceDesc);
-
-		// Check the type, looking for any kind of UAV
-		switch (resourceDesc.Type)
-		{
-		case D3D_SIT_UAV_APPEND_STRUCTURED:
-		case D3D_SIT_UAV_CONSUME_STRUCTURED:
-		case D3D_SIT_UAV_RWBYTEADDRESS:
-		case D3D_SIT_UAV_RWSTRUCTURED:
-		case D3D_SIT_UAV_RWSTRUCTURED_WITH_COUNTER:
-		case D3D_SIT_UAV_RWTYPED:
-			uavTable.insert(std::pair<std::string, unsigned int>(resourceDesc.Name, resourceDesc.BindPoint));
-		}
-	}
-
-	// All set
-	refl->Release();
-	return true;
-}
-
-// --------------------------------------------------------
-// Sets the Compute shader and constant buffers for
-// future DirectX drawing
-// --------------------------------------------------------
-void SimpleComputeShader::SetShaderAndCBs()
-{
-	// Is shader valid?
-	if (!shaderValid) return;
-
-	// Set the shader
-	deviceContext->CSSetShader(shader, 0, 0);
-
-	// Set the constant buffers?
-	for (unsigned int i = 0; i < constantBufferCount; i++)
-	{
-		// Skip "buffers" that aren't true constant buffers
-		if (constantBuffers[i].Type != D3D11_CT_CBUFFER)
-			continue;
-
-		// This is a real constant buffer, so set it
-		deviceContext->CSSetConstantBuffers(
-			constantBuffers[i].BindIndex,
-			1,
-			&constantBuffers[i].ConstantBuffer);
-	}
-}
-
-// --------------------------------------------------------
-// Dispatches the compute shader with the specified amount 
-// of groups, using the number of threads per group
-// specified in the shader file itself
-//
-// For example, calling this method with params (5,1,1) on
-// a shader with (8,2,2) threads per group will launch a 
-// total of 160 threads: ((5 * 8) * (1 * 2) * (1 * 2))
-//
-// This is identical to using the device context's 
-// Dispatch() method yourself.  
-//
-// Note: This will dispatch the currently active shader, 
-// not necessarily THIS shader. Be sure to activate this
-// shader with SetShader() before calling Dispatch
-//
-// groupsX - Numbers of groups in the X dimension
-// groupsY - Numbers of groups in the Y dimension
-// groupsZ - Numbers of groups in the Z dimension
-// --------------------------------------------------------
-void SimpleComputeShader::DispatchByGroups(unsigned int groupsX, unsigned int groupsY, unsigned int groupsZ)
-{
-	deviceContext->Dispatch(groupsX, groupsY, groupsZ);
-}
-
-// --------------------------------------------------------
-// Dispatches the compute shader with AT LEAST the 
-// specified amount of threads, calculating the number of
-// groups to dispatch using the number of threads per group
-// specified in the shader file itself
-//
-// For example, calling this method with params (10,3,3) on
-// a shader with (5,2,2) threads per group will launch 
-// 8 total groups and 160 total threads, calculated by:
-// Groups: ceil(10/5) * ceil(3/2) * ceil(3/2) = 8
-// Threads: ((2 * 5) * (2 * 2) * (2 * 2)) = 160
-//
-// Note: This will dispatch the currently active shader, 
-// not necessarily THIS shader. Be sure to activate this
-// shader with SetShader() before calling Dispatch
-//
-// threadsX - Desired numbers of threads in the X dimension
-// threadsY - Desired numbers of threads in the Y dimension
-// threadsZ - Desired numbers of threads in the Z dimension
-// --------------------------------------------------------
-void SimpleComputeShader::DispatchByThreads(unsigned int threadsX, unsigned int threadsY, unsigned int threadsZ)
-{
-	deviceContext->Dispatch(
-		max((unsigned int)ceil((float)threadsX / this->threadsX), 1),
-		max((unsigned int)ceil((float)threadsY / this->threadsY), 1),
-		max((unsigned int)ceil((float)threadsZ / this->threadsZ), 1));
-}
-
-// --------------------------------------------------------
-// Sets a shader resource view in the Compute shader stage
-//
-// name - The name of the texture resource in the shader
-// srv - The shader resource view of the texture in GPU memory
-//
-// Returns true if a texture of the given name was found, false otherwise
-// --------------------------------------------------------
-bool SimpleComputeShader::SetShaderResourceView(std::string name, ID3D11ShaderResourceView* srv)
-{
-	// Look for the variable and verify
-	const SimpleSRV* srvInfo = GetShaderResourceViewInfo(name);
-	if (srvInfo == 0)
-		return false;
-
-	// Set the shader resource view
-	deviceContext->CSSetShaderResources(srvInfo->BindIndex, 1, &srv);
-
-	// Success
-	return true;
-}
-
-// --------------------------------------------------------
-// Sets a sampler state in the Compute shader stage
-//
-// name - The name of the sampler state in the shader
-// samplerState - The sampler state in GPU memory
-//
-// Returns true if a sampler of the given name was found, false otherwise
-// --------------------------------------------------------
-bool SimpleComputeShader::SetSamplerState(std::string name, ID3D11SamplerState* samplerState)
-{
-	// Look for the variable and verify
-	const SimpleSampler* sampInfo = GetSamplerInfo(name);
-	if (sampInfo == 0)
-		return false;
-
-	// Set the shader resource view
-	deviceContext->CSSetSamplers(sampInfo->BindIndex, 1, &samplerState);
-
-	// Success
-	return true;
-}
-
-// --------------------------------------------------------
-// Sets an unordered access view in the Compute shader stage
-//
-// name - The name of the sampler state in the shader
-// uav - The UAV in GPU memory
-// appendConsumeOffset - Used for append or consume UAV's (optional)
-//
-// Returns true if a UAV of the given name was found, false otherwise
-// --------------------------------------------------------
-bool SimpleComputeShader::SetUnorderedAccessView(std::string name, ID3D11UnorderedAccessView * uav, unsigned int appendConsumeOffset)
-{
-	// Look for the variable and verify
-	unsigned int bindIndex = GetUnorderedAccessViewIndex(name);
-	if (bindIndex == -1)
-		return false;
-
-	// Set the shader resource view
-	deviceContext->CSSetUnorderedAccessViews(bindIndex, 1, &uav, &appendConsumeOffset);
-
-	// Success
-	return true;
-}
-
-// --------------------------------------------------------
-// Gets the index of the specified UAV (or -1)
-// --------------------------------------------------------
-int SimpleComputeShader::GetUnorderedAccessViewIndex(std::string name)
-{
-	// Look for the key
-	std::unordered_map<std::string, unsigned int>::iterator result =
-		uavTable.find(name);
-
-	// Did we find the key?
-	if (result == uavTable.end())
-		return -1;
-
-	// Success
-	return result->second;
-}
\ No newline at end of file
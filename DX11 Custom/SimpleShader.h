@@ -1,15 +1,22 @@
 #pragma once
-#pragma comment(lib, "dxguid.lib")
-#pragma comment(lib, "d3dcompiler.lib")
 
-#include <d3d11.h>
-#include <d3dcompiler.h>
 #include <DirectXMath.h>
 
 #include <unordered_map>
 #include <vector>
 #include <string>
 
+#include "ShaderReflectionCache.h"
+#include "RenderBackend.h"
+
+class StateCache;
+class ConstantBufferRing;
+class PipelineStateCache;
+
+// Slots of each kind the SRV and sampler tables stage.  Views and
+// samplers set on later slots are bound straight away.
+#define SIMPLE_SHADER_STAGED_SLOTS	16
+
 // --------------------------------------------------------
 // Used by simple shaders to store information about
 // specific variables in constant buffers
@@ -29,12 +36,31 @@ struct SimpleShaderVariable
 struct SimpleConstantBuffer
 {
 	std::string Name;
-	D3D_CBUFFER_TYPE Type = D3D_CBUFFER_TYPE::D3D11_CT_CBUFFER;
+	ReflectedBufferType Type = REFLECTED_BUFFER_CBUFFER;
 	unsigned int Size;
 	unsigned int BindIndex;
-	ID3D11Buffer* ConstantBuffer = 0;
+	RenderBuffer* ConstantBuffer = 0;
 	unsigned char* LocalDataBuffer = 0;
 	std::vector<SimpleShaderVariable> Variables;
+
+	// Set when the local data changes, cleared once it is uploaded
+	bool Dirty = true;
+
+	// Where the last upload landed when the shader shares the
+	// constant buffer ring (ConstantBuffer then points at the ring)
+	unsigned int RingFirstConstant = 0;
+	unsigned int RingNumConstants = 0;
+	unsigned int RingGeneration = 0;
+};
+
+// --------------------------------------------------------
+// Constant buffer upload counts, summed over all shaders
+// --------------------------------------------------------
+struct SimpleShaderUploadStats
+{
+	unsigned int uploads;			// Buffers actually copied to the GPU
+	unsigned int uploadBytes;		// Bytes copied by those uploads
+	unsigned int skippedUploads;	// Copies skipped since the data hadn't changed
 };
 
 // --------------------------------------------------------
@@ -56,12 +82,13 @@ struct SimpleSampler
 };
 
 // --------------------------------------------------------
-// Base abstract class for simplifying shader handling
+// Base abstract class for simplifying shader handling.
+// Everything is created and bound through a RenderBackend.
 // --------------------------------------------------------
 class ISimpleShader
 {
 public:
-	ISimpleShader(ID3D11Device* device, ID3D11DeviceContext* context);
+	ISimpleShader(RenderBackend* backend);
 	virtual ~ISimpleShader();
 
 	// Simple helpers
@@ -71,52 +98,113 @@ public:
 	void SetShader();
 	void CopyAllBufferData();
 	void CopyBufferData(unsigned int index);
-	void CopyBufferData(std::string bufferName);
+	void CopyBufferData(const std::string& bufferName);
 
 	// Sets arbitrary shader data
-	bool SetData(std::string name, const void* data, unsigned int size);
-
-	bool SetInt(std::string name, int data);
-	bool SetFloat(std::string name, float data);
-	bool SetFloat2(std::string name, const float data[2]);
-	bool SetFloat2(std::string name, const DirectX::XMFLOAT2 data);
-	bool SetFloat3(std::string name, const float data[3]);
-	bool SetFloat3(std::string name, const DirectX::XMFLOAT3 data);
-	bool SetFloat4(std::string name, const float data[4]);
-	bool SetFloat4(std::string name, const DirectX::XMFLOAT4 data);
-	bool SetMatrix4x4(std::string name, const float data[16]);
-	bool SetMatrix4x4(std::string name, const DirectX::XMFLOAT4X4 data);
-
-	// Setting shader resources
-	virtual bool SetShaderResourceView(std::string name, ID3D11ShaderResourceView* srv) = 0;
-	virtual bool SetSamplerState(std::string name, ID3D11SamplerState* samplerState) = 0;
+	bool SetData(const std::string& name, const void* data, unsigned int size);
+
+	bool SetInt(const std::string& name, int data);
+	bool SetFloat(const std::string& name, float data);
+	bool SetFloat2(const std::string& name, const float data[2]);
+	bool SetFloat2(const std::string& name, const DirectX::XMFLOAT2 data);
+	bool SetFloat3(const std::string& name, const float data[3]);
+	bool SetFloat3(const std::string& name, const DirectX::XMFLOAT3 data);
+	bool SetFloat4(const std::string& name, const float data[4]);
+	bool SetFloat4(const std::string& name, const DirectX::XMFLOAT4 data);
+	bool SetMatrix4x4(const std::string& name, const float data[16]);
+	bool SetMatrix4x4(const std::string& name, const DirectX::XMFLOAT4X4 data);
+
+	// Sets shader data by handle - resolve the handle once with
+	// GetVariableHandle() and these skip the name lookup entirely
+	bool SetData(int handle, const void* data, unsigned int size);
+
+	bool SetInt(int handle, int data);
+	bool SetFloat(int handle, float data);
+	bool SetFloat3(int handle, const DirectX::XMFLOAT3& data);
+	bool SetFloat4(int handle, const DirectX::XMFLOAT4& data);
+	bool SetMatrix4x4(int handle, const DirectX::XMFLOAT4X4& data);
+
+	// Sets a whole constant buffer at once, with one compare and one
+	// copy - meant for the structs in ShaderConstants.h.  Fails unless
+	// size is exactly the buffer's size, so a struct that has drifted
+	// from the shader is caught at runtime as well as by its asserts.
+	bool SetBufferData(const std::string& name, const void* data, unsigned int size);
+	bool SetBufferData(int handle, const void* data, unsigned int size);
+	template<typename T> bool SetBufferData(const std::string& name, const T& data) { return SetBufferData(name, &data, sizeof(T)); }
+	template<typename T> bool SetBufferData(int handle, const T& data) { return SetBufferData(handle, &data, sizeof(T)); }
+
+	// Setting shader resources, by name or by handle.  These only
+	// stage the view or sampler in this shader's tables, by slot;
+	// nothing is bound until FlushBindings().
+	bool SetShaderResourceView(const std::string& name, RenderResource* srv);
+	bool SetShaderResourceView(int handle, RenderResource* srv);
+	bool SetSamplerState(const std::string& name, RenderSamplerState* samplerState);
+	bool SetSamplerState(int handle, RenderSamplerState* samplerState);
+
+	// Binds every staged view and sampler, one call per contiguous
+	// run of slots.  Through the state cache, slots that already
+	// hold the same object are dropped and only the changed runs go
+	// out.  Call once per draw, after setting them.
+	void FlushBindings();
 
 	// Getting data about variables and resources
-	const SimpleShaderVariable* GetVariableInfo(std::string name);
+	const SimpleShaderVariable* GetVariableInfo(const std::string& name);
+
+	// Handles for the setters above, or -1 if the name doesn't exist
+	int GetVariableHandle(const std::string& name);
+	int GetBufferHandle(const std::string& name);
+	int GetSRVHandle(const std::string& name);
+	int GetSamplerHandle(const std::string& name);
 	
-	const SimpleSRV* GetShaderResourceViewInfo(std::string name);
+	const SimpleSRV* GetShaderResourceViewInfo(const std::string& name);
 	const SimpleSRV* GetShaderResourceViewInfo(unsigned int index);
 	size_t GetShaderResourceViewCount() { return textureTable.size(); }
 	
-	const SimpleSampler* GetSamplerInfo(std::string name);
+	const SimpleSampler* GetSamplerInfo(const std::string& name);
 	const SimpleSampler* GetSamplerInfo(unsigned int index);
 	size_t GetSamplerCount() { return samplerTable.size(); }
 
 	// Get data about constant buffers
 	unsigned int GetBufferCount();
 	unsigned int GetBufferSize(unsigned int index);
-	const SimpleConstantBuffer* GetBufferInfo(std::string name);
+	const SimpleConstantBuffer* GetBufferInfo(const std::string& name);
 	const SimpleConstantBuffer* GetBufferInfo(unsigned int index);
 	
 	// Misc getters
-	ID3DBlob* GetShaderBlob() { return shaderBlob; }
+	const std::vector<unsigned char>& GetByteCode() { return byteCode; }
+
+	// Optional state cache shared by every shader.  When set, vertex
+	// and pixel shader binds go through it so redundant calls are dropped.
+	static void SetStateCache(StateCache* cache) { stateCache = cache; }
+
+	// Optional constant buffer ring shared by every shader.  Must be set
+	// before shaders are loaded; vertex and pixel shaders loaded while it
+	// (and the state cache) are set suballocate their buffers from it.
+	static void SetConstantBufferRing(ConstantBufferRing* ring) { cbRing = ring; }
+
+	// Optional pipeline state cache shared by every shader.  When set,
+	// vertex shaders with the same input signature share one layout.
+	static void SetPipelineStateCache(PipelineStateCache* cache) { pipelineStates = cache; }
+
+	static const SimpleShaderUploadStats& GetUploadStats() { return uploadStats; }
+	static void ResetUploadStats();
 
 protected:
 	
+	static StateCache* stateCache;
+	static ConstantBufferRing* cbRing;
+	static PipelineStateCache* pipelineStates;
+	static SimpleShaderUploadStats uploadStats;
+
+	// True if this shader's constant buffers live in cbRing
+	bool useRing;
+
+	// Reflection tables, only filled while LoadShaderFile() runs
+	ShaderReflectionData reflection;
+
 	bool shaderValid;
-	ID3DBlob* shaderBlob;
-	ID3D11Device* device;
-	ID3D11DeviceContext* deviceContext;
+	std::vector<unsigned char> byteCode;
+	RenderBackend* backend;
 
 	// Resource counts
 	unsigned int constantBufferCount;
@@ -126,22 +214,37 @@ protected:
 	std::vector<SimpleSRV*>		shaderResourceViews;
 	std::vector<SimpleSampler*>	samplerStates;
 	std::unordered_map<std::string, SimpleConstantBuffer*> cbTable;
-	std::unordered_map<std::string, SimpleShaderVariable> varTable;
+	std::vector<SimpleShaderVariable>	variables; // Indexed by handle
+	std::unordered_map<std::string, unsigned int> varTable; // Name to handle
 	std::unordered_map<std::string, SimpleSRV*> textureTable;
 	std::unordered_map<std::string, SimpleSampler*> samplerTable;
 
+	// Staged views and samplers by slot, and a bit per slot set so far
+	RenderResource*		stagedSRVs[SIMPLE_SHADER_STAGED_SLOTS];
+	RenderSamplerState*	stagedSamplers[SIMPLE_SHADER_STAGED_SLOTS];
+	unsigned int				stagedSRVMask;
+	unsigned int				stagedSamplerMask;
+
 	// Initialization method
-	bool LoadShaderFile(LPCWSTR shaderFile);
+	bool LoadShaderFile(const wchar_t* shaderFile);
 
 	// Pure virtual functions for dealing with shader types
-	virtual bool CreateShader(ID3DBlob* shaderBlob) = 0;
+	virtual bool CreateShader() = 0;
 	virtual void SetShaderAndCBs() = 0;
+	virtual void BindShaderResourceViews(unsigned int startSlot, unsigned int count, RenderResource* const* srvs) = 0;
+	virtual void BindSamplerStates(unsigned int startSlot, unsigned int count, RenderSamplerState* const* samplers) = 0;
+
+	// Ring support - only stages that can bind a constant buffer
+	// window through the state cache opt in.  Rebinding points the
+	// buffer's slot at its latest upload if this shader is bound.
+	virtual bool SupportsConstantBufferRing() { return false; }
+	virtual void RebindConstantBuffer(unsigned int index) { }
 
 	virtual void CleanUp();
 
 	// Helpers for finding data by name
-	SimpleShaderVariable* FindVariable(std::string name, int size);
-	SimpleConstantBuffer* FindConstantBuffer(std::string name);
+	SimpleShaderVariable* FindVariable(const std::string& name, int size);
+	SimpleConstantBuffer* FindConstantBuffer(const std::string& name);
 };
 
 // --------------------------------------------------------
@@ -150,23 +253,30 @@ protected:
 class SimpleVertexShader : public ISimpleShader
 {
 public:
-	SimpleVertexShader(ID3D11Device* device, ID3D11DeviceContext* context, LPCWSTR shaderFile);
-	SimpleVertexShader(ID3D11Device* device, ID3D11DeviceContext* context, LPCWSTR shaderFile, ID3D11InputLayout* inputLayout, bool perInstanceCompatible);
+	SimpleVertexShader(RenderBackend* backend, const wchar_t* shaderFile);
+	SimpleVertexShader(RenderBackend* backend, const wchar_t* shaderFile, RenderInputLayout* inputLayout, bool perInstanceCompatible);
+	SimpleVertexShader(RenderBackend* backend, const wchar_t* shaderFile, const InputElementDesc* vertexElements, unsigned int vertexElementCount);
 	~SimpleVertexShader();
-	ID3D11VertexShader* GetDirectXShader() { return shader; }
-	ID3D11InputLayout* GetInputLayout() { return inputLayout; }
+	RenderVertexShader* GetDirectXShader() { return shader; }
+	RenderInputLayout* GetInputLayout() { return inputLayout; }
 	bool GetPerInstanceCompatible() { return perInstanceCompatible; }
 
-	bool SetShaderResourceView(std::string name, ID3D11ShaderResourceView* srv);
-	bool SetSamplerState(std::string name, ID3D11SamplerState* samplerState);
-
 protected:
 	bool perInstanceCompatible;
-	ID3D11InputLayout* inputLayout;
-	ID3D11VertexShader* shader;
-	bool CreateShader(ID3DBlob* shaderBlob);
+	RenderInputLayout* inputLayout;
+	RenderVertexShader* shader;
+
+	// Per vertex elements whose format and offset replace the
+	// reflected ones, matched by semantic (packed vertex streams)
+	std::vector<InputElementDesc> vertexElements;
+	bool CreateShader();
 	void SetShaderAndCBs();
+	void BindShaderResourceViews(unsigned int startSlot, unsigned int count, RenderResource* const* srvs);
+	void BindSamplerStates(unsigned int startSlot, unsigned int count, RenderSamplerState* const* samplers);
 	void CleanUp();
+
+	bool SupportsConstantBufferRing() { return true; }
+	void RebindConstantBuffer(unsigned int index);
 };
 
 
@@ -176,125 +286,18 @@ protected:
 class SimplePixelShader : public ISimpleShader
 {
 public:
-	SimplePixelShader(ID3D11Device* device, ID3D11DeviceContext* context, LPCWSTR shaderFile);
+	SimplePixelShader(RenderBackend* backend, const wchar_t* shaderFile);
 	~SimplePixelShader();
-	ID3D11PixelShader* GetDirectXShader() { return shader; }
-
-	bool SetShaderResourceView(std::string name, ID3D11ShaderResourceView* srv);
-	bool SetSamplerState(std::string name, ID3D11SamplerState* samplerState);
-
-protected:
-	ID3D11PixelShader* shader;
-	bool CreateShader(ID3DBlob* shaderBlob);
-	void SetShaderAndCBs();
-	void CleanUp();
-};
-
-// --------------------------------------------------------
-// Derived class for DOMAIN shaders ///////////////////////
-// --------------------------------------------------------
-class SimpleDomainShader : public ISimpleShader
-{
-public:
-	SimpleDomainShader(ID3D11Device* device, ID3D11DeviceContext* context, LPCWSTR shaderFile);
-	~SimpleDomainShader();
-	ID3D11DomainShader* GetDirectXShader() { return shader; }
-
-	bool SetShaderResourceView(std::string name, ID3D11ShaderResourceView* srv);
-	bool SetSamplerState(std::string name, ID3D11SamplerState* samplerState);
-
-protected:
-	ID3D11DomainShader* shader;
-	bool CreateShader(ID3DBlob* shaderBlob);
-	void SetShaderAndCBs();
-	void CleanUp();
-};
-
-// --------------------------------------------------------
-// Derived class for HULL shaders /////////////////////////
-// --------------------------------------------------------
-class SimpleHullShader : public ISimpleShader
-{
-public:
-	SimpleHullShader(ID3D11Device* device, ID3D11DeviceContext* context, LPCWSTR shaderFile);
-	~SimpleHullShader();
-	ID3D11HullShader* GetDirectXShader() { return shader; }
-
-	bool SetShaderResourceView(std::string name, ID3D11ShaderResourceView* srv);
-	bool SetSamplerState(std::string name, ID3D11SamplerState* samplerState);
-
-protected:
-	ID3D11HullShader* shader;
-	bool CreateShader(ID3DBlob* shaderBlob);
-	void SetShaderAndCBs();
-	void CleanUp();
-};
-
-// --------------------------------------------------------
-// Derived class for GEOMETRY shaders /////////////////////
-// --------------------------------------------------------
-class SimpleGeometryShader : public ISimpleShader
-{
-public:
-	SimpleGeometryShader(ID3D11Device* device, ID3D11DeviceContext* context, LPCWSTR shaderFile, bool useStreamOut = 0, bool allowStreamOutRasterization = 0);
-	~SimpleGeometryShader();
-	ID3D11GeometryShader* GetDirectXShader() { return shader; }
-
-	bool SetShaderResourceView(std::string name, ID3D11ShaderResourceView* srv);
-	bool SetSamplerState(std::string name, ID3D11SamplerState* samplerState);
-
-	bool CreateCompatibleStreamOutBuffer(ID3D11Buffer** buffer, int vertexCount);
-
-	static void UnbindStreamOutStage(ID3D11DeviceContext* deviceContext);
+	RenderPixelShader* GetDirectXShader() { return shader; }
 
 protected:
-	// Shader itself
-	ID3D11GeometryShader* shader;
-
-	// Stream out related
-	bool useStreamOut;
-	bool allowStreamOutRasterization;
-	unsigned int streamOutVertexSize;
-
-	bool CreateShader(ID3DBlob* shaderBlob);
-	bool CreateShaderWithStreamOut(ID3DBlob* shaderBlob);
+	RenderPixelShader* shader;
+	bool CreateShader();
 	void SetShaderAndCBs();
+	void BindShaderResourceViews(unsigned int startSlot, unsigned int count, RenderResource* const* srvs);
+	void BindSamplerStates(unsigned int startSlot, unsigned int count, RenderSamplerState* const* samplers);
 	void CleanUp();
 
-	// Helpers
-	unsigned int CalcComponentCount(unsigned int mask);
+	bool SupportsConstantBufferRing() { return true; }
+	void RebindConstantBuffer(unsigned int index);
 };
-
-
-// --------------------------------------------------------
-// Derived class for COMPUTE shaders //////////////////////
-// --------------------------------------------------------
-class SimpleComputeShader : public ISimpleShader
-{
-public:
-	SimpleComputeShader(ID3D11Device* device, ID3D11DeviceContext* context, LPCWSTR shaderFile);
-	~SimpleComputeShader();
-	ID3D11ComputeShader* GetDirectXShader() { return shader; }
-
-	void DispatchByGroups(unsigned int groupsX, unsigned int groupsY, unsigned int groupsZ);
-	void DispatchByThreads(unsigned int threadsX, unsigned int threadsY, unsigned int threadsZ);
-
-	bool SetShaderResourceView(std::string name, ID3D11ShaderResourceView* srv);
-	bool SetSamplerState(std::string name, ID3D11SamplerState* samplerState);
-	bool SetUnorderedAccessView(std::string name, ID3D11UnorderedAccessView* uav, unsigned int appendConsumeOffset = -1);
-
-	int GetUnorderedAccessViewIndex(std::string name);
-
-protected:
-	ID3D11ComputeShader* shader;
-	std::unordered_map<std::string, unsigned int> uavTable;
-
-	unsigned int threadsX;
-	unsigned int threadsY;
-	unsigned int threadsZ;
-	unsigned int threadsTotal;
-
-	bool CreateShader(ID3DBlob* shaderBlob);
-	void SetShaderAndCBs();
-	void CleanUp();
-};
\ No newline at end of file
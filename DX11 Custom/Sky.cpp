@@ -1,18 +1,11 @@
 #include "Sky.h"
+#include "ShaderConstants.h"
 
-Sky::Sky(Mesh* m, ID3D11SamplerState* samp, ID3D11Device* device)
+Sky::Sky(Mesh* m, RenderSamplerState* samp, PipelineStateCache* pipelineStates)
 {
-	//set rasterizer description
-	D3D11_RASTERIZER_DESC rastDesc = {};
-	rastDesc.FillMode = D3D11_FILL_SOLID;
-	rastDesc.CullMode = D3D11_CULL_FRONT;
-	device->CreateRasterizerState(&rastDesc, &rastState);
-
-	//set depth stencil description
-	D3D11_DEPTH_STENCIL_DESC stencilDesc = {};
-	stencilDesc.DepthFunc = D3D11_COMPARISON_LESS_EQUAL;
-	device->CreateDepthStencilState(&stencilDesc, &depthState);
 	meshObj = m;
+	this->pipelineStates = pipelineStates;
+	pipelineState = 0;
 }
 
 Sky::~Sky()
@@ -23,41 +16,51 @@ Sky::~Sky()
 	delete meshObj;
 }
 
-void Sky::Draw(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, Camera* cam)
+void Sky::Draw(StateCache* state, Camera* cam)
 {
-	//set rasterizer and depth stencil states
-	context->RSSetState(rastState.Get());
-	context->OMSetDepthStencilState(depthState.Get(), 0);
+	//the shaders are set after construction, so the pso is made on first draw
+	if (!pipelineState)
+	{
+		//drawn from inside the cube, and its depth is pushed to the far
+		//plane, so it only passes where nothing else was drawn
+		PipelineStateDesc desc;
+		desc.vertexShader = simpleVertex->GetDirectXShader();
+		desc.pixelShader = simplePixel->GetDirectXShader();
+		desc.inputLayout = simpleVertex->GetInputLayout();
+		desc.rasterizer.CullMode = RENDER_CULL_FRONT;
+		desc.rasterizer.DepthClipEnable = false;
+		desc.depthStencil.DepthWrite = false;
+		desc.depthStencil.DepthFunc = RENDER_COMPARISON_LESS_EQUAL;
+		pipelineState = pipelineStates->GetPipelineState(desc);
+	}
+	state->SetPipelineState(pipelineState);
 
-	//set shaders
+	//set shaders (constant buffers, the pso already bound the shaders)
 	simpleVertex->SetShader();
 	simplePixel->SetShader();
 
 	//set sample state and texture values in pixel shader 
 	simplePixel->SetSamplerState("sampleState", sampleOptions.Get());
 	simplePixel->SetShaderResourceView("cube", shaderView.Get());
+	simplePixel->FlushBindings();
 
 	//set view and proj matrices in vertex shader
-	simpleVertex->SetMatrix4x4("view", cam->getView());
-	simpleVertex->SetMatrix4x4("proj", cam->getProj());
+	SkyVSExternalData vertexData;
+	vertexData.view = cam->getView();
+	vertexData.proj = cam->getProj();
+	simpleVertex->SetBufferData("ExternalData", vertexData);
 
 	//copy buffer data
 	simplePixel->CopyAllBufferData();
 	simpleVertex->CopyAllBufferData();
 
-	UINT stride = sizeof(Vertex);
-	UINT offset = 0;
-
 	//set vertex and index buffers and draw
-	context->IASetVertexBuffers(0, 1, meshObj->GetVertexBuffer().GetAddressOf(), &stride, &offset);
-	context->IASetIndexBuffer(meshObj->GetIndexBuffer().Get(), DXGI_FORMAT_R32_UINT, 0);
-
-	context->DrawIndexed(
-		meshObj->GetIndexCount(),
-		0,
-		0);
-
-	context->RSSetState(0);
-	context->OMSetDepthStencilState(0, 0);
+	const MeshBindings& mesh = meshObj->GetBindings();
+	state->IASetVertexBuffers(0, 1, &mesh.vertexBuffer, &mesh.stride, &mesh.offset);
+	state->IASetIndexBuffer(mesh.indexBuffer, mesh.indexFormat, 0);
 
+	state->DrawIndexed(
+		mesh.indexCount,
+		mesh.startIndex,
+		mesh.baseVertex);
 }
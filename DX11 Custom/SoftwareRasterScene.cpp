@@ -0,0 +1,187 @@
+#include "SoftwareRasterScene.h"
+#include "Texels.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+using namespace DirectX;
+
+static const unsigned int TEXTURE_SIZE = 64;
+static const unsigned int MAP_CHANNELS[3] = { 4, 2, 4 };
+
+// Scale, then rotation, then translation, as Transform builds them
+static XMFLOAT4X4 WorldMatrix(const XMFLOAT3& position, float yaw, const XMFLOAT3& scale)
+{
+	XMFLOAT4X4 world;
+	XMMATRIX w = XMMatrixScaling(scale.x, scale.y, scale.z) * XMMatrixRotationRollPitchYaw(0, yaw, 0) *
+		XMMatrixTranslation(position.x, position.y, position.z);
+	XMStoreFloat4x4(&world, w);
+	return world;
+}
+
+SoftwareRasterScene::SoftwareRasterScene(unsigned int cubes, unsigned int width, unsigned int height)
+{
+	BuildCube();
+	BuildMaterials();
+
+	// A floor, then the cubes scattered down it
+	srand(1);
+	SoftwareDraw draw;
+	draw.vertices = cubeVertices.data();
+	draw.vertexCount = (unsigned int)cubeVertices.size();
+	draw.indices = cubeIndices.data();
+	draw.indexCount = (unsigned int)cubeIndices.size();
+
+	draw.world = WorldMatrix(XMFLOAT3(0, -0.6f, 30), 0, XMFLOAT3(30, 0.2f, 80));
+	draw.material = &materials[2];
+	draws.push_back(draw);
+	for (unsigned int c = 0; c < cubes; c++)
+	{
+		XMFLOAT3 position((float)(rand() % 200) / 10.0f - 10.0f, (float)(rand() % 20) / 10.0f, (float)(rand() % 600) / 10.0f);
+		float yaw = (float)(rand() % 628) / 100.0f;
+		draw.world = WorldMatrix(position, yaw, XMFLOAT3(1, 1, 1));
+		draw.material = &materials[c % 2];
+		draws.push_back(draw);
+	}
+
+	// Camera's default lens, looking down at the field
+	XMFLOAT3 cameraPos(0, 4, -8);
+	XMVECTOR forward = XMVector3Rotate(XMVectorSet(0, 0, 1, 0), XMQuaternionRotationRollPitchYaw(0.3f, 0, 0));
+	memset(&frame, 0, sizeof(frame));
+	XMStoreFloat4x4(&frame.view, XMMatrixLookToLH(XMLoadFloat3(&cameraPos), forward, XMVectorSet(0, 1, 0, 0)));
+	XMStoreFloat4x4(&frame.proj, XMMatrixPerspectiveFovLH(1.7f, (float)width / height, 0.1f, 500.0f));
+
+	// The game's kinds of lights: directional and point lights
+	// through the material cbuffer, and a row of cluster lights
+	frame.lights.dirLights[0].ambientColor = XMFLOAT3(1.0f, 0.9f, 0.8f);
+	XMStoreFloat3(&frame.lights.dirLights[0].direction, XMVector3Normalize(XMVectorSet(1, -1, 0.5f, 0)));
+	frame.lights.dirLights[1].ambientColor = XMFLOAT3(0.05f, 0.05f, 0.15f);
+	XMStoreFloat3(&frame.lights.dirLights[1].direction, XMVector3Normalize(XMVectorSet(-1, 1, 0, 0)));
+	frame.lights.pointLights[0].ambientColor = XMFLOAT3(0.5f, 0.5f, 0.5f);
+	frame.lights.pointLights[0].position = XMFLOAT3(0, 5, 0);
+	frame.lights.cameraPos = cameraPos;
+	frame.dirLightCount = 2;
+	frame.pointLightCount = 1;
+
+	lights.resize(64);
+	for (unsigned int i = 0; i < lights.size(); i++)
+	{
+		lights[i].position = XMFLOAT3(i % 2 ? 8.0f : -8.0f, 0.5f, (float)(i / 2) * 2.0f);
+		lights[i].range = 4.0f;
+		lights[i].color = XMFLOAT3(i % 3 == 0 ? 1.0f : 0.2f, i % 3 == 1 ? 1.0f : 0.2f, i % 3 == 2 ? 1.0f : 0.2f);
+		lights[i].intensity = 2.0f;
+	}
+	frame.clusterLights = lights.data();
+	frame.clusterLightCount = (unsigned int)lights.size();
+	frame.clearColor = XMFLOAT3(0.133f, 0.325f, 0.531f);
+}
+
+void SoftwareRasterScene::Draw(SoftwareRasterizer& rasterizer)
+{
+	rasterizer.BeginFrame(frame);
+	for (const SoftwareDraw& d : draws)
+		rasterizer.Submit(d);
+	rasterizer.EndFrame();
+}
+
+// --------------------------------------------------------
+// A unit cube, 4 vertices a face.  b = t x n makes each face
+// clockwise seen from outside, as the GPU's culling expects.
+// --------------------------------------------------------
+void SoftwareRasterScene::BuildCube()
+{
+	const XMFLOAT3 faces[6][2] =
+	{
+		{ XMFLOAT3(0, 0, -1), XMFLOAT3(1, 0, 0) }, { XMFLOAT3(0, 0, 1), XMFLOAT3(-1, 0, 0) },
+		{ XMFLOAT3(1, 0, 0), XMFLOAT3(0, 0, 1) }, { XMFLOAT3(-1, 0, 0), XMFLOAT3(0, 0, -1) },
+		{ XMFLOAT3(0, 1, 0), XMFLOAT3(1, 0, 0) }, { XMFLOAT3(0, -1, 0), XMFLOAT3(1, 0, 0) },
+	};
+	const float corners[4][2] = { { -1, 1 }, { 1, 1 }, { 1, -1 }, { -1, -1 } };
+	for (const auto& face : faces)
+	{
+		XMVECTOR n = XMLoadFloat3(&face[0]);
+		XMVECTOR t = XMLoadFloat3(&face[1]);
+		XMVECTOR b = XMVector3Cross(t, n);
+		unsigned int base = (unsigned int)cubeVertices.size();
+		for (const auto& c : corners)
+		{
+			Vertex v;
+			XMStoreFloat3(&v.Position, (n + t * c[0] + b * c[1]) * 0.5f);
+			v.normal = face[0];
+			v.uv = XMFLOAT2((c[0] + 1) * 0.5f, (1 - c[1]) * 0.5f);
+			v.tangent = face[1];
+			cubeVertices.push_back(v);
+		}
+		unsigned int quad[6] = { 0, 1, 2, 0, 2, 3 };
+		for (unsigned int i : quad)
+			cubeIndices.push_back(base + i);
+	}
+}
+
+// --------------------------------------------------------
+// Each material's three maps, full mip chains in the atlas's
+// layout: albedo (sRGB), normal and surface
+// --------------------------------------------------------
+void SoftwareRasterScene::BuildMaterials()
+{
+	size_t chainTexels = 0;
+	unsigned int mipLevels = 0;
+	for (unsigned int s = TEXTURE_SIZE; s > 0; s /= 2, mipLevels++)
+		chainTexels += s * s;
+
+	const XMFLOAT3 tints[SOFTWARE_SCENE_MATERIALS] = { XMFLOAT3(0.9f, 0.6f, 0.3f), XMFLOAT3(0.3f, 0.5f, 0.9f), XMFLOAT3(0.8f, 0.8f, 0.8f) };
+	for (unsigned int m = 0; m < SOFTWARE_SCENE_MATERIALS; m++)
+	{
+		for (unsigned int map = 0; map < 3; map++)
+		{
+			std::vector<unsigned char>& chain = maps[m][map];
+			chain.resize(chainTexels * MAP_CHANNELS[map]);
+			for (unsigned int y = 0; y < TEXTURE_SIZE; y++)
+			{
+				for (unsigned int x = 0; x < TEXTURE_SIZE; x++)
+				{
+					unsigned char* texel = &chain[(y * TEXTURE_SIZE + x) * MAP_CHANNELS[map]];
+					bool light = ((x / 8) + (y / 8)) % 2 == 0;
+					if (map == 0)
+					{
+						float shade = light ? 1.0f : 0.35f;
+						texel[0] = LinearToSRGB(tints[m].x * shade);
+						texel[1] = LinearToSRGB(tints[m].y * shade);
+						texel[2] = LinearToSRGB(tints[m].z * shade);
+						texel[3] = 255;
+					}
+					else if (map == 1)
+					{
+						texel[0] = (unsigned char)(128 + 90 * sinf(x * 6.2831853f * 4 / TEXTURE_SIZE));
+						texel[1] = 128;
+					}
+					else
+					{
+						texel[0] = light ? 60 : 200;
+						texel[1] = (unsigned char)(m * 120);
+						texel[2] = 255;
+						texel[3] = 255;
+					}
+				}
+			}
+
+			unsigned char* mip = chain.data();
+			for (unsigned int s = TEXTURE_SIZE; s > 1; s /= 2)
+			{
+				unsigned char* next = mip + s * s * MAP_CHANNELS[map];
+				DownsampleMip(mip, s, MAP_CHANNELS[map], next, map == 0);
+				mip = next;
+			}
+		}
+
+		SoftwareTexture* textures[3] = { &materials[m].albedo, &materials[m].normal, &materials[m].surface };
+		for (unsigned int map = 0; map < 3; map++)
+		{
+			textures[map]->texels = maps[m][map].data();
+			textures[map]->size = TEXTURE_SIZE;
+			textures[map]->mipLevels = mipLevels;
+			textures[map]->channels = MAP_CHANNELS[map];
+			textures[map]->srgb = map == 0;
+		}
+	}
+}
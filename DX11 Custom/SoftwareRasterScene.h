@@ -0,0 +1,49 @@
+#pragma once
+#include <DirectXMath.h>
+#include <vector>
+#include "ClusterLight.h"
+#include "SoftwareRasterizer.h"
+#include "Vertex.h"
+
+#define SOFTWARE_SCENE_MATERIALS	3
+
+// --------------------------------------------------------
+// A test scene for the software rasterizer: a field of
+// textured cubes scattered over a floor, with the game's
+// kinds of lights.  Textures are made here - a checker
+// albedo, a rippled normal map and varying roughness -
+// mipmapped the way the atlas cooks them.
+//
+// Built with DirectXMath alone (not Camera and Transform,
+// which bring in the window), so it can be drawn off Windows
+// as well as from the benchmarks.  The same cube count and
+// size always give the same scene.
+// --------------------------------------------------------
+class SoftwareRasterScene
+{
+public:
+	SoftwareRasterScene(unsigned int cubes, unsigned int width, unsigned int height);
+
+	// One frame of the whole scene
+	void Draw(SoftwareRasterizer& rasterizer);
+
+	unsigned int GetDrawCount() { return (unsigned int)draws.size(); }
+
+private:
+	// The draws and the frame point into everything below, so
+	// a scene can't be copied
+	SoftwareRasterScene(const SoftwareRasterScene&);
+	SoftwareRasterScene& operator=(const SoftwareRasterScene&);
+
+	std::vector<Vertex> cubeVertices;
+	std::vector<unsigned int> cubeIndices;
+	std::vector<unsigned char> maps[SOFTWARE_SCENE_MATERIALS][3];
+	SoftwareMaterial materials[SOFTWARE_SCENE_MATERIALS];
+	std::vector<ClusterLight> lights;
+
+	std::vector<SoftwareDraw> draws;
+	SoftwareFrame frame;
+
+	void BuildCube();
+	void BuildMaterials();
+};
@@ -0,0 +1,1144 @@
+#include "SoftwareRasterizer.h"
+#include "Texels.h"
+#include <emmintrin.h>
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <math.h>
+#include <string.h>
+
+using namespace DirectX;
+
+// Fewest triangles worth a binning job of their own
+#define SOFTWARE_MIN_RUN_TRIANGLES	256
+
+// Entries in the linear to sRGB table.  Near black, where the
+// curve is steepest, neighbouring entries are a tenth of an 8
+// bit level apart.
+#define SOFTWARE_SRGB_TABLE_SIZE	16384
+
+// Where each value lives in Triangle::planes.  The attributes
+// are in ShadedVertex's order, after its position.
+enum SoftwarePlane
+{
+	PLANE_Z = 0,
+	PLANE_W = 1,		// 1/w, to undo the perspective divide
+	PLANE_WORLD = 2,
+	PLANE_NORMAL = 5,
+	PLANE_UV = 8,
+	PLANE_TANGENT = 10,
+};
+
+static const float PI = 3.14159265359f;
+static const float F0_NON_METAL = 0.04f;
+static const float MIN_ROUGHNESS = 0.0000001f;
+
+// Covered lanes per 4 bit SSE mask
+static const unsigned char LANE_COUNTS[16] = { 0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4 };
+
+static float srgbToLinear[256];
+static float unormToFloat[256];
+static unsigned char linearToSRGB[SOFTWARE_SRGB_TABLE_SIZE];
+
+// --------------------------------------------------------
+// The texel decode tables and the sRGB encode table, from
+// the atlas's curve (Texels.h) so textures decode and the frame
+// encodes as they do on the GPU.  Built before any thread
+// reads them.
+// --------------------------------------------------------
+static void BuildTables()
+{
+	static bool built = false;
+	if (built)
+		return;
+
+	for (unsigned int i = 0; i < 256; i++)
+	{
+		srgbToLinear[i] = SRGBToLinear((unsigned char)i);
+		unormToFloat[i] = i / 255.0f;
+	}
+	for (unsigned int i = 0; i < SOFTWARE_SRGB_TABLE_SIZE; i++)
+		linearToSRGB[i] = LinearToSRGB((float)i / (SOFTWARE_SRGB_TABLE_SIZE - 1));
+	built = true;
+}
+
+SoftwareTexture::SoftwareTexture()
+{
+	texels = 0;
+	size = 0;
+	mipLevels = 0;
+	channels = 0;
+	srgb = false;
+}
+
+SoftwareMaterial::SoftwareMaterial()
+{
+	color = XMFLOAT3(1, 1, 1);
+
+	// The shader's defaults without PBR maps
+	roughness = 0.0f;
+	metalness = 0.0f;
+}
+
+// Draws submitted without a material
+static const SoftwareMaterial defaultMaterial;
+
+// --------------------------------------------------------
+// SSE helpers: a float3 for each of 4 pixels
+// --------------------------------------------------------
+struct Float3x4
+{
+	__m128 x, y, z;
+};
+
+static inline Float3x4 Set3(float x, float y, float z)
+{
+	Float3x4 r = { _mm_set1_ps(x), _mm_set1_ps(y), _mm_set1_ps(z) };
+	return r;
+}
+
+static inline Float3x4 Add3(const Float3x4& a, const Float3x4& b)
+{
+	Float3x4 r = { _mm_add_ps(a.x, b.x), _mm_add_ps(a.y, b.y), _mm_add_ps(a.z, b.z) };
+	return r;
+}
+
+static inline Float3x4 Sub3(const Float3x4& a, const Float3x4& b)
+{
+	Float3x4 r = { _mm_sub_ps(a.x, b.x), _mm_sub_ps(a.y, b.y), _mm_sub_ps(a.z, b.z) };
+	return r;
+}
+
+static inline Float3x4 Mul3(const Float3x4& a, const Float3x4& b)
+{
+	Float3x4 r = { _mm_mul_ps(a.x, b.x), _mm_mul_ps(a.y, b.y), _mm_mul_ps(a.z, b.z) };
+	return r;
+}
+
+static inline Float3x4 Scale3(const Float3x4& a, __m128 s)
+{
+	Float3x4 r = { _mm_mul_ps(a.x, s), _mm_mul_ps(a.y, s), _mm_mul_ps(a.z, s) };
+	return r;
+}
+
+static inline __m128 Dot3(const Float3x4& a, const Float3x4& b)
+{
+	return _mm_add_ps(_mm_add_ps(_mm_mul_ps(a.x, b.x), _mm_mul_ps(a.y, b.y)), _mm_mul_ps(a.z, b.z));
+}
+
+static inline Float3x4 Cross3(const Float3x4& a, const Float3x4& b)
+{
+	Float3x4 r =
+	{
+		_mm_sub_ps(_mm_mul_ps(a.y, b.z), _mm_mul_ps(a.z, b.y)),
+		_mm_sub_ps(_mm_mul_ps(a.z, b.x), _mm_mul_ps(a.x, b.z)),
+		_mm_sub_ps(_mm_mul_ps(a.x, b.y), _mm_mul_ps(a.y, b.x)),
+	};
+	return r;
+}
+
+// Zero length vectors stay (close to) zero rather than going NaN
+static inline Float3x4 Normalize3(const Float3x4& a)
+{
+	__m128 length = _mm_sqrt_ps(Dot3(a, a));
+	return Scale3(a, _mm_div_ps(_mm_set1_ps(1.0f), _mm_max_ps(length, _mm_set1_ps(1e-12f))));
+}
+
+static inline __m128 Saturate(__m128 v)
+{
+	return _mm_min_ps(_mm_max_ps(v, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+}
+
+static inline __m128 Select(__m128 mask, __m128 a, __m128 b)
+{
+	return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+// A triangle plane at 4 pixel centers
+static inline __m128 Plane(const float* plane, __m128 px, __m128 py)
+{
+	return _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane[0]), px), _mm_mul_ps(_mm_set1_ps(plane[1]), py)), _mm_set1_ps(plane[2]));
+}
+
+// --------------------------------------------------------
+// Texture sampling, one pixel at a time - the texels of
+// neighbouring pixels aren't neighbours in memory, so there
+// is nothing for SSE to load in one go.  Each texel's
+// channels are decoded through a table into a register, and
+// the filter weights them all at once.
+// --------------------------------------------------------
+static inline __m128 FetchTexel(const unsigned char* t, unsigned int channels, const float* const* decode)
+{
+	switch (channels)
+	{
+	case 4: return _mm_setr_ps(decode[0][t[0]], decode[1][t[1]], decode[2][t[2]], decode[3][t[3]]);
+	case 2: return _mm_setr_ps(decode[0][t[0]], decode[1][t[1]], 0, 0);
+	case 1: return _mm_setr_ps(decode[0][t[0]], 0, 0, 0);
+	default: return _mm_setr_ps(decode[0][t[0]], decode[1][t[1]], decode[2][t[2]], 0);
+	}
+}
+
+static __m128 SampleBilinear(const SoftwareTexture& tex, unsigned int mip, float u, float v)
+{
+	// Mip m starts after 1 + 1/4 + ... of the top level, which
+	// sums to 4/3 of the difference in area
+	unsigned int size = tex.size >> mip;
+	size_t offset = ((size_t)tex.size * tex.size - (size_t)size * size) / 3 * 4;
+	const unsigned char* texels = tex.texels + offset * tex.channels;
+
+	// Wrapped to [0, 1) first, so large uvs can't overflow
+	float fx = (u - floorf(u)) * size - 0.5f;
+	float fy = (v - floorf(v)) * size - 0.5f;
+	float lx = floorf(fx);
+	float ly = floorf(fy);
+	float tx = fx - lx;
+	float ty = fy - ly;
+
+	unsigned int mask = size - 1;
+	unsigned int x0 = (unsigned int)(int)lx & mask, x1 = (x0 + 1) & mask;
+	unsigned int y0 = (unsigned int)(int)ly & mask, y1 = (y0 + 1) & mask;
+
+	const float* linear = tex.srgb ? srgbToLinear : unormToFloat;
+	const float* decode[4] = { linear, linear, linear, unormToFloat };
+	__m128 t00 = FetchTexel(texels + (y0 * size + x0) * tex.channels, tex.channels, decode);
+	__m128 t10 = FetchTexel(texels + (y0 * size + x1) * tex.channels, tex.channels, decode);
+	__m128 t01 = FetchTexel(texels + (y1 * size + x0) * tex.channels, tex.channels, decode);
+	__m128 t11 = FetchTexel(texels + (y1 * size + x1) * tex.channels, tex.channels, decode);
+
+	__m128 wx = _mm_set1_ps(tx);
+	__m128 top = _mm_add_ps(t00, _mm_mul_ps(_mm_sub_ps(t10, t00), wx));
+	__m128 bottom = _mm_add_ps(t01, _mm_mul_ps(_mm_sub_ps(t11, t01), wx));
+	return _mm_add_ps(top, _mm_mul_ps(_mm_sub_ps(bottom, top), _mm_set1_ps(ty)));
+}
+
+// Between the two mips around lod, as MIN_MAG_MIP_LINEAR does
+static __m128 SampleTrilinear(const SoftwareTexture& tex, float u, float v, float lod)
+{
+	float last = (float)(tex.mipLevels - 1);
+	if (!(lod > 0.0f))
+		return SampleBilinear(tex, 0, u, v);
+	if (lod >= last)
+		return SampleBilinear(tex, tex.mipLevels - 1, u, v);
+
+	unsigned int mip = (unsigned int)lod;
+	__m128 fine = SampleBilinear(tex, mip, u, v);
+	__m128 coarse = SampleBilinear(tex, mip + 1, u, v);
+	return _mm_add_ps(fine, _mm_mul_ps(_mm_sub_ps(coarse, fine), _mm_set1_ps(lod - mip)));
+}
+
+// Samples the covered lanes of a group into a register per
+// channel.  lodBase is log2 of the uv footprint, without the
+// texture's size.
+static void SampleLanes(const SoftwareTexture& tex, const float* u, const float* v, const float* lodBase, int mask, __m128* channels)
+{
+	float sizeLog2 = log2f((float)tex.size);
+	__m128 lanes[4];
+	for (int lane = 0; lane < 4; lane++)
+		lanes[lane] = (mask & (1 << lane)) ? SampleTrilinear(tex, u[lane], v[lane], lodBase[lane] + sizeLog2) : _mm_setzero_ps();
+
+	// Texel per register to channel per register
+	_MM_TRANSPOSE4_PS(lanes[0], lanes[1], lanes[2], lanes[3]);
+	for (unsigned int c = 0; c < 4; c++)
+		channels[c] = lanes[c];
+}
+
+// --------------------------------------------------------
+// MaterialPS.hlsl's BRDF, 4 pixels at a time
+// --------------------------------------------------------
+struct SurfaceLanes
+{
+	Float3x4 normal;
+	Float3x4 toCam;
+	Float3x4 albedo;
+	Float3x4 specColor;
+	__m128 metal;
+	__m128 NdotV;		// Unsaturated, for the BRDF denominator
+	__m128 a2;
+	__m128 k;
+	__m128 shadowingV;
+};
+
+static inline __m128 GeometricShadowing(__m128 NdotX, __m128 k)
+{
+	__m128 one = _mm_set1_ps(1.0f);
+	return _mm_div_ps(NdotX, _mm_add_ps(_mm_mul_ps(NdotX, _mm_sub_ps(one, k)), k));
+}
+
+// ShadeLight(): Lambert diffuse plus GGX, Schlick Fresnel and
+// Schlick-GGX shadowing, adding into color.  l is normalized.
+static inline void ShadeLight(const SurfaceLanes& s, const Float3x4& l, const Float3x4& lightColor, Float3x4& color)
+{
+	__m128 one = _mm_set1_ps(1.0f);
+	Float3x4 h = Normalize3(Add3(s.toCam, l));
+	__m128 NdotL = Dot3(s.normal, l);
+	__m128 diffuse = Saturate(NdotL);
+
+	__m128 NdotH = Saturate(Dot3(s.normal, h));
+	__m128 denomToSquare = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(NdotH, NdotH), _mm_sub_ps(s.a2, one)), one);
+	__m128 D = _mm_div_ps(s.a2, _mm_mul_ps(_mm_set1_ps(PI), _mm_mul_ps(denomToSquare, denomToSquare)));
+
+	__m128 VdotH = Saturate(Dot3(s.toCam, h));
+	__m128 f = _mm_sub_ps(one, VdotH);
+	__m128 f2 = _mm_mul_ps(f, f);
+	__m128 f5 = _mm_mul_ps(_mm_mul_ps(f2, f2), f);
+	Float3x4 F =
+	{
+		_mm_add_ps(s.specColor.x, _mm_mul_ps(_mm_sub_ps(one, s.specColor.x), f5)),
+		_mm_add_ps(s.specColor.y, _mm_mul_ps(_mm_sub_ps(one, s.specColor.y), f5)),
+		_mm_add_ps(s.specColor.z, _mm_mul_ps(_mm_sub_ps(one, s.specColor.z), f5)),
+	};
+
+	__m128 G = _mm_mul_ps(s.shadowingV, GeometricShadowing(diffuse, s.k));
+
+	// The shader divides by this as is; kept off zero here so a
+	// grazing pixel can't turn NaN
+	__m128 denom = _mm_max_ps(_mm_mul_ps(_mm_set1_ps(4.0f), _mm_max_ps(s.NdotV, NdotL)), _mm_set1_ps(1e-6f));
+	Float3x4 specularity = Scale3(F, _mm_div_ps(_mm_mul_ps(D, G), denom));
+
+	// DiffuseEnergyConserve()
+	__m128 notMetal = _mm_sub_ps(one, s.metal);
+	Float3x4 balanced =
+	{
+		_mm_mul_ps(diffuse, _mm_mul_ps(_mm_sub_ps(one, Saturate(specularity.x)), notMetal)),
+		_mm_mul_ps(diffuse, _mm_mul_ps(_mm_sub_ps(one, Saturate(specularity.y)), notMetal)),
+		_mm_mul_ps(diffuse, _mm_mul_ps(_mm_sub_ps(one, Saturate(specularity.z)), notMetal)),
+	};
+
+	color = Add3(color, Mul3(Add3(Mul3(balanced, s.albedo), specularity), lightColor));
+}
+
+// --------------------------------------------------------
+// MaterialPS.hlsl's main() for the covered lanes of a group
+// of 4 pixels, with the triangle's planes standing in for the
+// interpolators.  Returns linear color.
+// --------------------------------------------------------
+static Float3x4 ShadePixels(const float (*planes)[3], const SoftwareMaterial& material, const SoftwareFrame& frame,
+	const unsigned int* lights, unsigned int lightCount, __m128 px, __m128 py, int mask)
+{
+	__m128 one = _mm_set1_ps(1.0f);
+	__m128 zero = _mm_setzero_ps();
+
+	// Perspective correct attributes: each plane holds the value
+	// over w, and 1/w is interpolated alongside to divide it back
+	__m128 pw = Plane(planes[PLANE_W], px, py);
+	__m128 w = _mm_div_ps(one, pw);
+
+	Float3x4 worldPos =
+	{
+		_mm_mul_ps(Plane(planes[PLANE_WORLD + 0], px, py), w),
+		_mm_mul_ps(Plane(planes[PLANE_WORLD + 1], px, py), w),
+		_mm_mul_ps(Plane(planes[PLANE_WORLD + 2], px, py), w),
+	};
+	Float3x4 n =
+	{
+		_mm_mul_ps(Plane(planes[PLANE_NORMAL + 0], px, py), w),
+		_mm_mul_ps(Plane(planes[PLANE_NORMAL + 1], px, py), w),
+		_mm_mul_ps(Plane(planes[PLANE_NORMAL + 2], px, py), w),
+	};
+	n = Normalize3(n);
+
+	// The uvs here and one pixel right and down, for the mip level
+	// - the derivatives a quad of pixels would give the GPU
+	__m128 pu = Plane(planes[PLANE_UV + 0], px, py);
+	__m128 pv = Plane(planes[PLANE_UV + 1], px, py);
+	__m128 u = _mm_mul_ps(pu, w);
+	__m128 v = _mm_mul_ps(pv, w);
+
+	__m128 wRight = _mm_div_ps(one, _mm_add_ps(pw, _mm_set1_ps(planes[PLANE_W][0])));
+	__m128 wDown = _mm_div_ps(one, _mm_add_ps(pw, _mm_set1_ps(planes[PLANE_W][1])));
+	__m128 dux = _mm_sub_ps(_mm_mul_ps(_mm_add_ps(pu, _mm_set1_ps(planes[PLANE_UV + 0][0])), wRight), u);
+	__m128 dvx = _mm_sub_ps(_mm_mul_ps(_mm_add_ps(pv, _mm_set1_ps(planes[PLANE_UV + 1][0])), wRight), v);
+	__m128 duy = _mm_sub_ps(_mm_mul_ps(_mm_add_ps(pu, _mm_set1_ps(planes[PLANE_UV + 0][1])), wDown), u);
+	__m128 dvy = _mm_sub_ps(_mm_mul_ps(_mm_add_ps(pv, _mm_set1_ps(planes[PLANE_UV + 1][1])), wDown), v);
+	__m128 rho2 = _mm_max_ps(
+		_mm_add_ps(_mm_mul_ps(dux, dux), _mm_mul_ps(dvx, dvx)),
+		_mm_add_ps(_mm_mul_ps(duy, duy), _mm_mul_ps(dvy, dvy)));
+
+	float uLanes[4], vLanes[4], rhoLanes[4], lodLanes[4];
+	_mm_storeu_ps(uLanes, u);
+	_mm_storeu_ps(vLanes, v);
+	_mm_storeu_ps(rhoLanes, rho2);
+	for (int lane = 0; lane < 4; lane++)
+		lodLanes[lane] = (mask & (1 << lane)) ? 0.5f * log2f(rhoLanes[lane]) : 0.0f;
+
+	if (material.normal.texels)
+	{
+		//tangent space normals always face out, so z is the positive root
+		__m128 packed[4];
+		SampleLanes(material.normal, uLanes, vLanes, lodLanes, mask, packed);
+		__m128 two = _mm_set1_ps(2.0f);
+		__m128 nx = _mm_sub_ps(_mm_mul_ps(packed[0], two), one);
+		__m128 ny = _mm_sub_ps(_mm_mul_ps(packed[1], two), one);
+		__m128 nz = _mm_sqrt_ps(Saturate(_mm_sub_ps(one, _mm_add_ps(_mm_mul_ps(nx, nx), _mm_mul_ps(ny, ny)))));
+
+		Float3x4 t =
+		{
+			_mm_mul_ps(Plane(planes[PLANE_TANGENT + 0], px, py), w),
+			_mm_mul_ps(Plane(planes[PLANE_TANGENT + 1], px, py), w),
+			_mm_mul_ps(Plane(planes[PLANE_TANGENT + 2], px, py), w),
+		};
+		t = Normalize3(Sub3(t, Scale3(n, Dot3(t, n))));
+		Float3x4 b = Cross3(t, n);
+
+		n = Normalize3(Add3(Add3(Scale3(t, nx), Scale3(b, ny)), Scale3(n, nz)));
+	}
+
+	Float3x4 albedo;
+	if (material.albedo.texels)
+	{
+		__m128 texel[4];
+		SampleLanes(material.albedo, uLanes, vLanes, lodLanes, mask, texel);
+		albedo.x = texel[0];
+		albedo.y = texel[1];
+		albedo.z = texel[2];
+	}
+	else
+	{
+		albedo = Set3(material.color.x, material.color.y, material.color.z);
+	}
+
+	__m128 roughness, metal;
+	if (material.surface.texels)
+	{
+		// Ambient occlusion only darkens the image based light,
+		// which isn't drawn here
+		__m128 texel[4];
+		SampleLanes(material.surface, uLanes, vLanes, lodLanes, mask, texel);
+		roughness = texel[0];
+		metal = texel[1];
+	}
+	else
+	{
+		roughness = _mm_set1_ps(material.roughness);
+		metal = _mm_set1_ps(material.metalness);
+	}
+
+	const XMFLOAT3& cameraPos = frame.lights.cameraPos;
+
+	// MakeSurfacePoint()
+	SurfaceLanes s;
+	s.normal = n;
+	s.toCam = Normalize3(Sub3(Set3(cameraPos.x, cameraPos.y, cameraPos.z), worldPos));
+	s.albedo = albedo;
+	s.specColor.x = _mm_add_ps(_mm_set1_ps(F0_NON_METAL), _mm_mul_ps(_mm_sub_ps(albedo.x, _mm_set1_ps(F0_NON_METAL)), metal));
+	s.specColor.y = _mm_add_ps(_mm_set1_ps(F0_NON_METAL), _mm_mul_ps(_mm_sub_ps(albedo.y, _mm_set1_ps(F0_NON_METAL)), metal));
+	s.specColor.z = _mm_add_ps(_mm_set1_ps(F0_NON_METAL), _mm_mul_ps(_mm_sub_ps(albedo.z, _mm_set1_ps(F0_NON_METAL)), metal));
+	s.metal = metal;
+
+	__m128 a = _mm_mul_ps(roughness, roughness);
+	s.a2 = _mm_max_ps(_mm_mul_ps(a, a), _mm_set1_ps(MIN_ROUGHNESS));
+	__m128 r1 = _mm_add_ps(roughness, one);
+	s.k = _mm_mul_ps(_mm_mul_ps(r1, r1), _mm_set1_ps(1.0f / 8.0f));
+	s.NdotV = Dot3(n, s.toCam);
+	s.shadowingV = GeometricShadowing(Saturate(s.NdotV), s.k);
+
+	Float3x4 color = { zero, zero, zero };
+
+	//the shader uses each light's ambient color as its color
+	for (unsigned int d = 0; d < frame.dirLightCount; d++)
+	{
+		const DirectionalLight& light = frame.lights.dirLights[d];
+		ShadeLight(s, Set3(-light.direction.x, -light.direction.y, -light.direction.z),
+			Set3(light.ambientColor.x, light.ambientColor.y, light.ambientColor.z), color);
+	}
+
+	for (unsigned int p = 0; p < frame.pointLightCount; p++)
+	{
+		const PointLight& light = frame.lights.pointLights[p];
+		Float3x4 toLight = Normalize3(Sub3(Set3(light.position.x, light.position.y, light.position.z), worldPos));
+		ShadeLight(s, toLight, Set3(light.ambientColor.x, light.ambientColor.y, light.ambientColor.z), color);
+	}
+
+	//only the cluster lights binned into this tile, fading out at their range
+	__m128 covered = _mm_castsi128_ps(_mm_cmpgt_epi32(
+		_mm_and_si128(_mm_set1_epi32(mask), _mm_setr_epi32(1, 2, 4, 8)), _mm_setzero_si128()));
+	for (unsigned int i = 0; i < lightCount; i++)
+	{
+		const ClusterLight& light = frame.clusterLights[lights[i]];
+		Float3x4 toLight = Sub3(Set3(light.position.x, light.position.y, light.position.z), worldPos);
+		__m128 dist2 = Dot3(toLight, toLight);
+
+		__m128 atten = Saturate(_mm_sub_ps(one, _mm_div_ps(dist2, _mm_set1_ps(light.range * light.range))));
+		if (_mm_movemask_ps(_mm_and_ps(_mm_cmpgt_ps(atten, zero), covered)) == 0)
+			continue;
+		atten = _mm_mul_ps(_mm_mul_ps(atten, atten), _mm_set1_ps(light.intensity));
+
+		__m128 dist = _mm_max_ps(_mm_sqrt_ps(dist2), _mm_set1_ps(0.0001f));
+		Float3x4 l = Scale3(toLight, _mm_div_ps(one, dist));
+		ShadeLight(s, l, Scale3(Set3(light.color.x, light.color.y, light.color.z), atten), color);
+	}
+
+	return color;
+}
+
+SoftwareRasterizer::SoftwareRasterizer(unsigned int width, unsigned int height, unsigned int threadCount)
+	: pool(1)
+{
+	BuildTables();
+
+	this->width = 0;
+	this->height = 0;
+	tilesX = 0;
+	tilesY = 0;
+	pitch = 0;
+	triangleCount = 0;
+	memset(&frame, 0, sizeof(frame));
+	memset(&stats, 0, sizeof(stats));
+	XMStoreFloat4x4(&viewProj, XMMatrixIdentity());
+
+	SetThreadCount(threadCount);
+
+	Resize(width, height);
+}
+
+// --------------------------------------------------------
+// The float buffers are padded out to whole tiles, so every
+// tile is drawn (and cleared) the same way; only the resolve
+// stops at the frame's edge
+// --------------------------------------------------------
+void SoftwareRasterizer::Resize(unsigned int width, unsigned int height)
+{
+	this->width = width > 0 ? width : 1;
+	this->height = height > 0 ? height : 1;
+	tilesX = (this->width + SOFTWARE_TILE_SIZE - 1) / SOFTWARE_TILE_SIZE;
+	tilesY = (this->height + SOFTWARE_TILE_SIZE - 1) / SOFTWARE_TILE_SIZE;
+	pitch = tilesX * SOFTWARE_TILE_SIZE;
+
+	size_t padded = (size_t)pitch * tilesY * SOFTWARE_TILE_SIZE;
+	depth.assign(padded, 1.0f);
+	for (unsigned int c = 0; c < 3; c++)
+		color[c].assign(padded, 0.0f);
+	pixels.assign((size_t)this->width * this->height * 4, 0);
+	tileLights.assign(tilesX * tilesY, std::vector<unsigned int>());
+}
+
+// --------------------------------------------------------
+// Restarts the pool with this many threads
+// --------------------------------------------------------
+void SoftwareRasterizer::SetThreadCount(unsigned int count)
+{
+	pool.SetThreadCount(count);
+	scratch.assign(pool.GetThreadCount(), ThreadScratch());
+	for (auto& s : scratch)
+		s.ids.resize(SOFTWARE_TILE_SIZE * SOFTWARE_TILE_SIZE);
+}
+
+// --------------------------------------------------------
+// Runs a stage's jobs across the pool and waits for them all.
+// A thread that drew empty tiles moves on to the next job
+// rather than waiting on a fixed share.
+// --------------------------------------------------------
+void SoftwareRasterizer::RunStage(Stage stage, unsigned int jobs)
+{
+	pool.ParallelFor(jobs, [&](unsigned int job, unsigned int thread)
+	{
+		switch (stage)
+		{
+		case STAGE_VERTICES: ShadeVertices(job); break;
+		case STAGE_BIN: BinRun(job); break;
+		case STAGE_RASTER: DrawTile(job, scratch[thread]); break;
+		case STAGE_RESOLVE: ResolveTileRow(job); break;
+		}
+	});
+}
+
+void SoftwareRasterizer::BeginFrame(const SoftwareFrame& frame)
+{
+	this->frame = frame;
+
+	unsigned int maxDir = sizeof(frame.lights.dirLights) / sizeof(frame.lights.dirLights[0]);
+	unsigned int maxPoint = sizeof(frame.lights.pointLights) / sizeof(frame.lights.pointLights[0]);
+	if (this->frame.dirLightCount > maxDir) this->frame.dirLightCount = maxDir;
+	if (this->frame.pointLightCount > maxPoint) this->frame.pointLightCount = maxPoint;
+	if (!frame.clusterLights) this->frame.clusterLightCount = 0;
+
+	XMStoreFloat4x4(&viewProj, XMMatrixMultiply(XMLoadFloat4x4(&frame.view), XMLoadFloat4x4(&frame.proj)));
+	draws.clear();
+}
+
+void SoftwareRasterizer::Submit(const SoftwareDraw& draw)
+{
+	if (!draw.vertices || !draw.indices || draw.indexCount < 3)
+		return;
+
+	draws.push_back(draw);
+	if (!draw.material)
+		draws.back().material = &defaultMaterial;
+}
+
+void SoftwareRasterizer::EndFrame()
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	unsigned int tileCount = tilesX * tilesY;
+	unsigned int drawCount = (unsigned int)draws.size();
+	memset(&stats, 0, sizeof(stats));
+	stats.draws = drawCount;
+	stats.tiles = tileCount;
+	stats.threads = pool.GetThreadCount();
+
+	// Where each draw's vertices and triangles start in the frame's
+	drawVertexStart.resize(drawCount + 1);
+	drawTriangleStart.resize(drawCount + 1);
+	drawVertexStart[0] = 0;
+	drawTriangleStart[0] = 0;
+	for (unsigned int d = 0; d < drawCount; d++)
+	{
+		drawVertexStart[d + 1] = drawVertexStart[d] + draws[d].vertexCount;
+		drawTriangleStart[d + 1] = drawTriangleStart[d] + draws[d].indexCount / 3;
+	}
+	triangleCount = drawTriangleStart[drawCount];
+	stats.triangles = triangleCount;
+
+	shadedVertices.resize(drawVertexStart[drawCount]);
+	RunStage(STAGE_VERTICES, drawCount);
+	auto verticesDone = std::chrono::high_resolution_clock::now();
+
+	// Enough runs to keep every thread busy, but not so many the
+	// bins cost more to walk than the triangles in them
+	unsigned int runCount = (triangleCount + SOFTWARE_MIN_RUN_TRIANGLES - 1) / SOFTWARE_MIN_RUN_TRIANGLES;
+	if (runCount > pool.GetThreadCount() * 2)
+		runCount = pool.GetThreadCount() * 2;
+	if (runCount < 1)
+		runCount = 1;
+	runs.resize(runCount);
+	for (Run& run : runs)
+	{
+		if (run.bins.size() != tileCount)
+			run.bins.assign(tileCount, std::vector<unsigned int>());
+	}
+
+	RunStage(STAGE_BIN, runCount);
+	BinLights();
+
+	for (Run& run : runs)
+	{
+		stats.trianglesClipped += run.clipped;
+		stats.trianglesCulled += run.culled;
+		for (auto& bin : run.bins)
+			stats.binEntries += (unsigned int)bin.size();
+	}
+	auto binDone = std::chrono::high_resolution_clock::now();
+
+	for (ThreadScratch& s : scratch)
+	{
+		s.pixelsCovered = 0;
+		s.pixelsShaded = 0;
+	}
+	RunStage(STAGE_RASTER, tileCount);
+	for (ThreadScratch& s : scratch)
+	{
+		stats.pixelsCovered += s.pixelsCovered;
+		stats.pixelsShaded += s.pixelsShaded;
+	}
+	auto rasterDone = std::chrono::high_resolution_clock::now();
+
+	RunStage(STAGE_RESOLVE, tilesY);
+	auto end = std::chrono::high_resolution_clock::now();
+
+	stats.vertexMilliseconds = std::chrono::duration<double, std::milli>(verticesDone - start).count();
+	stats.binMilliseconds = std::chrono::duration<double, std::milli>(binDone - verticesDone).count();
+	stats.rasterMilliseconds = std::chrono::duration<double, std::milli>(rasterDone - binDone).count();
+	stats.resolveMilliseconds = std::chrono::duration<double, std::milli>(end - rasterDone).count();
+	stats.totalMilliseconds = std::chrono::duration<double, std::milli>(end - start).count();
+
+	draws.clear();
+}
+
+// --------------------------------------------------------
+// MaterialVS.hlsl: positions to clip space, normals through
+// the world matrix's inverse transpose and tangents through
+// the world matrix
+// --------------------------------------------------------
+void SoftwareRasterizer::ShadeVertices(unsigned int d)
+{
+	const SoftwareDraw& draw = draws[d];
+	XMMATRIX world = XMLoadFloat4x4(&draw.world);
+	XMMATRIX worldViewProj = XMMatrixMultiply(world, XMLoadFloat4x4(&viewProj));
+	XMMATRIX normalWorld = XMMatrixTranspose(XMMatrixInverse(0, world));
+
+	ShadedVertex* out = &shadedVertices[drawVertexStart[d]];
+	for (unsigned int i = 0; i < draw.vertexCount; i++)
+	{
+		const Vertex& v = draw.vertices[i];
+		XMVECTOR position = XMLoadFloat3(&v.Position);
+		XMStoreFloat4(&out[i].position, XMVector3Transform(position, worldViewProj));
+		XMStoreFloat3(&out[i].worldPos, XMVector3Transform(position, world));
+		XMStoreFloat3(&out[i].normal, XMVector3Normalize(XMVector3TransformNormal(XMLoadFloat3(&v.normal), normalWorld)));
+		out[i].uv = v.uv;
+		XMStoreFloat3(&out[i].tangent, XMVector3Normalize(XMVector3TransformNormal(XMLoadFloat3(&v.tangent), world)));
+	}
+}
+
+// --------------------------------------------------------
+// Sets up and bins this run's share of the frame's triangles,
+// which are numbered across the draws in submission order
+// --------------------------------------------------------
+void SoftwareRasterizer::BinRun(unsigned int r)
+{
+	Run& run = runs[r];
+	run.triangles.clear();
+	for (auto& bin : run.bins)
+		bin.clear();
+	run.clipped = 0;
+	run.culled = 0;
+
+	unsigned int runCount = (unsigned int)runs.size();
+	unsigned int first = (unsigned int)((uint64_t)triangleCount * r / runCount);
+	unsigned int end = (unsigned int)((uint64_t)triangleCount * (r + 1) / runCount);
+	if (first >= end)
+		return;
+
+	// The last draw starting at or before the first triangle
+	unsigned int d = (unsigned int)(std::upper_bound(drawTriangleStart.begin(), drawTriangleStart.end(), first) - drawTriangleStart.begin()) - 1;
+	for (unsigned int t = first; t < end; t++)
+	{
+		while (t >= drawTriangleStart[d + 1])
+			d++;
+
+		const SoftwareDraw& draw = draws[d];
+		const unsigned int* index = draw.indices + (t - drawTriangleStart[d]) * 3;
+		if (index[0] >= draw.vertexCount || index[1] >= draw.vertexCount || index[2] >= draw.vertexCount)
+		{
+			run.culled++;
+			continue;
+		}
+
+		const ShadedVertex* base = &shadedVertices[drawVertexStart[d]];
+		const ShadedVertex* v0 = base + index[0];
+		const ShadedVertex* v1 = base + index[1];
+		const ShadedVertex* v2 = base + index[2];
+		const XMFLOAT4& a = v0->position;
+		const XMFLOAT4& b = v1->position;
+		const XMFLOAT4& c = v2->position;
+
+		// Wholly outside one of the frustum's planes
+		if ((a.x > a.w && b.x > b.w && c.x > c.w) || (a.x < -a.w && b.x < -b.w && c.x < -c.w) ||
+			(a.y > a.w && b.y > b.w && c.y > c.w) || (a.y < -a.w && b.y < -b.w && c.y < -c.w) ||
+			(a.z > a.w && b.z > b.w && c.z > c.w) || (a.z < 0 && b.z < 0 && c.z < 0))
+		{
+			run.culled++;
+			continue;
+		}
+
+		if (a.z < 0 || b.z < 0 || c.z < 0)
+		{
+			run.clipped++;
+			ClipTriangle(run, v0, v1, v2, draw.material);
+		}
+		else
+		{
+			const ShadedVertex* v[3] = { v0, v1, v2 };
+			SetupTriangle(run, v, draw.material);
+		}
+	}
+}
+
+// --------------------------------------------------------
+// Clips a triangle to the near plane (z >= 0), interpolating
+// every attribute in clip space, and sets up what's left
+// --------------------------------------------------------
+void SoftwareRasterizer::ClipTriangle(Run& run, const ShadedVertex* v0, const ShadedVertex* v1, const ShadedVertex* v2, const SoftwareMaterial* material)
+{
+	static const unsigned int floats = sizeof(ShadedVertex) / sizeof(float);
+	const ShadedVertex* in[3] = { v0, v1, v2 };
+	ShadedVertex poly[4];
+	unsigned int count = 0;
+
+	// Sutherland-Hodgman against the one plane - a triangle
+	// clipped by a plane has at most 4 vertices
+	for (unsigned int i = 0; i < 3; i++)
+	{
+		const ShadedVertex& cur = *in[i];
+		const ShadedVertex& next = *in[(i + 1) % 3];
+
+		if (cur.position.z >= 0)
+			poly[count++] = cur;
+
+		if ((cur.position.z >= 0) != (next.position.z >= 0))
+		{
+			float t = cur.position.z / (cur.position.z - next.position.z);
+			const float* a = &cur.position.x;
+			const float* b = &next.position.x;
+			float* out = &poly[count++].position.x;
+			for (unsigned int f = 0; f < floats; f++)
+				out[f] = a[f] + (b[f] - a[f]) * t;
+		}
+	}
+
+	if (count < 3)
+		return;
+
+	const ShadedVertex* first[3] = { &poly[0], &poly[1], &poly[2] };
+	SetupTriangle(run, first, material);
+	if (count == 4)
+	{
+		const ShadedVertex* second[3] = { &poly[0], &poly[2], &poly[3] };
+		SetupTriangle(run, second, material);
+	}
+}
+
+// --------------------------------------------------------
+// Projects a triangle to pixels, culls it if it faces away
+// or misses every pixel center, then works out its edges and
+// planes and bins it into the tiles it touches
+// --------------------------------------------------------
+bool SoftwareRasterizer::SetupTriangle(Run& run, const ShadedVertex* const* v, const SoftwareMaterial* material)
+{
+	float x[3], y[3], invW[3];
+	for (unsigned int i = 0; i < 3; i++)
+	{
+		invW[i] = 1.0f / v[i]->position.w;
+		x[i] = (v[i]->position.x * invW[i] * 0.5f + 0.5f) * width;
+		y[i] = (0.5f - v[i]->position.y * invW[i] * 0.5f) * height;
+	}
+
+	// Clockwise on screen faces the camera, as the pipeline
+	// states' back face culling has it.  Also drops degenerate
+	// (and NaN) triangles.
+	float area = (x[1] - x[0]) * (y[2] - y[0]) - (y[1] - y[0]) * (x[2] - x[0]);
+	if (!(area > 0))
+	{
+		run.culled++;
+		return false;
+	}
+
+	// Pixels whose centers could be inside, clamped to the
+	// screen before converting so far off vertices can't overflow
+	float minX = fmaxf(fminf(x[0], fminf(x[1], x[2])) - 0.5f, 0.0f);
+	float maxX = fminf(fmaxf(x[0], fmaxf(x[1], x[2])) - 0.5f, width - 1.0f);
+	float minY = fmaxf(fminf(y[0], fminf(y[1], y[2])) - 0.5f, 0.0f);
+	float maxY = fminf(fmaxf(y[0], fmaxf(y[1], y[2])) - 0.5f, height - 1.0f);
+	int x0 = (int)ceilf(minX), x1 = (int)floorf(maxX);
+	int y0 = (int)ceilf(minY), y1 = (int)floorf(maxY);
+	if (x0 > x1 || y0 > y1)
+	{
+		run.culled++;
+		return false;
+	}
+
+	run.triangles.push_back(Triangle());
+	Triangle& tri = run.triangles.back();
+	tri.minX = x0;
+	tri.maxX = x1;
+	tri.minY = y0;
+	tri.maxY = y1;
+	tri.material = material;
+
+	// Edge i is opposite vertex i: E(x, y) = A * x + B * y + C.
+	// Pixels exactly on an edge belong to the triangle on its
+	// top or left side, so shared edges are only drawn once.
+	for (unsigned int i = 0; i < 3; i++)
+	{
+		unsigned int j = (i + 1) % 3, k = (i + 2) % 3;
+		float A = y[j] - y[k];
+		float B = x[k] - x[j];
+		tri.edges[i][0] = A;
+		tri.edges[i][1] = B;
+		tri.edges[i][2] = -(A * x[j] + B * y[j]);
+		tri.topLeft[i] = A > 0 || (A == 0 && B > 0);
+	}
+
+	// Each plane is its values at the vertices weighted by the
+	// barycentrics, which are the edge functions over the area
+	float values[SOFTWARE_PLANE_COUNT][3];
+	for (unsigned int i = 0; i < 3; i++)
+	{
+		values[PLANE_Z][i] = v[i]->position.z * invW[i];
+		values[PLANE_W][i] = invW[i];
+		const float* attributes = &v[i]->worldPos.x;
+		for (unsigned int p = PLANE_WORLD; p < SOFTWARE_PLANE_COUNT; p++)
+			values[p][i] = attributes[p - PLANE_WORLD] * invW[i];
+	}
+
+	float invArea = 1.0f / area;
+	for (unsigned int p = 0; p < SOFTWARE_PLANE_COUNT; p++)
+	{
+		for (unsigned int c = 0; c < 3; c++)
+			tri.planes[p][c] = (tri.edges[0][c] * values[p][0] + tri.edges[1][c] * values[p][1] + tri.edges[2][c] * values[p][2]) * invArea;
+	}
+
+	// Into every tile of its bounds that isn't wholly outside one
+	// of its edges - tested at the tile's pixel center farthest
+	// along the edge's inside
+	unsigned int index = (unsigned int)run.triangles.size() - 1;
+	unsigned int tx0 = x0 / SOFTWARE_TILE_SIZE, tx1 = x1 / SOFTWARE_TILE_SIZE;
+	unsigned int ty0 = y0 / SOFTWARE_TILE_SIZE, ty1 = y1 / SOFTWARE_TILE_SIZE;
+	bool oneTile = tx0 == tx1 && ty0 == ty1;
+	for (unsigned int ty = ty0; ty <= ty1; ty++)
+	{
+		for (unsigned int tx = tx0; tx <= tx1; tx++)
+		{
+			if (!oneTile)
+			{
+				float left = tx * SOFTWARE_TILE_SIZE + 0.5f, right = left + SOFTWARE_TILE_SIZE - 1;
+				float top = ty * SOFTWARE_TILE_SIZE + 0.5f, bottom = top + SOFTWARE_TILE_SIZE - 1;
+				bool outside = false;
+				for (unsigned int e = 0; e < 3 && !outside; e++)
+				{
+					const float* edge = tri.edges[e];
+					float px = edge[0] > 0 ? right : left;
+					float py = edge[1] > 0 ? bottom : top;
+					outside = edge[0] * px + edge[1] * py + edge[2] < 0;
+				}
+				if (outside)
+					continue;
+			}
+			run.bins[ty * tilesX + tx].push_back(index);
+		}
+	}
+	return true;
+}
+
+// --------------------------------------------------------
+// Adds each cluster light to the tiles its sphere's screen
+// bounds cover.  In view space x/z and y/z are extreme at
+// the corners of the sphere's box, as LightClusters bins
+// them; spheres reaching behind the camera cover everything.
+// --------------------------------------------------------
+void SoftwareRasterizer::BinLights()
+{
+	for (auto& list : tileLights)
+		list.clear();
+
+	XMMATRIX view = XMLoadFloat4x4(&frame.view);
+	for (unsigned int i = 0; i < frame.clusterLightCount; i++)
+	{
+		const ClusterLight& light = frame.clusterLights[i];
+		XMFLOAT3 c;
+		XMStoreFloat3(&c, XMVector3Transform(XMLoadFloat3(&light.position), view));
+		float r = light.range;
+		if (c.z + r <= 0)
+			continue;
+
+		unsigned int tx0 = 0, tx1 = tilesX - 1, ty0 = 0, ty1 = tilesY - 1;
+		float zNear = c.z - r, zFar = c.z + r;
+		if (zNear > 0.0001f)
+		{
+			float left = fminf((c.x - r) / zNear, (c.x - r) / zFar) * frame.proj._11;
+			float right = fmaxf((c.x + r) / zNear, (c.x + r) / zFar) * frame.proj._11;
+			float bottom = fminf((c.y - r) / zNear, (c.y - r) / zFar) * frame.proj._22;
+			float top = fmaxf((c.y + r) / zNear, (c.y + r) / zFar) * frame.proj._22;
+
+			// NDC to pixels, y down
+			float px0 = (left * 0.5f + 0.5f) * width, px1 = (right * 0.5f + 0.5f) * width;
+			float py0 = (0.5f - top * 0.5f) * height, py1 = (0.5f - bottom * 0.5f) * height;
+			if (px1 < 0 || py1 < 0 || px0 >= width || py0 >= height)
+				continue;
+
+			tx0 = (unsigned int)fmaxf(px0, 0.0f) / SOFTWARE_TILE_SIZE;
+			ty0 = (unsigned int)fmaxf(py0, 0.0f) / SOFTWARE_TILE_SIZE;
+			tx1 = (unsigned int)fminf(px1, width - 1.0f) / SOFTWARE_TILE_SIZE;
+			ty1 = (unsigned int)fminf(py1, height - 1.0f) / SOFTWARE_TILE_SIZE;
+		}
+
+		for (unsigned int ty = ty0; ty <= ty1; ty++)
+		{
+			for (unsigned int tx = tx0; tx <= tx1; tx++)
+				tileLights[ty * tilesX + tx].push_back(i);
+		}
+		stats.lightEntries += (tx1 - tx0 + 1) * (ty1 - ty0 + 1);
+	}
+}
+
+// --------------------------------------------------------
+// Draws one tile: clears it, then a depth pass keeping the
+// nearest of its triangles per pixel (by their place in the
+// tile's list), then a shading pass over each triangle's
+// pixels that it won
+// --------------------------------------------------------
+void SoftwareRasterizer::DrawTile(unsigned int tile, ThreadScratch& threadScratch)
+{
+	int tileX = (int)(tile % tilesX) * SOFTWARE_TILE_SIZE;
+	int tileY = (int)(tile / tilesX) * SOFTWARE_TILE_SIZE;
+	int lastX = std::min(tileX + SOFTWARE_TILE_SIZE, (int)width) - 1;
+	int lastY = std::min(tileY + SOFTWARE_TILE_SIZE, (int)height) - 1;
+	unsigned int* ids = threadScratch.ids.data();
+
+	for (int y = 0; y < SOFTWARE_TILE_SIZE; y++)
+	{
+		size_t row = (size_t)(tileY + y) * pitch + tileX;
+		std::fill_n(&depth[row], SOFTWARE_TILE_SIZE, 1.0f);
+		std::fill_n(&color[0][row], SOFTWARE_TILE_SIZE, frame.clearColor.x);
+		std::fill_n(&color[1][row], SOFTWARE_TILE_SIZE, frame.clearColor.y);
+		std::fill_n(&color[2][row], SOFTWARE_TILE_SIZE, frame.clearColor.z);
+	}
+	memset(ids, 0, SOFTWARE_TILE_SIZE * SOFTWARE_TILE_SIZE * sizeof(unsigned int));
+
+	__m128 zero = _mm_setzero_ps();
+	__m128 centers = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+	__m128 screenWidth = _mm_set1_ps((float)width);
+
+	// Depth pass
+	unsigned int id = 0;
+	uint64_t covered = 0;
+	for (const Run& run : runs)
+	{
+		for (unsigned int index : run.bins[tile])
+		{
+			id++;
+			const Triangle& tri = run.triangles[index];
+
+			// Columns start on a multiple of 4 so each step is one
+			// aligned group of pixels, which never crosses a tile
+			int minX = std::max(tri.minX, tileX) & ~3;
+			int maxX = std::min(tri.maxX, lastX);
+			int minY = std::max(tri.minY, tileY);
+			int maxY = std::min(tri.maxY, lastY);
+
+			__m128 a0 = _mm_set1_ps(tri.edges[0][0]), a1 = _mm_set1_ps(tri.edges[1][0]), a2 = _mm_set1_ps(tri.edges[2][0]);
+			__m128 tl0 = _mm_castsi128_ps(_mm_set1_epi32(tri.topLeft[0] ? -1 : 0));
+			__m128 tl1 = _mm_castsi128_ps(_mm_set1_epi32(tri.topLeft[1] ? -1 : 0));
+			__m128 tl2 = _mm_castsi128_ps(_mm_set1_epi32(tri.topLeft[2] ? -1 : 0));
+			__m128 za = _mm_set1_ps(tri.planes[PLANE_Z][0]);
+			__m128i triId = _mm_set1_epi32((int)id);
+
+			for (int y = minY; y <= maxY; y++)
+			{
+				float py = y + 0.5f;
+				__m128 row0 = _mm_set1_ps(tri.edges[0][1] * py + tri.edges[0][2]);
+				__m128 row1 = _mm_set1_ps(tri.edges[1][1] * py + tri.edges[1][2]);
+				__m128 row2 = _mm_set1_ps(tri.edges[2][1] * py + tri.edges[2][2]);
+				__m128 rowZ = _mm_set1_ps(tri.planes[PLANE_Z][1] * py + tri.planes[PLANE_Z][2]);
+
+				float* depthRow = &depth[(size_t)y * pitch];
+				unsigned int* idRow = ids + (y - tileY) * SOFTWARE_TILE_SIZE;
+				for (int x = minX; x <= maxX; x += 4)
+				{
+					__m128 px = _mm_add_ps(_mm_set1_ps((float)x), centers);
+
+					// On the edge counts as inside only for top and left edges
+					__m128 e0 = _mm_add_ps(_mm_mul_ps(a0, px), row0);
+					__m128 e1 = _mm_add_ps(_mm_mul_ps(a1, px), row1);
+					__m128 e2 = _mm_add_ps(_mm_mul_ps(a2, px), row2);
+					__m128 inside = _mm_and_ps(_mm_and_ps(
+						_mm_or_ps(_mm_cmpgt_ps(e0, zero), _mm_and_ps(_mm_cmpeq_ps(e0, zero), tl0)),
+						_mm_or_ps(_mm_cmpgt_ps(e1, zero), _mm_and_ps(_mm_cmpeq_ps(e1, zero), tl1))),
+						_mm_or_ps(_mm_cmpgt_ps(e2, zero), _mm_and_ps(_mm_cmpeq_ps(e2, zero), tl2)));
+					if (x + 4 > (int)width)
+						inside = _mm_and_ps(inside, _mm_cmplt_ps(px, screenWidth));
+					if (_mm_movemask_ps(inside) == 0)
+						continue;
+
+					// z/w is affine in screen space, so needs no correction
+					__m128 z = _mm_add_ps(_mm_mul_ps(za, px), rowZ);
+					__m128 old = _mm_loadu_ps(depthRow + x);
+					__m128 closer = _mm_and_ps(inside, _mm_cmplt_ps(z, old));
+					int mask = _mm_movemask_ps(closer);
+					if (mask == 0)
+						continue;
+
+					_mm_storeu_ps(depthRow + x, Select(closer, z, old));
+					__m128i oldIds = _mm_loadu_si128((const __m128i*)(idRow + x - tileX));
+					__m128i closerIds = _mm_castps_si128(closer);
+					_mm_storeu_si128((__m128i*)(idRow + x - tileX), _mm_or_si128(_mm_and_si128(closerIds, triId), _mm_andnot_si128(closerIds, oldIds)));
+					covered += LANE_COUNTS[mask];
+				}
+			}
+		}
+	}
+
+	// Shading pass, over the same list in the same order
+	const std::vector<unsigned int>& lights = tileLights[tile];
+	float* red = color[0].data();
+	float* green = color[1].data();
+	float* blue = color[2].data();
+	uint64_t shaded = 0;
+	id = 0;
+	for (const Run& run : runs)
+	{
+		for (unsigned int index : run.bins[tile])
+		{
+			id++;
+			const Triangle& tri = run.triangles[index];
+			int minX = std::max(tri.minX, tileX) & ~3;
+			int maxX = std::min(tri.maxX, lastX);
+			int minY = std::max(tri.minY, tileY);
+			int maxY = std::min(tri.maxY, lastY);
+			__m128i triId = _mm_set1_epi32((int)id);
+
+			for (int y = minY; y <= maxY; y++)
+			{
+				__m128 py = _mm_set1_ps(y + 0.5f);
+				const unsigned int* idRow = ids + (y - tileY) * SOFTWARE_TILE_SIZE;
+				for (int x = minX; x <= maxX; x += 4)
+				{
+					__m128 won = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_loadu_si128((const __m128i*)(idRow + x - tileX)), triId));
+					int mask = _mm_movemask_ps(won);
+					if (mask == 0)
+						continue;
+
+					__m128 px = _mm_add_ps(_mm_set1_ps((float)x), centers);
+					Float3x4 rgb = ShadePixels(tri.planes, *tri.material, frame, lights.data(), (unsigned int)lights.size(), px, py, mask);
+
+					size_t at = (size_t)y * pitch + x;
+					_mm_storeu_ps(red + at, Select(won, rgb.x, _mm_loadu_ps(red + at)));
+					_mm_storeu_ps(green + at, Select(won, rgb.y, _mm_loadu_ps(green + at)));
+					_mm_storeu_ps(blue + at, Select(won, rgb.z, _mm_loadu_ps(blue + at)));
+					shaded += LANE_COUNTS[mask];
+				}
+			}
+		}
+	}
+
+	threadScratch.pixelsCovered += covered;
+	threadScratch.pixelsShaded += shaded;
+}
+
+// --------------------------------------------------------
+// Encodes a row of tiles to 8 bit sRGB, clamped to [0, 1]
+// as the output merger does
+// --------------------------------------------------------
+void SoftwareRasterizer::ResolveTileRow(unsigned int row)
+{
+	__m128 zero = _mm_setzero_ps();
+	__m128 one = _mm_set1_ps(1.0f);
+	__m128 scale = _mm_set1_ps(SOFTWARE_SRGB_TABLE_SIZE - 1.0f);
+
+	unsigned int firstY = row * SOFTWARE_TILE_SIZE;
+	unsigned int endY = std::min(firstY + SOFTWARE_TILE_SIZE, height);
+	for (unsigned int y = firstY; y < endY; y++)
+	{
+		unsigned char* out = &pixels[(size_t)y * width * 4];
+		for (unsigned int x = 0; x < width; x += 4)
+		{
+			int levels[3][4];
+			for (unsigned int c = 0; c < 3; c++)
+			{
+				__m128 value = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(&color[c][(size_t)y * pitch + x]), zero), one);
+				_mm_storeu_si128((__m128i*)levels[c], _mm_cvtps_epi32(_mm_mul_ps(value, scale)));
+			}
+
+			unsigned int lanes = std::min(4u, width - x);
+			for (unsigned int lane = 0; lane < lanes; lane++, out += 4)
+			{
+				out[0] = linearToSRGB[levels[0][lane]];
+				out[1] = linearToSRGB[levels[1][lane]];
+				out[2] = linearToSRGB[levels[2][lane]];
+				out[3] = 255;
+			}
+		}
+	}
+}
+
+// --------------------------------------------------------
+// Binary PPM (P6) of the last frame, which needs no image
+// library to write or view
+// --------------------------------------------------------
+bool SoftwareRasterizer::SavePPM(const char* file)
+{
+	std::ofstream out(file, std::ios::binary | std::ios::trunc);
+	if (!out)
+		return false;
+
+	out << "P6\n" << width << " " << height << "\n255\n";
+	std::vector<unsigned char> rgb((size_t)width * height * 3);
+	for (size_t p = 0; p < (size_t)width * height; p++)
+	{
+		rgb[p * 3 + 0] = pixels[p * 4 + 0];
+		rgb[p * 3 + 1] = pixels[p * 4 + 1];
+		rgb[p * 3 + 2] = pixels[p * 4 + 2];
+	}
+	out.write((const char*)rgb.data(), rgb.size());
+	return out.good();
+}
@@ -0,0 +1,246 @@
+#pragma once
+#include <DirectXMath.h>
+#include <cstdint>
+#include <vector>
+#include "Vertex.h"
+#include "ShaderConstants.h"
+#include "ClusterLight.h"
+#include "WorkerPool.h"
+
+// The screen is split into square tiles that are each drawn by
+// one thread start to finish.  Must be a multiple of 4 (one SSE
+// register of pixels).
+#define SOFTWARE_TILE_SIZE	32
+
+// Values interpolated across a triangle: depth, 1/w, then the
+// material vertex shader's outputs divided by w
+#define SOFTWARE_PLANE_COUNT	13
+
+// --------------------------------------------------------
+// One map's mip chain in CPU memory, laid out the way
+// MaterialAtlas keeps a slice: square, a power of 2, largest
+// mip first and tightly packed.  Sampled trilinear with
+// wrapping, like the material sampler.
+// --------------------------------------------------------
+struct SoftwareTexture
+{
+	const unsigned char* texels;	// Null if the material has no such map
+	unsigned int size;
+	unsigned int mipLevels;
+	unsigned int channels;
+	bool srgb;						// The first 3 channels are decoded to linear before filtering
+
+	SoftwareTexture();
+};
+
+// --------------------------------------------------------
+// What the pixel shader reads from a material.  Without an
+// albedo map the surface is color; without a surface map it
+// has the roughness and metalness below and no occlusion.
+// --------------------------------------------------------
+struct SoftwareMaterial
+{
+	SoftwareTexture albedo;			// RGBA, sRGB
+	SoftwareTexture normal;			// Tangent space x and y, z is rebuilt
+	SoftwareTexture surface;		// Roughness, metalness, ambient occlusion
+	DirectX::XMFLOAT3 color;		// Linear
+	float roughness;
+	float metalness;
+
+	SoftwareMaterial();
+};
+
+// --------------------------------------------------------
+// One draw: a mesh's source vertices and indices (a triangle
+// list) under a world matrix.  The pointers are borrowed until
+// the frame ends.
+// --------------------------------------------------------
+struct SoftwareDraw
+{
+	const Vertex* vertices;
+	unsigned int vertexCount;
+	const unsigned int* indices;
+	unsigned int indexCount;
+	DirectX::XMFLOAT4X4 world;
+	const SoftwareMaterial* material;
+};
+
+// --------------------------------------------------------
+// Everything shared by a frame's draws: the camera, the same
+// light cbuffer the material pixel shaders get (with how many
+// of each light the shader variant reads), and the clustered
+// lights.  The cluster lights are borrowed until the frame
+// ends.
+// --------------------------------------------------------
+struct SoftwareFrame
+{
+	DirectX::XMFLOAT4X4 view;
+	DirectX::XMFLOAT4X4 proj;
+	MaterialPSExternalData lights;
+	unsigned int dirLightCount;
+	unsigned int pointLightCount;
+	const ClusterLight* clusterLights;
+	unsigned int clusterLightCount;
+	DirectX::XMFLOAT3 clearColor;	// Linear
+};
+
+// --------------------------------------------------------
+// Numbers from the last EndFrame()
+// --------------------------------------------------------
+struct SoftwareRasterizerStats
+{
+	unsigned int draws;
+	unsigned int triangles;			// Submitted
+	unsigned int trianglesClipped;	// Crossing the near plane
+	unsigned int trianglesCulled;	// Back facing, outside the frustum or missing every pixel center
+	unsigned int binEntries;		// Triangle references across all tiles
+	unsigned int lightEntries;		// Cluster light references across all tiles
+	unsigned int tiles;
+	unsigned int threads;
+	uint64_t pixelsCovered;			// Passed the edge and depth tests in the depth pass
+	uint64_t pixelsShaded;			// Once per visible pixel
+
+	double vertexMilliseconds;		// Vertex shading, per draw
+	double binMilliseconds;			// Clipping, triangle setup and binning, then the lights
+	double rasterMilliseconds;		// Depth and shading passes, per tile
+	double resolveMilliseconds;		// Linear to 8 bit sRGB
+	double totalMilliseconds;
+};
+
+// --------------------------------------------------------
+// A CPU renderer for the material shaders, so frames can be
+// drawn (and timed) without a GPU.
+//
+// Draws are queued between BeginFrame() and EndFrame(), which
+// runs the stages, each spread over a pool of threads:
+//  - vertices: MaterialVS's transforms, a draw per job
+//  - binning: near plane clipping, back face culling and
+//    triangle setup, over runs of triangles in submission
+//    order.  Each run bins its triangles into its own list per
+//    tile, so each tile sees every triangle in submission
+//    order no matter how many threads there are - and every
+//    frame comes out the same.  Cluster lights are binned per
+//    tile by their screen bounds.
+//  - raster: a tile per job.  A depth pass over the tile's
+//    triangles keeps the nearest triangle per pixel, then a
+//    shading pass runs MaterialPS's lighting once for each
+//    visible pixel, like the GPU path's depth prepass.  Edge
+//    tests, interpolation and lighting are SSE, 4 pixels of a
+//    row at a time.
+//  - resolve: linear color to 8 bit sRGB, as the back buffer
+//    view's encoding would.
+//
+// The sky and image based lighting aren't drawn; the
+// background is the clear color.
+// --------------------------------------------------------
+class SoftwareRasterizer
+{
+public:
+	// threadCount - 0 for one per core
+	SoftwareRasterizer(unsigned int width, unsigned int height, unsigned int threadCount = 0);
+
+	void Resize(unsigned int width, unsigned int height);
+	unsigned int GetWidth() { return width; }
+	unsigned int GetHeight() { return height; }
+
+	// Restarts the pool with this many threads (0 for one per core)
+	void SetThreadCount(unsigned int count);
+	unsigned int GetThreadCount() { return pool.GetThreadCount(); }
+
+	void BeginFrame(const SoftwareFrame& frame);
+	void Submit(const SoftwareDraw& draw);
+	void EndFrame();
+
+	// The last frame, RGBA8 sRGB, top row first
+	const unsigned char* GetPixels() { return pixels.data(); }
+	bool SavePPM(const char* file);
+
+	const SoftwareRasterizerStats& GetStats() { return stats; }
+
+private:
+	// A vertex after the vertex stage: clip space position,
+	// then what's interpolated
+	struct ShadedVertex
+	{
+		DirectX::XMFLOAT4 position;
+		DirectX::XMFLOAT3 worldPos;
+		DirectX::XMFLOAT3 normal;
+		DirectX::XMFLOAT2 uv;
+		DirectX::XMFLOAT3 tangent;
+	};
+
+	// A set up triangle.  Edge i is opposite vertex i, positive
+	// inside; planes are (d/dx, d/dy, value at 0, 0) in pixels.
+	struct Triangle
+	{
+		float edges[3][3];
+		bool topLeft[3];
+		int minX, minY, maxX, maxY;
+		float planes[SOFTWARE_PLANE_COUNT][3];
+		const SoftwareMaterial* material;
+	};
+
+	// A run of triangles binned by one job
+	struct Run
+	{
+		std::vector<Triangle> triangles;
+		std::vector<std::vector<unsigned int>> bins;	// Per tile, indices into triangles
+		unsigned int clipped;
+		unsigned int culled;
+	};
+
+	// Per thread, so the tile jobs never share anything they write
+	struct ThreadScratch
+	{
+		std::vector<unsigned int> ids;		// A tile of visible triangles, 0 for none
+		uint64_t pixelsCovered;
+		uint64_t pixelsShaded;
+	};
+
+	enum Stage
+	{
+		STAGE_VERTICES,
+		STAGE_BIN,
+		STAGE_RASTER,
+		STAGE_RESOLVE,
+	};
+
+	unsigned int width;
+	unsigned int height;
+	unsigned int tilesX;
+	unsigned int tilesY;
+	unsigned int pitch;				// Pixels per row of the float buffers, a whole number of tiles
+
+	SoftwareFrame frame;
+	DirectX::XMFLOAT4X4 viewProj;
+
+	std::vector<SoftwareDraw> draws;
+	std::vector<unsigned int> drawVertexStart;
+	std::vector<unsigned int> drawTriangleStart;
+	std::vector<ShadedVertex> shadedVertices;
+	unsigned int triangleCount;
+
+	std::vector<Run> runs;
+	std::vector<std::vector<unsigned int>> tileLights;
+
+	std::vector<float> depth;
+	std::vector<float> color[3];
+	std::vector<unsigned char> pixels;
+
+	SoftwareRasterizerStats stats;
+
+	// The calling thread works through each stage's jobs
+	// alongside the pool's
+	WorkerPool pool;
+	std::vector<ThreadScratch> scratch;
+
+	void RunStage(Stage stage, unsigned int jobs);
+
+	void ShadeVertices(unsigned int draw);
+	void BinRun(unsigned int run);
+	void ClipTriangle(Run& run, const ShadedVertex* v0, const ShadedVertex* v1, const ShadedVertex* v2, const SoftwareMaterial* material);
+	bool SetupTriangle(Run& run, const ShadedVertex* const* v, const SoftwareMaterial* material);
+	void BinLights();
+	void DrawTile(unsigned int tile, ThreadScratch& threadScratch);
+	void ResolveTileRow(unsigned int row);
+};
@@ -0,0 +1,140 @@
+#include "SoftwareRenderer.h"
+#include <stdio.h>
+#include <string.h>
+
+using namespace DirectX;
+
+SoftwareRenderer::SoftwareRenderer(unsigned int width, unsigned int height, unsigned int threadCount)
+	: rasterizer(width, height, threadCount)
+{
+	frames = 0;
+	memset(&totals, 0, sizeof(totals));
+}
+
+void SoftwareRenderer::Resize(unsigned int width, unsigned int height)
+{
+	rasterizer.Resize(width, height);
+}
+
+void SoftwareRenderer::ClearMaterials()
+{
+	materialKeys.clear();
+	materials.clear();
+}
+
+// --------------------------------------------------------
+// Looks up (or fills in) the CPU side of a material.  Atlas
+// materials sample their slice of each map; the rest have
+// no maps the CPU can read, and are their tint.
+// --------------------------------------------------------
+const SoftwareMaterial* SoftwareRenderer::GetMaterial(const Material* material)
+{
+	for (size_t i = 0; i < materialKeys.size(); i++)
+	{
+		if (materialKeys[i] == material)
+			return &materials[i];
+	}
+
+	SoftwareMaterial software;
+	software.color = XMFLOAT3(material->colorTint.x, material->colorTint.y, material->colorTint.z);
+
+	MaterialAtlas* atlas = material->atlas;
+	if (atlas)
+	{
+		SoftwareTexture* textures[MATERIAL_ATLAS_MAP_COUNT] = { &software.albedo, &software.normal, &software.surface };
+		for (unsigned int map = 0; map < MATERIAL_ATLAS_MAP_COUNT; map++)
+		{
+			const unsigned char* texels = atlas->GetSlicePixels((MaterialAtlasMap)map, material->atlasSlice);
+			if (!texels)
+				continue;
+
+			textures[map]->texels = texels;
+			textures[map]->size = atlas->GetSize();
+			textures[map]->mipLevels = atlas->GetMipLevels();
+			textures[map]->channels = MaterialAtlas::GetMapChannels((MaterialAtlasMap)map);
+			textures[map]->srgb = MaterialAtlas::IsMapSRGB((MaterialAtlasMap)map);
+		}
+	}
+
+	materialKeys.push_back(material);
+	materials.push_back(software);
+	return &materials.back();
+}
+
+void SoftwareRenderer::Render(RenderQueue& queue, Camera* cam, const MaterialPSExternalData& lights,
+	unsigned int dirLightCount, unsigned int pointLightCount,
+	const std::vector<ClusterLight>& clusterLights, const float* clearColor)
+{
+	SoftwareFrame frame;
+	memset(&frame, 0, sizeof(frame));
+	frame.view = cam->getView();
+	frame.proj = cam->getProj();
+	frame.lights = lights;
+	frame.dirLightCount = dirLightCount;
+	frame.pointLightCount = pointLightCount;
+	frame.clusterLights = clusterLights.data();
+	frame.clusterLightCount = (unsigned int)clusterLights.size();
+	frame.clearColor = XMFLOAT3(clearColor[0], clearColor[1], clearColor[2]);
+	rasterizer.BeginFrame(frame);
+
+	// In the queue's order, which only matters to the stats -
+	// the depth pass makes the image the same either way
+	for (const DrawPacket& packet : queue.GetPackets())
+	{
+		gameEntity* entity = packet.entity;
+		const std::vector<Vertex>& vertices = entity->GetMesh()->GetSourceVertices();
+		const std::vector<unsigned int>& indices = entity->GetMesh()->GetSourceIndices();
+		if (vertices.empty() || indices.empty())
+			continue;
+
+		SoftwareDraw draw;
+		draw.vertices = vertices.data();
+		draw.vertexCount = (unsigned int)vertices.size();
+		draw.indices = indices.data();
+		draw.indexCount = (unsigned int)indices.size();
+		draw.world = entity->GetTransform()->GetWorldMatrix();
+		draw.material = GetMaterial(entity->mat);
+		rasterizer.Submit(draw);
+	}
+
+	rasterizer.EndFrame();
+
+	const SoftwareRasterizerStats& stats = rasterizer.GetStats();
+	frames++;
+	totals.draws += stats.draws;
+	totals.triangles += stats.triangles;
+	totals.trianglesClipped += stats.trianglesClipped;
+	totals.trianglesCulled += stats.trianglesCulled;
+	totals.binEntries += stats.binEntries;
+	totals.lightEntries += stats.lightEntries;
+	totals.tiles = stats.tiles;
+	totals.threads = stats.threads;
+	totals.pixelsCovered += stats.pixelsCovered;
+	totals.pixelsShaded += stats.pixelsShaded;
+	totals.vertexMilliseconds += stats.vertexMilliseconds;
+	totals.binMilliseconds += stats.binMilliseconds;
+	totals.rasterMilliseconds += stats.rasterMilliseconds;
+	totals.resolveMilliseconds += stats.resolveMilliseconds;
+	totals.totalMilliseconds += stats.totalMilliseconds;
+}
+
+bool SoftwareRenderer::SaveFrame(const char* file)
+{
+	return frames > 0 && rasterizer.SavePPM(file);
+}
+
+void SoftwareRenderer::PrintStats()
+{
+	if (!frames)
+		return;
+
+	printf("Software renderer: %u frames at %ux%u, %u tiles on %u threads\n",
+		frames, rasterizer.GetWidth(), rasterizer.GetHeight(), totals.tiles, totals.threads);
+	printf("  per frame: %.1f draws, %.1f triangles (%.1f clipped, %.1f culled), %.0f pixels shaded\n",
+		(double)totals.draws / frames, (double)totals.triangles / frames,
+		(double)totals.trianglesClipped / frames, (double)totals.trianglesCulled / frames,
+		(double)totals.pixelsShaded / frames);
+	printf("  vertex %.3f ms, bin %.3f ms, raster %.3f ms, resolve %.3f ms, total %.3f ms\n",
+		totals.vertexMilliseconds / frames, totals.binMilliseconds / frames, totals.rasterMilliseconds / frames,
+		totals.resolveMilliseconds / frames, totals.totalMilliseconds / frames);
+}
@@ -0,0 +1,59 @@
+#pragma once
+#include <deque>
+#include <vector>
+#include "SoftwareRasterizer.h"
+#include "RenderQueue.h"
+#include "Material.h"
+#include "Camera.h"
+
+// --------------------------------------------------------
+// Draws the game's sorted render queue with the software
+// rasterizer: each packet's mesh (from its kept source
+// vertices) under its entity's transform, with the frame's
+// lights.  Material maps come from the atlas's CPU copy, so
+// the atlas has to be built with SetKeepPixels(true); other
+// materials draw in their flat tint.
+//
+// Stats are summed over every frame drawn, so a headless run
+// can report average per stage timings at the end.
+// --------------------------------------------------------
+class SoftwareRenderer
+{
+public:
+	// threadCount - 0 for one per core
+	SoftwareRenderer(unsigned int width, unsigned int height, unsigned int threadCount = 0);
+
+	void Resize(unsigned int width, unsigned int height);
+
+	// Forgets every material, for when they (or the atlas they
+	// point into) are deleted
+	void ClearMaterials();
+
+	// clearColor is linear RGBA, as given to the back buffer clear
+	void Render(RenderQueue& queue, Camera* cam, const MaterialPSExternalData& lights,
+		unsigned int dirLightCount, unsigned int pointLightCount,
+		const std::vector<ClusterLight>& clusterLights, const float* clearColor);
+
+	// The last frame, as a binary PPM
+	bool SaveFrame(const char* file);
+
+	// The average frame since the renderer was made
+	void PrintStats();
+
+	SoftwareRasterizer& GetRasterizer() { return rasterizer; }
+
+private:
+	SoftwareRasterizer rasterizer;
+
+	// A handful of materials exist at once, so the lookup is a
+	// linear search like the render queue's ids.  A deque, so
+	// draws queued this frame keep pointing at their materials
+	// when one is added.
+	std::vector<const Material*> materialKeys;
+	std::deque<SoftwareMaterial> materials;
+
+	unsigned int frames;
+	SoftwareRasterizerStats totals;
+
+	const SoftwareMaterial* GetMaterial(const Material* material);
+};
@@ -0,0 +1,359 @@
+#include "StateCache.h"
+#include "PipelineState.h"
+#include <string.h>
+
+// Marks shadowed state as unknown - no real object lives at this
+// address, so the next call of that kind is always forwarded
+template<typename T>
+static T* Unknown() { return reinterpret_cast<T*>(~(uintptr_t)0); }
+
+unsigned int StateCacheStats::TotalForwarded() const
+{
+	unsigned int total = 0;
+	for (unsigned int i = 0; i < STATE_CALL_COUNT; i++)
+		total += forwarded[i];
+	return total;
+}
+
+unsigned int StateCacheStats::TotalFiltered() const
+{
+	unsigned int total = 0;
+	for (unsigned int i = 0; i < STATE_CALL_COUNT; i++)
+		total += filtered[i];
+	return total;
+}
+
+StateCache::StateCache(RenderBackend* backend)
+{
+	this->backend = backend;
+
+	memset(&stats, 0, sizeof(stats));
+	memset(&lastFrameStats, 0, sizeof(lastFrameStats));
+	Invalidate();
+}
+
+StateCache::~StateCache()
+{
+}
+
+// --------------------------------------------------------
+// Publishes last frame's counts and starts a new frame
+// --------------------------------------------------------
+void StateCache::BeginFrame()
+{
+	lastFrameStats = stats;
+	memset(&stats, 0, sizeof(stats));
+	Invalidate();
+}
+
+// --------------------------------------------------------
+// Marks every piece of shadowed state as unknown
+// --------------------------------------------------------
+void StateCache::Invalidate()
+{
+	inputLayout = Unknown<RenderInputLayout>();
+	vs = Unknown<RenderVertexShader>();
+	ps = Unknown<RenderPixelShader>();
+
+	for (unsigned int i = 0; i < STATE_CACHE_CB_SLOTS; i++)
+	{
+		vsConstantBuffers[i] = Unknown<RenderBuffer>();
+		psConstantBuffers[i] = Unknown<RenderBuffer>();
+		vsConstantRanges[i][0] = vsConstantRanges[i][1] = 0;
+		psConstantRanges[i][0] = psConstantRanges[i][1] = 0;
+	}
+
+	for (unsigned int i = 0; i < STATE_CACHE_SRV_SLOTS; i++)
+	{
+		vsSRVs[i] = Unknown<RenderResource>();
+		psSRVs[i] = Unknown<RenderResource>();
+	}
+
+	for (unsigned int i = 0; i < STATE_CACHE_SAMPLER_SLOTS; i++)
+	{
+		vsSamplers[i] = Unknown<RenderSamplerState>();
+		psSamplers[i] = Unknown<RenderSamplerState>();
+	}
+
+	for (unsigned int i = 0; i < STATE_CACHE_VB_SLOTS; i++)
+	{
+		vertexBuffers[i] = Unknown<RenderBuffer>();
+		vertexStrides[i] = 0;
+		vertexOffsets[i] = 0;
+	}
+
+	indexBuffer = Unknown<RenderBuffer>();
+	indexFormat = DXGI_FORMAT_UNKNOWN;
+	indexOffset = 0;
+
+	topology = RENDER_TOPOLOGY_UNDEFINED;
+	rasterizerState = Unknown<RenderRasterizerState>();
+	depthStencilState = Unknown<RenderDepthStencilState>();
+	stencilRef = 0;
+	blendState = Unknown<RenderBlendState>();
+
+	pipelineState = Unknown<const PipelineState>();
+}
+
+// --------------------------------------------------------
+// Counts the call as forwarded or filtered
+// --------------------------------------------------------
+bool StateCache::Changed(StateCall call, bool different)
+{
+	if (different)
+		stats.forwarded[call]++;
+	else
+		stats.filtered[call]++;
+
+	return different;
+}
+
+void StateCache::SetPipelineState(const PipelineState* pso)
+{
+	if (!Changed(STATE_CALL_PIPELINE_STATE, pso != pipelineState))
+		return;
+
+	IASetInputLayout(pso->inputLayout);
+	IASetPrimitiveTopology(pso->topology);
+	VSSetShader(pso->vertexShader);
+	PSSetShader(pso->pixelShader);
+	RSSetState(pso->rasterizerState);
+	OMSetDepthStencilState(pso->depthStencilState, 0);
+	OMSetBlendState(pso->blendState);
+
+	pipelineState = pso;
+}
+
+void StateCache::IASetInputLayout(RenderInputLayout* layout)
+{
+	if (!Changed(STATE_CALL_INPUT_LAYOUT, layout != inputLayout))
+		return;
+
+	inputLayout = layout;
+	pipelineState = Unknown<const PipelineState>();
+	backend->SetInputLayout(layout);
+}
+
+void StateCache::VSSetShader(RenderVertexShader* shader)
+{
+	if (!Changed(STATE_CALL_VERTEX_SHADER, shader != vs))
+		return;
+
+	vs = shader;
+	pipelineState = Unknown<const PipelineState>();
+	backend->SetVertexShader(shader);
+}
+
+void StateCache::PSSetShader(RenderPixelShader* shader)
+{
+	if (!Changed(STATE_CALL_PIXEL_SHADER, shader != ps))
+		return;
+
+	ps = shader;
+	pipelineState = Unknown<const PipelineState>();
+	backend->SetPixelShader(shader);
+}
+
+// --------------------------------------------------------
+// Checks (and updates) one stage's shadowed constant buffer
+// slot, counting the call either way
+// --------------------------------------------------------
+bool StateCache::ConstantBufferChanged(RenderBuffer** buffers, unsigned int (*ranges)[2], unsigned int slot, RenderBuffer* buffer, unsigned int firstConstant, unsigned int numConstants)
+{
+	if (slot >= STATE_CACHE_CB_SLOTS)
+		return Changed(STATE_CALL_CONSTANT_BUFFER, true);
+
+	bool different =
+		buffer != buffers[slot] ||
+		firstConstant != ranges[slot][0] ||
+		numConstants != ranges[slot][1];
+
+	if (!Changed(STATE_CALL_CONSTANT_BUFFER, different))
+		return false;
+
+	buffers[slot] = buffer;
+	ranges[slot][0] = firstConstant;
+	ranges[slot][1] = numConstants;
+	return true;
+}
+
+void StateCache::VSSetConstantBuffer(unsigned int slot, RenderBuffer* buffer, unsigned int firstConstant, unsigned int numConstants)
+{
+	if (!ConstantBufferChanged(vsConstantBuffers, vsConstantRanges, slot, buffer, firstConstant, numConstants))
+		return;
+
+	backend->SetConstantBuffer(SHADER_STAGE_VERTEX, slot, buffer, firstConstant, numConstants);
+}
+
+void StateCache::PSSetConstantBuffer(unsigned int slot, RenderBuffer* buffer, unsigned int firstConstant, unsigned int numConstants)
+{
+	if (!ConstantBufferChanged(psConstantBuffers, psConstantRanges, slot, buffer, firstConstant, numConstants))
+		return;
+
+	backend->SetConstantBuffer(SHADER_STAGE_PIXEL, slot, buffer, firstConstant, numConstants);
+}
+
+// --------------------------------------------------------
+// Walks the range, dropping slots whose shadow already holds
+// the object.  Slots past the shadowed ones always count as
+// changed.
+// --------------------------------------------------------
+template<typename T, typename Forward>
+void StateCache::ForwardChangedRuns(StateCall call, T** shadow, unsigned int shadowSlots, unsigned int startSlot, unsigned int count, T* const* objects, const Forward& forward)
+{
+	unsigned int i = 0;
+	while (i < count)
+	{
+		unsigned int slot = startSlot + i;
+		if (slot < shadowSlots && shadow[slot] == objects[i])
+		{
+			stats.filtered[call]++;
+			i++;
+			continue;
+		}
+
+		unsigned int first = i;
+		for (; i < count; i++)
+		{
+			slot = startSlot + i;
+			if (slot < shadowSlots)
+			{
+				if (shadow[slot] == objects[i])
+					break;
+				shadow[slot] = objects[i];
+			}
+		}
+
+		stats.forwarded[call]++;
+		stats.forwardedSlots[call] += i - first;
+		forward(startSlot + first, i - first);
+	}
+}
+
+void StateCache::VSSetShaderResources(unsigned int startSlot, unsigned int count, RenderResource* const* srvs)
+{
+	ForwardChangedRuns(STATE_CALL_SHADER_RESOURCE, vsSRVs, STATE_CACHE_SRV_SLOTS, startSlot, count, srvs, [&](unsigned int start, unsigned int n)
+	{
+		backend->SetShaderResources(SHADER_STAGE_VERTEX, start, n, srvs + (start - startSlot));
+	});
+}
+
+void StateCache::PSSetShaderResources(unsigned int startSlot, unsigned int count, RenderResource* const* srvs)
+{
+	ForwardChangedRuns(STATE_CALL_SHADER_RESOURCE, psSRVs, STATE_CACHE_SRV_SLOTS, startSlot, count, srvs, [&](unsigned int start, unsigned int n)
+	{
+		backend->SetShaderResources(SHADER_STAGE_PIXEL, start, n, srvs + (start - startSlot));
+	});
+}
+
+void StateCache::VSSetSamplers(unsigned int startSlot, unsigned int count, RenderSamplerState* const* samplers)
+{
+	ForwardChangedRuns(STATE_CALL_SAMPLER, vsSamplers, STATE_CACHE_SAMPLER_SLOTS, startSlot, count, samplers, [&](unsigned int start, unsigned int n)
+	{
+		backend->SetSamplers(SHADER_STAGE_VERTEX, start, n, samplers + (start - startSlot));
+	});
+}
+
+void StateCache::PSSetSamplers(unsigned int startSlot, unsigned int count, RenderSamplerState* const* samplers)
+{
+	ForwardChangedRuns(STATE_CALL_SAMPLER, psSamplers, STATE_CACHE_SAMPLER_SLOTS, startSlot, count, samplers, [&](unsigned int start, unsigned int n)
+	{
+		backend->SetSamplers(SHADER_STAGE_PIXEL, start, n, samplers + (start - startSlot));
+	});
+}
+
+// --------------------------------------------------------
+// Forwards the whole call if any of the slots it touches
+// would change (or lies past the shadowed slots)
+// --------------------------------------------------------
+void StateCache::IASetVertexBuffers(unsigned int startSlot, unsigned int numBuffers, RenderBuffer* const* buffers, const unsigned int* strides, const unsigned int* offsets)
+{
+	bool different = startSlot + numBuffers > STATE_CACHE_VB_SLOTS;
+	for (unsigned int i = 0; i < numBuffers && !different; i++)
+	{
+		unsigned int slot = startSlot + i;
+		different =
+			buffers[i] != vertexBuffers[slot] ||
+			strides[i] != vertexStrides[slot] ||
+			offsets[i] != vertexOffsets[slot];
+	}
+
+	if (!Changed(STATE_CALL_VERTEX_BUFFER, different))
+		return;
+
+	for (unsigned int i = 0; i < numBuffers && startSlot + i < STATE_CACHE_VB_SLOTS; i++)
+	{
+		unsigned int slot = startSlot + i;
+		vertexBuffers[slot] = buffers[i];
+		vertexStrides[slot] = strides[i];
+		vertexOffsets[slot] = offsets[i];
+	}
+
+	backend->SetVertexBuffers(startSlot, numBuffers, buffers, strides, offsets);
+}
+
+void StateCache::IASetIndexBuffer(RenderBuffer* buffer, DXGI_FORMAT format, unsigned int offset)
+{
+	bool different = buffer != indexBuffer || format != indexFormat || offset != indexOffset;
+	if (!Changed(STATE_CALL_INDEX_BUFFER, different))
+		return;
+
+	indexBuffer = buffer;
+	indexFormat = format;
+	indexOffset = offset;
+	backend->SetIndexBuffer(buffer, format, offset);
+}
+
+void StateCache::IASetPrimitiveTopology(RenderTopology topology)
+{
+	if (!Changed(STATE_CALL_TOPOLOGY, topology != this->topology))
+		return;
+
+	this->topology = topology;
+	pipelineState = Unknown<const PipelineState>();
+	backend->SetPrimitiveTopology(topology);
+}
+
+void StateCache::RSSetState(RenderRasterizerState* state)
+{
+	if (!Changed(STATE_CALL_RASTERIZER, state != rasterizerState))
+		return;
+
+	rasterizerState = state;
+	pipelineState = Unknown<const PipelineState>();
+	backend->SetRasterizerState(state);
+}
+
+void StateCache::OMSetDepthStencilState(RenderDepthStencilState* state, unsigned int stencilRef)
+{
+	bool different = state != depthStencilState || stencilRef != this->stencilRef;
+	if (!Changed(STATE_CALL_DEPTH_STENCIL, different))
+		return;
+
+	depthStencilState = state;
+	this->stencilRef = stencilRef;
+	pipelineState = Unknown<const PipelineState>();
+	backend->SetDepthStencilState(state, stencilRef);
+}
+
+void StateCache::OMSetBlendState(RenderBlendState* state)
+{
+	if (!Changed(STATE_CALL_BLEND, state != blendState))
+		return;
+
+	blendState = state;
+	pipelineState = Unknown<const PipelineState>();
+	backend->SetBlendState(state);
+}
+
+void StateCache::DrawIndexed(unsigned int indexCount, unsigned int startIndex, int baseVertex)
+{
+	stats.draws++;
+	backend->DrawIndexed(indexCount, startIndex, baseVertex);
+}
+
+void StateCache::Draw(unsigned int vertexCount, unsigned int startVertex)
+{
+	stats.draws++;
+	backend->Draw(vertexCount, startVertex);
+}
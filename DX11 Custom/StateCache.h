@@ -0,0 +1,169 @@
+#pragma once
+#include <cstdint>
+#include "RenderBackend.h"
+
+struct PipelineState;
+
+// How many slots of each kind are shadowed (all of D3D11's
+// constant buffer and sampler slots).  Calls touching slots
+// past these are always forwarded.
+#define STATE_CACHE_CB_SLOTS		14
+#define STATE_CACHE_SRV_SLOTS		16
+#define STATE_CACHE_SAMPLER_SLOTS	16
+#define STATE_CACHE_VB_SLOTS		4
+
+// --------------------------------------------------------
+// The kinds of calls the cache filters, used to index stats
+// --------------------------------------------------------
+enum StateCall
+{
+	STATE_CALL_VERTEX_SHADER,
+	STATE_CALL_PIXEL_SHADER,
+	STATE_CALL_INPUT_LAYOUT,
+	STATE_CALL_CONSTANT_BUFFER,
+	STATE_CALL_SHADER_RESOURCE,
+	STATE_CALL_SAMPLER,
+	STATE_CALL_VERTEX_BUFFER,
+	STATE_CALL_INDEX_BUFFER,
+	STATE_CALL_TOPOLOGY,
+	STATE_CALL_RASTERIZER,
+	STATE_CALL_DEPTH_STENCIL,
+	STATE_CALL_BLEND,
+	STATE_CALL_PIPELINE_STATE,
+	STATE_CALL_COUNT
+};
+
+// --------------------------------------------------------
+// Number of calls that reached the backend (forwarded) and
+// that were dropped as redundant (filtered) in one frame.
+// Shader resources and samplers are bound in ranges: for
+// those, filtered counts slots dropped, and forwardedSlots
+// the slots the forwarded calls covered.
+// --------------------------------------------------------
+struct StateCacheStats
+{
+	unsigned int forwarded[STATE_CALL_COUNT];
+	unsigned int filtered[STATE_CALL_COUNT];
+	unsigned int forwardedSlots[STATE_CALL_COUNT];
+	unsigned int draws;
+
+	unsigned int TotalForwarded() const;
+	unsigned int TotalFiltered() const;
+};
+
+// --------------------------------------------------------
+// Shadows the pipeline state bound through a RenderBackend
+// and drops calls that would not change it.  Every bind in
+// the draw path should go through here - anything that sets
+// state behind its back (SpriteBatch, for one) must be
+// followed by Invalidate().
+// --------------------------------------------------------
+class StateCache
+{
+public:
+	StateCache(RenderBackend* backend);
+	~StateCache();
+
+	RenderBackend* GetBackend() { return backend; }
+
+	// Frame boundaries - rolls the stats over and forgets all
+	// shadowed state, since it can't be trusted across frames
+	void BeginFrame();
+	const StateCacheStats& GetStats() { return lastFrameStats; }
+
+	// Forget everything shadowed, so the next call of each kind is forwarded
+	void Invalidate();
+
+	// Binds a whole pipeline state object.  Rebinding the current
+	// one is a single compare; otherwise only the parts that
+	// differ from what's bound reach the backend.
+	void SetPipelineState(const PipelineState* pso);
+	const PipelineState* GetPipelineState() { return pipelineState; }
+
+	// Shaders and input layout
+	void IASetInputLayout(RenderInputLayout* layout);
+	void VSSetShader(RenderVertexShader* shader);
+	void PSSetShader(RenderPixelShader* shader);
+	RenderVertexShader* GetVertexShader() { return vs; }
+	RenderPixelShader* GetPixelShader() { return ps; }
+
+	// Per-stage constant buffers, one slot at a time.  A non-zero numConstants
+	// binds a window of the buffer (D3D 11.1), otherwise the whole buffer.
+	void VSSetConstantBuffer(unsigned int slot, RenderBuffer* buffer, unsigned int firstConstant = 0, unsigned int numConstants = 0);
+	void PSSetConstantBuffer(unsigned int slot, RenderBuffer* buffer, unsigned int firstConstant = 0, unsigned int numConstants = 0);
+
+	// Per-stage views and samplers, a range of slots at a time.  Slots
+	// already holding the same object are dropped, and each run of
+	// changed slots left goes to the backend as one call.
+	void VSSetShaderResources(unsigned int startSlot, unsigned int count, RenderResource* const* srvs);
+	void PSSetShaderResources(unsigned int startSlot, unsigned int count, RenderResource* const* srvs);
+	void VSSetSamplers(unsigned int startSlot, unsigned int count, RenderSamplerState* const* samplers);
+	void PSSetSamplers(unsigned int startSlot, unsigned int count, RenderSamplerState* const* samplers);
+	void VSSetShaderResource(unsigned int slot, RenderResource* srv) { VSSetShaderResources(slot, 1, &srv); }
+	void PSSetShaderResource(unsigned int slot, RenderResource* srv) { PSSetShaderResources(slot, 1, &srv); }
+	void VSSetSampler(unsigned int slot, RenderSamplerState* sampler) { VSSetSamplers(slot, 1, &sampler); }
+	void PSSetSampler(unsigned int slot, RenderSamplerState* sampler) { PSSetSamplers(slot, 1, &sampler); }
+
+	// Input assembler
+	void IASetVertexBuffers(unsigned int startSlot, unsigned int numBuffers, RenderBuffer* const* buffers, const unsigned int* strides, const unsigned int* offsets);
+	void IASetIndexBuffer(RenderBuffer* buffer, DXGI_FORMAT format, unsigned int offset);
+	void IASetPrimitiveTopology(RenderTopology topology);
+
+	// Fixed function state
+	void RSSetState(RenderRasterizerState* state);
+	void OMSetDepthStencilState(RenderDepthStencilState* state, unsigned int stencilRef);
+	void OMSetBlendState(RenderBlendState* state);
+
+	// Draws are always forwarded, just counted
+	void DrawIndexed(unsigned int indexCount, unsigned int startIndex, int baseVertex);
+	void Draw(unsigned int vertexCount, unsigned int startVertex);
+
+private:
+	RenderBackend* backend;
+
+	StateCacheStats stats;
+	StateCacheStats lastFrameStats;
+
+	// Shadowed state
+	RenderInputLayout* inputLayout;
+	RenderVertexShader* vs;
+	RenderPixelShader* ps;
+
+	RenderBuffer* vsConstantBuffers[STATE_CACHE_CB_SLOTS];
+	RenderBuffer* psConstantBuffers[STATE_CACHE_CB_SLOTS];
+	unsigned int vsConstantRanges[STATE_CACHE_CB_SLOTS][2];
+	unsigned int psConstantRanges[STATE_CACHE_CB_SLOTS][2];
+	RenderResource* vsSRVs[STATE_CACHE_SRV_SLOTS];
+	RenderResource* psSRVs[STATE_CACHE_SRV_SLOTS];
+	RenderSamplerState* vsSamplers[STATE_CACHE_SAMPLER_SLOTS];
+	RenderSamplerState* psSamplers[STATE_CACHE_SAMPLER_SLOTS];
+
+	RenderBuffer* vertexBuffers[STATE_CACHE_VB_SLOTS];
+	unsigned int vertexStrides[STATE_CACHE_VB_SLOTS];
+	unsigned int vertexOffsets[STATE_CACHE_VB_SLOTS];
+
+	RenderBuffer* indexBuffer;
+	DXGI_FORMAT indexFormat;
+	unsigned int indexOffset;
+
+	RenderTopology topology;
+	RenderRasterizerState* rasterizerState;
+	RenderDepthStencilState* depthStencilState;
+	unsigned int stencilRef;
+	RenderBlendState* blendState;
+
+	// Last PSO bound, forgotten as soon as any state it covers is
+	// changed through the individual calls
+	const PipelineState* pipelineState;
+
+	// Returns true (and counts it) if the call changes state and must be forwarded
+	bool Changed(StateCall call, bool different);
+
+	// Shared by the view and sampler ranges: updates the shadow and
+	// calls forward(start, count) for each run of changed slots
+	template<typename T, typename Forward>
+	void ForwardChangedRuns(StateCall call, T** shadow, unsigned int shadowSlots, unsigned int startSlot, unsigned int count, T* const* objects, const Forward& forward);
+
+	// Shared by both stages' constant buffer binds
+	bool ConstantBufferChanged(RenderBuffer** buffers, unsigned int (*ranges)[2], unsigned int slot, RenderBuffer* buffer, unsigned int firstConstant, unsigned int numConstants);
+};
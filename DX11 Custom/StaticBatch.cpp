@@ -0,0 +1,132 @@
+#include "StaticBatch.h"
+#include <cassert>
+#include <chrono>
+#include <string.h>
+
+using namespace DirectX;
+
+StaticBatch::StaticBatch()
+{
+	memset(&stats, 0, sizeof(stats));
+}
+
+StaticBatch::~StaticBatch()
+{
+}
+
+void StaticBatch::Add(Mesh* mesh, Material* material, const XMFLOAT4X4& partToBatch)
+{
+	Part part;
+	part.mesh = mesh;
+	part.material = material;
+	part.partToBatch = partToBatch;
+	parts.push_back(part);
+}
+
+void StaticBatch::Add(gameEntity* part, const XMFLOAT4X4& batchWorld)
+{
+	XMFLOAT4X4 partWorld = part->GetTransform()->GetWorldMatrix();
+	XMMATRIX toBatch = XMLoadFloat4x4(&partWorld) * XMMatrixInverse(0, XMLoadFloat4x4(&batchWorld));
+
+	XMFLOAT4X4 partToBatch;
+	XMStoreFloat4x4(&partToBatch, toBatch);
+	Add(part->GetMesh(), part->mat, partToBatch);
+}
+
+// --------------------------------------------------------
+// Groups the parts by material, in the order the materials
+// were first added, and makes one mesh per group
+// --------------------------------------------------------
+void StaticBatch::Build(RenderBackend* backend, MeshVertexFormat format, GeometryArena* arena, bool keepSource)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	groups.clear();
+	meshes.clear();
+	memset(&stats, 0, sizeof(stats));
+	stats.parts = (unsigned int)parts.size();
+
+	std::vector<Mesh*> sourceMeshes;
+	std::vector<bool> done(parts.size(), false);
+	for (size_t first = 0; first < parts.size(); first++)
+	{
+		if (done[first])
+			continue;
+
+		std::vector<Vertex> verts;
+		std::vector<unsigned int> indices;
+		for (size_t i = first; i < parts.size(); i++)
+		{
+			if (parts[i].material != parts[first].material)
+				continue;
+			AppendPart(parts[i], verts, indices);
+			done[i] = true;
+
+			bool counted = false;
+			for (Mesh* m : sourceMeshes)
+				counted |= m == parts[i].mesh;
+			if (!counted)
+			{
+				const MeshVertexStats& source = parts[i].mesh->GetVertexStats();
+				stats.sourceBytes += source.vertexBytes + source.indexBytes;
+				sourceMeshes.push_back(parts[i].mesh);
+			}
+		}
+
+		if (indices.empty())
+			continue;
+
+		Mesh* mesh = new Mesh(verts.data(), (int)verts.size(), indices.data(), (int)indices.size(), backend, format, arena, keepSource);
+		meshes.emplace_back(mesh);
+
+		StaticBatchGroup group;
+		group.material = parts[first].material;
+		group.mesh = mesh;
+		groups.push_back(group);
+
+		const MeshVertexStats& meshStats = mesh->GetVertexStats();
+		stats.vertexCount += meshStats.vertexCount;
+		stats.indexCount += meshStats.indexCount;
+		stats.batchBytes += meshStats.vertexBytes + meshStats.indexBytes;
+		if (format == MESH_VERTEX_COMPACT && meshStats.maxPositionError > stats.maxPositionError)
+			stats.maxPositionError = meshStats.maxPositionError;
+	}
+	stats.groups = (unsigned int)groups.size();
+
+	stats.buildMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+// --------------------------------------------------------
+// Positions and tangents go through the part's matrix,
+// normals through its inverse transpose.  A mirroring
+// matrix turns the triangles inside out, so their winding is
+// flipped back.
+// --------------------------------------------------------
+void StaticBatch::AppendPart(const Part& part, std::vector<Vertex>& verts, std::vector<unsigned int>& indices)
+{
+	const std::vector<Vertex>& sourceVerts = part.mesh->GetSourceVertices();
+	const std::vector<unsigned int>& sourceIndices = part.mesh->GetSourceIndices();
+	assert((part.mesh->GetIndexCount() == 0 || !sourceIndices.empty()) && "batched meshes need to be made with keepSource");
+
+	XMMATRIX toBatch = XMLoadFloat4x4(&part.partToBatch);
+	XMVECTOR det;
+	XMMATRIX normalToBatch = XMMatrixTranspose(XMMatrixInverse(&det, toBatch));
+	bool mirrored = XMVectorGetX(det) < 0;
+
+	unsigned int base = (unsigned int)verts.size();
+	for (const Vertex& src : sourceVerts)
+	{
+		Vertex v = src;
+		XMStoreFloat3(&v.Position, XMVector3Transform(XMLoadFloat3(&src.Position), toBatch));
+		XMStoreFloat3(&v.normal, XMVector3Normalize(XMVector3TransformNormal(XMLoadFloat3(&src.normal), normalToBatch)));
+		XMStoreFloat3(&v.tangent, XMVector3Normalize(XMVector3TransformNormal(XMLoadFloat3(&src.tangent), toBatch)));
+		verts.push_back(v);
+	}
+
+	for (size_t i = 0; i + 2 < sourceIndices.size(); i += 3)
+	{
+		indices.push_back(base + sourceIndices[i]);
+		indices.push_back(base + sourceIndices[mirrored ? i + 2 : i + 1]);
+		indices.push_back(base + sourceIndices[mirrored ? i + 1 : i + 2]);
+	}
+}
@@ -0,0 +1,87 @@
+#pragma once
+#include <DirectXMath.h>
+#include <memory>
+#include <vector>
+#include "Mesh.h"
+#include "Material.h"
+#include "gameEntity.h"
+
+// --------------------------------------------------------
+// Numbers from the last Build()
+// --------------------------------------------------------
+struct StaticBatchStats
+{
+	unsigned int parts;				// Draws the parts took on their own
+	unsigned int groups;			// Draws the batch takes, one per material
+	unsigned int vertexCount;
+	unsigned int indexCount;
+
+	// GPU buffer bytes of the batched meshes, and of the distinct
+	// meshes the parts drew from (a mesh shared by parts counts once)
+	unsigned int batchBytes;
+	unsigned int sourceBytes;
+
+	float maxPositionError;			// Of the batched meshes' compact vertices
+	double buildMilliseconds;
+};
+
+// --------------------------------------------------------
+// One draw of the batch: a mesh with every part that uses
+// the material, already placed in the batch's space
+// --------------------------------------------------------
+struct StaticBatchGroup
+{
+	Material* material;
+	Mesh* mesh;
+};
+
+// --------------------------------------------------------
+// Static batching.  Parts that never move relative to each
+// other are pre-transformed into the batch's space and merged
+// into one vertex and index buffer per material, so the whole
+// set draws with one draw per material, placed by a single
+// transform.
+//
+// The batch only holds geometry: anything with the same layout
+// can share it, each drawing the groups' meshes with its own
+// transform.  Normals go through the inverse transpose, so
+// non-uniformly scaled parts light correctly.
+// --------------------------------------------------------
+class StaticBatch
+{
+public:
+	StaticBatch();
+	~StaticBatch();
+
+	// Adds a part, placed by partToBatch
+	void Add(Mesh* mesh, Material* material, const DirectX::XMFLOAT4X4& partToBatch);
+
+	// Adds an entity's mesh and material, placed where it sits
+	// relative to batchWorld
+	void Add(gameEntity* part, const DirectX::XMFLOAT4X4& batchWorld);
+
+	// Merges the parts added so far into the groups' meshes,
+	// suballocated from arena if one is given.  The parts' meshes
+	// must have kept their source; the groups' meshes keep theirs
+	// only with keepSource
+	void Build(RenderBackend* backend, MeshVertexFormat format, GeometryArena* arena = 0, bool keepSource = false);
+
+	const std::vector<StaticBatchGroup>& GetGroups() { return groups; }
+	const StaticBatchStats& GetStats() { return stats; }
+
+private:
+	struct Part
+	{
+		Mesh* mesh;
+		Material* material;
+		DirectX::XMFLOAT4X4 partToBatch;
+	};
+
+	std::vector<Part> parts;
+	std::vector<StaticBatchGroup> groups;
+	std::vector<std::unique_ptr<Mesh>> meshes;
+	StaticBatchStats stats;
+
+	// Appends a part's vertices and indices in the batch's space
+	static void AppendPart(const Part& part, std::vector<Vertex>& verts, std::vector<unsigned int>& indices);
+};
@@ -0,0 +1,11 @@
+#include "FrameGovernorTraces.h"
+
+// --------------------------------------------------------
+// The frame governor traces on their own, without the app
+// or a device.  Exits non-zero if any trace fails, so ctest
+// (or any CI) can run it headless.
+// --------------------------------------------------------
+int main()
+{
+	return RunFrameGovernorTraces() ? 0 : 1;
+}
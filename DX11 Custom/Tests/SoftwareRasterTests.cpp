@@ -0,0 +1,41 @@
+#include "SoftwareRasterScene.h"
+#include <stdio.h>
+#include <vector>
+
+// --------------------------------------------------------
+// The software rasterizer's test scene on one thread and on
+// several.  Each tile sees its triangles in submission order
+// however the work is split, so the images must match to the
+// byte.  Exits non-zero if they don't, or nothing was drawn.
+// --------------------------------------------------------
+int main()
+{
+	const unsigned int width = 320;
+	const unsigned int height = 180;
+	const unsigned int threads[] = { 1, 3, 4 };
+	const unsigned int runs = sizeof(threads) / sizeof(threads[0]);
+
+	SoftwareRasterScene scene(100, width, height);
+	SoftwareRasterizer rasterizer(width, height, 1);
+
+	std::vector<unsigned char> images[runs];
+	bool pass = true;
+	for (unsigned int r = 0; r < runs; r++)
+	{
+		rasterizer.SetThreadCount(threads[r]);
+
+		// Twice, so the second frame reuses the pool's workers
+		scene.Draw(rasterizer);
+		scene.Draw(rasterizer);
+		images[r].assign(rasterizer.GetPixels(), rasterizer.GetPixels() + width * height * 4);
+
+		const SoftwareRasterizerStats& stats = rasterizer.GetStats();
+		bool match = images[r] == images[0];
+		printf("  %u thread%s: %u triangles, %llu pixels shaded, image %s\n", threads[r], threads[r] == 1 ? " " : "s",
+			stats.triangles, (unsigned long long)stats.pixelsShaded, match ? "matches" : "differs");
+		pass &= stats.pixelsShaded > 0 && match;
+	}
+
+	printf("Software raster images - %s\n", pass ? "PASS" : "FAIL");
+	return pass ? 0 : 1;
+}
@@ -0,0 +1,60 @@
+#include "Texels.h"
+#include <math.h>
+
+// Every 8 bit value's linear float
+struct SRGBDecodeTable
+{
+	float values[256];
+
+	SRGBDecodeTable()
+	{
+		for (unsigned int i = 0; i < 256; i++)
+		{
+			float c = i / 255.0f;
+			values[i] = c <= 0.04045f ? c / 12.92f : powf((c + 0.055f) / 1.055f, 2.4f);
+		}
+	}
+};
+
+float SRGBToLinear(unsigned char value)
+{
+	// Built on first use.  Callers are on worker threads too,
+	// and a local static is only ever built once.
+	static const SRGBDecodeTable table;
+	return table.values[value];
+}
+
+unsigned char LinearToSRGB(float value)
+{
+	if (value <= 0.0f) return 0;
+	if (value >= 1.0f) return 255;
+	float c = value <= 0.0031308f ? value * 12.92f : 1.055f * powf(value, 1.0f / 2.4f) - 0.055f;
+	return (unsigned char)(c * 255.0f + 0.5f);
+}
+
+void DownsampleMip(const unsigned char* src, unsigned int srcSize, unsigned int channels, unsigned char* dst, bool srgb)
+{
+	unsigned int dstSize = srcSize / 2;
+	unsigned int pitch = srcSize * channels;
+	unsigned int linearChannels = srgb ? 3 : 0;
+	for (unsigned int y = 0; y < dstSize; y++)
+	{
+		const unsigned char* row0 = src + (y * 2) * pitch;
+		const unsigned char* row1 = row0 + pitch;
+		for (unsigned int x = 0; x < dstSize; x++)
+		{
+			const unsigned char* a = row0 + x * 2 * channels;
+			const unsigned char* b = row1 + x * 2 * channels;
+			for (unsigned int c = 0; c < linearChannels; c++)
+			{
+				float sum = SRGBToLinear(a[c]) + SRGBToLinear(a[channels + c]) + SRGBToLinear(b[c]) + SRGBToLinear(b[channels + c]);
+				dst[(y * dstSize + x) * channels + c] = LinearToSRGB(sum * 0.25f);
+			}
+			for (unsigned int c = linearChannels; c < channels; c++)
+			{
+				unsigned int sum = a[c] + a[channels + c] + b[c] + b[channels + c];
+				dst[(y * dstSize + x) * channels + c] = (unsigned char)((sum + 2) / 4);
+			}
+		}
+	}
+}
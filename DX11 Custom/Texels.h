@@ -0,0 +1,17 @@
+#pragma once
+
+// --------------------------------------------------------
+// 8 bit texel helpers shared by the material atlas's cook,
+// the environment lighting's decode and the software
+// rasterizer.  No D3D, so the CPU-only code can use them.
+// --------------------------------------------------------
+
+// The exact sRGB curve the hardware applies to 8 bit channels.
+// Linear values are clamped to [0, 1] on the way back, as the
+// output merger does.
+float SRGBToLinear(unsigned char value);
+unsigned char LinearToSRGB(float value);
+
+// Box-filters one square mip level to the next (half size).
+// With srgb, the first 3 channels are averaged in linear space.
+void DownsampleMip(const unsigned char* src, unsigned int srcSize, unsigned int channels, unsigned char* dst, bool srgb = false);
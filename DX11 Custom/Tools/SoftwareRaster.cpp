@@ -0,0 +1,62 @@
+#include "SoftwareRasterScene.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// --------------------------------------------------------
+// Draws the software rasterizer's test scene with no window
+// or device, prints each stage's average time and saves the
+// last frame.
+//
+//   SoftwareRaster [out.ppm] [width height] [cubes] [threads] [frames]
+//
+// threads 0 is one per core.
+// --------------------------------------------------------
+int main(int argc, char** argv)
+{
+	const char* file = argc > 1 ? argv[1] : "software.ppm";
+	unsigned int width = argc > 3 ? (unsigned int)atoi(argv[2]) : 1280;
+	unsigned int height = argc > 3 ? (unsigned int)atoi(argv[3]) : 720;
+	unsigned int cubes = argc > 4 ? (unsigned int)atoi(argv[4]) : 400;
+	unsigned int threads = argc > 5 ? (unsigned int)atoi(argv[5]) : 0;
+	unsigned int frames = argc > 6 ? (unsigned int)atoi(argv[6]) : 10;
+	if (width == 0 || height == 0 || frames == 0)
+	{
+		printf("usage: %s [out.ppm] [width height] [cubes] [threads] [frames]\n", argv[0]);
+		return 1;
+	}
+
+	SoftwareRasterScene scene(cubes, width, height);
+	SoftwareRasterizer rasterizer(width, height, threads);
+
+	SoftwareRasterizerStats sums;
+	memset(&sums, 0, sizeof(sums));
+	for (unsigned int f = 0; f < frames; f++)
+	{
+		scene.Draw(rasterizer);
+
+		const SoftwareRasterizerStats& stats = rasterizer.GetStats();
+		sums.vertexMilliseconds += stats.vertexMilliseconds / frames;
+		sums.binMilliseconds += stats.binMilliseconds / frames;
+		sums.rasterMilliseconds += stats.rasterMilliseconds / frames;
+		sums.resolveMilliseconds += stats.resolveMilliseconds / frames;
+		sums.totalMilliseconds += stats.totalMilliseconds / frames;
+	}
+
+	const SoftwareRasterizerStats& stats = rasterizer.GetStats();
+	printf("Software raster: %u frames at %ux%u, %u tiles on %u threads\n",
+		frames, width, height, stats.tiles, stats.threads);
+	printf("  per frame: %u draws, %u triangles (%u clipped, %u culled), %llu pixels shaded\n",
+		stats.draws, stats.triangles, stats.trianglesClipped, stats.trianglesCulled, (unsigned long long)stats.pixelsShaded);
+	printf("  vertex %.3f ms, bin %.3f ms, raster %.3f ms, resolve %.3f ms, total %.3f ms\n",
+		sums.vertexMilliseconds, sums.binMilliseconds, sums.rasterMilliseconds,
+		sums.resolveMilliseconds, sums.totalMilliseconds);
+
+	if (!rasterizer.SavePPM(file))
+	{
+		printf("Couldn't write %s\n", file);
+		return 1;
+	}
+	printf("Saved %s\n", file);
+	return 0;
+}
@@ -1,6 +1,4 @@
 #include "Transform.h"
-#include <wrl/event.h>
-#include <d3d11.h>
 
 using namespace DirectX;
 
@@ -11,6 +9,7 @@ Transform::Transform()
 	scale = DirectX::XMFLOAT3(1,1,1);
 	rotation = DirectX::XMFLOAT3(0,0,0);
 	XMStoreFloat4x4(&world, DirectX::XMMatrixIdentity());
+	XMStoreFloat4x4(&worldInverseTranspose, DirectX::XMMatrixIdentity());
 	matrixDirty = false;
 }
 
@@ -56,6 +55,19 @@ DirectX::XMFLOAT3 Transform::GetScale()
 }
 
 DirectX::XMFLOAT4X4 Transform::GetWorldMatrix()
+{
+	UpdateMatrices();
+	return world;
+}
+
+DirectX::XMFLOAT4X4 Transform::GetWorldInverseTransposeMatrix()
+{
+	UpdateMatrices();
+	return worldInverseTranspose;
+}
+
+//rebuilds both matrices together, only after something moved
+void Transform::UpdateMatrices()
 {
 	if (matrixDirty) 
 	{
@@ -64,10 +76,9 @@ DirectX::XMFLOAT4X4 Transform::GetWorldMatrix()
 		DirectX::XMMATRIX sc = DirectX::XMMatrixScaling(scale.x, scale.y, scale.z);
 		DirectX::XMMATRIX w = sc * rotate * trans;
 		DirectX::XMStoreFloat4x4(&world, w);
+		DirectX::XMStoreFloat4x4(&worldInverseTranspose, DirectX::XMMatrixTranspose(DirectX::XMMatrixInverse(0, w)));
 		matrixDirty = false;
 	}
-	
-	return world;
 }
 
 void Transform::MoveAbsolute(float x, float y, float z)
@@ -105,6 +116,7 @@ void Transform::MoveRelative(float x, float y, float z)
 	XMVECTOR quat = XMQuaternionRotationRollPitchYaw(rotation.x, rotation.y, rotation.z);
 	XMVECTOR relative = XMVector3Rotate(vect, quat);
 	XMStoreFloat3(&position, XMLoadFloat3(&position) + relative);
+	matrixDirty = true;
 
 }
 
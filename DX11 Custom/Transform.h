@@ -1,15 +1,13 @@
 #pragma once
 #include <DirectXMath.h>
-#include <wrl/event.h>
-#include <d3d11.h>
-#include <DirectXMath.h>
-#include "DXCore.h"
 
 
 class Transform
 {
 public:
 	DirectX::XMFLOAT4X4 world;
+	//transforms normals, rebuilt with world
+	DirectX::XMFLOAT4X4 worldInverseTranspose;
 	DirectX::XMFLOAT3 position;
 	DirectX::XMFLOAT3 scale;
 	DirectX::XMFLOAT3 rotation;
@@ -26,12 +24,16 @@ public:
 	DirectX::XMFLOAT3 GetPitchYawRoll();
 	DirectX::XMFLOAT3 GetScale();
 	DirectX::XMFLOAT4X4 GetWorldMatrix();
+	DirectX::XMFLOAT4X4 GetWorldInverseTransposeMatrix();
 
 	void MoveAbsolute(float x, float y, float z);
 	void Rotate(float pitch, float yaw, float roll);
 	void Scale(float x, float y, float z);
 
 	void MoveRelative(float x, float y, float z);
+
+private:
+	void UpdateMatrices();
 	
 };
 
@@ -13,4 +13,23 @@ struct Vertex
 	DirectX::XMFLOAT3 normal;
 	DirectX::XMFLOAT2 uv;
 	DirectX::XMFLOAT3 tangent;
-};
\ No newline at end of file
+};
+
+// --------------------------------------------------------
+// The optional compact vertex, 20 bytes to Vertex's 44:
+//  - position as half floats (w = 1)
+//  - normal octahedral encoded, 16 bit snorm
+//  - uv as half floats
+//  - tangent octahedral encoded in xy, 8 bit snorm, with its
+//    handedness in w
+// Matches VertexShaderInput in MaterialVS.hlsl when
+// USE_COMPACT_VERTICES is on; its input layout is in
+// VertexLayouts.h.
+// --------------------------------------------------------
+struct CompactVertex
+{
+	unsigned short Position[4];
+	short normal[2];
+	unsigned short uv[2];
+	signed char tangent[4];
+};
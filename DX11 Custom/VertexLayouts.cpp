@@ -0,0 +1,9 @@
+#include "VertexLayouts.h"
+
+const InputElementDesc CompactVertexElements[COMPACT_VERTEX_ELEMENT_COUNT] =
+{
+	{ "POSITION", 0, DXGI_FORMAT_R16G16B16A16_FLOAT, 0, 0, false, 0 },
+	{ "NORMAL", 0, DXGI_FORMAT_R16G16_SNORM, 0, 8, false, 0 },
+	{ "TEXCOORD", 0, DXGI_FORMAT_R16G16_FLOAT, 0, 12, false, 0 },
+	{ "TANGENT", 0, DXGI_FORMAT_R8G8B8A8_SNORM, 0, 16, false, 0 },
+};
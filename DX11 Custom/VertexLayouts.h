@@ -0,0 +1,14 @@
+#pragma once
+#include "RenderBackend.h"
+
+// --------------------------------------------------------
+// Input layouts for the vertex structs in Vertex.h, kept
+// apart so code that only needs the structs (the software
+// rasterizer) doesn't pull in the render backend
+// --------------------------------------------------------
+
+// Formats of the compact vertex's elements, by semantic.  Vertex
+// shaders loaded with these take them over the float formats
+// reflection would give their inputs.
+#define COMPACT_VERTEX_ELEMENT_COUNT	4
+extern const InputElementDesc CompactVertexElements[COMPACT_VERTEX_ELEMENT_COUNT];
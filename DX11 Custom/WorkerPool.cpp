@@ -0,0 +1,105 @@
+#include "WorkerPool.h"
+
+WorkerPool::WorkerPool(unsigned int threadCount)
+{
+	this->threadCount = 1;
+	workGeneration = 0;
+	workersBusy = 0;
+	activeThreads = 0;
+	stopping = false;
+	job = 0;
+	SetThreadCount(threadCount);
+}
+
+WorkerPool::~WorkerPool()
+{
+	StopWorkers();
+}
+
+unsigned int WorkerPool::GetCoreCount()
+{
+	unsigned int count = std::thread::hardware_concurrency();
+	return count > 0 ? count : 1;
+}
+
+void WorkerPool::SetThreadCount(unsigned int count)
+{
+	if (count == 0)
+		count = GetCoreCount();
+
+	StopWorkers();
+	threadCount = count;
+	for (unsigned int t = 1; t < count; t++)
+		workers.emplace_back(&WorkerPool::WorkerLoop, this, t, workGeneration);
+}
+
+void WorkerPool::StopWorkers()
+{
+	{
+		std::lock_guard<std::mutex> lock(workMutex);
+		stopping = true;
+	}
+	workReady.notify_all();
+
+	for (auto& w : workers)
+		w.join();
+	workers.clear();
+	stopping = false;
+}
+
+// --------------------------------------------------------
+// Each worker waits for a new generation of work, runs its
+// part if it has one and reports back.  It starts from the
+// generation current when SetThreadCount() made it, so it
+// neither reruns an old batch nor misses the first new one
+// posted before it gets the lock.
+// --------------------------------------------------------
+void WorkerPool::WorkerLoop(unsigned int thread, unsigned int seen)
+{
+	std::unique_lock<std::mutex> lock(workMutex);
+	for (;;)
+	{
+		workReady.wait(lock, [&]() { return stopping || workGeneration != seen; });
+		if (stopping)
+			return;
+		seen = workGeneration;
+
+		if (thread < activeThreads)
+		{
+			const std::function<void(unsigned int)>* current = job;
+			lock.unlock();
+			(*current)(thread);
+			lock.lock();
+		}
+
+		if (--workersBusy == 0)
+			workDone.notify_one();
+	}
+}
+
+void WorkerPool::Run(const std::function<void(unsigned int thread)>& job, unsigned int threads)
+{
+	if (threads > threadCount)
+		threads = threadCount;
+	if (threads <= 1)
+	{
+		if (threads == 1)
+			job(0);
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(workMutex);
+		this->job = &job;
+		activeThreads = threads;
+		workersBusy = (unsigned int)workers.size();
+		workGeneration++;
+	}
+	workReady.notify_all();
+
+	job(0);
+
+	std::unique_lock<std::mutex> lock(workMutex);
+	workDone.wait(lock, [&]() { return workersBusy == 0; });
+	this->job = 0;
+}
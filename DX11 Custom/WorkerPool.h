@@ -0,0 +1,70 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// --------------------------------------------------------
+// A fixed pool of threads that sleep between batches of
+// work.  The thread calling Run() works too, as thread 0, so
+// a pool of one thread has no workers and runs everything
+// inline.
+//
+// Each batch bumps a generation number that the workers wait
+// on.  A worker starts at the generation current when it was
+// made, so one started after earlier batches won't take an
+// old batch for a new one.
+// --------------------------------------------------------
+class WorkerPool
+{
+public:
+	// threadCount - 0 for one per core
+	WorkerPool(unsigned int threadCount = 0);
+	~WorkerPool();
+
+	// Restarts the pool with this many threads (0 for one per
+	// core).  Not while a batch is running.
+	void SetThreadCount(unsigned int count);
+	unsigned int GetThreadCount() { return threadCount; }
+
+	// One per core, at least 1
+	static unsigned int GetCoreCount();
+
+	// Calls job(thread) once on each of the first threads
+	// (thread 0 being the caller) and waits for them all
+	void Run(const std::function<void(unsigned int thread)>& job, unsigned int threads);
+
+	// Runs job(index, thread) for every index below count and
+	// waits.  Indices are handed out one at a time, so a thread
+	// with quick jobs takes more of them rather than waiting on
+	// a fixed share.
+	template<typename Job> void ParallelFor(unsigned int count, const Job& job);
+
+private:
+	unsigned int threadCount;
+	std::vector<std::thread> workers;
+	std::mutex workMutex;
+	std::condition_variable workReady;
+	std::condition_variable workDone;
+	unsigned int workGeneration;
+	unsigned int workersBusy;
+	unsigned int activeThreads;
+	bool stopping;
+	const std::function<void(unsigned int)>* job;
+
+	void WorkerLoop(unsigned int thread, unsigned int seen);
+	void StopWorkers();
+};
+
+template<typename Job>
+void WorkerPool::ParallelFor(unsigned int count, const Job& job)
+{
+	std::atomic<unsigned int> next(0);
+	Run([&](unsigned int thread)
+	{
+		for (unsigned int i = next++; i < count; i = next++)
+			job(i, thread);
+	}, count);
+}
@@ -1,7 +1,8 @@
 #include "gameEntity.h"
-#include "bufferStructs.h"
+#include "ShaderConstants.h"
 #include "Material.h"
 #include "Camera.h"
+#include <string.h>
 
 gameEntity::gameEntity(Mesh* obj, Material* material, bool isStationary) 
 {
@@ -10,9 +11,9 @@ gameEntity::gameEntity(Mesh* obj, Material* material, bool isStationary)
 	tObj = Transform();
 	this->mat = material;
 	stationary = isStationary;
-	if (!isStationary) {
-		isActive = false;
-	}
+	isOccluder = false;
+	//stationary entities are drawn until something turns them off
+	isActive = isStationary;
 	
 	
 }
@@ -34,45 +35,72 @@ Transform* gameEntity::GetTransform()
 }
 
 //draw function called in draw/game.cpp
-void gameEntity::draw(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, UINT stride, UINT offset, Camera* cam)
+void gameEntity::draw(StateCache* state, Camera* cam)
 {
-	//setting shaders from material with simpleshader
+	//setting shaders from material with simpleshader, already bound
+	//by the pso so this only binds their constant buffers
 
 	mat->getVertex()->SetShader();
 	mat->getPixel()->SetShader();
 
-	//set srv and sampler in pixel shader
-	mat->getPixel()->SetShaderResourceView("Albedo", mat->getSRV().Get());
-	mat->getPixel()->SetSamplerState("samplerOptions", mat->getSampler().Get());
+	//set srvs and sampler in pixel shader, the table only holds
+	//the maps the material's variant samples
+	SimplePixelShader* ps = mat->getPixel();
+	const MaterialBindings& matBindings = mat->GetBindings();
+	for (unsigned int i = 0; i < matBindings.textureCount; i++)
+		ps->SetShaderResourceView(matBindings.textures[i].handle, matBindings.textures[i].srv);
+	ps->SetSamplerState(matBindings.samplerHandle, matBindings.sampler);
 
-	//if texture has a normal, set normal map in pixel shader
-	if (mat->hasNormal) {
-		mat->getPixel()->SetShaderResourceView("NormalMap", mat->normalMap.Get());
-	}
+	//bind the staged table (with the per frame cluster and environment maps)
+	//in contiguous runs, the state cache drops the slots that didn't change
+	ps->FlushBindings();
 
-	mat->getPixel()->SetShaderResourceView("RoughnessMap", mat->roughnessMap.Get());
-	mat->getPixel()->SetShaderResourceView("MetalnessMap", mat->metalMap.Get());
+	//set the values of the vertex shader and copy buffer data
+	setVertexData(cam);
+	
+	//set vertex and index buffers (skipped by the state cache if already bound,
+	//as they are between meshes sharing the geometry arena)
+	const MeshBindings& mesh = meshObj->GetBindings();
+	state->IASetVertexBuffers(0, 1, &mesh.vertexBuffer, &mesh.stride, &mesh.offset);
+	state->IASetIndexBuffer(mesh.indexBuffer, mesh.indexFormat, 0);
 
+	//draw entity, from where the mesh sits in its buffers
+	state->DrawIndexed(
+		mesh.indexCount,     
+		mesh.startIndex,    
+		mesh.baseVertex);
+	
+}
 
+//draw function for the depth prepass, the same vertex shader as draw() so the depth matches exactly
+void gameEntity::drawDepth(StateCache* state, Camera* cam)
+{
+	//no pixel shader (the depth only pso has none), only depth is written
+	mat->getVertex()->SetShader();
+	setVertexData(cam);
 
-	//set the values of the vertex shader 
-	SimpleVertexShader* vs = mat->getVertex(); 
-	vs->SetFloat4("colorTint", mat->getTint());
-	vs->SetMatrix4x4("world", tObj.GetWorldMatrix());
-	vs->SetMatrix4x4("view", cam->getView());
-	vs->SetMatrix4x4("proj", cam->getProj());
+	const MeshBindings& mesh = meshObj->GetBindings();
+	state->IASetVertexBuffers(0, 1, &mesh.vertexBuffer, &mesh.stride, &mesh.offset);
+	state->IASetIndexBuffer(mesh.indexBuffer, mesh.indexFormat, 0);
 
-	//copy buffer data
-	vs->CopyAllBufferData();
-	
-	//set vertex and index buffers
-	context->IASetVertexBuffers(0, 1, meshObj->GetVertexBuffer().GetAddressOf(), &stride, &offset);
-	context->IASetIndexBuffer(meshObj->GetIndexBuffer().Get(), DXGI_FORMAT_R32_UINT, 0);
+	state->DrawIndexed(
+		mesh.indexCount,
+		mesh.startIndex,
+		mesh.baseVertex);
+}
 
-	//draw entity
-	context->DrawIndexed(
-		meshObj->GetIndexCount(),     
-		0,    
-		0);
-	
+//the whole cbuffer in one copy, the padding zeroed so unchanged data compares equal
+void gameEntity::setVertexData(Camera* cam)
+{
+	MaterialVSExternalData data;
+	memset(&data, 0, sizeof(data));
+	data.colorTint = mat->colorTint;
+	data.world = tObj.GetWorldMatrix();
+	data.worldInverseTranspose = tObj.GetWorldInverseTransposeMatrix();
+	data.viewProj = cam->getViewProj();
+	data.materialSlice = mat->atlasSlice;	//only read by atlas variants
+
+	SimpleVertexShader* vs = mat->getVertex();
+	vs->SetBufferData(mat->vertexDataHandle, data);
+	vs->CopyAllBufferData();
 }
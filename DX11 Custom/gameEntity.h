@@ -3,6 +3,7 @@
 #include "Transform.h"
 #include "Material.h"
 #include "Camera.h"
+#include "StateCache.h"
 class gameEntity
 {
 public:
@@ -15,9 +16,20 @@ public:
 	Transform* GetTransform();
 	
 	bool isActive;
+
+	//drawn into the software occlusion buffer to hide what's behind it
+	bool isOccluder;
 	
-	void draw(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, UINT stide, UINT offset, Camera* cam);
+	//binds from the material's and mesh's baked tables, no refcounting
+	void draw(StateCache* state, Camera* cam);
+
+	//depth prepass version, vertex shader only
+	void drawDepth(StateCache* state, Camera* cam);
 
 	Material* mat;
+
+private:
+	//fills and uploads the vertex shader's whole cbuffer
+	void setVertexData(Camera* cam);
 };
 
@@ -0,0 +1,262 @@
+#!/usr/bin/env python3
+# Generates ShaderConstants.h: a C++ struct for every cbuffer the
+# shaders below declare, laid out by HLSL's packing rules with the
+# padding spelled out, and static_asserts on every member's offset
+# and each struct's size so a mismatch fails the C++ build.
+#
+#   ./generate_shader_constants.py [path/to/dxc]          rewrites the header
+#   ./generate_shader_constants.py --check [path/to/dxc]  fails if it is stale
+#
+# The Visual Studio project runs --check (with the Windows SDK's dxc)
+# before compiling, so a stale header fails the build.
+#
+# Each shader is run through DXC's preprocessor twice, with every
+# feature in MaterialCommon.hlsli on and then off.  A cbuffer has to
+# come out the same both times: variants share the C++ structs, so
+# its layout can't depend on the features.
+
+import os
+import re
+import subprocess
+import sys
+import tempfile
+
+DIR = os.path.dirname(os.path.abspath(__file__))
+OUTPUT = "ShaderConstants.h"
+
+# Shader file, prefix for its cbuffers' struct names
+SHADERS = [
+	("MaterialVS.hlsl", "MaterialVS"),
+	("MaterialPS.hlsl", "MaterialPS"),
+	("vertexShaderSky.hlsl", "SkyVS"),
+	("pixelShaderUpscale.hlsl", "UpscalePS"),
+]
+
+FEATURES_ON = ["HAS_NORMAL_MAP=1", "HAS_PBR_MAPS=1", "NUM_DIR_LIGHTS=3", "NUM_POINT_LIGHTS=3",
+	"USE_INSTANCING=1", "USE_CLUSTERED_LIGHTS=1", "USE_MATERIAL_ATLAS=1", "USE_COMPACT_VERTICES=1",
+	"USE_IMAGE_LIGHTING=1"]
+FEATURES_OFF = ["HAS_NORMAL_MAP=0", "HAS_PBR_MAPS=0", "NUM_DIR_LIGHTS=0", "NUM_POINT_LIGHTS=0",
+	"USE_INSTANCING=0", "USE_CLUSTERED_LIGHTS=0", "USE_MATERIAL_ATLAS=0", "USE_COMPACT_VERTICES=0",
+	"USE_IMAGE_LIGHTING=0"]
+
+# HLSL scalar, component size and C++ type
+SCALARS = {"float": "float", "int": "int", "uint": "unsigned int", "bool": "int", "dword": "unsigned int"}
+VECTORS = {"float": "DirectX::XMFLOAT", "int": "DirectX::XMINT", "uint": "DirectX::XMUINT"}
+MATRICES = {"float4x4": "DirectX::XMFLOAT4X4", "matrix": "DirectX::XMFLOAT4X4"}
+
+
+class LayoutError(Exception):
+	pass
+
+
+def preprocess(dxc, shader, defines):
+	with tempfile.TemporaryDirectory() as out:
+		target = os.path.join(out, "preprocessed.hlsl")
+		command = [dxc, "-nologo", "-P", "-Fi", target, "-I", DIR]
+		for define in defines:
+			command += ["-D", define]
+		command.append(os.path.join(DIR, shader))
+		result = subprocess.run(command, stdout=subprocess.PIPE, stderr=subprocess.STDOUT, universal_newlines=True)
+		if result.returncode != 0:
+			raise LayoutError("%s failed to preprocess:\n%s" % (shader, result.stdout))
+		with open(target) as f:
+			source = f.read()
+
+	# Line markers, and any comments the preprocessor kept
+	source = re.sub(r"^\s*#.*$", "", source, flags=re.M)
+	source = re.sub(r"//.*$", "", source, flags=re.M)
+	return re.sub(r"/\*.*?\*/", "", source, flags=re.S)
+
+
+def parse_members(body, where):
+	members = []
+	for declaration in body.split(";"):
+		declaration = re.sub(r":.*$", "", declaration.strip(), flags=re.S)
+		if not declaration:
+			continue
+		match = re.match(r"^((?:\w+\s+)*)(\w+)\s+(\w+)\s*(?:\[\s*(\d+)\s*\])?$", " ".join(declaration.split()))
+		if not match:
+			raise LayoutError("%s: can't parse '%s'" % (where, declaration))
+		modifiers = match.group(1).split()
+		if "row_major" in modifiers:
+			raise LayoutError("%s: row_major %s isn't supported" % (where, match.group(3)))
+		members.append((match.group(2), match.group(3), int(match.group(4)) if match.group(4) else 0))
+	return members
+
+
+def parse(source):
+	structs = {}
+	for match in re.finditer(r"\bstruct\s+(\w+)\s*\{(.*?)\}\s*;", source, re.S):
+		structs[match.group(1)] = match.group(2)
+	cbuffers = []
+	for match in re.finditer(r"\bcbuffer\s+(\w+)\s*(?::\s*register\s*\(\s*b(\d+)\s*\))?\s*\{(.*?)\}", source, re.S):
+		cbuffers.append((match.group(1), int(match.group(2) or 0), match.group(3)))
+	return structs, cbuffers
+
+
+def align(offset, alignment):
+	return (offset + alignment - 1) // alignment * alignment
+
+
+class Layouts:
+	def __init__(self):
+		self.structs = {}		# Name to (members, size), in the order they're needed
+		self.bodies = {}		# Name to the source the layout came from
+		self.sources = {}		# The current shader's structs
+
+	# (size, starts on a register, C++ type) of one element
+	def type_info(self, name, where):
+		if name in SCALARS:
+			return 4, False, SCALARS[name]
+		if name in MATRICES:
+			return 64, True, MATRICES[name]
+		match = re.match(r"^(float|int|uint)([1-4])$", name)
+		if match:
+			count = int(match.group(2))
+			return 4 * count, False, (VECTORS[match.group(1)] + str(count)) if count > 1 else SCALARS[match.group(1)]
+		if name in self.sources:
+			return self.struct_layout(name)[1], True, name
+		raise LayoutError("%s: unsupported type %s" % (where, name))
+
+	def struct_layout(self, name):
+		body = " ".join(self.sources[name].split())
+		if name in self.bodies and self.bodies[name] != body:
+			raise LayoutError("struct %s differs between shaders or features" % name)
+		if name not in self.structs:
+			self.bodies[name] = body
+			self.structs[name] = None
+			self.structs[name] = self.pack(parse_members(self.sources[name], name), name)
+		if self.structs[name] is None:
+			raise LayoutError("%s contains itself" % name)
+		return self.structs[name]
+
+	# Offsets of each member, and the packed size
+	#  - nothing straddles a 16 byte register
+	#  - structs, arrays and matrices start on a register
+	#  - array elements are a whole number of registers apart
+	def pack(self, members, where):
+		packed = []
+		offset = 0
+		startsRegister = False
+		for type, name, count in members:
+			size, aligned, cppType = self.type_info(type, "%s.%s" % (where, name))
+			if count > 0:
+				stride = align(size, 16)
+				if stride != size:
+					raise LayoutError("%s.%s: array elements of %d bytes are padded to %d in HLSL, use a float4 or pad the struct" % (where, name, size, stride))
+				size = stride * count
+				aligned = True
+			if aligned or offset % 16 + size > 16:
+				position = align(offset, 16)
+			else:
+				position = offset
+			# A struct's size isn't rounded up to a register, so what
+			# follows one could pack into its last register; HLSL
+			# compilers don't agree on whether it does, so don't let it
+			if startsRegister and position % 16 != 0:
+				raise LayoutError("%s.%s: packs after a struct that doesn't end on a register, pad the struct" % (where, name))
+			packed.append((cppType, name, count, position, size))
+			offset = position + size
+			startsRegister = type in self.sources and count == 0
+		return packed, offset
+
+
+def read_shader(dxc, shader, prefix, defines, layouts):
+	layouts.sources, cbuffers = parse(preprocess(dxc, shader, defines))
+	result = {}
+	for name, register, body in cbuffers:
+		members, size = layouts.pack(parse_members(body, name), prefix + name)
+		result[prefix + name] = (members, size, shader, name, register)
+	return result
+
+
+def emit_struct(lines, name, members, size, comment):
+	lines.append("// " + comment)
+	lines.append("struct " + name)
+	lines.append("{")
+	offset = 0
+	pads = 0
+
+	def pad(to):
+		if to > offset:
+			lines.append("\tfloat _pad%d[%d];" % (pads, (to - offset) // 4))
+			return 1
+		return 0
+
+	for cppType, member, count, position, memberSize in members:
+		pads += pad(position)
+		lines.append("\t%s %s%s;" % (cppType, member, "[%d]" % count if count else ""))
+		offset = position + memberSize
+	pad(size)
+	lines.append("};")
+	for cppType, member, count, position, memberSize in members:
+		lines.append("static_assert(offsetof(%s, %s) == %d, \"%s.%s doesn't match HLSL\");" % (name, member, position, name, member))
+	lines.append("static_assert(sizeof(%s) == %d, \"%s doesn't match HLSL\");" % (name, size, name))
+	lines.append("")
+
+
+def generate(dxc):
+	layouts = Layouts()
+	cbuffers = {}
+	for shader, prefix in SHADERS:
+		on = read_shader(dxc, shader, prefix, FEATURES_ON, layouts)
+		off = read_shader(dxc, shader, prefix, FEATURES_OFF, layouts)
+		for name in set(on) & set(off):
+			if on[name][:2] != off[name][:2]:
+				raise LayoutError("%s's cbuffer %s changes layout with the features" % (shader, on[name][3]))
+		for name in on:
+			cbuffers[name] = on[name]
+		for name in off:
+			cbuffers.setdefault(name, off[name])
+
+	lines = [
+		"// Generated by generate_shader_constants.py - don't edit, rerun it",
+		"// after changing a cbuffer or a struct one uses.",
+		"//",
+		"// Each cbuffer's struct is its shader's prefix plus the cbuffer's",
+		"// name, padded out to the size D3D reflects for the buffer, so the",
+		"// whole thing can go to SimpleShader::SetBufferData() at once.",
+		"#pragma once",
+		"#include <DirectXMath.h>",
+		"#include <cstddef>",
+		"",
+	]
+	for name, packed in layouts.structs.items():
+		if packed is None:
+			continue
+		members, size = packed
+		emit_struct(lines, name, members, size, "HLSL struct %s, %d bytes" % (name, size))
+	for name in cbuffers:
+		members, size, shader, cbuffer, register = cbuffers[name]
+		emit_struct(lines, name, members, align(size, 16), "cbuffer %s : register(b%d) in %s" % (cbuffer, register, shader))
+	return "\n".join(lines)
+
+
+def main():
+	args = sys.argv[1:]
+	check = "--check" in args
+	args = [a for a in args if a != "--check"]
+	dxc = args[0] if args else "dxc"
+
+	try:
+		header = generate(dxc)
+	except LayoutError as e:
+		print("error: %s" % e)
+		return 1
+
+	path = os.path.join(DIR, OUTPUT)
+	current = open(path).read() if os.path.exists(path) else ""
+	if check:
+		if current != header:
+			print("%s is out of date, rerun generate_shader_constants.py" % OUTPUT)
+			return 1
+		return 0
+	if current != header:
+		with open(path, "w", newline="\n") as f:
+			f.write(header)
+		print("wrote " + OUTPUT)
+	return 0
+
+
+if __name__ == "__main__":
+	sys.exit(main())
@@ -0,0 +1,20 @@
+struct VertexToPixel {
+	float4 position		: SV_POSITION;
+	float2 uv			: TEXCOORD;
+};
+
+cbuffer ExternalData : register(b0)
+{
+	float2 uvScale;	//the part of the scene texture the scene was drawn into
+	float2 uvMax;	//the last texel centre inside it, so filtering never reads past
+}
+
+Texture2D sceneTexture : register(t0);
+SamplerState sampleState : register(s0);
+
+//stretches the scene, drawn at a fraction of the window, over the whole
+//back buffer with bilinear filtering
+float4 main(VertexToPixel input) : SV_TARGET
+{
+	return sceneTexture.Sample(sampleState, min(input.uv * uvScale, uvMax));
+}
@@ -0,0 +1,82 @@
+#!/bin/sh
+# Compiles every material shader variant with DXC, so the whole
+# define matrix in MaterialCommon.hlsli can be checked without
+# running the game (e.g. on Linux), and checks ShaderConstants.h
+# is up to date with the cbuffers.  Exits non-zero if any fail.
+#
+#   ./validate_shaders.sh [path/to/dxc]
+
+DXC=${1:-dxc}
+DIR=$(dirname "$0")
+OUT=$(mktemp -d)
+FAILED=0
+
+trap 'rm -rf "$OUT"' EXIT
+
+# The light count bounds, from LightList.h (which MaterialCommon.hlsli
+# has to match), so every count LightList can ask for is compiled
+light_bound() {
+	sed -n "s/^#define[[:space:]]*$1[[:space:]]*\([0-9][0-9]*\).*/\1/p" "$DIR/LightList.h"
+}
+MAX_DIR_LIGHTS=$(light_bound MAX_DIR_LIGHTS)
+MAX_POINT_LIGHTS=$(light_bound MAX_POINT_LIGHTS)
+if [ -z "$MAX_DIR_LIGHTS" ] || [ -z "$MAX_POINT_LIGHTS" ]; then
+	echo "Couldn't read MAX_DIR_LIGHTS and MAX_POINT_LIGHTS from LightList.h"
+	exit 1
+fi
+
+compile() {
+	# $1 = source, $2 = target, rest = defines
+	SRC=$1; TARGET=$2; shift 2
+	if ! "$DXC" -nologo -T "$TARGET" -E main -I "$DIR" "$@" -Fo "$OUT/variant.cso" "$DIR/$SRC" > "$OUT/log.txt" 2>&1; then
+		echo "FAILED: $SRC $TARGET $*"
+		cat "$OUT/log.txt"
+		FAILED=$((FAILED + 1))
+	fi
+}
+
+COUNT=0
+for NORMAL in 0 1; do
+	for INSTANCING in 0 1; do
+		for COMPACT in 0 1; do
+			compile MaterialVS.hlsl vs_6_0 -D HAS_NORMAL_MAP=$NORMAL -D USE_INSTANCING=$INSTANCING -D USE_COMPACT_VERTICES=$COMPACT
+			COUNT=$((COUNT + 1))
+
+			# The atlas always has all four maps
+			if [ $NORMAL -eq 1 ]; then
+				compile MaterialVS.hlsl vs_6_0 -D HAS_NORMAL_MAP=1 -D USE_INSTANCING=$INSTANCING -D USE_MATERIAL_ATLAS=1 -D USE_COMPACT_VERTICES=$COMPACT
+				COUNT=$((COUNT + 1))
+			fi
+		done
+	done
+
+	for PBR in 0 1; do
+		for DIRLIGHTS in $(seq 0 "$MAX_DIR_LIGHTS"); do
+			for POINTLIGHTS in $(seq 0 "$MAX_POINT_LIGHTS"); do
+				for CLUSTERED in 0 1; do
+					compile MaterialPS.hlsl ps_6_0 -D HAS_NORMAL_MAP=$NORMAL -D HAS_PBR_MAPS=$PBR \
+						-D NUM_DIR_LIGHTS=$DIRLIGHTS -D NUM_POINT_LIGHTS=$POINTLIGHTS -D USE_CLUSTERED_LIGHTS=$CLUSTERED
+					COUNT=$((COUNT + 1))
+				done
+			done
+		done
+	done
+done
+
+for CLUSTERED in 0 1; do
+	compile MaterialPS.hlsl ps_6_0 -D HAS_NORMAL_MAP=1 -D HAS_PBR_MAPS=1 -D USE_MATERIAL_ATLAS=1 -D USE_CLUSTERED_LIGHTS=$CLUSTERED
+	COUNT=$((COUNT + 1))
+done
+
+# Image based lighting on each way of getting the surface maps
+for MAPS in "-D HAS_PBR_MAPS=0" "-D HAS_PBR_MAPS=1" "-D HAS_NORMAL_MAP=1 -D HAS_PBR_MAPS=1 -D USE_MATERIAL_ATLAS=1"; do
+	compile MaterialPS.hlsl ps_6_0 $MAPS -D NUM_DIR_LIGHTS=$MAX_DIR_LIGHTS -D NUM_POINT_LIGHTS=$MAX_POINT_LIGHTS -D USE_CLUSTERED_LIGHTS=1 -D USE_IMAGE_LIGHTING=1
+	COUNT=$((COUNT + 1))
+done
+
+echo "$((COUNT - FAILED)) of $COUNT variants compiled"
+
+if ! python3 "$DIR/generate_shader_constants.py" --check "$DXC"; then
+	FAILED=$((FAILED + 1))
+fi
+[ $FAILED -eq 0 ]
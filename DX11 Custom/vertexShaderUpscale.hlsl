@@ -0,0 +1,17 @@
+struct VertexToPixel {
+	float4 position		: SV_POSITION;
+	float2 uv			: TEXCOORD;
+};
+
+//one triangle covering the screen, made from the vertex id alone, so
+//it draws with no vertex buffer or input layout
+VertexToPixel main(uint id : SV_VertexID)
+{
+	VertexToPixel output;
+
+	//uvs (0,0), (2,0) and (0,2) - the part inside the screen covers 0 to 1
+	output.uv = float2((id << 1) & 2, id & 2);
+	output.position = float4(output.uv * float2(2, -2) + float2(-1, 1), 0, 1);
+
+	return output;
+}